@@ -0,0 +1,123 @@
+/* Measure passwd and group lookups of Android IDs.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* Names and IDs that are not found by the configured NSS services are
+   synthesized from the Android ID tables.  The timings therefore include
+   the (usually failing) lookup in the files database; compare runs before
+   and after a change to see the cost of the Android part.  */
+
+#define TEST_MAIN
+#define TEST_NAME "android-ids"
+#define TEST_FUNCTION test_main
+#include <grp.h>
+#include <pwd.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench-timing.h"
+#include "json-lib.h"
+
+#define NUM_ITERS 20000
+
+struct lookup
+{
+  const char *name;
+  bool group;
+};
+
+static const struct lookup lookups[] =
+{
+  /* System IDs at both ends of the table and in the middle.  */
+  { "adb", false },
+  { "system", false },
+  { "wifi", false },
+  { "inet", true },
+  /* Per-user application IDs.  */
+  { "u0_a123", false },
+  { "u10_a123", false },
+  { "u0_a123_cache", true },
+  { "u0_i5", false },
+  /* Shared application group IDs.  */
+  { "all_a123", true },
+  /* Names that are not Android IDs at all.  */
+  { "no-such-user", false },
+};
+
+static bool
+lookup_one (const struct lookup *l)
+{
+  char buf[1024];
+
+  if (l->group)
+    {
+      struct group gr, *res;
+      return getgrnam_r (l->name, &gr, buf, sizeof buf, &res) == 0
+	     && res != NULL;
+    }
+  else
+    {
+      struct passwd pw, *res;
+      return getpwnam_r (l->name, &pw, buf, sizeof buf, &res) == 0
+	     && res != NULL;
+    }
+}
+
+static void
+bench_lookup (json_ctx_t *json_ctx, const struct lookup *l)
+{
+  timing_t start, stop, total;
+
+  /* Warm up, and load the NSS modules.  */
+  bool found = lookup_one (l);
+  for (int i = 0; i < NUM_ITERS / 10; i++)
+    lookup_one (l);
+
+  TIMING_NOW (start);
+  for (int i = 0; i < NUM_ITERS; i++)
+    lookup_one (l);
+  TIMING_NOW (stop);
+  TIMING_DIFF (total, start, stop);
+
+  json_attr_object_begin (json_ctx, l->group ? "getgrnam_r" : "getpwnam_r");
+  json_attr_string (json_ctx, "bench-variant", l->name);
+  json_attr_uint (json_ctx, "found", found);
+  json_array_begin (json_ctx, "results");
+  json_element_double (json_ctx, (double) total / (double) NUM_ITERS);
+  json_array_end (json_ctx);
+  json_attr_object_end (json_ctx);
+}
+
+int
+test_main (void)
+{
+  json_ctx_t json_ctx;
+
+  json_init (&json_ctx, 0, stdout);
+  json_document_begin (&json_ctx);
+  json_attr_string (&json_ctx, "timing_type", TIMING_TYPE);
+  json_attr_object_begin (&json_ctx, "functions");
+
+  for (size_t i = 0; i < sizeof (lookups) / sizeof (lookups[0]); i++)
+    bench_lookup (&json_ctx, &lookups[i]);
+
+  json_attr_object_end (&json_ctx);
+  json_document_end (&json_ctx);
+  return 0;
+}
+
+#include "support/test-driver.c"
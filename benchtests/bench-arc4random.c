@@ -25,6 +25,7 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/sysinfo.h>
 #include <support/support.h>
 #include <support/timespec.h>
 #include <support/xthread.h>
@@ -171,6 +172,58 @@ bench_singlethread (json_ctx_t *json_ctx)
   json_element_object_end (json_ctx);
 }
 
+struct thread_args
+{
+  uint32_t size;
+  double result;
+};
+
+static void *
+bench_thread (void *closure)
+{
+  struct thread_args *args = closure;
+  args->result = args->size == 0
+    ? bench_throughput () : bench_buf_throughput (args->size);
+  return NULL;
+}
+
+/* Measure the total throughput of one thread per CPU, all drawing
+   random bytes at the same time.  */
+static void
+bench_multithread (json_ctx_t *json_ctx)
+{
+  int nthreads = get_nprocs ();
+
+  json_element_object_begin (json_ctx);
+  json_attr_uint (json_ctx, "threads", nthreads);
+
+  json_array_begin (json_ctx, "throughput");
+  for (int i = 0; i < array_length (sizes); i++)
+    {
+      struct thread_args args[nthreads];
+      pthread_t threads[nthreads];
+
+      timer_start ();
+      for (int t = 0; t < nthreads; t++)
+	{
+	  args[t].size = sizes[i];
+	  threads[t] = xpthread_create (NULL, bench_thread, &args[t]);
+	}
+      double r = 0;
+      for (int t = 0; t < nthreads; t++)
+	{
+	  xpthread_join (threads[t]);
+	  r += args[t].result;
+	}
+      timer_stop ();
+
+      json_element_double (json_ctx, r);
+    }
+  json_array_end (json_ctx);
+
+  json_element_object_end (json_ctx);
+}
+
 static void
 run_bench (json_ctx_t *json_ctx, const char *name,
 	   char *const*fnames, size_t fnameslen,
@@ -206,6 +259,8 @@ do_test (void)
 
   run_bench (&json_ctx, "single-thread", fnames, array_length (fnames),
 	     bench_singlethread);
+  run_bench (&json_ctx, "multi-thread", fnames, array_length (fnames),
+	     bench_multithread);
 
   json_document_end (&json_ctx);
 
@@ -0,0 +1,211 @@
+/* Measure ld.so.cache lookups with and without the name hash index.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* The benchmark builds the entries, the string table and the
+   cache_extension_tag_name_hash section of a cache with NUM_ENTRIES
+   libraries in memory, laid out and sorted the way ldconfig writes them,
+   and looks up every name once per round, in random order, with the
+   binary search and with the hash index.  The cache is built and
+   searched with the functions from <dl-cache.h> which ldconfig and the
+   dynamic loader use.  A fraction of the lookups is for names which are
+   not in the cache, like the DT_NEEDED entries that are found
+   elsewhere.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench-timing.h"
+#include "json-lib.h"
+#include <dl-cache.h>
+
+#define NUM_ENTRIES	10000
+#define NUM_MISSES	(NUM_ENTRIES / 10)
+#define NUM_ROUNDS	20
+#define RAND_SEED	23
+
+static struct file_entry_new *libs;
+static char *string_table;
+static uint32_t string_table_size;
+static struct cache_name_hash *name_hash;
+
+/* The names looked up, NUM_ENTRIES present and NUM_MISSES missing
+   ones, in random order.  */
+static const char *names[NUM_ENTRIES + NUM_MISSES];
+
+static int
+compare_names (const void *a, const void *b)
+{
+  /* ldconfig sorts the entries in descending order.  */
+  return _dl_cache_libcmp (*(const char **) b, *(const char **) a);
+}
+
+/* Return the index of the first entry with the key NAME, found the way
+   search_cache does, or -1.  */
+static int
+search_binary (const char *name)
+{
+  int matched, last;
+  return _dl_cache_search_binary (string_table, string_table_size,
+				  &libs[0].entry, NUM_ENTRIES,
+				  sizeof (libs[0]), name, &matched, &last);
+}
+
+/* Likewise, the way search_cache_hashed does.  */
+static int
+search_hashed (const char *name)
+{
+  int matched, last;
+  return _dl_cache_search_hashed (string_table, string_table_size,
+				  &libs[0].entry, NUM_ENTRIES,
+				  sizeof (libs[0]), name_hash, name, &matched,
+				  &last);
+}
+
+/* Build the cache.  Entry I is lib<word>-<I>.so.<I % 7>, where the words
+   give the names a spread of common prefixes.  */
+static void
+build_cache (void)
+{
+  static const char *const words[] =
+    { "c++", "crypto", "gtk-3", "icu", "kf5", "python3.11", "qt6", "x11" };
+  const char *keys[NUM_ENTRIES];
+  size_t strings_size = 0;
+
+  for (int i = 0; i < NUM_ENTRIES + NUM_MISSES; i++)
+    {
+      char *name;
+      if (asprintf (&name, "lib%s%s-%d.so.%d",
+		    i < NUM_ENTRIES ? "" : "missing-",
+		    words[i % (sizeof words / sizeof words[0])], i, i % 7) < 0)
+	{
+	  fprintf (stderr, "### out of memory\n");
+	  exit (EXIT_FAILURE);
+	}
+      names[i] = name;
+      if (i < NUM_ENTRIES)
+	{
+	  keys[i] = name;
+	  strings_size += strlen (name) + 1;
+	}
+    }
+  qsort (keys, NUM_ENTRIES, sizeof (keys[0]), compare_names);
+
+  libs = calloc (NUM_ENTRIES, sizeof (*libs));
+  string_table = malloc (strings_size);
+  uint32_t nbuckets = _dl_cache_name_hash_buckets (NUM_ENTRIES);
+  name_hash = malloc (sizeof (struct cache_name_hash)
+		      + nbuckets * sizeof (struct cache_name_hash_bucket));
+  if (libs == NULL || string_table == NULL || name_hash == NULL)
+    {
+      fprintf (stderr, "### out of memory\n");
+      exit (EXIT_FAILURE);
+    }
+
+  /* All keys are distinct, so every entry is entered in the index.  */
+  name_hash->nbuckets = nbuckets;
+  for (uint32_t i = 0; i < nbuckets; i++)
+    name_hash->buckets[i].index = cache_name_hash_empty;
+  size_t offset = 0;
+  for (uint32_t i = 0; i < NUM_ENTRIES; i++)
+    {
+      libs[i].flags = _DL_CACHE_DEFAULT_ID;
+      libs[i].key = offset;
+      libs[i].value = offset;
+      strcpy (string_table + offset, keys[i]);
+      offset += strlen (keys[i]) + 1;
+      _dl_cache_name_hash_insert (name_hash, keys[i], i);
+    }
+  string_table_size = strings_size;
+
+  srandom (RAND_SEED);
+  for (int i = NUM_ENTRIES + NUM_MISSES - 1; i > 0; i--)
+    {
+      int j = random () % (i + 1);
+      const char *tmp = names[i];
+      names[i] = names[j];
+      names[j] = tmp;
+    }
+}
+
+/* Look up all names NUM_ROUNDS times with SEARCH, and return the time
+   per lookup.  */
+static double
+run (int (*search) (const char *))
+{
+  timing_t start, stop, elapsed;
+  int found = 0;
+
+  TIMING_NOW (start);
+  for (int round = 0; round < NUM_ROUNDS; round++)
+    for (int i = 0; i < NUM_ENTRIES + NUM_MISSES; i++)
+      found += search (names[i]) >= 0;
+  TIMING_NOW (stop);
+  TIMING_DIFF (elapsed, start, stop);
+
+  if (found != NUM_ROUNDS * NUM_ENTRIES)
+    {
+      fprintf (stderr, "### found %d names instead of %d\n",
+	       found, NUM_ROUNDS * NUM_ENTRIES);
+      exit (EXIT_FAILURE);
+    }
+  return (double) elapsed / (NUM_ROUNDS * (NUM_ENTRIES + NUM_MISSES));
+}
+
+int
+main (void)
+{
+  build_cache ();
+
+  /* Both searches have to agree on every name.  */
+  for (int i = 0; i < NUM_ENTRIES + NUM_MISSES; i++)
+    if (search_binary (names[i]) != search_hashed (names[i]))
+      {
+	fprintf (stderr, "### lookups of %s differ\n", names[i]);
+	return EXIT_FAILURE;
+      }
+
+  double binary = run (search_binary);
+  double hashed = run (search_hashed);
+
+  json_ctx_t json_ctx;
+  json_init (&json_ctx, 0, stdout);
+  json_document_begin (&json_ctx);
+
+  json_attr_string (&json_ctx, "timing_type", TIMING_TYPE);
+  json_attr_object_begin (&json_ctx, "functions");
+  json_attr_object_begin (&json_ctx, "_dl_load_cache_lookup");
+
+  json_attr_object_begin (&json_ctx, "binary-search");
+  json_attr_uint (&json_ctx, "entries", NUM_ENTRIES);
+  json_attr_uint (&json_ctx, "misses", NUM_MISSES);
+  json_attr_double (&json_ctx, "mean", binary);
+  json_attr_object_end (&json_ctx);
+
+  json_attr_object_begin (&json_ctx, "name-hash");
+  json_attr_uint (&json_ctx, "entries", NUM_ENTRIES);
+  json_attr_uint (&json_ctx, "misses", NUM_MISSES);
+  json_attr_uint (&json_ctx, "buckets", name_hash->nbuckets);
+  json_attr_double (&json_ctx, "mean", hashed);
+  json_attr_object_end (&json_ctx);
+
+  json_attr_object_end (&json_ctx);
+  json_attr_object_end (&json_ctx);
+  json_document_end (&json_ctx);
+
+  return 0;
+}
@@ -0,0 +1,27 @@
+/* Base library of bench-dl-lookup-startup.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* This plays the part of a library like libstdc++, which all the other
+   objects use.  It comes last in the global scope, so that looking up
+   its symbols has to go through all the other objects first.  */
+
+#include "bench-dl-lookup-mod.h"
+
+#define DEFINE(x)							      \
+  void bench_base_##x (void) { }
+BENCH_SYMBOLS (DEFINE)
@@ -0,0 +1,46 @@
+/* Module of bench-dl-lookup-startup, built once for each value of MOD.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* Each module defines symbols of its own and refers to all symbols of
+   the base library, both through a data relocation and a call.  */
+
+#include "bench-dl-lookup-mod.h"
+
+#define CONCAT3(a, b, c) CONCAT3_1 (a, b, c)
+#define CONCAT3_1(a, b, c) a##b##c
+
+#define DEFINE(x)							      \
+  void CONCAT3 (bench_mod, MOD, _##x) (void) { }
+BENCH_SYMBOLS (DEFINE)
+
+#define DECLARE(x)							      \
+  extern void bench_base_##x (void);
+BENCH_SYMBOLS (DECLARE)
+
+#define REFER(x) bench_base_##x,
+void (*const CONCAT3 (bench_mod, MOD, _refs)[]) (void) =
+  {
+    BENCH_SYMBOLS (REFER)
+  };
+
+#define CALL(x) bench_base_##x ();
+void
+CONCAT3 (bench_mod, MOD, _call) (void)
+{
+  BENCH_SYMBOLS (CALL)
+}
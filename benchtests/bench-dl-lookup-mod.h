@@ -0,0 +1,31 @@
+/* Symbols of the modules of bench-dl-lookup-startup.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* Expand M for 256 suffixes, 00 to ff, to generate as many symbols.  */
+#define BENCH_SYMBOLS_16(M, p)						      \
+  M (p##0) M (p##1) M (p##2) M (p##3) M (p##4) M (p##5) M (p##6) M (p##7)    \
+  M (p##8) M (p##9) M (p##a) M (p##b) M (p##c) M (p##d) M (p##e) M (p##f)
+#define BENCH_SYMBOLS(M)						      \
+  BENCH_SYMBOLS_16 (M, 0) BENCH_SYMBOLS_16 (M, 1)			      \
+  BENCH_SYMBOLS_16 (M, 2) BENCH_SYMBOLS_16 (M, 3)			      \
+  BENCH_SYMBOLS_16 (M, 4) BENCH_SYMBOLS_16 (M, 5)			      \
+  BENCH_SYMBOLS_16 (M, 6) BENCH_SYMBOLS_16 (M, 7)			      \
+  BENCH_SYMBOLS_16 (M, 8) BENCH_SYMBOLS_16 (M, 9)			      \
+  BENCH_SYMBOLS_16 (M, a) BENCH_SYMBOLS_16 (M, b)			      \
+  BENCH_SYMBOLS_16 (M, c) BENCH_SYMBOLS_16 (M, d)			      \
+  BENCH_SYMBOLS_16 (M, e) BENCH_SYMBOLS_16 (M, f)
@@ -0,0 +1,122 @@
+/* Measure symbol lookup during startup of a program with many objects.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* The synthetic program consists of bench-dl-lookup-root.so, which
+   links against 300 modules and a base library after them.  Every
+   module defines symbols of its own and refers to all symbols of the
+   base library, like C++ libraries refer to libstdc++, so that most
+   lookups search all modules before they find the definition.
+
+   The root module is opened with dlmopen in a new namespace, where it
+   is the first object and its dependencies make up the global scope,
+   and with RTLD_NOW, so that all relocations are processed the way
+   they are on startup of a program linked with -z now.  Compare runs
+   with GLIBC_TUNABLES=glibc.rtld.lookup_cache=0.
+
+   The path of the root module can be passed on the command line; by
+   default it is looked up next to the benchmark.  */
+
+#include <dlfcn.h>
+#include <libgen.h>
+#include <link.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench-timing.h"
+#include "json-lib.h"
+
+#define NUM_ROUNDS	16
+
+/* Load the program once.  Store the number of objects in *NOBJECTS and
+   return the elapsed time.  */
+static timing_t
+load_program (const char *root, unsigned int *nobjects)
+{
+  timing_t start, stop, elapsed;
+
+  TIMING_NOW (start);
+  void *handle = dlmopen (LM_ID_NEWLM, root, RTLD_NOW);
+  TIMING_NOW (stop);
+  TIMING_DIFF (elapsed, start, stop);
+
+  struct link_map *map;
+  if (handle == NULL || dlinfo (handle, RTLD_DI_LINKMAP, &map) != 0)
+    {
+      fprintf (stderr, "### cannot load %s: %s\n", root, dlerror ());
+      exit (EXIT_FAILURE);
+    }
+
+  for (*nobjects = 0; map != NULL; map = map->l_next)
+    ++*nobjects;
+
+  dlclose (handle);
+  return elapsed;
+}
+
+int
+main (int argc, char **argv)
+{
+  char *root;
+
+  if (argc > 1)
+    root = strdup (argv[1]);
+  else
+    {
+      char *dir = strdup (argv[0]);
+      if (dir == NULL
+	  || asprintf (&root, "%s/bench-dl-lookup-root.so", dirname (dir)) < 0)
+	root = NULL;
+      free (dir);
+    }
+  if (root == NULL)
+    {
+      fprintf (stderr, "### out of memory\n");
+      return EXIT_FAILURE;
+    }
+
+  unsigned int nobjects;
+  timing_t first = load_program (root, &nobjects);
+  timing_t total = 0;
+  for (int i = 0; i < NUM_ROUNDS; i++)
+    {
+      timing_t cur = load_program (root, &nobjects);
+      TIMING_ACCUM (total, cur);
+    }
+
+  json_ctx_t json_ctx;
+  json_init (&json_ctx, 0, stdout);
+  json_document_begin (&json_ctx);
+
+  json_attr_string (&json_ctx, "timing_type", TIMING_TYPE);
+  json_attr_object_begin (&json_ctx, "functions");
+  json_attr_object_begin (&json_ctx, "dlmopen");
+  json_attr_object_begin (&json_ctx, "lookup-startup");
+
+  json_attr_uint (&json_ctx, "objects", nobjects);
+  json_attr_uint (&json_ctx, "rounds", NUM_ROUNDS);
+  json_attr_double (&json_ctx, "first-round", first);
+  json_attr_double (&json_ctx, "later-rounds", (double) total / NUM_ROUNDS);
+
+  json_attr_object_end (&json_ctx);
+  json_attr_object_end (&json_ctx);
+  json_attr_object_end (&json_ctx);
+  json_document_end (&json_ctx);
+
+  free (root);
+  return 0;
+}
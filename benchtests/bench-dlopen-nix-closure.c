@@ -0,0 +1,247 @@
+/* Measure library path resolution cost for a Nix-style closure.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* The benchmark builds a synthetic closure in a temporary directory:
+
+     profile/lib/libpkgN.so -> store/HASH-pkgN/lib/libpkgN.so
+     store/HASH-pkgN/lib/libpkgN.so -> libpkgN.so.1
+     store/HASH-pkgN/lib/libpkgN.so.1 -> store/HASH-pkgM/lib/libpkgM.so
+
+   with M = N - 1, down to the first package of each group of CHAIN_DEPTH
+   packages, which links to the real libm (this keeps every chain well
+   below the kernel's symlink limit).  Each profile path is then opened
+   with dlopen.  Since all of them end at the same (already loaded)
+   object, the loader only resolves and opens the path before it finds
+   the existing link map, so the timings are dominated by the path
+   translation and symlink walk in open_verify.
+
+   On nix-on-droid, library paths from a real closure (e.g. the output
+   of "nix-store -qR" joined with lib/ names) can be passed on the command
+   line instead; they are then used in place of the synthetic closure.  */
+
+#include <dlfcn.h>
+#include <gnu/lib-names.h>
+#include <limits.h>
+#include <link.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "bench-timing.h"
+#include "json-lib.h"
+
+#define NUM_PKGS	64
+#define NUM_ROUNDS	16
+#define CHAIN_DEPTH	8
+
+static char tmpdir[] = "/tmp/bench-nix-closure-XXXXXX";
+
+static void
+xsymlink_fmt (const char *target, const char *fmt, int n)
+{
+  char linkpath[PATH_MAX];
+  snprintf (linkpath, sizeof linkpath, fmt, tmpdir, n, n);
+  if (symlink (target, linkpath) != 0)
+    {
+      fprintf (stderr, "### symlink %s failed: %m\n", linkpath);
+      exit (EXIT_FAILURE);
+    }
+}
+
+static void
+xmkdir_fmt (const char *fmt, int n)
+{
+  char path[PATH_MAX];
+  snprintf (path, sizeof path, fmt, tmpdir, n);
+  if (mkdir (path, 0700) != 0)
+    {
+      fprintf (stderr, "### mkdir %s failed: %m\n", path);
+      exit (EXIT_FAILURE);
+    }
+}
+
+/* Build the synthetic closure and return the NUM_PKGS profile paths.  */
+static char **
+build_closure (const char *realname)
+{
+  char **paths = calloc (NUM_PKGS, sizeof (char *));
+  char target[PATH_MAX];
+
+  if (paths == NULL || mkdtemp (tmpdir) == NULL)
+    {
+      fprintf (stderr, "### cannot create closure directory: %m\n");
+      exit (EXIT_FAILURE);
+    }
+
+  xmkdir_fmt ("%s/store", 0);
+  xmkdir_fmt ("%s/profile", 0);
+  xmkdir_fmt ("%s/profile/lib", 0);
+
+  for (int n = 0; n < NUM_PKGS; n++)
+    {
+      xmkdir_fmt ("%s/store/%08x-pkg", n);
+      xmkdir_fmt ("%s/store/%08x-pkg/lib", n);
+
+      if (n % CHAIN_DEPTH == 0)
+	strcpy (target, realname);
+      else
+	snprintf (target, sizeof target, "%s/store/%08x-pkg/lib/libpkg%d.so",
+		  tmpdir, n - 1, n - 1);
+      xsymlink_fmt (target, "%s/store/%08x-pkg/lib/libpkg%d.so.1", n);
+
+      snprintf (target, sizeof target, "libpkg%d.so.1", n);
+      xsymlink_fmt (target, "%s/store/%08x-pkg/lib/libpkg%d.so", n);
+
+      snprintf (target, sizeof target, "%s/store/%08x-pkg/lib/libpkg%d.so",
+		tmpdir, n, n);
+      if (asprintf (&paths[n], "%s/profile/lib/libpkg%d.so", tmpdir, n) < 0)
+	exit (EXIT_FAILURE);
+      if (symlink (target, paths[n]) != 0)
+	{
+	  fprintf (stderr, "### symlink %s failed: %m\n", paths[n]);
+	  exit (EXIT_FAILURE);
+	}
+    }
+
+  return paths;
+}
+
+static void
+remove_closure (char **paths)
+{
+  char path[PATH_MAX];
+
+  for (int n = 0; n < NUM_PKGS; n++)
+    {
+      unlink (paths[n]);
+      free (paths[n]);
+      snprintf (path, sizeof path, "%s/store/%08x-pkg/lib/libpkg%d.so",
+		tmpdir, n, n);
+      unlink (path);
+      strcat (path, ".1");
+      unlink (path);
+      snprintf (path, sizeof path, "%s/store/%08x-pkg/lib", tmpdir, n);
+      rmdir (path);
+      snprintf (path, sizeof path, "%s/store/%08x-pkg", tmpdir, n);
+      rmdir (path);
+    }
+  free (paths);
+
+  snprintf (path, sizeof path, "%s/profile/lib", tmpdir);
+  rmdir (path);
+  snprintf (path, sizeof path, "%s/profile", tmpdir);
+  rmdir (path);
+  snprintf (path, sizeof path, "%s/store", tmpdir);
+  rmdir (path);
+  rmdir (tmpdir);
+}
+
+/* Open and close all NPATHS paths once.  Returns the elapsed time.  */
+static timing_t
+open_closure (char **paths, int npaths)
+{
+  void *handles[npaths];
+  timing_t start, stop, elapsed;
+
+  TIMING_NOW (start);
+  for (int i = 0; i < npaths; i++)
+    handles[i] = dlopen (paths[i], RTLD_LAZY);
+  TIMING_NOW (stop);
+  TIMING_DIFF (elapsed, start, stop);
+
+  for (int i = 0; i < npaths; i++)
+    if (handles[i] == NULL)
+      {
+	fprintf (stderr, "### dlopen %s failed: %s\n", paths[i], dlerror ());
+	exit (EXIT_FAILURE);
+      }
+    else
+      dlclose (handles[i]);
+
+  return elapsed;
+}
+
+int
+main (int argc, char **argv)
+{
+  char **paths;
+  int npaths;
+
+  /* Keep the target object loaded so that the dlopen calls below only
+     exercise path resolution.  */
+  void *libm = dlopen (LIBM_SO, RTLD_LAZY);
+  struct link_map *map;
+  if (libm == NULL || dlinfo (libm, RTLD_DI_LINKMAP, &map) != 0)
+    {
+      fprintf (stderr, "### cannot load %s: %s\n", LIBM_SO, dlerror ());
+      return EXIT_FAILURE;
+    }
+
+  if (argc > 1)
+    {
+      paths = argv + 1;
+      npaths = argc - 1;
+    }
+  else
+    {
+      char *realname = realpath (map->l_name, NULL);
+      if (realname == NULL)
+	{
+	  fprintf (stderr, "### realpath %s failed: %m\n", map->l_name);
+	  return EXIT_FAILURE;
+	}
+      paths = build_closure (realname);
+      npaths = NUM_PKGS;
+      free (realname);
+    }
+
+  timing_t first = open_closure (paths, npaths);
+  timing_t total = 0;
+  for (int i = 0; i < NUM_ROUNDS; i++)
+    {
+      timing_t cur = open_closure (paths, npaths);
+      TIMING_ACCUM (total, cur);
+    }
+
+  json_ctx_t json_ctx;
+  json_init (&json_ctx, 0, stdout);
+  json_document_begin (&json_ctx);
+
+  json_attr_string (&json_ctx, "timing_type", TIMING_TYPE);
+  json_attr_object_begin (&json_ctx, "functions");
+  json_attr_object_begin (&json_ctx, "dlopen");
+  json_attr_object_begin (&json_ctx, "nix-closure");
+
+  json_attr_uint (&json_ctx, "objects", npaths);
+  json_attr_uint (&json_ctx, "rounds", NUM_ROUNDS);
+  json_attr_double (&json_ctx, "first-round", (double) first / npaths);
+  json_attr_double (&json_ctx, "later-rounds",
+		    (double) total / ((double) npaths * NUM_ROUNDS));
+
+  json_attr_object_end (&json_ctx);
+  json_attr_object_end (&json_ctx);
+  json_attr_object_end (&json_ctx);
+  json_document_end (&json_ctx);
+
+  if (argc <= 1)
+    remove_closure (paths);
+  dlclose (libm);
+
+  return 0;
+}
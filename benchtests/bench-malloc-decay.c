@@ -0,0 +1,247 @@
+/* Benchmark the resident memory of a bursty malloc workload over time.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* Several threads, each with its own arena, repeatedly allocate a burst
+   of blocks, free most of them again and then stay idle, like a daemon
+   that handles requests now and then.  The blocks that are kept live
+   pin the heaps, so the memory freed below them can only be returned
+   by madvise.  The resident set size is sampled at regular intervals
+   and printed as a time series, together with the time spent in the
+   bursts.  Compare runs with GLIBC_TUNABLES=glibc.malloc.decay_ms=0 and
+   with a decay time shorter than the idle period.  */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bench-timing.h"
+#include "json-lib.h"
+
+#define NUM_THREADS		4
+#define NUM_BURSTS		4
+/* Bytes allocated per thread and burst.  */
+#define BURST_SIZE		(64 * 1024 * 1024)
+#define MIN_ALLOCATION_SIZE	1024
+#define MAX_ALLOCATION_SIZE	(64 * 1024)
+/* One block in KEEP_EVERY is kept until the end of the run.  */
+#define KEEP_EVERY		64
+#define IDLE_MS			2000
+#define SAMPLE_MS		100
+#define MAX_SAMPLES		((NUM_BURSTS * IDLE_MS) / SAMPLE_MS + 256)
+
+static pthread_barrier_t barrier;
+
+struct sample
+{
+  double time_ms;
+  long rss_kb;
+};
+
+static struct sample samples[MAX_SAMPLES];
+static int num_samples;
+
+static long
+current_rss_kb (void)
+{
+  FILE *f = fopen ("/proc/self/statm", "r");
+  long size, resident = 0;
+
+  if (f == NULL)
+    return -1;
+  if (fscanf (f, "%ld %ld", &size, &resident) != 2)
+    resident = 0;
+  fclose (f);
+  return resident * (sysconf (_SC_PAGESIZE) / 1024);
+}
+
+static double
+now_ms (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static void
+sleep_ms (long ms)
+{
+  struct timespec ts = { .tv_sec = ms / 1000,
+			 .tv_nsec = (ms % 1000) * 1000000 };
+  nanosleep (&ts, NULL);
+}
+
+struct worker_args
+{
+  unsigned int seed;
+  timing_t elapsed;
+  void **kept;
+  size_t num_kept;
+};
+
+static void *
+worker (void *closure)
+{
+  struct worker_args *args = closure;
+  size_t max_blocks = BURST_SIZE / MIN_ALLOCATION_SIZE;
+  void **blocks = malloc (max_blocks * sizeof (*blocks));
+  timing_t start, stop, elapsed;
+
+  args->kept = malloc (NUM_BURSTS * max_blocks / KEEP_EVERY
+		       * sizeof (*args->kept));
+  args->num_kept = 0;
+  args->elapsed = 0;
+  if (blocks == NULL || args->kept == NULL)
+    {
+      fprintf (stderr, "error: out of memory\n");
+      exit (1);
+    }
+
+  for (int burst = 0; burst < NUM_BURSTS; burst++)
+    {
+      pthread_barrier_wait (&barrier);
+
+      TIMING_NOW (start);
+      size_t n = 0, total = 0;
+      while (total < BURST_SIZE)
+	{
+	  size_t size = MIN_ALLOCATION_SIZE
+			+ rand_r (&args->seed) % (MAX_ALLOCATION_SIZE
+						  - MIN_ALLOCATION_SIZE);
+	  blocks[n] = malloc (size);
+	  if (blocks[n] == NULL)
+	    {
+	      fprintf (stderr, "error: out of memory\n");
+	      exit (1);
+	    }
+	  memset (blocks[n], 1, size);
+	  total += size;
+	  n++;
+	}
+      for (size_t i = 0; i < n; i++)
+	if (i % KEEP_EVERY == KEEP_EVERY - 1)
+	  args->kept[args->num_kept++] = blocks[i];
+	else
+	  free (blocks[i]);
+      TIMING_NOW (stop);
+      TIMING_DIFF (elapsed, start, stop);
+      TIMING_ACCUM (args->elapsed, elapsed);
+
+      pthread_barrier_wait (&barrier);
+      sleep_ms (IDLE_MS);
+    }
+
+  free (blocks);
+  return NULL;
+}
+
+int
+main (int argc, char **argv)
+{
+  struct worker_args args[NUM_THREADS];
+  pthread_t threads[NUM_THREADS];
+
+  pthread_barrier_init (&barrier, NULL, NUM_THREADS + 1);
+  for (int i = 0; i < NUM_THREADS; i++)
+    {
+      args[i].seed = i + 1;
+      pthread_create (&threads[i], NULL, worker, &args[i]);
+    }
+
+  double start = now_ms ();
+  double peak = 0, idle_sum = 0;
+  int idle_count = 0;
+  for (int burst = 0; burst < NUM_BURSTS; burst++)
+    {
+      /* Start the burst, and wait for its end.  */
+      pthread_barrier_wait (&barrier);
+      pthread_barrier_wait (&barrier);
+
+      double idle_start = now_ms ();
+      while (now_ms () - idle_start < IDLE_MS && num_samples < MAX_SAMPLES)
+	{
+	  long rss = current_rss_kb ();
+	  samples[num_samples].time_ms = now_ms () - start;
+	  samples[num_samples].rss_kb = rss;
+	  num_samples++;
+	  if (rss > peak)
+	    peak = rss;
+	  /* The RSS at the end of the idle period shows how much memory
+	     was returned.  */
+	  if (now_ms () - idle_start >= IDLE_MS - SAMPLE_MS)
+	    {
+	      idle_sum += rss;
+	      idle_count++;
+	    }
+	  sleep_ms (SAMPLE_MS);
+	}
+    }
+
+  timing_t burst_time = 0;
+  for (int i = 0; i < NUM_THREADS; i++)
+    {
+      pthread_join (threads[i], NULL);
+      TIMING_ACCUM (burst_time, args[i].elapsed);
+      for (size_t j = 0; j < args[i].num_kept; j++)
+	free (args[i].kept[j]);
+      free (args[i].kept);
+    }
+
+  json_ctx_t json_ctx;
+
+  json_init (&json_ctx, 0, stdout);
+
+  json_document_begin (&json_ctx);
+
+  json_attr_string (&json_ctx, "timing_type", TIMING_TYPE);
+
+  json_attr_object_begin (&json_ctx, "functions");
+
+  json_attr_object_begin (&json_ctx, "malloc");
+
+  json_attr_object_begin (&json_ctx, "");
+  json_attr_double (&json_ctx, "threads", NUM_THREADS);
+  json_attr_double (&json_ctx, "bursts", NUM_BURSTS);
+  json_attr_double (&json_ctx, "burst_time", (double) burst_time
+					     / (NUM_THREADS * NUM_BURSTS));
+  json_attr_double (&json_ctx, "peak_rss", peak);
+  json_attr_double (&json_ctx, "idle_rss",
+		    idle_count > 0 ? idle_sum / idle_count : 0);
+
+  json_array_begin (&json_ctx, "time_ms");
+  for (int i = 0; i < num_samples; i++)
+    json_element_double (&json_ctx, samples[i].time_ms);
+  json_array_end (&json_ctx);
+
+  json_array_begin (&json_ctx, "rss");
+  for (int i = 0; i < num_samples; i++)
+    json_element_double (&json_ctx, samples[i].rss_kb);
+  json_array_end (&json_ctx);
+
+  json_attr_object_end (&json_ctx);
+
+  json_attr_object_end (&json_ctx);
+
+  json_attr_object_end (&json_ctx);
+
+  json_document_end (&json_ctx);
+
+  return 0;
+}
@@ -0,0 +1,153 @@
+/* Benchmark allocating and freeing large buffers.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* Each thread allocates a buffer of 256 KiB to 4 MiB, writes to every
+   page of it and frees it again, like a server that allocates a buffer
+   per request.  The buffers are above the mmap threshold, so without
+   the mmap cache every iteration costs an mmap and munmap pair, a page
+   fault per page and, with several threads, TLB shootdowns.  The time
+   per iteration and the number of page faults are printed.  Compare
+   runs with GLIBC_TUNABLES=glibc.malloc.mmap_cache_size=0 and with a
+   cache that holds a few buffers per thread.  */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "bench-timing.h"
+#include "json-lib.h"
+
+#define NUM_ITERATIONS		20000
+#define MIN_ALLOCATION_SIZE	(256 * 1024)
+#define MAX_ALLOCATION_SIZE	(4 * 1024 * 1024)
+#define RAND_SEED		88
+
+struct thread_args
+{
+  unsigned int seed;
+  timing_t elapsed;
+};
+
+static size_t iterations = NUM_ITERATIONS;
+static long pagesize;
+
+static void *
+worker (void *closure)
+{
+  struct thread_args *args = closure;
+  timing_t start, stop;
+
+  TIMING_NOW (start);
+  for (size_t i = 0; i < iterations; i++)
+    {
+      size_t size = MIN_ALLOCATION_SIZE
+		    + rand_r (&args->seed) % (MAX_ALLOCATION_SIZE
+					      - MIN_ALLOCATION_SIZE);
+      volatile char *p = malloc (size);
+      if (p == NULL)
+	{
+	  fprintf (stderr, "error: out of memory\n");
+	  exit (1);
+	}
+      for (size_t j = 0; j < size; j += pagesize)
+	p[j] = 1;
+      free ((void *) p);
+    }
+  TIMING_NOW (stop);
+  TIMING_DIFF (args->elapsed, start, stop);
+  return NULL;
+}
+
+static void
+usage (const char *name)
+{
+  fprintf (stderr, "%s: <num_threads>\n", name);
+  exit (1);
+}
+
+int
+main (int argc, char **argv)
+{
+  long num_threads = 1;
+
+  if (argc > 2)
+    usage (argv[0]);
+  if (argc == 2)
+    {
+      num_threads = strtol (argv[1], NULL, 10);
+      if (num_threads < 1)
+	usage (argv[0]);
+    }
+
+  pagesize = sysconf (_SC_PAGESIZE);
+  /* Keep the total run time about the same for any number of
+     threads.  */
+  iterations = NUM_ITERATIONS / num_threads;
+
+  struct thread_args args[num_threads];
+  pthread_t threads[num_threads];
+  struct rusage usage_before, usage_after;
+
+  getrusage (RUSAGE_SELF, &usage_before);
+  for (long i = 0; i < num_threads; i++)
+    {
+      args[i].seed = RAND_SEED + i;
+      pthread_create (&threads[i], NULL, worker, &args[i]);
+    }
+
+  timing_t elapsed = 0;
+  for (long i = 0; i < num_threads; i++)
+    {
+      pthread_join (threads[i], NULL);
+      TIMING_ACCUM (elapsed, args[i].elapsed);
+    }
+  getrusage (RUSAGE_SELF, &usage_after);
+
+  json_ctx_t json_ctx;
+
+  json_init (&json_ctx, 0, stdout);
+
+  json_document_begin (&json_ctx);
+
+  json_attr_string (&json_ctx, "timing_type", TIMING_TYPE);
+
+  json_attr_object_begin (&json_ctx, "functions");
+
+  json_attr_object_begin (&json_ctx, "malloc");
+
+  json_attr_object_begin (&json_ctx, "");
+  json_attr_double (&json_ctx, "threads", num_threads);
+  json_attr_double (&json_ctx, "iterations", iterations * num_threads);
+  json_attr_double (&json_ctx, "time_per_iteration",
+		    (double) elapsed / (iterations * num_threads));
+  json_attr_double (&json_ctx, "minor_faults",
+		    usage_after.ru_minflt - usage_before.ru_minflt);
+  json_attr_double (&json_ctx, "min_size", MIN_ALLOCATION_SIZE);
+  json_attr_double (&json_ctx, "max_size", MAX_ALLOCATION_SIZE);
+  json_attr_object_end (&json_ctx);
+
+  json_attr_object_end (&json_ctx);
+
+  json_attr_object_end (&json_ctx);
+
+  json_document_end (&json_ctx);
+
+  return 0;
+}
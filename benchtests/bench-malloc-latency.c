@@ -0,0 +1,205 @@
+/* Benchmark the latency distribution of malloc and free.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* Each thread replaces random blocks in a working set of blocks of 1 KiB
+   to 64 KiB, which are too large for the thread cache and the fastbins,
+   and times every call to malloc and free on its own.  The percentiles
+   of the latencies of all threads are printed, since the cost of
+   coalescing shows in the tail rather than in the mean.  Compare runs
+   with GLIBC_TUNABLES=glibc.malloc.deferred_free=0 and with a small
+   batch size.  */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench-timing.h"
+#include "json-lib.h"
+#include <array_length.h>
+
+#define NUM_ITERATIONS		200000
+#define WORKING_SET		512
+#define MIN_ALLOCATION_SIZE	1024
+#define MAX_ALLOCATION_SIZE	(64 * 1024)
+#define RAND_SEED		88
+
+struct thread_args
+{
+  unsigned int seed;
+  timing_t *malloc_latency;
+  timing_t *free_latency;
+};
+
+static size_t iterations = NUM_ITERATIONS;
+
+static void *
+worker (void *closure)
+{
+  struct thread_args *args = closure;
+  void *blocks[WORKING_SET];
+  timing_t start, stop;
+
+  for (int i = 0; i < WORKING_SET; i++)
+    blocks[i] = malloc (MIN_ALLOCATION_SIZE);
+
+  for (size_t i = 0; i < iterations; i++)
+    {
+      size_t slot = rand_r (&args->seed) % WORKING_SET;
+      size_t size = MIN_ALLOCATION_SIZE
+		    + rand_r (&args->seed) % (MAX_ALLOCATION_SIZE
+					      - MIN_ALLOCATION_SIZE);
+
+      TIMING_NOW (start);
+      free (blocks[slot]);
+      TIMING_NOW (stop);
+      TIMING_DIFF (args->free_latency[i], start, stop);
+
+      TIMING_NOW (start);
+      blocks[slot] = malloc (size);
+      TIMING_NOW (stop);
+      TIMING_DIFF (args->malloc_latency[i], start, stop);
+
+      memset (blocks[slot], 1, MIN_ALLOCATION_SIZE);
+    }
+
+  for (int i = 0; i < WORKING_SET; i++)
+    free (blocks[i]);
+  return NULL;
+}
+
+static int
+compare_timing (const void *a, const void *b)
+{
+  timing_t x = *(const timing_t *) a;
+  timing_t y = *(const timing_t *) b;
+  return x < y ? -1 : x > y;
+}
+
+/* Print the percentiles of the N latencies in SAMPLES, sorting them.  */
+static void
+print_percentiles (json_ctx_t *json_ctx, const char *name,
+		   timing_t *samples, size_t n)
+{
+  static const struct
+  {
+    const char *name;
+    double fraction;
+  } percentiles[] =
+    {
+      { "p50", 0.5 },
+      { "p90", 0.9 },
+      { "p99", 0.99 },
+      { "p99.9", 0.999 },
+      { "p99.99", 0.9999 },
+    };
+  double sum = 0;
+
+  qsort (samples, n, sizeof (timing_t), compare_timing);
+  for (size_t i = 0; i < n; i++)
+    sum += samples[i];
+
+  json_attr_object_begin (json_ctx, name);
+  json_attr_double (json_ctx, "mean", sum / n);
+  for (size_t i = 0; i < array_length (percentiles); i++)
+    json_attr_double (json_ctx, percentiles[i].name,
+		      samples[(size_t) (percentiles[i].fraction * (n - 1))]);
+  json_attr_double (json_ctx, "max", samples[n - 1]);
+  json_attr_object_end (json_ctx);
+}
+
+static void
+usage (const char *name)
+{
+  fprintf (stderr, "%s: <num_threads>\n", name);
+  exit (1);
+}
+
+int
+main (int argc, char **argv)
+{
+  long num_threads = 1;
+
+  if (argc > 2)
+    usage (argv[0]);
+  if (argc == 2)
+    {
+      num_threads = strtol (argv[1], NULL, 10);
+      if (num_threads < 1)
+	usage (argv[0]);
+    }
+
+  /* Keep the number of samples the same for any number of threads.  */
+  iterations = NUM_ITERATIONS / num_threads;
+  size_t samples = iterations * num_threads;
+
+  /* Allocate the samples up front, so that recording them does not
+     disturb the heap being measured.  */
+  timing_t *malloc_latency = calloc (samples, sizeof (timing_t));
+  timing_t *free_latency = calloc (samples, sizeof (timing_t));
+  if (malloc_latency == NULL || free_latency == NULL)
+    {
+      fprintf (stderr, "error: out of memory\n");
+      return 1;
+    }
+
+  struct thread_args args[num_threads];
+  pthread_t threads[num_threads];
+
+  for (long i = 0; i < num_threads; i++)
+    {
+      args[i].seed = RAND_SEED + i;
+      args[i].malloc_latency = malloc_latency + i * iterations;
+      args[i].free_latency = free_latency + i * iterations;
+      pthread_create (&threads[i], NULL, worker, &args[i]);
+    }
+
+  for (long i = 0; i < num_threads; i++)
+    pthread_join (threads[i], NULL);
+
+  json_ctx_t json_ctx;
+
+  json_init (&json_ctx, 0, stdout);
+
+  json_document_begin (&json_ctx);
+
+  json_attr_string (&json_ctx, "timing_type", TIMING_TYPE);
+
+  json_attr_object_begin (&json_ctx, "functions");
+
+  json_attr_object_begin (&json_ctx, "malloc");
+
+  json_attr_object_begin (&json_ctx, "");
+  json_attr_double (&json_ctx, "threads", num_threads);
+  json_attr_double (&json_ctx, "samples", samples);
+  json_attr_double (&json_ctx, "min_size", MIN_ALLOCATION_SIZE);
+  json_attr_double (&json_ctx, "max_size", MAX_ALLOCATION_SIZE);
+  print_percentiles (&json_ctx, "malloc_latency", malloc_latency, samples);
+  print_percentiles (&json_ctx, "free_latency", free_latency, samples);
+  json_attr_object_end (&json_ctx);
+
+  json_attr_object_end (&json_ctx);
+
+  json_attr_object_end (&json_ctx);
+
+  json_document_end (&json_ctx);
+
+  free (malloc_latency);
+  free (free_latency);
+  return 0;
+}
@@ -0,0 +1,238 @@
+/* Benchmark the NUMA locality of arena selection.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* Start threads pinned to the CPUs in turn, one after the other, and
+   let each of them replace random blocks in a working set.  Besides the
+   time per iteration, the benchmark prints how often two threads share
+   an arena although they run on different NUMA nodes, and how often
+   threads of the same node do.  With fewer arenas than threads, arenas
+   are always shared, but with GLIBC_TUNABLES=glibc.malloc.numa=1 only
+   by threads of the same node.
+
+   If a second argument is given, that many nodes are emulated the way
+   glibc.malloc.numa=N does, by assigning the CPUs to them in turn.
+   This allows running the benchmark on a single node with, for
+   example, glibc.malloc.numa=2 and the arguments 8 2.  */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench-timing.h"
+#include "json-lib.h"
+
+#define NUM_ITERATIONS		(1 << 20)
+#define WORKING_SET		1024
+#define MIN_ALLOCATION_SIZE	16
+#define MAX_ALLOCATION_SIZE	1024
+#define RAND_SEED		88
+
+/* The heaps of thread arenas are aligned to their maximum size, so the
+   address of a block rounded down to that size identifies the heap,
+   and thus the arena, it was allocated from.  */
+#define HEAP_MAX_SIZE		(sizeof (long) == 4 ? 1024 * 1024	      \
+				 : 2 * 4 * 1024 * 1024 * sizeof (long))
+
+struct thread_args
+{
+  int cpu;
+  int node;
+  uintptr_t heap;
+  timing_t elapsed;
+  pthread_barrier_t *started;
+};
+
+static int emulated_nodes;
+
+static int
+current_node (int cpu)
+{
+  unsigned int c, node;
+
+  if (emulated_nodes > 0)
+    return cpu % emulated_nodes;
+  if (getcpu (&c, &node) != 0)
+    return 0;
+  return node;
+}
+
+static void *
+worker (void *closure)
+{
+  struct thread_args *args = closure;
+  void *blocks[WORKING_SET];
+  unsigned int seed = RAND_SEED + args->cpu;
+  timing_t start, stop;
+
+  /* The first allocation attaches the thread to an arena.  Let the
+     next thread start only then, so that the arenas are created in a
+     fixed order.  */
+  args->node = current_node (args->cpu);
+  for (int i = 0; i < WORKING_SET; i++)
+    blocks[i] = malloc (MIN_ALLOCATION_SIZE);
+  args->heap = (uintptr_t) blocks[0] & ~(HEAP_MAX_SIZE - 1);
+  pthread_barrier_wait (args->started);
+
+  TIMING_NOW (start);
+  for (size_t i = 0; i < NUM_ITERATIONS; i++)
+    {
+      size_t slot = rand_r (&seed) % WORKING_SET;
+      size_t size = MIN_ALLOCATION_SIZE
+		    + rand_r (&seed) % (MAX_ALLOCATION_SIZE
+					- MIN_ALLOCATION_SIZE);
+      free (blocks[slot]);
+      blocks[slot] = malloc (size);
+      memset (blocks[slot], 1, MIN_ALLOCATION_SIZE);
+    }
+  TIMING_NOW (stop);
+  TIMING_DIFF (args->elapsed, start, stop);
+
+  for (int i = 0; i < WORKING_SET; i++)
+    free (blocks[i]);
+  return NULL;
+}
+
+static void
+usage (const char *name)
+{
+  fprintf (stderr, "%s: <num_threads> [<emulated_nodes>]\n", name);
+  exit (1);
+}
+
+int
+main (int argc, char **argv)
+{
+  long num_threads = 8;
+
+  if (argc > 3)
+    usage (argv[0]);
+  if (argc >= 2)
+    {
+      num_threads = strtol (argv[1], NULL, 10);
+      if (num_threads < 1)
+	usage (argv[0]);
+    }
+  if (argc == 3)
+    {
+      emulated_nodes = strtol (argv[2], NULL, 10);
+      if (emulated_nodes < 1)
+	usage (argv[0]);
+    }
+
+  cpu_set_t allowed;
+  if (sched_getaffinity (0, sizeof (allowed), &allowed) != 0)
+    {
+      fprintf (stderr, "error: sched_getaffinity failed\n");
+      return 1;
+    }
+  int ncpus = CPU_COUNT (&allowed);
+
+  struct thread_args args[num_threads];
+  pthread_t threads[num_threads];
+  pthread_barrier_t started;
+
+  for (long i = 0, cpu = -1; i < num_threads; i++)
+    {
+      /* Take the allowed CPUs in turn.  */
+      if (i % ncpus == 0)
+	cpu = -1;
+      do
+	cpu++;
+      while (!CPU_ISSET (cpu, &allowed));
+
+      cpu_set_t set;
+      CPU_ZERO (&set);
+      CPU_SET (cpu, &set);
+      pthread_attr_t attr;
+      pthread_attr_init (&attr);
+      pthread_attr_setaffinity_np (&attr, sizeof (set), &set);
+
+      pthread_barrier_init (&started, NULL, 2);
+      args[i].cpu = cpu;
+      args[i].started = &started;
+      if (pthread_create (&threads[i], &attr, worker, &args[i]) != 0)
+	{
+	  fprintf (stderr, "error: pthread_create failed\n");
+	  return 1;
+	}
+      pthread_barrier_wait (&started);
+      pthread_barrier_destroy (&started);
+      pthread_attr_destroy (&attr);
+    }
+
+  timing_t elapsed = 0;
+  for (long i = 0; i < num_threads; i++)
+    {
+      pthread_join (threads[i], NULL);
+      TIMING_ACCUM (elapsed, args[i].elapsed);
+    }
+
+  /* Count the pairs of threads that share a heap.  */
+  double local_pairs = 0, local_shared = 0;
+  double remote_pairs = 0, remote_shared = 0;
+  for (long i = 0; i < num_threads; i++)
+    for (long j = i + 1; j < num_threads; j++)
+      {
+	bool shared = args[i].heap == args[j].heap;
+	if (args[i].node == args[j].node)
+	  {
+	    local_pairs++;
+	    local_shared += shared;
+	  }
+	else
+	  {
+	    remote_pairs++;
+	    remote_shared += shared;
+	  }
+      }
+
+  json_ctx_t json_ctx;
+
+  json_init (&json_ctx, 0, stdout);
+
+  json_document_begin (&json_ctx);
+
+  json_attr_string (&json_ctx, "timing_type", TIMING_TYPE);
+
+  json_attr_object_begin (&json_ctx, "functions");
+
+  json_attr_object_begin (&json_ctx, "malloc");
+
+  json_attr_object_begin (&json_ctx, "");
+  json_attr_double (&json_ctx, "threads", num_threads);
+  json_attr_double (&json_ctx, "emulated_nodes", emulated_nodes);
+  json_attr_double (&json_ctx, "time_per_iteration",
+		    (double) elapsed / (NUM_ITERATIONS * num_threads));
+  json_attr_double (&json_ctx, "local_sharing",
+		    local_pairs > 0 ? local_shared / local_pairs : 0);
+  json_attr_double (&json_ctx, "remote_sharing",
+		    remote_pairs > 0 ? remote_shared / remote_pairs : 0);
+  json_attr_object_end (&json_ctx);
+
+  json_attr_object_end (&json_ctx);
+
+  json_attr_object_end (&json_ctx);
+
+  json_document_end (&json_ctx);
+
+  return 0;
+}
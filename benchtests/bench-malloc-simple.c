@@ -28,11 +28,14 @@
    given size.  This enables performance tracking of the t-cache and fastbins.
    It tests 3 different scenarios: single-threaded using main arena,
    multi-threaded using thread-arena, and main arena with SINGLE_THREAD_P
-   false.  */
+   false.  Finally LIVE_BYTES worth of blocks are allocated and kept live,
+   to show the memory overhead per block.  Run with
+   GLIBC_TUNABLES=glibc.malloc.slab=1 to measure the slab allocator.  */
 
 #define NUM_ITERS 200000
 #define NUM_ALLOCS 4
 #define MAX_ALLOCS 1600
+#define LIVE_BYTES (32 * 1024 * 1024)
 
 typedef struct
 {
@@ -69,6 +72,37 @@ do_benchmark (malloc_args *args, int **arr)
 static malloc_args tests[3][NUM_ALLOCS];
 static int allocs[NUM_ALLOCS] = { 25, 100, 400, MAX_ALLOCS };
 
+/* Allocate N blocks of SIZE bytes before freeing any of them.  Return
+   the growth of the maximum resident set size in kilobytes, and store
+   the time per block in *ELAPSED.  */
+static long
+do_live_benchmark (size_t size, size_t n, double *elapsed)
+{
+  void **arr = malloc (n * sizeof (void *));
+  struct rusage usage;
+  timing_t start, stop, diff;
+
+  /* Touch the array so that it does not count as growth.  */
+  for (size_t i = 0; i < n; i++)
+    arr[i] = NULL;
+  getrusage (RUSAGE_SELF, &usage);
+  long rss = usage.ru_maxrss;
+
+  TIMING_NOW (start);
+  for (size_t i = 0; i < n; i++)
+    arr[i] = malloc (size);
+  for (size_t i = 0; i < n; i++)
+    free (arr[i]);
+  TIMING_NOW (stop);
+
+  TIMING_DIFF (diff, start, stop);
+  *elapsed = (double) diff / n;
+
+  getrusage (RUSAGE_SELF, &usage);
+  free (arr);
+  return usage.ru_maxrss - rss;
+}
+
 static void *
 thread_test (void *p)
 {
@@ -114,6 +148,10 @@ bench (unsigned long size)
 
   free (arr);
 
+  size_t live_allocs = LIVE_BYTES / size;
+  double live_elapsed;
+  long live_rss = do_live_benchmark (size, live_allocs, &live_elapsed);
+
   json_ctx_t json_ctx;
 
   json_init (&json_ctx, 0, stdout);
@@ -154,6 +192,10 @@ bench (unsigned long size)
       json_attr_double (&json_ctx, s, tests[2][i].elapsed / iters2);
     }
 
+  json_attr_double (&json_ctx, "live_allocs", live_allocs);
+  json_attr_double (&json_ctx, "live_allocs_time", live_elapsed);
+  json_attr_double (&json_ctx, "live_allocs_rss", live_rss);
+
   json_attr_object_end (&json_ctx);
 
   json_attr_object_end (&json_ctx);
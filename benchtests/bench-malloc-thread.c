@@ -17,6 +17,7 @@
    <https://www.gnu.org/licenses/>.  */
 
 #include <errno.h>
+#include <malloc.h>
 #include <math.h>
 #include <pthread.h>
 #include <signal.h>
@@ -214,6 +215,31 @@ do_benchmark (size_t num_threads, size_t *iters)
   return elapsed;
 }
 
+/* Return the number of arena lock acquisitions so far, as reported by
+   malloc_info, or zero if it does not report them.  */
+static size_t
+malloc_lock_count (void)
+{
+  char *buf = NULL;
+  size_t size = 0, count = 0;
+  FILE *fp = open_memstream (&buf, &size);
+
+  if (fp == NULL)
+    return 0;
+  malloc_info (0, fp);
+  fclose (fp);
+
+  /* The totals for all arenas come last.  */
+  const char *tag = "<locks count=\"";
+  char *p = NULL;
+  for (char *q = buf; (q = strstr (q, tag)) != NULL; q++)
+    p = q;
+  if (p != NULL)
+    count = strtoul (p + strlen (tag), NULL, 10);
+  free (buf);
+  return count;
+}
+
 static void usage(const char *name)
 {
   fprintf (stderr, "%s: <num_threads>\n", name);
@@ -267,7 +293,9 @@ main (int argc, char **argv)
 
   alarm (BENCHMARK_DURATION);
 
+  size_t locks = malloc_lock_count ();
   cur = do_benchmark (num_threads, &iters);
+  locks = malloc_lock_count () - locks;
 
   struct rusage usage;
   getrusage(RUSAGE_SELF, &usage);
@@ -279,6 +307,8 @@ main (int argc, char **argv)
   json_attr_double (&json_ctx, "iterations", d_total_i);
   json_attr_double (&json_ctx, "time_per_iteration", d_total_s / d_total_i);
   json_attr_double (&json_ctx, "max_rss", usage.ru_maxrss);
+  /* Every iteration calls free and malloc once.  */
+  json_attr_double (&json_ctx, "locks_per_op", locks / (2 * d_total_i));
 
   json_attr_double (&json_ctx, "threads", num_threads);
   json_attr_double (&json_ctx, "min_size", MIN_ALLOCATION_SIZE);
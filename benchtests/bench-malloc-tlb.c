@@ -0,0 +1,214 @@
+/* Benchmark access to many small heap blocks for dTLB pressure.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* Allocate a working set of small blocks and chase pointers through
+   them in random order, so that nearly every access touches a different
+   page.  The time per access is dominated by dTLB misses unless the heap
+   is backed by huge pages.  The benchmark is run in the main arena, which
+   grows with sbrk, and in a thread arena, which grows its mmapped heaps.
+   Compare runs with GLIBC_TUNABLES=glibc.malloc.hugetlb=0 and 1.  */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench-timing.h"
+#include "json-lib.h"
+
+/* Default size of the working set in MiB.  */
+#define WORKING_SET_MB		48
+#define MIN_ALLOCATION_SIZE	16
+#define MAX_ALLOCATION_SIZE	512
+#define NUM_ACCESSES		(16 * 1024 * 1024)
+#define RAND_SEED		88
+
+struct block
+{
+  struct block *next;
+};
+
+struct tlb_args
+{
+  size_t working_set;
+  size_t blocks;
+  double alloc_time;
+  double access_time;
+  double free_time;
+  long anon_huge_kb;
+};
+
+/* Return the AnonHugePages total of the process in kB, or -1 if it is
+   not available.  */
+static long
+anon_huge_kb (void)
+{
+  FILE *f = fopen ("/proc/self/smaps_rollup", "r");
+  if (f == NULL)
+    return -1;
+
+  char line[256];
+  long kb = -1;
+  while (fgets (line, sizeof line, f) != NULL)
+    if (sscanf (line, "AnonHugePages: %ld kB", &kb) == 1)
+      break;
+  fclose (f);
+  return kb;
+}
+
+static void
+do_benchmark (struct tlb_args *args)
+{
+  size_t max_blocks = args->working_set / MIN_ALLOCATION_SIZE;
+  struct block **blocks = malloc (max_blocks * sizeof (*blocks));
+  unsigned int seed = RAND_SEED;
+  timing_t start, stop, elapsed;
+  size_t n = 0, total = 0;
+
+  if (blocks == NULL)
+    {
+      fprintf (stderr, "error: out of memory\n");
+      exit (1);
+    }
+
+  TIMING_NOW (start);
+  while (total < args->working_set)
+    {
+      size_t size = MIN_ALLOCATION_SIZE
+		    + rand_r (&seed) % (MAX_ALLOCATION_SIZE
+					- MIN_ALLOCATION_SIZE + 1);
+      blocks[n] = malloc (size);
+      if (blocks[n] == NULL)
+	{
+	  fprintf (stderr, "error: out of memory\n");
+	  exit (1);
+	}
+      total += size;
+      n++;
+    }
+  TIMING_NOW (stop);
+  TIMING_DIFF (elapsed, start, stop);
+  args->alloc_time = (double) elapsed / n;
+  args->blocks = n;
+
+  /* Link the blocks into a single cycle in random order.  */
+  for (size_t i = n - 1; i > 0; i--)
+    {
+      size_t j = rand_r (&seed) % (i + 1);
+      struct block *tmp = blocks[i];
+      blocks[i] = blocks[j];
+      blocks[j] = tmp;
+    }
+  for (size_t i = 0; i < n; i++)
+    blocks[i]->next = blocks[(i + 1) % n];
+
+  args->anon_huge_kb = anon_huge_kb ();
+
+  struct block *b = blocks[0];
+  TIMING_NOW (start);
+  for (size_t i = 0; i < NUM_ACCESSES; i++)
+    b = b->next;
+  TIMING_NOW (stop);
+  TIMING_DIFF (elapsed, start, stop);
+  args->access_time = (double) elapsed / NUM_ACCESSES;
+  /* Keep the loop from being optimized away.  */
+  __asm__ volatile ("" : : "r" (b) : "memory");
+
+  TIMING_NOW (start);
+  for (size_t i = 0; i < n; i++)
+    free (blocks[i]);
+  TIMING_NOW (stop);
+  TIMING_DIFF (elapsed, start, stop);
+  args->free_time = (double) elapsed / n;
+
+  free (blocks);
+}
+
+static void *
+thread_test (void *p)
+{
+  do_benchmark (p);
+  return NULL;
+}
+
+static void
+print_result (json_ctx_t *json_ctx, const char *name, struct tlb_args *args)
+{
+  json_attr_object_begin (json_ctx, name);
+  json_attr_double (json_ctx, "blocks", args->blocks);
+  json_attr_double (json_ctx, "alloc_time", args->alloc_time);
+  json_attr_double (json_ctx, "access_time", args->access_time);
+  json_attr_double (json_ctx, "free_time", args->free_time);
+  json_attr_double (json_ctx, "anon_huge_kb", args->anon_huge_kb);
+  json_attr_object_end (json_ctx);
+}
+
+static void
+usage (const char *name)
+{
+  fprintf (stderr, "%s: [working_set_mb]\n", name);
+  exit (1);
+}
+
+int
+main (int argc, char **argv)
+{
+  long mb = WORKING_SET_MB;
+  if (argc == 2)
+    mb = strtol (argv[1], NULL, 0);
+
+  if (argc > 2 || mb <= 0)
+    usage (argv[0]);
+
+  struct tlb_args main_args = { .working_set = (size_t) mb << 20 };
+  struct tlb_args thread_args = main_args;
+
+  /* Run in the main arena.  */
+  do_benchmark (&main_args);
+
+  /* Run in a thread arena.  */
+  pthread_t t;
+  pthread_create (&t, NULL, thread_test, &thread_args);
+  pthread_join (t, NULL);
+
+  json_ctx_t json_ctx;
+
+  json_init (&json_ctx, 0, stdout);
+
+  json_document_begin (&json_ctx);
+
+  json_attr_string (&json_ctx, "timing_type", TIMING_TYPE);
+
+  json_attr_object_begin (&json_ctx, "functions");
+
+  json_attr_object_begin (&json_ctx, "malloc");
+
+  json_attr_object_begin (&json_ctx, "");
+  json_attr_double (&json_ctx, "working_set_mb", mb);
+  print_result (&json_ctx, "main_arena", &main_args);
+  print_result (&json_ctx, "thread_arena", &thread_args);
+  json_attr_object_end (&json_ctx);
+
+  json_attr_object_end (&json_ctx);
+
+  json_attr_object_end (&json_ctx);
+
+  json_document_end (&json_ctx);
+
+  return 0;
+}
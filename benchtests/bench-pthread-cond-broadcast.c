@@ -0,0 +1,169 @@
+/* Benchmark the latency of pthread_cond_broadcast with many waiters.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* All waiters block on a condvar with the same mutex, and the main
+   thread broadcasts while holding the mutex, as for a barrier or a
+   state change that all waiters act upon.  For every broadcast, the
+   benchmark measures the time until the first and until the last
+   waiter got the mutex, and it reports the context switches per
+   broadcast.  Waking all waiters at once makes them contend for the
+   mutex, while requeueing them to it lets them take it one after the
+   other.  */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+
+#include "bench-timing.h"
+#include "json-lib.h"
+
+#define NUM_ROUNDS	1000
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t main_cond = PTHREAD_COND_INITIALIZER;
+static long num_waiters = 64;
+static long waiting;
+static long woken;
+static unsigned long generation;
+static timing_t first, last;
+
+static void *
+waiter (void *closure)
+{
+  for (int round = 0; round < NUM_ROUNDS; round++)
+    {
+      pthread_mutex_lock (&mutex);
+      unsigned long gen = generation;
+      if (++waiting == num_waiters)
+	pthread_cond_signal (&main_cond);
+      while (generation == gen)
+	pthread_cond_wait (&cond, &mutex);
+
+      timing_t now;
+      TIMING_NOW (now);
+      if (woken++ == 0)
+	first = now;
+      last = now;
+      if (woken == num_waiters)
+	pthread_cond_signal (&main_cond);
+      pthread_mutex_unlock (&mutex);
+    }
+  return NULL;
+}
+
+static void
+usage (const char *name)
+{
+  fprintf (stderr, "%s: [<num_waiters>]\n", name);
+  exit (1);
+}
+
+int
+main (int argc, char **argv)
+{
+  if (argc > 2)
+    usage (argv[0]);
+  if (argc == 2)
+    {
+      num_waiters = strtol (argv[1], NULL, 10);
+      if (num_waiters < 1)
+	usage (argv[0]);
+    }
+
+  pthread_t threads[num_waiters];
+  for (long i = 0; i < num_waiters; i++)
+    if (pthread_create (&threads[i], NULL, waiter, NULL) != 0)
+      {
+	fprintf (stderr, "error: pthread_create failed\n");
+	return 1;
+      }
+
+  timing_t first_total = 0, last_total = 0;
+  timing_t last_min = ~(timing_t) 0, last_max = 0;
+  struct rusage usage_before, usage_after;
+
+  getrusage (RUSAGE_SELF, &usage_before);
+  for (int round = 0; round < NUM_ROUNDS; round++)
+    {
+      pthread_mutex_lock (&mutex);
+      while (waiting < num_waiters)
+	pthread_cond_wait (&main_cond, &mutex);
+      waiting = 0;
+      woken = 0;
+
+      timing_t start, diff;
+      TIMING_NOW (start);
+      generation++;
+      pthread_cond_broadcast (&cond);
+      pthread_mutex_unlock (&mutex);
+
+      pthread_mutex_lock (&mutex);
+      while (woken < num_waiters)
+	pthread_cond_wait (&main_cond, &mutex);
+      TIMING_DIFF (diff, start, first);
+      TIMING_ACCUM (first_total, diff);
+      TIMING_DIFF (diff, start, last);
+      TIMING_ACCUM (last_total, diff);
+      if (diff < last_min)
+	last_min = diff;
+      if (diff > last_max)
+	last_max = diff;
+      pthread_mutex_unlock (&mutex);
+    }
+  getrusage (RUSAGE_SELF, &usage_after);
+
+  for (long i = 0; i < num_waiters; i++)
+    pthread_join (threads[i], NULL);
+
+  json_ctx_t json_ctx;
+
+  json_init (&json_ctx, 0, stdout);
+
+  json_document_begin (&json_ctx);
+
+  json_attr_string (&json_ctx, "timing_type", TIMING_TYPE);
+
+  json_attr_object_begin (&json_ctx, "functions");
+
+  json_attr_object_begin (&json_ctx, "pthread_cond_broadcast");
+
+  json_attr_object_begin (&json_ctx, "");
+  json_attr_double (&json_ctx, "waiters", num_waiters);
+  json_attr_double (&json_ctx, "broadcasts", NUM_ROUNDS);
+  json_attr_double (&json_ctx, "first_waiter_latency",
+		    (double) first_total / NUM_ROUNDS);
+  json_attr_double (&json_ctx, "last_waiter_latency",
+		    (double) last_total / NUM_ROUNDS);
+  json_attr_double (&json_ctx, "last_waiter_latency_min", last_min);
+  json_attr_double (&json_ctx, "last_waiter_latency_max", last_max);
+  json_attr_double (&json_ctx, "context_switches",
+		    (double) ((usage_after.ru_nvcsw - usage_before.ru_nvcsw)
+			      + (usage_after.ru_nivcsw
+				 - usage_before.ru_nivcsw)) / NUM_ROUNDS);
+  json_attr_object_end (&json_ctx);
+
+  json_attr_object_end (&json_ctx);
+
+  json_attr_object_end (&json_ctx);
+
+  json_document_end (&json_ctx);
+
+  return 0;
+}
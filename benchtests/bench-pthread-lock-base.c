@@ -36,6 +36,13 @@ static pthread_barrier_t barrier;
 
 #define START_ITERS 1000
 
+/* The lock types to measure, as pairs of a name and a value for
+   LOCK_ATTR_INIT_TYPE.  */
+#ifndef LOCK_TYPES
+# define LOCK_TYPES { "adaptive", 0 }
+# define LOCK_ATTR_INIT_TYPE(attr, type) LOCK_ATTR_INIT (attr)
+#endif
+
 #pragma GCC push_options
 #pragma GCC optimize(1)
 
@@ -65,7 +72,9 @@ do_filler_shared (void)
 
 #pragma GCC pop_options
 
-#define UNIT_WORK_CRT do_filler_shared ()
+#ifndef UNIT_WORK_CRT
+# define UNIT_WORK_CRT do_filler_shared ()
+#endif
 #define UNIT_WORK_NON_CRT do_filler ()
 
 static inline void
@@ -230,7 +239,7 @@ do_bench_one (const char *name, int num_threads, int crt_len, int non_crt_len,
   json_attr_object_end (js);
 }
 
-#define TH_CONF_MAX 10
+#define TH_CONF_MAX 12
 
 int
 do_bench (void)
@@ -243,6 +252,11 @@ do_bench (void)
   int crt_lens[] = { 0, 1, 2, 4, 8, 16, 32, 64, 128 };
   int non_crt_lens[] = { 1, 32, 128 };
   char name[128];
+  static const struct
+  {
+    const char *name;
+    int type;
+  } types[] = { LOCK_TYPES };
 
   json_init (&json_ctx, 2, stdout);
   json_attr_object_begin (&json_ctx, TEST_NAME);
@@ -258,20 +272,30 @@ do_bench (void)
     }
   threads[th_conf++] = nprocs;
   threads[th_conf++] = nprocs + nprocs / 4;
-
-  LOCK_ATTR_INIT (&attr);
-  snprintf (name, sizeof name, "type=adaptive");
-
-  for (k = 0; k < (sizeof (non_crt_lens) / sizeof (int)); k++)
+#ifdef LOCK_OVERSUBSCRIBE
+  /* Lock holders get preempted once there are several threads per CPU,
+     and spinning on the lock only delays them.  */
+  threads[th_conf++] = 2 * nprocs;
+  threads[th_conf++] = 4 * nprocs;
+#endif
+
+  for (int t = 0; t < (sizeof (types) / sizeof (types[0])); t++)
     {
-      int non_crt_len = non_crt_lens[k];
-      for (j = 0; j < (sizeof (crt_lens) / sizeof (int)); j++)
+      LOCK_ATTR_INIT_TYPE (&attr, types[t].type);
+      snprintf (name, sizeof name, "type=%s", types[t].name);
+
+      for (k = 0; k < (sizeof (non_crt_lens) / sizeof (int)); k++)
 	{
-	  int crt_len = crt_lens[j];
-	  for (i = 0; i < th_conf; i++)
+	  int non_crt_len = non_crt_lens[k];
+	  for (j = 0; j < (sizeof (crt_lens) / sizeof (int)); j++)
 	    {
-	      th_num = threads[i];
-	      do_bench_one (name, th_num, crt_len, non_crt_len, &json_ctx);
+	      int crt_len = crt_lens[j];
+	      for (i = 0; i < th_conf; i++)
+		{
+		  th_num = threads[i];
+		  do_bench_one (name, th_num, crt_len, non_crt_len,
+				&json_ctx);
+		}
 	    }
 	}
     }
@@ -20,9 +20,16 @@
 #define UNLOCK(lock) pthread_mutex_unlock (lock)
 #define LOCK_INIT(lock, attr) pthread_mutex_init (lock, attr)
 #define LOCK_DESTROY(lock) pthread_mutex_destroy (lock)
-#define LOCK_ATTR_INIT(attr)                                                  \
+#define LOCK_ATTR_INIT_TYPE(attr, type)                                       \
   pthread_mutexattr_init (attr);                                              \
-  pthread_mutexattr_settype (attr, PTHREAD_MUTEX_ADAPTIVE_NP);
+  pthread_mutexattr_settype (attr, type);
+
+/* Compare the fixed spin budget of adaptive mutexes with the learned one,
+   including with more threads than CPUs.  */
+#define LOCK_TYPES                                                            \
+  { "adaptive", PTHREAD_MUTEX_ADAPTIVE_NP },                                  \
+  { "adaptive_spin", PTHREAD_MUTEX_ADAPTIVE_SPIN_NP }
+#define LOCK_OVERSUBSCRIBE
 
 #define bench_lock_t pthread_mutex_t
 #define bench_lock_attr_t pthread_mutexattr_t
@@ -0,0 +1,51 @@
+/* Measure pthread_rwlock_rdlock with mostly readers.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <pthread.h>
+
+/* One in WRITE_PERIOD acquisitions of each thread is a write lock.  */
+#define WRITE_PERIOD 100
+
+static __thread unsigned int lock_count;
+
+#define LOCK(lock)                                                            \
+  (++lock_count % WRITE_PERIOD == 0                                           \
+   ? pthread_rwlock_wrlock (lock) : pthread_rwlock_rdlock (lock))
+#define UNLOCK(lock) pthread_rwlock_unlock (lock)
+#define LOCK_INIT(lock, attr) pthread_rwlock_init (lock, attr)
+#define LOCK_DESTROY(lock) pthread_rwlock_destroy (lock)
+#define LOCK_ATTR_INIT_TYPE(attr, type)                                       \
+  pthread_rwlockattr_init (attr);                                             \
+  pthread_rwlockattr_setkind_np (attr, type);
+
+/* Compare the reader count in the lock word with the per-thread reader
+   slots.  */
+#define LOCK_TYPES                                                            \
+  { "prefer_reader", PTHREAD_RWLOCK_PREFER_READER_NP },                       \
+  { "prefer_reader_scalable", PTHREAD_RWLOCK_PREFER_READER_SCALABLE_NP }
+
+/* Readers run concurrently, so let their critical sections not share
+   any data, which would hide the cost of the lock itself.  */
+#define UNIT_WORK_CRT do_filler ()
+
+#define bench_lock_t pthread_rwlock_t
+#define bench_lock_attr_t pthread_rwlockattr_t
+
+#define TEST_NAME "pthread-rwlock-read"
+
+#include "bench-pthread-lock-base.c"
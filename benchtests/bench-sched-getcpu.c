@@ -0,0 +1,133 @@
+/* Measure sched_getcpu against the getcpu system call.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* sched_getcpu uses the rseq area when the kernel maintains it, and
+   otherwise the per-thread cache configured with the
+   glibc.pthread.getcpu_cache tunable.  Run this benchmark with different
+   values of GLIBC_TUNABLES=glibc.pthread.getcpu_cache=N to compare the
+   cache against the plain system call.  */
+
+#define TEST_MAIN
+#define TEST_NAME "sched-getcpu"
+#define TIMEOUT (20 * 60)
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <sys/sysinfo.h>
+#include <unistd.h>
+#include "bench-timing.h"
+#include "json-lib.h"
+
+#define ITERS 100000
+
+static pthread_barrier_t barrier;
+
+static int
+syscall_getcpu (void)
+{
+  unsigned int cpu;
+  return syscall (SYS_getcpu, &cpu, NULL, NULL) == 0 ? cpu : -1;
+}
+
+struct worker_params
+{
+  int (*getcpu) (void);
+  timing_t duration;
+};
+
+static void *
+worker (void *closure)
+{
+  struct worker_params *p = closure;
+  timing_t start, stop;
+
+  pthread_barrier_wait (&barrier);
+  TIMING_NOW (start);
+  for (int i = 0; i < ITERS; i++)
+    if (p->getcpu () < 0)
+      {
+	printf ("error: getcpu failed\n");
+	exit (1);
+      }
+  TIMING_NOW (stop);
+  TIMING_DIFF (p->duration, start, stop);
+
+  return NULL;
+}
+
+static void
+do_bench_one (json_ctx_t *js, const char *name, int (*getcpu) (void),
+	      int num_threads)
+{
+  struct worker_params params[num_threads];
+  pthread_t threads[num_threads];
+
+  pthread_barrier_init (&barrier, NULL, num_threads);
+  for (int i = 0; i < num_threads; i++)
+    {
+      params[i].getcpu = getcpu;
+      pthread_create (&threads[i], NULL, worker, &params[i]);
+    }
+
+  double mean = 0;
+  for (int i = 0; i < num_threads; i++)
+    {
+      pthread_join (threads[i], NULL);
+      mean += (double) params[i].duration / ITERS;
+    }
+  mean /= num_threads;
+  pthread_barrier_destroy (&barrier);
+
+  char buf[128];
+  snprintf (buf, sizeof buf, "%s,threads=%d", name, num_threads);
+  json_attr_object_begin (js, buf);
+  json_attr_double (js, "iterations", ITERS);
+  json_attr_double (js, "mean", mean);
+  json_attr_object_end (js);
+}
+
+static int
+do_bench (void)
+{
+  json_ctx_t json_ctx;
+  int nprocs = get_nprocs ();
+
+  json_init (&json_ctx, 2, stdout);
+  json_attr_object_begin (&json_ctx, TEST_NAME);
+
+  for (int threads = 1; ; threads *= 2)
+    {
+      if (threads > nprocs)
+	threads = nprocs;
+      do_bench_one (&json_ctx, "sched_getcpu", sched_getcpu, threads);
+      do_bench_one (&json_ctx, "syscall", syscall_getcpu, threads);
+      if (threads == nprocs)
+	break;
+    }
+
+  json_attr_object_end (&json_ctx);
+
+  return 0;
+}
+
+#define TEST_FUNCTION do_bench ()
+
+#include "../test-skeleton.c"
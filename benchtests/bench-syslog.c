@@ -0,0 +1,128 @@
+/* Measure syslog throughput from several threads.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* Every thread logs ITERS short messages.  The time per message covers
+   the syslog calls and the closelog call at the end, which sends any
+   messages still queued, so synchronous and batched delivery can be
+   compared.  Run once with the default settings and once with, for
+   example, GLIBC_TUNABLES=glibc.syslog.batch=64.
+
+   Messages that cannot be delivered to the log daemon are written to
+   standard error, which is redirected to /dev/null while measuring.  */
+
+#define TEST_MAIN
+#define TEST_NAME "syslog"
+#define TIMEOUT (20 * 60)
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/sysinfo.h>
+#include <syslog.h>
+#include <unistd.h>
+#include "bench-timing.h"
+#include "json-lib.h"
+
+#define ITERS 10000
+
+static pthread_barrier_t barrier;
+
+static void *
+worker (void *closure)
+{
+  long id = (long) closure;
+
+  pthread_barrier_wait (&barrier);
+  for (int i = 0; i < ITERS; i++)
+    syslog (LOG_INFO, "bench-syslog thread %ld message %d", id, i);
+  pthread_barrier_wait (&barrier);
+
+  return NULL;
+}
+
+static void
+do_bench_one (json_ctx_t *js, int num_threads)
+{
+  pthread_t threads[num_threads];
+  timing_t start, stop, duration;
+
+  openlog ("bench-syslog", LOG_NDELAY, LOG_USER);
+  pthread_barrier_init (&barrier, NULL, num_threads + 1);
+  for (long i = 0; i < num_threads; i++)
+    pthread_create (&threads[i], NULL, worker, (void *) i);
+
+  pthread_barrier_wait (&barrier);
+  TIMING_NOW (start);
+  pthread_barrier_wait (&barrier);
+  closelog ();
+  TIMING_NOW (stop);
+  TIMING_DIFF (duration, start, stop);
+
+  for (int i = 0; i < num_threads; i++)
+    pthread_join (threads[i], NULL);
+  pthread_barrier_destroy (&barrier);
+
+  char buf[128];
+  snprintf (buf, sizeof buf, "syslog,threads=%d", num_threads);
+  json_attr_object_begin (js, buf);
+  json_attr_double (js, "iterations", (double) ITERS * num_threads);
+  json_attr_double (js, "mean", (double) duration / ITERS / num_threads);
+  json_attr_object_end (js);
+}
+
+static int
+do_bench (void)
+{
+  json_ctx_t json_ctx;
+  int nprocs = get_nprocs ();
+  const char *tunables = getenv ("GLIBC_TUNABLES");
+
+  int saved_stderr = dup (STDERR_FILENO);
+  int null_fd = open ("/dev/null", O_WRONLY);
+  if (saved_stderr < 0 || null_fd < 0)
+    {
+      printf ("error: cannot redirect standard error\n");
+      exit (1);
+    }
+
+  json_init (&json_ctx, 2, stdout);
+  json_attr_object_begin (&json_ctx, TEST_NAME);
+  json_attr_string (&json_ctx, "tunables", tunables != NULL ? tunables : "");
+
+  for (int threads = 1; ; threads *= 2)
+    {
+      if (threads > nprocs)
+	threads = nprocs;
+      dup2 (null_fd, STDERR_FILENO);
+      do_bench_one (&json_ctx, threads);
+      dup2 (saved_stderr, STDERR_FILENO);
+      if (threads == nprocs)
+	break;
+    }
+
+  json_attr_object_end (&json_ctx);
+
+  close (null_fd);
+  close (saved_stderr);
+  return 0;
+}
+
+#define TEST_FUNCTION do_bench ()
+
+#include "../test-skeleton.c"
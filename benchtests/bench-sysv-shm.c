@@ -0,0 +1,184 @@
+/* Measure SysV shared memory segment churn from several threads.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* Two workloads are measured with an increasing number of threads:
+
+   - "create": every iteration creates a private segment, attaches and
+     detaches it, and removes it again, like a client that allocates a
+     segment per request.
+   - "attach": every thread attaches and detaches one segment created
+     up front, like MIT-SHM clients that map the same images repeatedly.
+
+   On Android, where the segments are emulated on top of ashmem, this
+   shows how well the emulation scales with the number of threads.  */
+
+#define TEST_MAIN
+#define TEST_NAME "sysv-shm"
+#define TIMEOUT (20 * 60)
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <sys/sysinfo.h>
+#include "bench-timing.h"
+#include "json-lib.h"
+
+#define ITERS 2000
+#define SEGMENT_SIZE (64 * 1024)
+
+static pthread_barrier_t barrier;
+
+struct worker_params
+{
+  void (*op) (struct worker_params *);
+  int shmid;
+  timing_t duration;
+};
+
+static void
+xshmdt (void *addr)
+{
+  if (shmdt (addr) != 0)
+    {
+      printf ("error: shmdt failed\n");
+      exit (1);
+    }
+}
+
+static void *
+xshmat (int shmid)
+{
+  void *addr = shmat (shmid, NULL, 0);
+  if (addr == (void *) -1)
+    {
+      printf ("error: shmat failed\n");
+      exit (1);
+    }
+  /* Touch the mapping so that it is actually populated.  */
+  *(volatile char *) addr = 1;
+  return addr;
+}
+
+static void
+op_create (struct worker_params *p)
+{
+  int shmid = shmget (IPC_PRIVATE, SEGMENT_SIZE, IPC_CREAT | 0600);
+  if (shmid < 0)
+    {
+      printf ("error: shmget failed\n");
+      exit (1);
+    }
+  xshmdt (xshmat (shmid));
+  shmctl (shmid, IPC_RMID, NULL);
+}
+
+static void
+op_attach (struct worker_params *p)
+{
+  xshmdt (xshmat (p->shmid));
+}
+
+static void *
+worker (void *closure)
+{
+  struct worker_params *p = closure;
+  timing_t start, stop;
+
+  pthread_barrier_wait (&barrier);
+  TIMING_NOW (start);
+  for (int i = 0; i < ITERS; i++)
+    p->op (p);
+  TIMING_NOW (stop);
+  TIMING_DIFF (p->duration, start, stop);
+
+  return NULL;
+}
+
+static void
+do_bench_one (json_ctx_t *js, const char *name,
+	      void (*op) (struct worker_params *), int num_threads)
+{
+  struct worker_params params[num_threads];
+  pthread_t threads[num_threads];
+
+  pthread_barrier_init (&barrier, NULL, num_threads);
+  for (int i = 0; i < num_threads; i++)
+    {
+      params[i].op = op;
+      params[i].shmid = -1;
+      if (op == op_attach)
+	{
+	  params[i].shmid = shmget (IPC_PRIVATE, SEGMENT_SIZE,
+				    IPC_CREAT | 0600);
+	  if (params[i].shmid < 0)
+	    {
+	      printf ("error: shmget failed\n");
+	      exit (1);
+	    }
+	}
+      pthread_create (&threads[i], NULL, worker, &params[i]);
+    }
+
+  double mean = 0;
+  for (int i = 0; i < num_threads; i++)
+    {
+      pthread_join (threads[i], NULL);
+      mean += (double) params[i].duration / ITERS;
+      if (params[i].shmid >= 0)
+	shmctl (params[i].shmid, IPC_RMID, NULL);
+    }
+  mean /= num_threads;
+  pthread_barrier_destroy (&barrier);
+
+  char buf[128];
+  snprintf (buf, sizeof buf, "%s,threads=%d", name, num_threads);
+  json_attr_object_begin (js, buf);
+  json_attr_double (js, "iterations", ITERS);
+  json_attr_double (js, "mean", mean);
+  json_attr_object_end (js);
+}
+
+static int
+do_bench (void)
+{
+  json_ctx_t json_ctx;
+  int nprocs = get_nprocs ();
+
+  json_init (&json_ctx, 2, stdout);
+  json_attr_object_begin (&json_ctx, TEST_NAME);
+
+  for (int threads = 1; ; threads *= 2)
+    {
+      if (threads > nprocs)
+	threads = nprocs;
+      do_bench_one (&json_ctx, "create", op_create, threads);
+      do_bench_one (&json_ctx, "attach", op_attach, threads);
+      if (threads == nprocs)
+	break;
+    }
+
+  json_attr_object_end (&json_ctx);
+
+  return 0;
+}
+
+#define TEST_FUNCTION do_bench ()
+
+#include "../test-skeleton.c"
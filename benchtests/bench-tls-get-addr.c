@@ -0,0 +1,266 @@
+/* Measure __tls_get_addr latency while another thread calls dlopen.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* The benchmark keeps NUM_RESIDENT plugins with TLS loaded, which fill
+   several elements of the slotinfo list, like the modules of a server
+   with many plugins.  Each of the worker threads times every call of
+   bench_tls_access in bench-tls-get-addr-mod.so, which accesses a TLS
+   variable of that module.  This is done once with no other activity,
+   and once while another thread keeps loading the remaining plugins,
+   touching their TLS and unloading them again.  Each dlopen and dlclose
+   changes the TLS generation, so that the next access of every worker
+   has to update its DTV.  The percentiles of the latencies are printed,
+   since the updates show in the tail rather than in the mean.
+
+   The directory with the modules can be passed on the command line
+   after the number of threads; by default it is the directory of the
+   benchmark.  */
+
+#include <dlfcn.h>
+#include <libgen.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench-timing.h"
+#include "json-lib.h"
+#include <array_length.h>
+
+#define NUM_SAMPLES	200000
+#define NUM_PLUGINS	200
+#define NUM_RESIDENT	192
+#define NUM_CYCLING	(NUM_PLUGINS - NUM_RESIDENT)
+
+static const char *dir;
+static int (*bench_tls_access) (void);
+static void *resident[NUM_RESIDENT];
+
+/* Set when the worker threads are done.  */
+static int done;
+
+/* Number of times the loader thread loaded all plugins.  */
+static unsigned long int cycles;
+
+static void *
+xdlopen_plugin (int i)
+{
+  char *path;
+  void *handle = NULL;
+  if (asprintf (&path, "%s/bench-tls-get-addr-plugin%03d.so", dir, i) >= 0)
+    {
+      handle = dlopen (path, RTLD_NOW);
+      free (path);
+    }
+  if (handle == NULL)
+    {
+      fprintf (stderr, "### cannot load plugin %d: %s\n", i, dlerror ());
+      exit (EXIT_FAILURE);
+    }
+
+  /* Allocate the TLS block of the plugin in this thread.  */
+  void (*touch) (void) = dlsym (handle, "bench_tls_plugin_touch");
+  if (touch == NULL)
+    {
+      fprintf (stderr, "### %s\n", dlerror ());
+      exit (EXIT_FAILURE);
+    }
+  touch ();
+  return handle;
+}
+
+static void *
+loader (void *closure)
+{
+  void *handles[NUM_CYCLING];
+
+  while (!__atomic_load_n (&done, __ATOMIC_RELAXED))
+    {
+      for (int i = 0; i < NUM_CYCLING; i++)
+	handles[i] = xdlopen_plugin (NUM_RESIDENT + i);
+      for (int i = NUM_CYCLING - 1; i >= 0; i--)
+	dlclose (handles[i]);
+      ++cycles;
+    }
+  return NULL;
+}
+
+static void *
+worker (void *closure)
+{
+  timing_t *latency = closure;
+  timing_t start, stop;
+
+  bench_tls_access ();
+  for (size_t i = 0; i < NUM_SAMPLES; i++)
+    {
+      TIMING_NOW (start);
+      bench_tls_access ();
+      TIMING_NOW (stop);
+      TIMING_DIFF (latency[i], start, stop);
+    }
+  return NULL;
+}
+
+static int
+compare_timing (const void *a, const void *b)
+{
+  timing_t x = *(const timing_t *) a;
+  timing_t y = *(const timing_t *) b;
+  return x < y ? -1 : x > y;
+}
+
+/* Print the percentiles of the N latencies in SAMPLES, sorting them.  */
+static void
+print_percentiles (json_ctx_t *json_ctx, const char *name,
+		   timing_t *samples, size_t n)
+{
+  static const struct
+  {
+    const char *name;
+    double fraction;
+  } percentiles[] =
+    {
+      { "p50", 0.5 },
+      { "p99", 0.99 },
+      { "p99.9", 0.999 },
+      { "p99.99", 0.9999 },
+    };
+  double sum = 0;
+
+  qsort (samples, n, sizeof (timing_t), compare_timing);
+  for (size_t i = 0; i < n; i++)
+    sum += samples[i];
+
+  json_attr_object_begin (json_ctx, name);
+  json_attr_double (json_ctx, "mean", sum / n);
+  for (size_t i = 0; i < array_length (percentiles); i++)
+    json_attr_double (json_ctx, percentiles[i].name,
+		      samples[(size_t) (percentiles[i].fraction * (n - 1))]);
+  json_attr_double (json_ctx, "max", samples[n - 1]);
+  json_attr_object_end (json_ctx);
+}
+
+/* Run NUM_THREADS workers, with the loader thread if WITH_LOADER, and
+   store their latencies in SAMPLES.  */
+static void
+run (long num_threads, bool with_loader, timing_t *samples)
+{
+  pthread_t threads[num_threads];
+  pthread_t loader_thread;
+
+  __atomic_store_n (&done, 0, __ATOMIC_RELAXED);
+  if (with_loader)
+    pthread_create (&loader_thread, NULL, loader, NULL);
+  for (long i = 0; i < num_threads; i++)
+    pthread_create (&threads[i], NULL, worker, samples + i * NUM_SAMPLES);
+  for (long i = 0; i < num_threads; i++)
+    pthread_join (threads[i], NULL);
+  __atomic_store_n (&done, 1, __ATOMIC_RELAXED);
+  if (with_loader)
+    pthread_join (loader_thread, NULL);
+}
+
+static void
+usage (const char *name)
+{
+  fprintf (stderr, "%s: [<num_threads> [<module directory>]]\n", name);
+  exit (1);
+}
+
+int
+main (int argc, char **argv)
+{
+  long num_threads = 4;
+
+  if (argc > 3)
+    usage (argv[0]);
+  if (argc >= 2)
+    {
+      num_threads = strtol (argv[1], NULL, 10);
+      if (num_threads < 1)
+	usage (argv[0]);
+    }
+  if (argc == 3)
+    dir = argv[2];
+  else
+    {
+      char *copy = strdup (argv[0]);
+      if (copy == NULL)
+	{
+	  fprintf (stderr, "### out of memory\n");
+	  return EXIT_FAILURE;
+	}
+      dir = dirname (copy);
+    }
+
+  char *path;
+  void *handle = NULL;
+  if (asprintf (&path, "%s/bench-tls-get-addr-mod.so", dir) >= 0)
+    {
+      handle = dlopen (path, RTLD_NOW);
+      free (path);
+    }
+  if (handle == NULL
+      || (bench_tls_access = dlsym (handle, "bench_tls_access")) == NULL)
+    {
+      fprintf (stderr, "### cannot load module: %s\n", dlerror ());
+      return EXIT_FAILURE;
+    }
+  for (int i = 0; i < NUM_RESIDENT; i++)
+    resident[i] = xdlopen_plugin (i);
+
+  size_t n = num_threads * NUM_SAMPLES;
+  timing_t *idle = calloc (n, sizeof (timing_t));
+  timing_t *loading = calloc (n, sizeof (timing_t));
+  if (idle == NULL || loading == NULL)
+    {
+      fprintf (stderr, "### out of memory\n");
+      return EXIT_FAILURE;
+    }
+
+  run (num_threads, false, idle);
+  run (num_threads, true, loading);
+
+  json_ctx_t json_ctx;
+  json_init (&json_ctx, 0, stdout);
+  json_document_begin (&json_ctx);
+
+  json_attr_string (&json_ctx, "timing_type", TIMING_TYPE);
+  json_attr_object_begin (&json_ctx, "functions");
+  json_attr_object_begin (&json_ctx, "__tls_get_addr");
+  json_attr_object_begin (&json_ctx, "");
+
+  json_attr_uint (&json_ctx, "threads", num_threads);
+  json_attr_uint (&json_ctx, "samples", n);
+  json_attr_uint (&json_ctx, "resident-modules", NUM_RESIDENT);
+  json_attr_uint (&json_ctx, "dlopen-cycles", cycles);
+  print_percentiles (&json_ctx, "idle", idle, n);
+  print_percentiles (&json_ctx, "dlopen-loop", loading, n);
+
+  json_attr_object_end (&json_ctx);
+  json_attr_object_end (&json_ctx);
+  json_attr_object_end (&json_ctx);
+  json_document_end (&json_ctx);
+
+  for (int i = NUM_RESIDENT - 1; i >= 0; i--)
+    dlclose (resident[i]);
+  free (idle);
+  free (loading);
+  return 0;
+}
@@ -0,0 +1,454 @@
+/* Build the prebuilt Android store path map used by ld.so.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <argp.h>
+#include <dirent.h>
+#include <error.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <libintl.h>
+#include <limits.h>
+#include <locale.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <dl-new-hash.h>
+#include <programs/xasprintf.h>
+#include <programs/xmalloc.h>
+#include "dl-android-paths.h"
+#include "dl-android-pathmap.h"
+
+/* Get libc version number.  */
+#include <version.h>
+
+#define PACKAGE _libc_intl_domainname
+
+/* Same as MAXSYMLINKS, and the limit used by ld.so.  */
+#define MAX_SYMLINKS 40
+
+struct pathmap_entry
+{
+  uint32_t hash;
+  uint32_t flags;
+  char *key;
+  char *value;
+};
+
+static struct pathmap_entry *entries;
+static size_t nentries;
+static size_t entries_alloc;
+
+/* Be verbose.  */
+static int opt_verbose;
+
+/* Print the map instead of building it.  */
+static int opt_print;
+
+/* Map file to use.  */
+static const char *map_file = ANDROID_PATHMAP_FILE;
+
+/* Name and version of program.  */
+static void print_version (FILE *stream, struct argp_state *state);
+void (*argp_program_version_hook) (FILE *, struct argp_state *)
+     = print_version;
+
+/* Function to print some extra text in the help message.  */
+static char *more_help (int key, const char *text, void *input);
+
+/* Definitions of arguments for argp functions.  */
+static const struct argp_option options[] =
+{
+  { "print", 'p', NULL, 0, N_("Print the current map"), 0},
+  { "verbose", 'v', NULL, 0, N_("Generate verbose messages"), 0},
+  { NULL, 'C', N_("MAP"), 0, N_("Use MAP as map file"), 0},
+  { NULL, 0, NULL, 0, NULL, 0 }
+};
+
+/* Short description of program.  */
+static const char doc[] = N_("\
+Build the map of Nix store library paths used by the dynamic linker.");
+
+/* Prototype for option handler.  */
+static error_t parse_opt (int key, char *arg, struct argp_state *state);
+
+/* Data structure to communicate with argp functions.  */
+static struct argp argp =
+{
+  options, parse_opt, NULL, doc, NULL, more_help, NULL
+};
+
+/* Handle program arguments.  */
+static error_t
+parse_opt (int key, char *arg, struct argp_state *state)
+{
+  switch (key)
+    {
+    case 'C':
+      map_file = arg;
+      break;
+    case 'p':
+      opt_print = 1;
+      break;
+    case 'v':
+      opt_verbose = 1;
+      break;
+    default:
+      return ARGP_ERR_UNKNOWN;
+    }
+
+  return 0;
+}
+
+/* Print bug-reporting information in the help message.  */
+static char *
+more_help (int key, const char *text, void *input)
+{
+  char *tp = NULL;
+  switch (key)
+    {
+    case ARGP_KEY_HELP_EXTRA:
+      /* We print some extra information.  */
+      if (asprintf (&tp, gettext ("\
+For bug reporting instructions, please see:\n\
+%s.\n"), REPORT_BUGS_TO) < 0)
+	return NULL;
+      return tp;
+    default:
+      break;
+    }
+  return (char *) text;
+}
+
+/* Print the version information.  */
+static void
+print_version (FILE *stream, struct argp_state *state)
+{
+  fprintf (stream, "android-pathmap %s%s\n", PKGVERSION, VERSION);
+  fprintf (stream, gettext ("\
+Copyright (C) %s Free Software Foundation, Inc.\n\
+This is free software; see the source for copying conditions.  There is NO\n\
+warranty; not even for MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.\n\
+"), "2024");
+}
+
+static bool
+in_store (const char *path)
+{
+  return (strncmp (path, ANDROID_REAL_STORE, ANDROID_REAL_STORE_LEN) == 0
+	  && path[ANDROID_REAL_STORE_LEN] == '/');
+}
+
+/* Resolve PATH into BUF the way _dl_android_resolve_path does.  Returns
+   true if the chain ends at an existing file inside the store.  */
+static bool
+resolve (const char *path, char *buf)
+{
+  char link_target[PATH_MAX];
+
+  if (_dl_android_process_path (path, buf, PATH_MAX) == 0)
+    {
+      if (strlen (path) >= PATH_MAX)
+	return false;
+      strcpy (buf, path);
+    }
+
+  for (int i = 0; i < MAX_SYMLINKS; ++i)
+    {
+      struct stat64 st;
+      if (lstat64 (buf, &st) != 0)
+	return false;
+      if (!S_ISLNK (st.st_mode))
+	return in_store (buf);
+
+      ssize_t n = readlink (buf, link_target, PATH_MAX - 1);
+      if (n < 0)
+	return false;
+      link_target[n] = '\0';
+
+      if (_dl_android_process_path (link_target, buf, PATH_MAX) != 0)
+	continue;
+      if (link_target[0] != '/')
+	{
+	  char *last_slash = strrchr (buf, '/');
+	  size_t dir_len = last_slash != NULL ? last_slash - buf + 1 : 0;
+	  if (dir_len + n >= PATH_MAX)
+	    return false;
+	  memcpy (buf + dir_len, link_target, n + 1);
+	}
+      else
+	memcpy (buf, link_target, n + 1);
+    }
+
+  return false;
+}
+
+static void
+add_entry (char *key, uint32_t flags, char *value)
+{
+  if (nentries == entries_alloc)
+    {
+      entries_alloc = entries_alloc != 0 ? 2 * entries_alloc : 1024;
+      entries = xrealloc (entries, entries_alloc * sizeof (*entries));
+    }
+  entries[nentries++] = (struct pathmap_entry)
+    {
+      .hash = _dl_new_hash (key),
+      .flags = flags,
+      .key = key,
+      .value = value
+    };
+}
+
+/* Record the lib directory of the store object NAME, if it has one, and
+   every entry in it.  */
+static void
+add_store_object (const char *name)
+{
+  char *dirname = xasprintf ("%s/%s/lib", ANDROID_REAL_STORE, name);
+  DIR *dir = opendir (dirname);
+  if (dir == NULL)
+    {
+      free (dirname);
+      return;
+    }
+
+  if (opt_verbose)
+    printf ("%s:\n", dirname);
+
+  char resolved[PATH_MAX];
+  struct dirent64 *d;
+  while ((d = readdir64 (dir)) != NULL)
+    {
+      if (strcmp (d->d_name, ".") == 0 || strcmp (d->d_name, "..") == 0)
+	continue;
+
+      char *key = xasprintf ("%s/%s", dirname, d->d_name);
+      if (resolve (key, resolved))
+	{
+	  if (opt_verbose)
+	    printf ("\t%s -> %s\n", d->d_name, resolved);
+	  add_entry (key, 0, xstrdup (resolved));
+	}
+      else
+	{
+	  if (opt_verbose)
+	    printf ("\t%s (resolved at run time)\n", d->d_name);
+	  add_entry (key, ANDROID_PATHMAP_LIVE, xstrdup (""));
+	}
+    }
+  closedir (dir);
+
+  add_entry (dirname, ANDROID_PATHMAP_DIR, xstrdup (""));
+}
+
+static int
+compare_entries (const void *p1, const void *p2)
+{
+  const struct pathmap_entry *e1 = p1;
+  const struct pathmap_entry *e2 = p2;
+  return android_pathmap_compare (e1->hash, e1->key, e2->hash, e2->key);
+}
+
+/* Return the generation of the existing map, or 0 if there is none.  */
+static uint32_t
+old_generation (void)
+{
+  struct android_pathmap_header header;
+  uint32_t generation = 0;
+  int fd = open (map_file, O_RDONLY);
+  if (fd < 0)
+    return 0;
+  if (read (fd, &header, sizeof (header)) == sizeof (header)
+      && memcmp (header.magic, ANDROID_PATHMAP_MAGIC,
+		 sizeof (header.magic)) == 0)
+    generation = header.generation;
+  close (fd);
+  return generation;
+}
+
+static void
+write_map (const struct stat64 *store_st)
+{
+  qsort (entries, nentries, sizeof (*entries), compare_entries);
+
+  /* Lay out the string table.  Offset 0 is the empty string, which all
+     entries without a value share.  */
+  size_t len_strings = 1;
+  for (size_t i = 0; i < nentries; ++i)
+    {
+      len_strings += strlen (entries[i].key) + 1;
+      if (entries[i].value[0] != '\0')
+	len_strings += strlen (entries[i].value) + 1;
+    }
+  if (len_strings > UINT32_MAX || nentries > UINT32_MAX)
+    error (EXIT_FAILURE, 0, _("Too many store paths for the map"));
+
+  struct android_pathmap_entry *file_entries
+    = xcalloc (nentries, sizeof (*file_entries));
+  char *strings = xmalloc (len_strings);
+  char *p = strings;
+  *p++ = '\0';
+  for (size_t i = 0; i < nentries; ++i)
+    {
+      file_entries[i].hash = entries[i].hash;
+      file_entries[i].flags = entries[i].flags;
+      file_entries[i].key = p - strings;
+      p = stpcpy (p, entries[i].key) + 1;
+      if (entries[i].value[0] != '\0')
+	{
+	  file_entries[i].value = p - strings;
+	  p = stpcpy (p, entries[i].value) + 1;
+	}
+    }
+
+  struct android_pathmap_header header =
+    {
+      .generation = old_generation () + 1,
+      .nentries = nentries,
+      .len_strings = len_strings,
+      .store_mtime_sec = store_st->st_mtim.tv_sec,
+      .store_mtime_nsec = store_st->st_mtim.tv_nsec
+    };
+  memcpy (header.magic, ANDROID_PATHMAP_MAGIC, sizeof (header.magic));
+
+  /* Write the map first to a temporary file and rename it later.  */
+  char *temp_name = xasprintf ("%s~", map_file);
+  int fd = open (temp_name, O_CREAT|O_WRONLY|O_TRUNC|O_NOFOLLOW,
+		 S_IRUSR|S_IWUSR);
+  if (fd < 0)
+    error (EXIT_FAILURE, errno, _("Can't create temporary map file %s"),
+	   temp_name);
+
+  size_t entries_size = nentries * sizeof (*file_entries);
+  if (write (fd, &header, sizeof (header)) != sizeof (header)
+      || write (fd, file_entries, entries_size) != (ssize_t) entries_size
+      || write (fd, strings, len_strings) != (ssize_t) len_strings)
+    error (EXIT_FAILURE, errno, _("Writing of map data failed"));
+
+  /* Make sure user can always read the map.  */
+  if (fchmod (fd, S_IROTH|S_IRGRP|S_IRUSR|S_IWUSR))
+    error (EXIT_FAILURE, errno,
+	   _("Changing access rights of %s to %#o failed"), temp_name,
+	   S_IROTH|S_IRGRP|S_IRUSR|S_IWUSR);
+
+  /* Make sure that data is written to disk.  */
+  if (fsync (fd) != 0 || close (fd) != 0)
+    error (EXIT_FAILURE, errno, _("Writing of map data failed"));
+
+  /* Move temporary to its final location.  */
+  if (rename (temp_name, map_file))
+    error (EXIT_FAILURE, errno, _("Renaming of %s to %s failed"), temp_name,
+	   map_file);
+
+  if (opt_verbose)
+    printf (_("%zu entries written to %s, generation %" PRIu32 "\n"),
+	    nentries, map_file, header.generation);
+
+  free (temp_name);
+  free (strings);
+  free (file_entries);
+}
+
+static void
+print_map (void)
+{
+  int fd = open (map_file, O_RDONLY);
+  struct stat64 st;
+  if (fd < 0 || fstat64 (fd, &st) != 0)
+    error (EXIT_FAILURE, errno, _("Can't open map file %s\n"), map_file);
+
+  const struct android_pathmap_header *header = NULL;
+  if (st.st_size > 0)
+    header = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (header == NULL || header == MAP_FAILED
+      || !android_pathmap_check (header, st.st_size))
+    error (EXIT_FAILURE, 0, _("File is not a path map file.\n"));
+  close (fd);
+
+  struct stat64 store_st;
+  bool current = (stat64 (ANDROID_REAL_STORE, &store_st) == 0
+		  && store_st.st_mtim.tv_sec == header->store_mtime_sec
+		  && store_st.st_mtim.tv_nsec == header->store_mtime_nsec);
+  printf (_("%" PRIu32 " entries in map \"%s\", generation %" PRIu32
+	    " (%s)\n"),
+	  header->nentries, map_file, header->generation,
+	  current ? _("current") : _("stale"));
+
+  const struct android_pathmap_entry *e = android_pathmap_entries (header);
+  const char *strings = android_pathmap_strings (header);
+  for (uint32_t i = 0; i < header->nentries; ++i)
+    {
+      if (e[i].key >= header->len_strings
+	  || e[i].value >= header->len_strings)
+	continue;
+      if (e[i].flags & ANDROID_PATHMAP_DIR)
+	printf ("\t%s/ (listed)\n", strings + e[i].key);
+      else if (e[i].flags & ANDROID_PATHMAP_LIVE)
+	printf ("\t%s (resolved at run time)\n", strings + e[i].key);
+      else
+	printf ("\t%s => %s\n", strings + e[i].key, strings + e[i].value);
+    }
+
+  munmap ((void *) header, st.st_size);
+}
+
+int
+main (int argc, char **argv)
+{
+  /* Set locale via LC_ALL.  */
+  setlocale (LC_ALL, "");
+
+  /* Set the text message domain.  */
+  textdomain (_libc_intl_domainname);
+
+  /* Parse and process arguments.  */
+  argp_parse (&argp, argc, argv, 0, NULL, NULL);
+
+  if (opt_print)
+    {
+      print_map ();
+      return 0;
+    }
+
+  /* Take the modification time before the walk, so that any change to
+     the store while we run makes the map stale.  */
+  struct stat64 store_st;
+  if (stat64 (ANDROID_REAL_STORE, &store_st) != 0)
+    error (EXIT_FAILURE, errno, _("Can't stat %s"), ANDROID_REAL_STORE);
+
+  DIR *store = opendir (ANDROID_REAL_STORE);
+  if (store == NULL)
+    error (EXIT_FAILURE, errno, _("Can't open directory %s"),
+	   ANDROID_REAL_STORE);
+
+  struct dirent64 *d;
+  while ((d = readdir64 (store)) != NULL)
+    if (d->d_name[0] != '.')
+      add_store_object (d->d_name);
+  closedir (store);
+
+  write_map (&store_st);
+
+  return 0;
+}
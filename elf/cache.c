@@ -447,34 +447,72 @@ enum
 			      * sizeof (struct cache_extension_section)))
   };
 
+/* Build the cache_extension_tag_name_hash section for the COUNT entries
+   in the entries list and store its size in *SIZE.  */
+static struct cache_name_hash *
+make_name_hash (uint32_t count, uint32_t *size)
+{
+  uint32_t nbuckets = _dl_cache_name_hash_buckets (count);
+  *size = (sizeof (struct cache_name_hash)
+	   + nbuckets * sizeof (struct cache_name_hash_bucket));
+  struct cache_name_hash *hash = xmalloc (*size);
+  hash->nbuckets = nbuckets;
+  for (uint32_t i = 0; i < nbuckets; ++i)
+    {
+      hash->buckets[i].hash = 0;
+      hash->buckets[i].index = cache_name_hash_empty;
+    }
+
+  /* The entries are sorted, so the ones with the same key are
+     adjacent.  Only the first of them is entered.  */
+  const char *previous = NULL;
+  uint32_t index = 0;
+  for (struct cache_entry *entry = entries; entry != NULL;
+       entry = entry->next, ++index)
+    {
+      if (previous != NULL
+	  && _dl_cache_libcmp (previous, entry->lib->string) == 0)
+	continue;
+      previous = entry->lib->string;
+      _dl_cache_name_hash_insert (hash, entry->lib->string, index);
+    }
+
+  return hash;
+}
+
 /* Write the cache extensions to FD.  The string table is shifted by
    STRING_TABLE_OFFSET.  The extension directory is assumed to be
    located at CACHE_EXTENSION_OFFSET.  assign_glibc_hwcaps_indices
-   must have been called.  */
+   must have been called.  The name hash section indexes the
+   CACHE_ENTRY_COUNT entries of the new format.  */
 static void
 write_extensions (int fd, uint32_t str_offset,
-		  uint32_t cache_extension_offset)
+		  uint32_t cache_extension_offset, uint32_t cache_entry_count)
 {
   assert ((cache_extension_offset % 4) == 0);
 
   /* The length and contents of the glibc-hwcaps section.  */
   uint32_t hwcaps_count = glibc_hwcaps_count ();
-  uint32_t hwcaps_offset = cache_extension_offset + cache_extension_size;
   uint32_t hwcaps_size = hwcaps_count * sizeof (uint32_t);
   uint32_t *hwcaps_array = xmalloc (hwcaps_size);
   for (struct glibc_hwcaps_subdirectory *p = hwcaps; p != NULL; p = p->next)
     if (p->used)
       hwcaps_array[p->section_index] = str_offset + p->name->offset;
 
-  /* This is the offset of the generator string.  */
-  uint32_t generator_offset = hwcaps_offset;
-  if (hwcaps_count == 0)
-    /* There is no section for the hwcaps subdirectories.  */
-    generator_offset -= sizeof (struct cache_extension_section);
-  else
-    /* The string table indices for the hwcaps subdirectories shift
-       the generator string backwards.  */
-    generator_offset += hwcaps_size;
+  /* The length and contents of the name hash section.  */
+  uint32_t name_hash_size;
+  struct cache_name_hash *name_hash
+    = make_name_hash (cache_entry_count, &name_hash_size);
+
+  /* The section data follows the directory, in the order of the write
+     calls below, which keeps the sections that need it aligned at 4
+     bytes.  */
+  size_t section_count = hwcaps_count > 0 ? 3 : 2;
+  size_t ext_size = (offsetof (struct cache_extension, sections)
+		     + section_count * sizeof (struct cache_extension_section));
+  uint32_t hwcaps_offset = cache_extension_offset + ext_size;
+  uint32_t name_hash_offset = hwcaps_offset + hwcaps_size;
+  uint32_t generator_offset = name_hash_offset + name_hash_size;
 
   struct cache_extension *ext = xmalloc (cache_extension_size);
   ext->magic = cache_extension_magic;
@@ -489,6 +527,12 @@ write_extensions (int fd, uint32_t str_offset,
   ext->sections[xid].offset = generator_offset;
   ext->sections[xid].size = strlen (generator);
 
+  ++xid;
+  ext->sections[xid].tag = cache_extension_tag_name_hash;
+  ext->sections[xid].flags = 0;
+  ext->sections[xid].offset = name_hash_offset;
+  ext->sections[xid].size = name_hash_size;
+
   if (hwcaps_count > 0)
     {
       ++xid;
@@ -500,15 +544,16 @@ write_extensions (int fd, uint32_t str_offset,
 
   ++xid;
   ext->count = xid;
+  assert (xid == section_count);
   assert (xid <= cache_extension_count);
 
-  size_t ext_size = (offsetof (struct cache_extension, sections)
-		     + xid * sizeof (struct cache_extension_section));
   if (write (fd, ext, ext_size) != ext_size
       || write (fd, hwcaps_array, hwcaps_size) != hwcaps_size
+      || write (fd, name_hash, name_hash_size) != name_hash_size
       || write (fd, generator, strlen (generator)) != strlen (generator))
     error (EXIT_FAILURE, errno, _("Writing of cache extension data failed"));
 
+  free (name_hash);
   free (hwcaps_array);
   free (ext);
 }
@@ -717,7 +762,7 @@ save_cache (const char *cache_name)
       __attribute__ ((unused)) off64_t old_offset
         = lseek64 (fd, extension_offset, SEEK_SET);
       assert ((unsigned long long int) (extension_offset - old_offset) < 4);
-      write_extensions (fd, str_offset, extension_offset);
+      write_extensions (fd, str_offset, extension_offset, cache_entry_count);
     }
 
   /* Make sure user can always read cache file */
@@ -0,0 +1,127 @@
+/* Prebuilt Android store path map, shared by ld.so and android-pathmap.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#ifndef _DL_ANDROID_PATHMAP_H
+#define _DL_ANDROID_PATHMAP_H
+
+/* nix-on-droid: The android-pathmap program walks the lib directories of
+   every object in the real Nix store and records, for every entry, the
+   result of resolving its symlink chain the way _dl_android_resolve_path
+   does.  ld.so maps the file read-only and consults it before walking
+   symlinks itself.
+
+   The file consists of a header, an array of entries sorted by hash and
+   then by key, and a string table.  All offsets are relative to the
+   start of the string table.
+
+   Store objects never change once they exist, but objects can be added
+   or garbage collected, both of which update the modification time of
+   the store directory.  The header records that time, and ld.so ignores
+   the whole map if it no longer matches.  Because every listed
+   directory is complete while the map is valid, a path inside a listed
+   directory that has no entry is known not to exist.  */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifndef ANDROID_PATHMAP_FILE
+# define ANDROID_PATHMAP_FILE "/data/data/com.termux.nix/files/etc/ld.so.android-paths"
+#endif
+
+#define ANDROID_PATHMAP_MAGIC "ld-android-paths-1"
+
+/* The key is a directory whose complete listing is in the map.  */
+#define ANDROID_PATHMAP_DIR	0x1
+/* The key exists, but its symlink chain leaves the store or could not be
+   resolved, so it must be resolved at run time.  VALUE is unused.  */
+#define ANDROID_PATHMAP_LIVE	0x2
+
+struct android_pathmap_header
+{
+  char magic[sizeof (ANDROID_PATHMAP_MAGIC) - 1];
+  uint16_t unused;
+  /* Incremented every time the map is regenerated.  */
+  uint32_t generation;
+  uint32_t nentries;
+  uint32_t len_strings;
+  /* Modification time of ANDROID_REAL_STORE when the map was built.  */
+  int64_t store_mtime_sec;
+  int64_t store_mtime_nsec;
+};
+
+struct android_pathmap_entry
+{
+  /* _dl_new_hash of the key.  */
+  uint32_t hash;
+  uint32_t flags;
+  /* Offsets into the string table.  */
+  uint32_t key;
+  uint32_t value;
+};
+
+static inline const struct android_pathmap_entry *
+android_pathmap_entries (const struct android_pathmap_header *header)
+{
+  return (const struct android_pathmap_entry *) (header + 1);
+}
+
+static inline const char *
+android_pathmap_strings (const struct android_pathmap_header *header)
+{
+  return (const char *) (android_pathmap_entries (header)
+			 + header->nentries);
+}
+
+/* Check that the SIZE bytes at HEADER form a well-formed map.  String
+   offsets of individual entries are checked when they are used.  */
+static inline bool
+android_pathmap_check (const struct android_pathmap_header *header,
+		       size_t size)
+{
+  if (size < sizeof (*header)
+      || memcmp (header->magic, ANDROID_PATHMAP_MAGIC,
+		 sizeof (header->magic)) != 0)
+    return false;
+
+  size_t max_entries = ((size - sizeof (*header))
+			 / sizeof (struct android_pathmap_entry));
+  if (header->nentries > max_entries
+      || (size - sizeof (*header)
+	  - header->nentries * sizeof (struct android_pathmap_entry)
+	  != header->len_strings)
+      || header->len_strings == 0)
+    return false;
+
+  /* The string table must end with a terminator, so that any offset
+     below LEN_STRINGS refers to a terminated string.  */
+  return android_pathmap_strings (header)[header->len_strings - 1] == '\0';
+}
+
+/* Compare two entries the way the map is sorted.  */
+static inline int
+android_pathmap_compare (uint32_t hash1, const char *key1,
+			 uint32_t hash2, const char *key2)
+{
+  if (hash1 != hash2)
+    return hash1 < hash2 ? -1 : 1;
+  return strcmp (key1, key2);
+}
+
+#endif /* _DL_ANDROID_PATHMAP_H */
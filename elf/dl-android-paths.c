@@ -0,0 +1,353 @@
+/* Android path translation cache for nix-on-droid.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <array_length.h>
+#include <limits.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <ldsodefs.h>
+#include <dl-new-hash.h>
+#include "dl-android-paths.h"
+#include "dl-android-pathmap.h"
+
+/* Same as MAXSYMLINKS.  */
+#define ANDROID_MAX_SYMLINKS 40
+
+/* The translation cache maps a path below ANDROID_REAL_STORE to the
+   result of resolving its symlink chain.  Store paths never change once
+   they exist, so positive results stay valid for the lifetime of the
+   process and need no revalidation.  Paths that do not exist (yet) are
+   never cached.
+
+   The cache is an open-addressed hash table with a fixed number of slots
+   whose strings live in a static pool; when either is exhausted new
+   results are simply not remembered.  All accesses happen with
+   GL(dl_load_lock) held (or while the process is still single-threaded
+   during startup), so no further synchronization is needed.  */
+
+#define ANDROID_PATH_CACHE_SLOTS 512
+#define ANDROID_PATH_CACHE_POOL (32 * 1024)
+
+struct android_path_cache_entry
+{
+  uint32_t hash;
+  /* Offsets into android_path_pool.  */
+  uint32_t key;
+  uint32_t value;
+  uint16_t keylen;
+  /* Zero while the entry is reserved but its chain not yet resolved.  */
+  uint16_t valuelen;
+};
+
+static struct android_path_cache_entry
+  android_path_cache[ANDROID_PATH_CACHE_SLOTS];
+static unsigned int android_path_cache_used;
+static char android_path_pool[ANDROID_PATH_CACHE_POOL];
+static size_t android_path_pool_used;
+
+/* Return true if the LEN bytes long PATH lies inside the real store.  */
+static bool
+android_path_cacheable (const char *path, size_t len)
+{
+  return (len > ANDROID_REAL_STORE_LEN
+          && path[ANDROID_REAL_STORE_LEN] == '/'
+          && memcmp (path, ANDROID_REAL_STORE, ANDROID_REAL_STORE_LEN) == 0);
+}
+
+/* Copy the LEN bytes long string S into the pool, including its
+   terminator.  Returns its offset, or -1 if the pool is full.  */
+static int64_t
+android_path_pool_add (const char *s, size_t len)
+{
+  if (len > UINT16_MAX
+      || ANDROID_PATH_CACHE_POOL - android_path_pool_used < len + 1)
+    return -1;
+  size_t off = android_path_pool_used;
+  memcpy (android_path_pool + off, s, len);
+  android_path_pool[off + len] = '\0';
+  android_path_pool_used += len + 1;
+  return off;
+}
+
+/* Find the entry for the LEN bytes long PATH with hash HASH.  If there
+   is none and RESERVE is true, create one without a value.  Returns NULL
+   if there is no entry and none could be created.  */
+static struct android_path_cache_entry *
+android_path_cache_find (const char *path, size_t len, uint32_t hash,
+                         bool reserve)
+{
+  size_t mask = ANDROID_PATH_CACHE_SLOTS - 1;
+
+  for (size_t i = hash & mask; ; i = (i + 1) & mask)
+    {
+      struct android_path_cache_entry *e = &android_path_cache[i];
+      if (e->keylen == 0)
+        {
+          /* Keep at least one quarter of the slots free so that probe
+             sequences stay short.  */
+          if (!reserve
+              || android_path_cache_used >= ANDROID_PATH_CACHE_SLOTS * 3 / 4)
+            return NULL;
+          int64_t key = android_path_pool_add (path, len);
+          if (key < 0)
+            return NULL;
+          e->hash = hash;
+          e->key = key;
+          e->keylen = len;
+          ++android_path_cache_used;
+          return e;
+        }
+      if (e->hash == hash && e->keylen == len
+          && memcmp (android_path_pool + e->key, path, len) == 0)
+        return e;
+    }
+}
+
+/* Give back the N entries in ENTRIES, which have been reserved by
+   android_path_cache_find since the cache had USED entries and the
+   pool POOL_USED bytes, because their chain could not be resolved.  */
+static void
+android_path_cache_release (struct android_path_cache_entry **entries,
+                            size_t n, unsigned int used, size_t pool_used)
+{
+  /* Nothing has been entered after them, so no probe sequence of
+     another entry passes through their slots.  */
+  for (size_t i = 0; i < n; ++i)
+    entries[i]->keylen = 0;
+  android_path_cache_used = used;
+  android_path_pool_used = pool_used;
+}
+
+/* The prebuilt map written by android-pathmap, if there is a valid one.
+   It is loaded on first use and then kept for the lifetime of the
+   process, like the cache above.  */
+static const struct android_pathmap_header *android_pathmap;
+static bool android_pathmap_loaded;
+
+static void
+android_pathmap_load (void)
+{
+  android_pathmap_loaded = true;
+
+  /* The map is owned by the user of the store, so do not trust it in
+     privileged programs.  */
+  if (__libc_enable_secure)
+    return;
+
+  size_t size;
+  void *file = _dl_sysdep_read_whole_file (ANDROID_PATHMAP_FILE, &size,
+                                           PROT_READ);
+  if (file == MAP_FAILED)
+    return;
+
+  /* Ignore a map that is older than the current contents of the store.  */
+  const struct android_pathmap_header *header = file;
+  struct __stat64_t64 st;
+  if (!android_pathmap_check (header, size)
+      || __stat64_time64 (ANDROID_REAL_STORE, &st) != 0
+      || st.st_mtim.tv_sec != header->store_mtime_sec
+      || st.st_mtim.tv_nsec != header->store_mtime_nsec)
+    {
+      __munmap (file, size);
+      return;
+    }
+
+  android_pathmap = header;
+}
+
+/* Return the map entry for PATH with hash HASH, or NULL.  */
+static const struct android_pathmap_entry *
+android_pathmap_lookup (const char *path, uint32_t hash)
+{
+  const struct android_pathmap_entry *entries
+    = android_pathmap_entries (android_pathmap);
+  const char *strings = android_pathmap_strings (android_pathmap);
+  uint32_t len_strings = android_pathmap->len_strings;
+  size_t left = 0;
+  size_t right = android_pathmap->nentries;
+
+  while (left < right)
+    {
+      size_t middle = left + (right - left) / 2;
+      const struct android_pathmap_entry *e = &entries[middle];
+      if (e->key >= len_strings || e->value >= len_strings)
+        return NULL;
+      int cmp = android_pathmap_compare (hash, path, e->hash,
+                                         strings + e->key);
+      if (cmp == 0)
+        return e;
+      if (cmp < 0)
+        right = middle;
+      else
+        left = middle + 1;
+    }
+  return NULL;
+}
+
+/* Return true if the map lists the complete contents of the directory
+   containing PATH.  */
+static bool
+android_pathmap_dir_listed (char *path)
+{
+  char *last_slash = strrchr (path, '/');
+  if (last_slash == NULL)
+    return false;
+
+  *last_slash = '\0';
+  const struct android_pathmap_entry *e
+    = android_pathmap_lookup (path, _dl_new_hash (path));
+  *last_slash = '/';
+  return e != NULL && (e->flags & ANDROID_PATHMAP_DIR) != 0;
+}
+
+enum android_resolve_status
+_dl_android_resolve_path (const char *path, char *buf)
+{
+  char link_target[PATH_MAX];
+  /* Cache entries for every link of the chain, to be filled in with the
+     final result once it is known.  */
+  struct android_path_cache_entry *pending[ANDROID_MAX_SYMLINKS];
+  size_t npending = 0;
+  bool complete = false;
+  enum android_resolve_status status = android_resolve_ok;
+  unsigned int cache_used = android_path_cache_used;
+  size_t pool_used = android_path_pool_used;
+
+  if (path == NULL)
+    return android_resolve_error;
+
+  if (!android_pathmap_loaded)
+    android_pathmap_load ();
+
+  /* Start with the input path, possibly translated.  */
+  size_t len = _dl_android_process_path (path, buf, PATH_MAX);
+  if (len == 0)
+    {
+      len = strlen (path);
+      if (len >= PATH_MAX)
+        return android_resolve_error;
+      memcpy (buf, path, len + 1);
+    }
+
+  /* Resolve symlinks iteratively.  */
+  for (int loop_count = 0; loop_count < ANDROID_MAX_SYMLINKS; ++loop_count)
+    {
+      if (android_path_cacheable (buf, len))
+        {
+          uint32_t hash = _dl_new_hash (buf);
+          struct android_path_cache_entry *e
+            = android_path_cache_find (buf, len, hash, true);
+          if (e != NULL && e->valuelen != 0)
+            {
+              len = e->valuelen;
+              memcpy (buf, android_path_pool + e->value, len + 1);
+              complete = true;
+              break;
+            }
+          if (e != NULL)
+            pending[npending++] = e;
+
+          if (android_pathmap != NULL)
+            {
+              const struct android_pathmap_entry *m
+                = android_pathmap_lookup (buf, hash);
+              if (m == NULL && android_pathmap_dir_listed (buf))
+                {
+                  status = android_resolve_missing;
+                  break;
+                }
+              if (m != NULL
+                  && (m->flags & (ANDROID_PATHMAP_DIR
+                                  | ANDROID_PATHMAP_LIVE)) == 0)
+                {
+                  const char *value
+                    = android_pathmap_strings (android_pathmap) + m->value;
+                  len = strlen (value);
+                  if (len >= PATH_MAX)
+                    {
+                      status = android_resolve_error;
+                      break;
+                    }
+                  memcpy (buf, value, len + 1);
+                  complete = true;
+                  break;
+                }
+            }
+        }
+
+      struct stat64 st;
+      if (__lstat64 (buf, &st) != 0)
+        break;  /* Can't stat, return what we have */
+
+      if (!S_ISLNK (st.st_mode))
+        {
+          complete = true;
+          break;  /* Not a symlink, we're done */
+        }
+
+      /* Read the symlink target.  */
+      ssize_t n = __readlink (buf, link_target, PATH_MAX - 1);
+      if (n < 0)
+        break;  /* Can't read link, return what we have */
+      link_target[n] = '\0';
+
+      /* Translate the symlink target if needed.  */
+      size_t translated_len = _dl_android_process_path (link_target, buf,
+                                                        PATH_MAX);
+      if (translated_len != 0)
+        len = translated_len;
+      else if (link_target[0] != '/')
+        {
+          /* Handle relative symlinks relative to the directory of the
+             current path.  */
+          char *last_slash = strrchr (buf, '/');
+          size_t dir_len = last_slash != NULL ? last_slash - buf + 1 : 0;
+          if (dir_len + n >= PATH_MAX)
+            break;
+          memcpy (buf + dir_len, link_target, n + 1);
+          len = dir_len + n;
+        }
+      else
+        {
+          memcpy (buf, link_target, n + 1);
+          len = n;
+        }
+    }
+
+  /* Remember the result for every link of the chain, provided the chain
+     ends inside the store as well.  Otherwise give the entries reserved
+     for it back, so that paths which do not exist do not use up the
+     cache.  */
+  int64_t value = -1;
+  if (status == android_resolve_ok && complete && npending > 0
+      && android_path_cacheable (buf, len))
+    value = android_path_pool_add (buf, len);
+  if (value >= 0)
+    for (size_t i = 0; i < npending; ++i)
+      {
+        pending[i]->value = value;
+        pending[i]->valuelen = len;
+      }
+  else if (npending > 0)
+    android_path_cache_release (pending, npending, cache_used, pool_used);
+
+  return status;
+}
@@ -31,10 +31,12 @@
    Additionally, binaries built against standard glibc are redirected
    to use our Android-patched glibc at runtime.
 
-   Returns malloc'd string. Caller must free.  */
+   Translated paths are written to caller-supplied buffers; nothing here
+   allocates.  */
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <string.h>
-#include <stdlib.h>
 
 /* The original Nix store path that binaries reference.  */
 #define ANDROID_ORIGINAL_STORE "/nix/store"
@@ -87,16 +89,18 @@ _dl_is_standard_glibc_path (const char *path)
    1. Translate /nix/store -> /data/data/.../nix/store
    2. Redirect standard glibc paths -> android glibc
 
-   Returns malloc'd processed path, or NULL if no processing needed.
-   Caller must free the returned pointer.  */
-static inline char *
-_dl_android_process_path (const char *path)
+   The processed path is written to BUF, which is BUFLEN bytes long.
+   Returns the length of the processed path, or 0 if no processing is
+   needed or the result would not fit in BUF.  PATH may not overlap
+   BUF.  */
+static inline size_t
+_dl_android_process_path (const char *path, char *buf, size_t buflen)
 {
   if (path == NULL)
-    return NULL;
+    return 0;
 
   const char *current = path;
-  char *translated = NULL;
+  size_t len = 0;
 
   /* Step 1: Translate /nix/store prefix if present.  */
   if (__builtin_strncmp (path, ANDROID_ORIGINAL_STORE,
@@ -104,16 +108,15 @@ _dl_android_process_path (const char *path)
     {
       size_t suffix_len = __builtin_strlen (path + ANDROID_ORIGINAL_STORE_LEN);
       size_t new_len = ANDROID_REAL_STORE_LEN + suffix_len;
+      if (new_len >= buflen)
+        return 0;
 
-      translated = (char *) malloc (new_len + 1);
-      if (translated == NULL)
-        return NULL;
-
-      __builtin_memcpy (translated, ANDROID_REAL_STORE, ANDROID_REAL_STORE_LEN);
-      __builtin_memcpy (translated + ANDROID_REAL_STORE_LEN,
+      __builtin_memcpy (buf, ANDROID_REAL_STORE, ANDROID_REAL_STORE_LEN);
+      __builtin_memcpy (buf + ANDROID_REAL_STORE_LEN,
                         path + ANDROID_ORIGINAL_STORE_LEN,
                         suffix_len + 1);
-      current = translated;
+      current = buf;
+      len = new_len;
     }
 
   /* Step 2: Check if path needs glibc redirect.  */
@@ -133,121 +136,48 @@ _dl_android_process_path (const char *path)
               size_t suffix_len = __builtin_strlen (suffix);
               size_t new_len = ANDROID_GLIBC_LIB_LEN + suffix_len;
 
-              char *redirected = (char *) malloc (new_len + 1);
-              if (redirected != NULL)
+              if (new_len < buflen)
                 {
-                  __builtin_memcpy (redirected, ANDROID_GLIBC_LIB,
+                  /* SUFFIX may point into BUF if step 1 translated it.  */
+                  __builtin_memmove (buf + ANDROID_GLIBC_LIB_LEN, suffix,
+                                     suffix_len + 1);
+                  __builtin_memcpy (buf, ANDROID_GLIBC_LIB,
                                     ANDROID_GLIBC_LIB_LEN);
-                  __builtin_memcpy (redirected + ANDROID_GLIBC_LIB_LEN,
-                                    suffix, suffix_len + 1);
-                  free (translated);
-                  return redirected;
+                  return new_len;
                 }
             }
         }
     }
 
-  /* Return translated path (may be NULL if no translation needed).  */
-  return translated;
+  /* Return translated length (0 if no translation needed).  */
+  return len;
 }
 
+enum android_resolve_status
+{
+  /* The path could not be processed; use the original path.  */
+  android_resolve_error,
+  /* The buffer holds the path to open.  */
+  android_resolve_ok,
+  /* The path is known not to exist.  */
+  android_resolve_missing
+};
+
 /* Resolve symlinks in a path, translating /nix/store paths along the way.
    This is needed because symlinks in the nix store may point to /nix/store/...
    which doesn't exist on Android - we need to translate to the real path.
 
-   Returns malloc'd resolved path, or NULL on error.
-   Caller must free the returned pointer.  */
-static inline char *
-_dl_android_resolve_path (const char *path)
-{
-  if (path == NULL)
-    return NULL;
-
-  char current[PATH_MAX];
-  char link_target[PATH_MAX];
-  int loop_count = 0;
-  const int max_loops = 40;  /* Same as MAXSYMLINKS */
-
-  /* Start with the input path, possibly translated.  */
-  char *translated = _dl_android_process_path (path);
-  if (translated != NULL)
-    {
-      if (__builtin_strlen (translated) >= PATH_MAX)
-        {
-          free (translated);
-          return NULL;
-        }
-      __builtin_strcpy (current, translated);
-      free (translated);
-    }
-  else
-    {
-      if (__builtin_strlen (path) >= PATH_MAX)
-        return NULL;
-      __builtin_strcpy (current, path);
-    }
-
-  /* Resolve symlinks iteratively.  */
-  while (loop_count++ < max_loops)
-    {
-      struct stat64 st;
-      if (__lstat64 (current, &st) != 0)
-        break;  /* Can't stat, return what we have */
-
-      if (!S_ISLNK (st.st_mode))
-        break;  /* Not a symlink, we're done */
-
-      /* Read the symlink target.  */
-      ssize_t len = __readlink (current, link_target, PATH_MAX - 1);
-      if (len < 0)
-        break;  /* Can't read link, return what we have */
-      link_target[len] = '\0';
-
-      /* Translate the symlink target if needed.  */
-      translated = _dl_android_process_path (link_target);
-      if (translated != NULL)
-        {
-          if (__builtin_strlen (translated) >= PATH_MAX)
-            {
-              free (translated);
-              break;
-            }
-          __builtin_strcpy (current, translated);
-          free (translated);
-        }
-      else
-        {
-          /* Handle relative symlinks.  */
-          if (link_target[0] != '/')
-            {
-              /* Find directory of current path.  */
-              char *last_slash = __builtin_strrchr (current, '/');
-              if (last_slash != NULL)
-                {
-                  size_t dir_len = last_slash - current + 1;
-                  if (dir_len + __builtin_strlen (link_target) >= PATH_MAX)
-                    break;
-                  __builtin_memmove (current + dir_len, link_target,
-                                     __builtin_strlen (link_target) + 1);
-                }
-              else
-                {
-                  __builtin_strcpy (current, link_target);
-                }
-            }
-          else
-            {
-              __builtin_strcpy (current, link_target);
-            }
-        }
-    }
-
-  /* Return a copy of the resolved path.  */
-  size_t len = __builtin_strlen (current);
-  char *result = (char *) malloc (len + 1);
-  if (result != NULL)
-    __builtin_memcpy (result, current, len + 1);
-  return result;
-}
+   Store paths are first looked up in the map prebuilt by android-pathmap
+   (see dl-android-pathmap.h), if it is current.  Resolved chains that
+   stay within the (immutable) real store are also remembered for the
+   lifetime of the process, so repeated lookups of the same store paths do
+   not hit lstat/readlink again.  Must be called with GL(dl_load_lock)
+   held.
+
+   The resolved path is written to BUF, which must be PATH_MAX bytes
+   long.  */
+extern enum android_resolve_status _dl_android_resolve_path (const char *path,
+                                                             char *buf)
+  attribute_hidden;
 
 #endif /* _DL_ANDROID_PATHS_H */
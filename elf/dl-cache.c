@@ -32,6 +32,10 @@ static struct cache_file *cache;
 static struct cache_file_new *cache_new;
 static size_t cachesize;
 
+/* The cache_extension_tag_name_hash section of cache_new, or NULL if
+   the entries have to be searched with search_cache.  */
+static const struct cache_name_hash *cache_name_hash;
+
 #ifdef SHARED
 /* This is used to cache the priorities of glibc-hwcaps
    subdirectories.  The elements of _dl_cache_priorities correspond to
@@ -170,208 +174,157 @@ glibc_hwcaps_priority (uint32_t index)
 }
 #endif /* SHARED */
 
-/* True if PTR is a valid string table index.  */
-static inline bool
-_dl_cache_verify_ptr (uint32_t ptr, size_t string_table_size)
-{
-  return ptr < string_table_size;
-}
-
-/* Compute the address of the element INDEX of the array at LIBS.
-   Conceptually, this is &LIBS[INDEX], but use ENTRY_SIZE for the size
-   of *LIBS.  */
-static inline const struct file_entry *
-_dl_cache_file_entry (const struct file_entry *libs, size_t entry_size,
-		      size_t index)
-{
-  return (const void *) libs + index * entry_size;
-}
-
-/* We use binary search since the table is sorted in the cache file.
-   The first matching entry in the table is returned.  It is important
-   to use the same algorithm as used while generating the cache file.
-   STRING_TABLE_SIZE indicates the maximum offset in STRING_TABLE at
-   which data is mapped; it is not exact.  */
+/* Return the best entry among the ones with the key NAME, which start
+   at index FIRST.  The entries up to MATCHED are known to have that
+   key; the search stops at the first entry after them with another key
+   or after LAST.  */
 static const char *
-search_cache (const char *string_table, uint32_t string_table_size,
-	      struct file_entry *libs, uint32_t nlibs, uint32_t entry_size,
-	      const char *name)
+search_cache_entries (const char *string_table, uint32_t string_table_size,
+		      struct file_entry *libs, uint32_t entry_size,
+		      const char *name, int first, int matched, int last)
 {
-  int left = 0;
-  int right = nlibs - 1;
+  int middle = first;
   const char *best = NULL;
 #ifdef SHARED
   uint32_t best_priority = 0;
 #endif
 
-  while (left <= right)
+  do
     {
-      int middle = (left + right) / 2;
-      uint32_t key = _dl_cache_file_entry (libs, entry_size, middle)->key;
-
-      /* Make sure string table indices are not bogus before using
-	 them.  */
-      if (!_dl_cache_verify_ptr (key, string_table_size))
-	return NULL;
-
-      /* Actually compare the entry with the key.  */
-      int cmpres = _dl_cache_libcmp (name, string_table + key);
-      if (__glibc_unlikely (cmpres == 0))
+      int flags;
+      const struct file_entry *lib
+	= _dl_cache_file_entry (libs, entry_size, middle);
+
+      /* Only perform the name test if necessary.  */
+      if (middle > matched
+	  /* We haven't seen this string so far.  Test whether the
+	     index is ok and whether the name matches.  Otherwise
+	     we are done.  */
+	  && (! _dl_cache_verify_ptr (lib->key, string_table_size)
+	      || (_dl_cache_libcmp (name, string_table + lib->key)
+		  != 0)))
+	break;
+
+      flags = lib->flags;
+      if (_dl_cache_check_flags (flags)
+	  && _dl_cache_verify_ptr (lib->value, string_table_size))
 	{
-	  /* Found it.  LEFT now marks the last entry for which we
-	     know the name is correct.  */
-	  left = middle;
-
-	  /* There might be entries with this name before the one we
-	     found.  So we have to find the beginning.  */
-	  while (middle > 0)
-	    {
-	      key = _dl_cache_file_entry (libs, entry_size, middle - 1)->key;
-	      /* Make sure string table indices are not bogus before
-		 using them.  */
-	      if (!_dl_cache_verify_ptr (key, string_table_size)
-		  /* Actually compare the entry.  */
-		  || _dl_cache_libcmp (name, string_table + key) != 0)
-		break;
-	      --middle;
-	    }
+	  /* Named/extension hwcaps get slightly different
+	     treatment: We keep searching for a better
+	     match.  */
+	  bool named_hwcap = false;
 
-	  do
+	  if (entry_size >= sizeof (struct file_entry_new))
 	    {
-	      int flags;
-	      const struct file_entry *lib
-		= _dl_cache_file_entry (libs, entry_size, middle);
-
-	      /* Only perform the name test if necessary.  */
-	      if (middle > left
-		  /* We haven't seen this string so far.  Test whether the
-		     index is ok and whether the name matches.  Otherwise
-		     we are done.  */
-		  && (! _dl_cache_verify_ptr (lib->key, string_table_size)
-		      || (_dl_cache_libcmp (name, string_table + lib->key)
-			  != 0)))
-		break;
-
-	      flags = lib->flags;
-	      if (_dl_cache_check_flags (flags)
-		  && _dl_cache_verify_ptr (lib->value, string_table_size))
-		{
-		  /* Named/extension hwcaps get slightly different
-		     treatment: We keep searching for a better
-		     match.  */
-		  bool named_hwcap = false;
-
-		  if (entry_size >= sizeof (struct file_entry_new))
-		    {
-		      /* The entry is large enough to include
-			 HWCAP data.  Check it.  */
-		      struct file_entry_new *libnew
-			= (struct file_entry_new *) lib;
+	      /* The entry is large enough to include
+		 HWCAP data.  Check it.  */
+	      struct file_entry_new *libnew
+		= (struct file_entry_new *) lib;
 
 #ifdef SHARED
-		      named_hwcap = dl_cache_hwcap_extension (libnew);
-		      if (named_hwcap
-			  && !dl_cache_hwcap_isa_level_compatible (libnew))
-			continue;
+	      named_hwcap = dl_cache_hwcap_extension (libnew);
+	      if (named_hwcap
+		  && !dl_cache_hwcap_isa_level_compatible (libnew))
+		continue;
 #endif
 
-		      /* The entries with named/extension hwcaps have
-			 been exhausted (they are listed before all
-			 other entries).  Return the best match
-			 encountered so far if there is one.  */
-		      if (!named_hwcap && best != NULL)
-			break;
+	      /* The entries with named/extension hwcaps have
+		 been exhausted (they are listed before all
+		 other entries).  Return the best match
+		 encountered so far if there is one.  */
+	      if (!named_hwcap && best != NULL)
+		break;
 
-		      /* Skip entries with the legacy hwcap/platform mechanism
-			 which was removed with glibc 2.37.  */
-		      if (!named_hwcap && libnew->hwcap != 0)
-			continue;
+	      /* Skip entries with the legacy hwcap/platform mechanism
+		 which was removed with glibc 2.37.  */
+	      if (!named_hwcap && libnew->hwcap != 0)
+		continue;
 
 #ifdef SHARED
-		      /* For named hwcaps, determine the priority and
-			 see if beats what has been found so far.  */
-		      if (named_hwcap)
-			{
-			  uint32_t entry_priority
-			    = glibc_hwcaps_priority (libnew->hwcap);
-			  if (entry_priority == 0)
-			    /* Not usable at all.  Skip.  */
-			    continue;
-			  else if (best == NULL
-				   || entry_priority < best_priority)
-			    /* This entry is of higher priority
-			       than the previous one, or it is the
-			       first entry.  */
-			    best_priority = entry_priority;
-			  else
-			    /* An entry has already been found,
-			       but it is a better match.  */
-			    continue;
-			}
-#endif /* SHARED */
-		    }
-
-		  best = string_table + lib->value;
-
-		  if (!named_hwcap && flags == _DL_CACHE_DEFAULT_ID)
-		    /* With named hwcaps, we need to keep searching to
-		       see if we find a better match.  A better match
-		       is also possible if the flags of the current
-		       entry do not match the expected cache flags.
-		       But if the flags match, no better entry will be
-		       found.  */
-		    break;
+	      /* For named hwcaps, determine the priority and
+		 see if beats what has been found so far.  */
+	      if (named_hwcap)
+		{
+		  uint32_t entry_priority
+		    = glibc_hwcaps_priority (libnew->hwcap);
+		  if (entry_priority == 0)
+		    /* Not usable at all.  Skip.  */
+		    continue;
+		  else if (best == NULL
+			   || entry_priority < best_priority)
+		    /* This entry is of higher priority
+		       than the previous one, or it is the
+		       first entry.  */
+		    best_priority = entry_priority;
+		  else
+		    /* An entry has already been found,
+		       but it is a better match.  */
+		    continue;
 		}
+#endif /* SHARED */
 	    }
-	  while (++middle <= right);
-	  break;
-	}
 
-      if (cmpres < 0)
-	left = middle + 1;
-      else
-	right = middle - 1;
+	  best = string_table + lib->value;
+
+	  if (!named_hwcap && flags == _DL_CACHE_DEFAULT_ID)
+	    /* With named hwcaps, we need to keep searching to
+	       see if we find a better match.  A better match
+	       is also possible if the flags of the current
+	       entry do not match the expected cache flags.
+	       But if the flags match, no better entry will be
+	       found.  */
+	    break;
+	}
     }
+  while (++middle <= last);
 
   return best;
 }
 
-int
-_dl_cache_libcmp (const char *p1, const char *p2)
+/* Return the best entry with the key NAME among the NLIBS entries at
+   LIBS, found by binary search.  */
+static const char *
+search_cache (const char *string_table, uint32_t string_table_size,
+	      struct file_entry *libs, uint32_t nlibs, uint32_t entry_size,
+	      const char *name)
 {
-  while (*p1 != '\0')
-    {
-      if (*p1 >= '0' && *p1 <= '9')
-        {
-          if (*p2 >= '0' && *p2 <= '9')
-            {
-	      /* Must compare this numerically.  */
-	      int val1;
-	      int val2;
-
-	      val1 = *p1++ - '0';
-	      val2 = *p2++ - '0';
-	      while (*p1 >= '0' && *p1 <= '9')
-	        val1 = val1 * 10 + *p1++ - '0';
-	      while (*p2 >= '0' && *p2 <= '9')
-	        val2 = val2 * 10 + *p2++ - '0';
-	      if (val1 != val2)
-		return val1 - val2;
-	    }
-	  else
-            return 1;
-        }
-      else if (*p2 >= '0' && *p2 <= '9')
-        return -1;
-      else if (*p1 != *p2)
-        return *p1 - *p2;
-      else
-	{
-	  ++p1;
-	  ++p2;
-	}
-    }
-  return *p1 - *p2;
+  int matched, last;
+  int first = _dl_cache_search_binary (string_table, string_table_size,
+				       libs, nlibs, entry_size, name,
+				       &matched, &last);
+  if (first < 0)
+    return NULL;
+  return search_cache_entries (string_table, string_table_size, libs,
+			       entry_size, name, first, matched, last);
+}
+
+/* Like search_cache, but find the first entry with the key NAME in the
+   hash index HASH instead of searching for it.  */
+static const char *
+search_cache_hashed (const char *string_table, uint32_t string_table_size,
+		     struct file_entry *libs, uint32_t nlibs,
+		     uint32_t entry_size, const struct cache_name_hash *hash,
+		     const char *name)
+{
+  int matched, last;
+  int first = _dl_cache_search_hashed (string_table, string_table_size,
+				       libs, nlibs, entry_size, hash, name,
+				       &matched, &last);
+  if (first < 0)
+    return NULL;
+  return search_cache_entries (string_table, string_table_size, libs,
+			       entry_size, name, first, matched, last);
+}
+
+/* Set cache_name_hash from the extension sections of cache_new.  */
+static void
+cache_name_hash_init (void)
+{
+  struct cache_extension_all_loaded ext;
+  if (cache_extension_load (cache_new, cache, cachesize, &ext))
+    cache_name_hash = ext.sections[cache_extension_tag_name_hash].base;
+  else
+    cache_name_hash = NULL;
 }
 
 
@@ -456,6 +409,9 @@ _dl_load_cache_lookup (const char *name)
 	}
 
       assert (cache != NULL);
+
+      if (cache != (void *) -1 && cache_new != (void *) -1)
+	cache_name_hash_init ();
     }
 
   if (cache == (void *) -1)
@@ -466,9 +422,16 @@ _dl_load_cache_lookup (const char *name)
   if (cache_new != (void *) -1)
     {
       const char *string_table = (const char *) cache_new;
-      best = search_cache (string_table, cachesize,
-			   &cache_new->libs[0].entry, cache_new->nlibs,
-			   sizeof (cache_new->libs[0]), name);
+      if (cache_name_hash != NULL)
+	best = search_cache_hashed (string_table, cachesize,
+				    &cache_new->libs[0].entry,
+				    cache_new->nlibs,
+				    sizeof (cache_new->libs[0]),
+				    cache_name_hash, name);
+      else
+	best = search_cache (string_table, cachesize,
+			     &cache_new->libs[0].entry, cache_new->nlibs,
+			     sizeof (cache_new->libs[0]), name);
     }
   else
     {
@@ -511,6 +474,7 @@ _dl_unload_cache (void)
     {
       __munmap (cache, cachesize);
       cache = NULL;
+      cache_name_hash = NULL;
     }
 #ifdef SHARED
   /* This marks the glibc_hwcaps_priorities array as out-of-date.  */
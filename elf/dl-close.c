@@ -77,6 +77,7 @@ remove_slotinfo (size_t idx, struct dtv_slotinfo_list *listp, size_t disp,
 	  atomic_store_relaxed (&listp->slotinfo[idx - disp].gen,
 				GL(dl_tls_generation) + 1);
 	  atomic_store_relaxed (&listp->slotinfo[idx - disp].map, NULL);
+	  atomic_store_relaxed (&listp->gen, GL(dl_tls_generation) + 1);
 	}
 
       /* If this is not the last currently used entry no need to look
@@ -435,6 +436,9 @@ _dl_close_worker (struct link_map *map, bool force)
   _dl_debug_state ();
   LIBC_PROBE (unmap_start, 2, nsid, r);
 
+  /* Cached symbol lookups may refer to the objects being removed.  */
+  _dl_lookup_cache_reset (nsid);
+
   if (unload_global)
     {
       /* Some objects are in the global scope list.  Remove them.  */
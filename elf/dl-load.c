@@ -465,6 +465,7 @@ fillin_rpath (char *rpath, struct r_search_path_elem **result, const char *sep,
     {
       struct r_search_path_elem *dirp;
       char *to_free = NULL;
+      char processed[PATH_MAX];
       size_t len = 0;
 
       /* `strsep' can pass an empty string.  */
@@ -477,15 +478,15 @@ fillin_rpath (char *rpath, struct r_search_path_elem **result, const char *sep,
 	  if (cp == NULL)
 	    continue;
 
-	  /* Android/nix-on-droid: Process path (translate + glibc redirect).  */
-	  {
-	    char *processed = _dl_android_process_path (cp);
-	    if (processed != NULL)
-	      {
-		free (to_free);
-		to_free = cp = processed;
-	      }
-	  }
+	  /* Android/nix-on-droid: Process path (translate + glibc redirect).
+	     Leave room for the trailing slash added below.  */
+	  if (_dl_android_process_path (cp, processed,
+					sizeof (processed) - 1) != 0)
+	    {
+	      free (to_free);
+	      to_free = NULL;
+	      cp = processed;
+	    }
 
 	  /* Compute the length after dynamic string token expansion and
 	     ignore empty paths.  */
@@ -1589,15 +1590,21 @@ open_verify (const char *name, int fd,
       /* Android: Resolve symlinks with path translation before opening.
          This handles symlinks in the nix store that point to /nix/store/...
          which needs to be translated to /data/data/.../nix/store/...  */
-      char *resolved = _dl_android_resolve_path (name);
-      if (resolved != NULL)
+      char resolved[PATH_MAX];
+      switch (_dl_android_resolve_path (name, resolved))
         {
+        case android_resolve_ok:
           fd = __open64_nocancel (resolved, O_RDONLY | O_CLOEXEC);
-          free (resolved);
+          break;
+        case android_resolve_missing:
+          /* The prebuilt path map says there is no such file.  */
+          __set_errno (ENOENT);
+          break;
+        default:
+          /* Fall back to opening the original name.  */
+          fd = __open64_nocancel (name, O_RDONLY | O_CLOEXEC);
+          break;
         }
-      else
-        /* Fall back to opening the original name.  */
-        fd = __open64_nocancel (name, O_RDONLY | O_CLOEXEC);
     }
 
   if (fd != -1)
@@ -30,6 +30,7 @@
 #include <tls.h>
 #include <atomic.h>
 #include <elf_machine_sym_no_match.h>
+#include <dl-tunables.h>
 
 #include <assert.h>
 
@@ -42,13 +43,45 @@ struct sym_val
   };
 
 
-/* Statistics function.  */
+/* Statistics function.  Relocation may run on several threads during
+   startup, see _dl_relocate_parallel.  */
 #ifdef SHARED
-# define bump_num_relocations() ++GL(dl_num_relocations)
+# define bump_num_relocations()						      \
+  (__glibc_unlikely (atomic_load_relaxed (&GL(dl_parallel_relocation)))	      \
+   ? (void) atomic_fetch_add_relaxed (&GL(dl_num_relocations), 1)	      \
+   : (void) ++GL(dl_num_relocations))
 #else
 # define bump_num_relocations() ((void) 0)
 #endif
 
+/* Relocation processing is done either with the loader lock held or
+   during startup, when it may run on several threads for different
+   objects.  In the latter case, take the lock which serializes updates
+   of the lookup cache and the unique symbol tables, and return true.
+   Otherwise return false.  */
+static inline bool
+lookup_lock (void)
+{
+#ifdef SHARED
+  if (__glibc_unlikely (atomic_load_relaxed (&GL(dl_parallel_relocation))))
+    {
+      lll_lock (GL(dl_parallel_relocation_lock), LLL_PRIVATE);
+      return true;
+    }
+#endif
+  return false;
+}
+
+/* Release the lock taken by lookup_lock if LOCKED.  */
+static inline void
+lookup_unlock (bool locked)
+{
+#ifdef SHARED
+  if (__glibc_unlikely (locked))
+    lll_unlock (GL(dl_parallel_relocation_lock), LLL_PRIVATE);
+#endif
+}
+
 /* Utility function for do_lookup_x. The caller is called with undef_name,
    ref, version, flags and type_class, and those are passed as the first
    five arguments. The caller then computes sym, symidx, strtab, and map
@@ -334,6 +367,90 @@ marking %s [%lu] as NODELETE due to unique symbol\n",
   result->m = (struct link_map *) map;
 }
 
+/* Search the symbol table of MAP for a definition of UNDEF_NAME
+   matching VERSION and TYPE_CLASS, as do_lookup_x does for each object
+   of the scope.  Return NULL if there is none.  */
+static __always_inline const ElfW(Sym) *
+do_lookup_map (const char *undef_name, unsigned int new_hash,
+	       unsigned long int *old_hash, const ElfW(Sym) *ref,
+	       const struct r_found_version *const version, int flags,
+	       int type_class, const struct link_map *map)
+{
+  /* If the hash table is empty there is nothing to do here.  */
+  if (map->l_nbuckets == 0)
+    return NULL;
+
+  Elf_Symndx symidx;
+  int num_versions = 0;
+  const ElfW(Sym) *versioned_sym = NULL;
+
+  /* The tables for this map.  */
+  const ElfW(Sym) *symtab = (const void *) D_PTR (map, l_info[DT_SYMTAB]);
+  const char *strtab = (const void *) D_PTR (map, l_info[DT_STRTAB]);
+
+  const ElfW(Sym) *sym;
+  const ElfW(Addr) *bitmask = map->l_gnu_bitmask;
+  if (__glibc_likely (bitmask != NULL))
+    {
+      ElfW(Addr) bitmask_word
+	= bitmask[(new_hash / __ELF_NATIVE_CLASS)
+		  & map->l_gnu_bitmask_idxbits];
+
+      unsigned int hashbit1 = new_hash & (__ELF_NATIVE_CLASS - 1);
+      unsigned int hashbit2 = ((new_hash >> map->l_gnu_shift)
+			       & (__ELF_NATIVE_CLASS - 1));
+
+      if (__glibc_unlikely ((bitmask_word >> hashbit1)
+			    & (bitmask_word >> hashbit2) & 1))
+	{
+	  Elf32_Word bucket = map->l_gnu_buckets[new_hash % map->l_nbuckets];
+	  if (bucket != 0)
+	    {
+	      const Elf32_Word *hasharr = &map->l_gnu_chain_zero[bucket];
+
+	      do
+		if (((*hasharr ^ new_hash) >> 1) == 0)
+		  {
+		    symidx = ELF_MACHINE_HASH_SYMIDX (map, hasharr);
+		    sym = check_match (undef_name, ref, version, flags,
+				       type_class, &symtab[symidx], symidx,
+				       strtab, map, &versioned_sym,
+				       &num_versions);
+		    if (sym != NULL)
+		      return sym;
+		  }
+	      while ((*hasharr++ & 1u) == 0);
+	    }
+	}
+    }
+  else
+    {
+      if (*old_hash == 0xffffffff)
+	*old_hash = _dl_elf_hash (undef_name);
+
+      /* Use the old SysV-style hash table.  Search the appropriate
+	 hash bucket in this object's symbol table for a definition
+	 for the same symbol name.  */
+      for (symidx = map->l_buckets[*old_hash % map->l_nbuckets];
+	   symidx != STN_UNDEF;
+	   symidx = map->l_chain[symidx])
+	{
+	  sym = check_match (undef_name, ref, version, flags,
+			     type_class, &symtab[symidx], symidx,
+			     strtab, map, &versioned_sym,
+			     &num_versions);
+	  if (sym != NULL)
+	    return sym;
+	}
+    }
+
+  /* If we have seen exactly one versioned symbol while we are
+     looking for an unversioned symbol and the version is not the
+     default version we still accept this symbol since there are
+     no possible ambiguities.  */
+  return num_versions == 1 ? versioned_sym : NULL;
+}
+
 /* Inner part of the lookup functions.  We return a value > 0 if we
    found the symbol, the value 0 if nothing is found and < 0 if
    something bad happened.  */
@@ -392,86 +509,13 @@ do_lookup_x (const char *undef_name, unsigned int new_hash,
 			  undef_name, DSO_FILENAME (map->l_name),
 			  map->l_ns);
 
-      /* If the hash table is empty there is nothing to do here.  */
-      if (map->l_nbuckets == 0)
-	continue;
-
-      Elf_Symndx symidx;
-      int num_versions = 0;
-      const ElfW(Sym) *versioned_sym = NULL;
-
-      /* The tables for this map.  */
-      const ElfW(Sym) *symtab = (const void *) D_PTR (map, l_info[DT_SYMTAB]);
-      const char *strtab = (const void *) D_PTR (map, l_info[DT_STRTAB]);
-
-      const ElfW(Sym) *sym;
-      const ElfW(Addr) *bitmask = map->l_gnu_bitmask;
-      if (__glibc_likely (bitmask != NULL))
-	{
-	  ElfW(Addr) bitmask_word
-	    = bitmask[(new_hash / __ELF_NATIVE_CLASS)
-		      & map->l_gnu_bitmask_idxbits];
-
-	  unsigned int hashbit1 = new_hash & (__ELF_NATIVE_CLASS - 1);
-	  unsigned int hashbit2 = ((new_hash >> map->l_gnu_shift)
-				   & (__ELF_NATIVE_CLASS - 1));
-
-	  if (__glibc_unlikely ((bitmask_word >> hashbit1)
-				& (bitmask_word >> hashbit2) & 1))
-	    {
-	      Elf32_Word bucket = map->l_gnu_buckets[new_hash
-						     % map->l_nbuckets];
-	      if (bucket != 0)
-		{
-		  const Elf32_Word *hasharr = &map->l_gnu_chain_zero[bucket];
-
-		  do
-		    if (((*hasharr ^ new_hash) >> 1) == 0)
-		      {
-			symidx = ELF_MACHINE_HASH_SYMIDX (map, hasharr);
-			sym = check_match (undef_name, ref, version, flags,
-					   type_class, &symtab[symidx], symidx,
-					   strtab, map, &versioned_sym,
-					   &num_versions);
-			if (sym != NULL)
-			  goto found_it;
-		      }
-		  while ((*hasharr++ & 1u) == 0);
-		}
-	    }
-	  /* No symbol found.  */
-	  symidx = SHN_UNDEF;
-	}
-      else
-	{
-	  if (*old_hash == 0xffffffff)
-	    *old_hash = _dl_elf_hash (undef_name);
-
-	  /* Use the old SysV-style hash table.  Search the appropriate
-	     hash bucket in this object's symbol table for a definition
-	     for the same symbol name.  */
-	  for (symidx = map->l_buckets[*old_hash % map->l_nbuckets];
-	       symidx != STN_UNDEF;
-	       symidx = map->l_chain[symidx])
-	    {
-	      sym = check_match (undef_name, ref, version, flags,
-				 type_class, &symtab[symidx], symidx,
-				 strtab, map, &versioned_sym,
-				 &num_versions);
-	      if (sym != NULL)
-		goto found_it;
-	    }
-	}
-
-      /* If we have seen exactly one versioned symbol while we are
-	 looking for an unversioned symbol and the version is not the
-	 default version we still accept this symbol since there are
-	 no possible ambiguities.  */
-      sym = num_versions == 1 ? versioned_sym : NULL;
-
+      const ElfW(Sym) *sym = do_lookup_map (undef_name, new_hash, old_hash,
+					    ref, version, flags, type_class,
+					    map);
       if (sym != NULL)
 	{
-	found_it:
+	  const char *strtab = (const void *) D_PTR (map, l_info[DT_STRTAB]);
+
 	  /* Hidden and internal symbols are local, ignore them.  */
 	  if (__glibc_unlikely (dl_symbol_visibility_binds_local_p (sym)))
 	    goto skip;
@@ -501,9 +545,11 @@ do_lookup_x (const char *undef_name, unsigned int new_hash,
 	      return 1;
 
 	    case STB_GNU_UNIQUE:;
+	      bool locked = lookup_lock ();
 	      do_lookup_unique (undef_name, new_hash, (struct link_map *) map,
 				result, type_class, sym, strtab, ref,
 				undef_map, flags);
+	      lookup_unlock (locked);
 	      return 1;
 
 	    default:
@@ -757,6 +803,219 @@ marking %s [%lu] as NODELETE due to memory allocation failure\n",
 }
 
 
+/* Relocating an object looks up each symbol it refers to in the
+   global scope of its namespace, which means asking every object in
+   the scope in turn until one defines the symbol.  With many objects
+   most of the time goes to objects which do not define it, and most
+   symbols are looked up again for the next object referring to them.
+   So the result of searching the global scope is kept in a hash table
+   per namespace, keyed by the name, version and type class.
+
+   The table is only used for relocation processing, which is done
+   either during startup or with the loader lock held, so it needs no
+   lock of its own, except while objects are relocated on several
+   threads at startup (see lookup_lock).  It refers to the names and
+   link maps of loaded objects and has to be reset whenever the global
+   scope changes or an object is removed.  */
+
+#define INITIAL_LOOKUP_CACHE_SIZE 1021
+
+void
+_dl_lookup_cache_reset (Lmid_t nsid)
+{
+  struct lookup_cache_table *tab = &GL(dl_ns)[nsid]._ns_lookup_cache;
+
+  if (tab->n_elements != 0)
+    {
+      memset (tab->entries, 0, tab->size * sizeof (struct lookup_cache_entry));
+      tab->n_elements = 0;
+    }
+}
+
+/* Return true if the search of SCOPE for a symbol referenced by
+   UNDEF_MAP may use the lookup cache.  */
+static inline bool
+lookup_cache_usable (struct r_scope_elem *scope, struct link_map *undef_map,
+		     int flags, struct link_map *skip_map)
+{
+  return ((flags & DL_LOOKUP_FOR_RELOCATE) != 0
+	  && skip_map == NULL
+	  && undef_map != NULL
+	  && !undef_map->l_removed
+	  && scope == &GL(dl_ns)[undef_map->l_ns]._ns_loaded->l_searchlist
+	  && !(GLRO(dl_debug_mask) & DL_DEBUG_SYMBOLS));
+}
+
+/* Grow TAB, or allocate it on first use.  Return false if the cache
+   is disabled or there is not enough memory.  */
+static bool
+lookup_cache_grow (struct lookup_cache_table *tab)
+{
+  if (TUNABLE_GET (glibc, rtld, lookup_cache, int32_t, NULL) == 0)
+    return false;
+
+  size_t size = tab->size;
+  size_t newsize = (size == 0 ? INITIAL_LOOKUP_CACHE_SIZE
+		    : _dl_higher_prime_number (size + 1));
+  struct lookup_cache_entry *entries
+    = calloc (sizeof (struct lookup_cache_entry), newsize);
+  if (entries == NULL)
+    return false;
+
+  for (size_t idx = 0; idx < size; ++idx)
+    {
+      struct lookup_cache_entry *old = &tab->entries[idx];
+      if (old->name == NULL)
+	continue;
+
+      size_t newidx = old->hashval % newsize;
+      size_t hash2 = 1 + old->hashval % (newsize - 2);
+      while (entries[newidx].name != NULL)
+	{
+	  newidx += hash2;
+	  if (newidx >= newsize)
+	    newidx -= newsize;
+	}
+      entries[newidx] = *old;
+    }
+
+  if (tab->entries != NULL)
+    tab->free (tab->entries);
+  tab->entries = entries;
+  tab->size = newsize;
+  tab->free = __rtld_free;
+  return true;
+}
+
+/* Return the entry of TAB for the symbol UNDEF_NAME with hash
+   NEW_HASH, version VERSION and type class TYPE_CLASS.  If the symbol
+   has not been looked up yet, the entry is unused and the result of
+   the lookup can be stored in it.  Return NULL if there is no entry
+   available.  */
+static struct lookup_cache_entry *
+lookup_cache_find (struct lookup_cache_table *tab, const char *undef_name,
+		   unsigned int new_hash,
+		   const struct r_found_version *version, int type_class)
+{
+  if (__glibc_unlikely (tab->size * 3 <= (tab->n_elements + 1) * 4)
+      && !lookup_cache_grow (tab))
+    return NULL;
+
+  size_t size = tab->size;
+  size_t idx = new_hash % size;
+  size_t hash2 = 1 + new_hash % (size - 2);
+  while (1)
+    {
+      struct lookup_cache_entry *entry = &tab->entries[idx];
+
+      if (entry->name == NULL)
+	return entry;
+
+      if (entry->hashval == new_hash
+	  && entry->type_class == type_class
+	  && (version == NULL
+	      ? entry->version_name == NULL
+	      : (entry->version_name != NULL
+		 && entry->version_hash == version->hash
+		 && entry->version_hidden == version->hidden
+		 && strcmp (entry->version_name, version->name) == 0))
+	  && strcmp (entry->name, undef_name) == 0)
+	return entry;
+
+      idx += hash2;
+      if (idx >= size)
+	idx -= size;
+    }
+}
+
+/* Record in the unused ENTRY of TAB the result of a lookup, which
+   returned FOUND and VALUE.  */
+static void
+lookup_cache_enter (struct lookup_cache_table *tab,
+		    struct lookup_cache_entry *entry, const char *undef_name,
+		    unsigned int new_hash,
+		    const struct r_found_version *version, int type_class,
+		    int found, const struct sym_val *value)
+{
+  /* Binding to a protected symbol is checked against the referencing
+     object, and unique symbols are entered in their own table by the
+     lookup, so these lookups have to be repeated.  */
+  if (value->s != NULL
+      && (ELFW(ST_VISIBILITY) (value->s->st_other) == STV_PROTECTED
+	  || ELFW(ST_BIND) (value->s->st_info) == STB_GNU_UNIQUE))
+    return;
+
+  entry->hashval = new_hash;
+  entry->type_class = type_class;
+  entry->name = undef_name;
+  if (version != NULL)
+    {
+      entry->version_name = version->name;
+      entry->version_hash = version->hash;
+      entry->version_hidden = version->hidden;
+    }
+  entry->found = found;
+  entry->sym = value->s;
+  entry->map = value->m;
+  ++tab->n_elements;
+}
+
+bool
+_dl_lookup_cache_insert (Lmid_t nsid, const char *undef_name,
+			 unsigned int new_hash,
+			 const struct r_found_version *version, int type_class,
+			 int found, const ElfW(Sym) *sym, struct link_map *map)
+{
+  struct lookup_cache_table *tab = &GL(dl_ns)[nsid]._ns_lookup_cache;
+  struct lookup_cache_entry *entry
+    = lookup_cache_find (tab, undef_name, new_hash, version, type_class);
+
+  if (entry == NULL)
+    return false;
+
+  if (entry->name == NULL)
+    {
+      struct sym_val value = { sym, map };
+      lookup_cache_enter (tab, entry, undef_name, new_hash, version,
+			  type_class, found, &value);
+    }
+  return true;
+}
+
+bool
+_dl_lookup_cache_check (const char *undef_name, unsigned int new_hash,
+			const struct r_found_version *version, int type_class,
+			int found, const ElfW(Sym) *sym, struct link_map *map)
+{
+  /* The objects searched before MAP are not known here, so a failed
+     lookup cannot be checked.  */
+  if (map == NULL)
+    return sym == NULL && found == 0;
+
+  unsigned long int old_hash = 0xffffffff;
+  if (sym == NULL
+      || do_lookup_map (undef_name, new_hash, &old_hash, NULL, version, 0,
+			type_class, map) != sym
+      || dl_symbol_visibility_binds_local_p (sym)
+      || ELFW(ST_VISIBILITY) (sym->st_other) == STV_PROTECTED)
+    return false;
+
+  /* Mirror the handling of the binding in do_lookup_x.  Unique symbols
+     are not cached (see lookup_cache_enter).  */
+  switch (ELFW(ST_BIND) (sym->st_info))
+    {
+    case STB_WEAK:
+      if (GLRO(dl_dynamic_weak))
+	return found == 0;
+      /* FALLTHROUGH */
+    case STB_GLOBAL:
+      return found == 1;
+    default:
+      return false;
+    }
+}
+
+
 /* Search loaded objects' symbol tables for a definition of the symbol
    UNDEF_NAME, perhaps with a requested version for the symbol.
 
@@ -787,12 +1046,54 @@ _dl_lookup_symbol_x (const char *undef_name, struct link_map *undef_map,
     while ((*scope)->r_list[i] != skip_map)
       ++i;
 
+  /* Look for the result of searching the global scope in the cache.
+     It is the first scope unless the object was linked with
+     -Bsymbolic or loaded with RTLD_DEEPBIND.  */
+  int found = 0;
+  if (lookup_cache_usable (*scope, undef_map, flags, skip_map))
+    {
+      struct lookup_cache_table *tab
+	= &GL(dl_ns)[undef_map->l_ns]._ns_lookup_cache;
+      bool locked = lookup_lock ();
+      struct lookup_cache_entry *entry
+	= lookup_cache_find (tab, undef_name, new_hash, version, type_class);
+
+      if (entry != NULL && entry->name != NULL)
+	{
+	  current_value.s = entry->sym;
+	  current_value.m = entry->map;
+	  found = entry->found;
+	}
+      else
+	{
+	  /* Do not hold the lock while searching the scope.  Other
+	     threads may fill in or move the entry meanwhile.  */
+	  lookup_unlock (locked);
+	  found = do_lookup_x (undef_name, new_hash, &old_hash, *ref,
+			       &current_value, *scope, 0, version, flags,
+			       skip_map, type_class, undef_map);
+	  if (locked)
+	    {
+	      lookup_lock ();
+	      entry = lookup_cache_find (tab, undef_name, new_hash, version,
+					 type_class);
+	    }
+	  if (entry != NULL && entry->name == NULL)
+	    lookup_cache_enter (tab, entry, undef_name, new_hash, version,
+				type_class, found, &current_value);
+	}
+      lookup_unlock (locked);
+
+      ++scope;
+    }
+
   /* Search the relevant loaded objects for a definition.  */
-  for (size_t start = i; *scope != NULL; start = 0, ++scope)
-    if (do_lookup_x (undef_name, new_hash, &old_hash, *ref,
-		     &current_value, *scope, start, version, flags,
-		     skip_map, type_class, undef_map) != 0)
-      break;
+  if (found == 0)
+    for (size_t start = i; *scope != NULL; start = 0, ++scope)
+      if (do_lookup_x (undef_name, new_hash, &old_hash, *ref,
+		       &current_value, *scope, start, version, flags,
+		       skip_map, type_class, undef_map) != 0)
+	break;
 
   if (__glibc_unlikely (current_value.s == NULL))
     {
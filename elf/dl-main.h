@@ -99,6 +99,9 @@ struct dl_main_state
 
   /* True if information about versions has to be printed.  */
   bool version_info;
+
+  /* The relocation cache file from LD_RELOC_CACHE.  */
+  const char *reloc_cache;
 };
 
 /* Helper function to invoke _dl_init_paths with the right arguments
@@ -110,6 +113,25 @@ call_init_paths (const struct dl_main_state *state)
                   state->glibc_hwcaps_prepend, state->glibc_hwcaps_mask);
 }
 
+/* Enter the symbol lookups recorded in the relocation cache file PATH
+   in the lookup cache of the base namespace.  Return false if there
+   is no such file or it does not match the global scope of MAIN_MAP.  */
+bool _dl_reloc_cache_load (const char *path, struct link_map *main_map)
+  attribute_hidden;
+
+/* Write the symbol lookups done while relocating the objects in the
+   global scope of MAIN_MAP to the relocation cache file PATH.  */
+void _dl_reloc_cache_save (const char *path, struct link_map *main_map)
+  attribute_hidden;
+
+/* Relocate the objects loaded at startup which are in the global scope
+   of MAIN_MAP, except for the main program, on helper threads if the
+   tunable glibc.rtld.parallel_relocation is set.  RELOC_MODE and
+   CONSIDER_PROFILING are as for _dl_relocate_object.  The objects
+   which are left unrelocated have to be relocated by the caller.  */
+void _dl_relocate_parallel (struct link_map *main_map, int reloc_mode,
+			    int consider_profiling) attribute_hidden;
+
 /* Print ld.so usage information and exit.  */
 _Noreturn void _dl_usage (const char *argv0, const char *wrong_option)
   attribute_hidden;
@@ -204,6 +204,10 @@ add_to_global_update (struct link_map *new)
 
   atomic_write_barrier ();
   ns->_ns_main_searchlist->r_nlist = new_nlist;
+
+  /* Symbols may now resolve to the new global objects.  */
+  if (added != 0)
+    _dl_lookup_cache_reset (new->l_ns);
 }
 
 /* Search link maps in all namespaces for the DSO that contains the object at
@@ -411,6 +415,8 @@ TLS generation counter wrapped!  Please report this."));
 
 	  dl_init_static_tls (imap);
 	  assert (imap->l_need_tls_init == 0);
+	  /* Synchronize with tls_get_addr_tail.  */
+	  atomic_store_release (&imap->l_tls_static_initialized, 1);
 	}
     }
 }
@@ -0,0 +1,443 @@
+/* Persistent cache of symbol lookups done during startup relocation.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* If LD_RELOC_CACHE names a file, the dynamic linker saves the results
+   of the symbol lookups in the global scope done while relocating the
+   program at startup to it, and on the next startup enters them in the
+   lookup cache of the base namespace (see dl-lookup.c) before the
+   relocations are processed.
+
+   The file records the objects of the global scope in order, with
+   their file identity (device, inode and modification time) and build
+   ID.  It is only used if all of them match the objects loaded now,
+   and if looking up every cached symbol in its defining object still
+   finds the cached definition.  Otherwise the lookups are done as
+   usual and the file is replaced once relocation is done.  No file is
+   used or written if an object has neither a file identity nor a
+   build ID, or if the name of the file is too long.  LD_RELOC_CACHE is
+   removed from the environment once it has been read, so that the
+   programs which this one runs do not replace the file with their own
+   lookups.  */
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <ldsodefs.h>
+#include <dl-hash.h>
+#include <dl-main.h>
+#include <dl-new-hash.h>
+#include <not-cancel.h>
+#include <libc-pointer-arith.h>
+#include <_itoa.h>
+
+#define RELOC_CACHE_MAGIC "ld.so-relocs-1"
+
+/* Longer build IDs are ignored.  */
+#define RELOC_CACHE_BUILD_ID_MAX 64
+
+/* Used for absent version names and definitions.  */
+#define RELOC_CACHE_NONE UINT32_MAX
+
+struct reloc_cache_header
+{
+  char magic[16];
+  uint32_t elf_class;
+  uint32_t dynamic_weak;
+  uint32_t nobjects;
+  uint32_t nentries;
+  /* Size of the whole file, including the strings after the
+     entries.  */
+  uint64_t size;
+};
+
+struct reloc_cache_object
+{
+  struct r_file_id file_id;
+  uint32_t build_id_size;
+  unsigned char build_id[RELOC_CACHE_BUILD_ID_MAX];
+};
+
+/* Names are offsets into the strings after the entries.  */
+struct reloc_cache_entry
+{
+  uint32_t hashval;
+  int32_t type_class;
+  uint32_t name;
+  uint32_t version_name;
+  uint32_t version_hash;
+  int32_t version_hidden;
+  int32_t found;
+  /* Index of the defining object in the global scope.  */
+  uint32_t object;
+  uint32_t symndx;
+};
+
+/* Store the identity of MAP in *OBJ.  Return false if MAP cannot be
+   identified, in which case the cache is not used.  */
+static bool
+reloc_cache_identify (struct link_map *map, struct reloc_cache_object *obj)
+{
+  static const struct r_file_id unknown;
+
+  memset (obj, 0, sizeof (*obj));
+  obj->file_id = map->l_file_id;
+
+  /* Only the objects opened by _dl_map_object_from_fd have a file
+     identity.  The main program mapped by the kernel and the dynamic
+     linker itself are looked up by name.  */
+  if (memcmp (&obj->file_id, &unknown, sizeof (unknown)) == 0)
+    {
+      const char *path = NULL;
+      if (map->l_type == lt_executable && map->l_name[0] == '\0')
+	path = "/proc/self/exe";
+      else if (map == &GL(dl_rtld_map))
+	path = map->l_name;
+
+      struct __stat64_t64 st;
+      if (path != NULL && __stat64_time64 (path, &st) == 0)
+	{
+	  obj->file_id.dev = st.st_dev;
+	  obj->file_id.ino = st.st_ino;
+	  obj->file_id.mtime_sec = st.st_mtim.tv_sec;
+	  obj->file_id.mtime_nsec = st.st_mtim.tv_nsec;
+	}
+    }
+
+  const ElfW(Phdr) *ph = map->l_phdr;
+  for (const ElfW(Phdr) *end = ph + map->l_phnum; ph < end; ++ph)
+    {
+      if (ph->p_type != PT_NOTE)
+	continue;
+
+      ElfW(Addr) align = ph->p_align == 8 ? 8 : 4;
+      ElfW(Addr) start = map->l_addr + ph->p_vaddr;
+      ElfW(Addr) note_end = start + ph->p_memsz;
+      while (start + sizeof (ElfW(Nhdr)) <= note_end)
+	{
+	  const ElfW(Nhdr) *note = (const ElfW(Nhdr) *) start;
+	  const char *name = (const char *) (note + 1);
+	  const unsigned char *desc
+	    = (const unsigned char *) ALIGN_UP ((ElfW(Addr)) name
+						+ note->n_namesz, align);
+	  start = ALIGN_UP ((ElfW(Addr)) desc + note->n_descsz, align);
+
+	  if (note->n_type == NT_GNU_BUILD_ID
+	      && note->n_namesz == sizeof "GNU"
+	      && memcmp (name, "GNU", sizeof "GNU") == 0
+	      && note->n_descsz <= RELOC_CACHE_BUILD_ID_MAX
+	      && start <= note_end)
+	    {
+	      obj->build_id_size = note->n_descsz;
+	      memcpy (obj->build_id, desc, note->n_descsz);
+	      return true;
+	    }
+	}
+    }
+
+  /* Without a build ID, the file identity has to do.  */
+  return memcmp (&obj->file_id, &unknown, sizeof (unknown)) != 0;
+}
+
+/* Return the symbol SYMNDX of MAP if it is named NAME, else NULL.  */
+static const ElfW(Sym) *
+reloc_cache_symbol (struct link_map *map, uint32_t symndx, const char *name)
+{
+  const ElfW(Sym) *symtab = (const void *) D_PTR (map, l_info[DT_SYMTAB]);
+  const char *strtab = (const void *) D_PTR (map, l_info[DT_STRTAB]);
+  ElfW(Addr) strsz = map->l_info[DT_STRSZ]->d_un.d_val;
+
+  /* The symbol table ends before the end of the mapping.  */
+  if (symndx >= (map->l_map_end - (ElfW(Addr)) symtab) / sizeof (*symtab))
+    return NULL;
+
+  const ElfW(Sym) *sym = &symtab[symndx];
+  if (sym->st_name >= strsz || strcmp (strtab + sym->st_name, name) != 0)
+    return NULL;
+  return sym;
+}
+
+/* Return the version of entry E, stored in *VERSION, or NULL if E is
+   for an unversioned lookup.  */
+static const struct r_found_version *
+reloc_cache_version (const struct reloc_cache_entry *e, const char *strings,
+		     struct r_found_version *version)
+{
+  if (e->version_name == RELOC_CACHE_NONE)
+    return NULL;
+
+  version->name = strings + e->version_name;
+  version->hash = e->version_hash;
+  version->hidden = e->version_hidden;
+  version->filename = NULL;
+  return version;
+}
+
+bool
+_dl_reloc_cache_load (const char *path, struct link_map *main_map)
+{
+  struct r_scope_elem *scope = &main_map->l_searchlist;
+  int fd = __open64_nocancel (path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1)
+    return false;
+
+  struct __stat64_t64 st;
+  void *file = MAP_FAILED;
+  if (__fstat64_time64 (fd, &st) == 0
+      && S_ISREG (st.st_mode)
+      && st.st_size >= (off64_t) sizeof (struct reloc_cache_header))
+    file = __mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  __close_nocancel (fd);
+  if (file == MAP_FAILED)
+    return false;
+
+  const struct reloc_cache_header *header = file;
+  uint64_t strings_offset
+    = (sizeof (struct reloc_cache_header)
+       + (uint64_t) scope->r_nlist * sizeof (struct reloc_cache_object)
+       + (uint64_t) header->nentries * sizeof (struct reloc_cache_entry));
+
+  if (memcmp (header->magic, RELOC_CACHE_MAGIC,
+	      sizeof (RELOC_CACHE_MAGIC)) != 0
+      || header->elf_class != __ELF_NATIVE_CLASS
+      || header->dynamic_weak != GLRO(dl_dynamic_weak)
+      || header->nobjects != scope->r_nlist
+      || header->size != st.st_size
+      || strings_offset >= st.st_size
+      || ((const char *) file)[st.st_size - 1] != '\0')
+    goto invalid;
+
+  const struct reloc_cache_object *objects = (const void *) (header + 1);
+  const struct reloc_cache_entry *entries
+    = (const void *) (objects + scope->r_nlist);
+  const char *strings = (const char *) file + strings_offset;
+  uint64_t strsize = st.st_size - strings_offset;
+
+  for (unsigned int i = 0; i < scope->r_nlist; ++i)
+    {
+      struct reloc_cache_object obj;
+      if (!reloc_cache_identify (scope->r_list[i], &obj)
+	  || memcmp (&obj, &objects[i], sizeof (obj)) != 0)
+	goto invalid;
+    }
+
+  /* Check all entries before entering any.  */
+  for (uint32_t i = 0; i < header->nentries; ++i)
+    {
+      const struct reloc_cache_entry *e = &entries[i];
+      if (e->name >= strsize
+	  || (e->version_name != RELOC_CACHE_NONE
+	      && e->version_name >= strsize)
+	  || (e->object != RELOC_CACHE_NONE && e->object >= scope->r_nlist))
+	goto invalid;
+
+      struct r_found_version version;
+      const struct r_found_version *v
+	= reloc_cache_version (e, strings, &version);
+      struct link_map *map = NULL;
+      const ElfW(Sym) *sym = NULL;
+      if (e->object != RELOC_CACHE_NONE)
+	{
+	  map = scope->r_list[e->object];
+	  sym = reloc_cache_symbol (map, e->symndx, strings + e->name);
+	  if (sym == NULL)
+	    goto invalid;
+	}
+
+      /* The lookup has to find the same definition in the object as
+	 when the entry was written.  */
+      if (e->hashval != _dl_new_hash (strings + e->name)
+	  || (v != NULL && v->hash != _dl_elf_hash (v->name))
+	  || !_dl_lookup_cache_check (strings + e->name, e->hashval, v,
+				      e->type_class, e->found, sym, map))
+	goto invalid;
+    }
+
+  for (uint32_t i = 0; i < header->nentries; ++i)
+    {
+      const struct reloc_cache_entry *e = &entries[i];
+      struct r_found_version version;
+      const struct r_found_version *v
+	= reloc_cache_version (e, strings, &version);
+      const ElfW(Sym) *sym = NULL;
+      struct link_map *map = NULL;
+
+      if (e->object != RELOC_CACHE_NONE)
+	{
+	  map = scope->r_list[e->object];
+	  sym = reloc_cache_symbol (map, e->symndx, strings + e->name);
+	}
+
+      /* If the cache is disabled, the lookups are simply done again.  */
+      if (!_dl_lookup_cache_insert (LM_ID_BASE, strings + e->name,
+				    e->hashval, v, e->type_class, e->found,
+				    sym, map))
+	break;
+    }
+
+  /* The cached names point into the file, so it stays mapped.  */
+  if (__glibc_unlikely (GLRO(dl_debug_mask) & DL_DEBUG_RELOC))
+    _dl_debug_printf ("\nusing relocation cache %s: %u lookups\n",
+		      path, header->nentries);
+  return true;
+
+ invalid:
+  __munmap (file, st.st_size);
+  return false;
+}
+
+/* Write the N bytes at BUF to FD.  Return false on error.  */
+static bool
+reloc_cache_write (int fd, const void *buf, size_t n)
+{
+  while (n > 0)
+    {
+      ssize_t written = __write_nocancel (fd, buf, n);
+      if (written <= 0)
+	return false;
+      buf = (const char *) buf + written;
+      n -= written;
+    }
+  return true;
+}
+
+void
+_dl_reloc_cache_save (const char *path, struct link_map *main_map)
+{
+  struct r_scope_elem *scope = &main_map->l_searchlist;
+  const struct lookup_cache_table *tab
+    = &GL(dl_ns)[LM_ID_BASE]._ns_lookup_cache;
+
+  /* Leave room for the suffix of the temporary file.  */
+  size_t path_len = strlen (path);
+  if (tab->n_elements == 0 || path_len >= PATH_MAX - 12)
+    return;
+
+  /* Number the objects of the global scope.  Entries referring to
+     other objects, which cannot happen, are dropped below.  */
+  for (unsigned int i = 0; i < scope->r_nlist; ++i)
+    scope->r_list[i]->l_idx = i;
+
+  size_t strsize = 0;
+  for (size_t i = 0; i < tab->size; ++i)
+    if (tab->entries[i].name != NULL)
+      {
+	strsize += strlen (tab->entries[i].name) + 1;
+	if (tab->entries[i].version_name != NULL)
+	  strsize += strlen (tab->entries[i].version_name) + 1;
+      }
+  if (strsize >= RELOC_CACHE_NONE)
+    return;
+
+  size_t size = (sizeof (struct reloc_cache_header)
+		 + scope->r_nlist * sizeof (struct reloc_cache_object)
+		 + tab->n_elements * sizeof (struct reloc_cache_entry)
+		 + strsize);
+  size_t alloc_size = size;
+  void *buf = __mmap (NULL, alloc_size, PROT_READ | PROT_WRITE,
+		      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (buf == MAP_FAILED)
+    return;
+
+  struct reloc_cache_header *header = buf;
+  struct reloc_cache_object *objects = (void *) (header + 1);
+  struct reloc_cache_entry *entries = (void *) (objects + scope->r_nlist);
+  char *strings = (char *) (entries + tab->n_elements);
+  uint32_t nentries = 0;
+  uint32_t stroff = 0;
+
+  for (unsigned int i = 0; i < scope->r_nlist; ++i)
+    if (!reloc_cache_identify (scope->r_list[i], &objects[i]))
+      {
+	__munmap (buf, alloc_size);
+	return;
+      }
+
+  for (size_t i = 0; i < tab->size; ++i)
+    {
+      const struct lookup_cache_entry *le = &tab->entries[i];
+      if (le->name == NULL)
+	continue;
+
+      struct reloc_cache_entry *e = &entries[nentries];
+      e->hashval = le->hashval;
+      e->type_class = le->type_class;
+      e->version_hash = le->version_hash;
+      e->version_hidden = le->version_hidden;
+      e->found = le->found;
+      if (le->map == NULL)
+	e->object = e->symndx = RELOC_CACHE_NONE;
+      else
+	{
+	  e->object = le->map->l_idx;
+	  if (e->object >= scope->r_nlist
+	      || scope->r_list[e->object] != le->map)
+	    continue;
+	  const ElfW(Sym) *symtab
+	    = (const void *) D_PTR (le->map, l_info[DT_SYMTAB]);
+	  e->symndx = le->sym - symtab;
+	}
+
+      e->name = stroff;
+      stroff = __stpcpy (strings + stroff, le->name) + 1 - strings;
+      if (le->version_name == NULL)
+	e->version_name = RELOC_CACHE_NONE;
+      else
+	{
+	  e->version_name = stroff;
+	  stroff = __stpcpy (strings + stroff, le->version_name) + 1 - strings;
+	}
+      ++nentries;
+    }
+
+  /* Drop the space of skipped entries by moving the strings down.  */
+  memmove (entries + nentries, strings, stroff);
+  size -= (tab->n_elements - nentries) * sizeof (struct reloc_cache_entry);
+  size -= strsize - stroff;
+
+  memcpy (header->magic, RELOC_CACHE_MAGIC, sizeof (RELOC_CACHE_MAGIC));
+  header->elf_class = __ELF_NATIVE_CLASS;
+  header->dynamic_weak = GLRO(dl_dynamic_weak);
+  header->nobjects = scope->r_nlist;
+  header->nentries = nentries;
+  header->size = size;
+
+  /* Write a file of our own and rename it, so that other processes
+     never see a partial file.  */
+  char tmp[PATH_MAX];
+  tmp[path_len + 11] = '\0';
+  char *startp = _itoa (__getpid (), &tmp[path_len + 11], 10, 0);
+  *--startp = '.';
+  startp = memcpy (startp - path_len, path, path_len);
+
+  int fd = __open64_nocancel (startp, O_WRONLY | O_CREAT | O_EXCL
+			      | O_NOFOLLOW | O_CLOEXEC, S_IRUSR | S_IWUSR);
+  if (fd != -1)
+    {
+      bool ok = reloc_cache_write (fd, buf, size);
+      __close_nocancel (fd);
+      if (!ok || __renameat (AT_FDCWD, startp, AT_FDCWD, path) != 0)
+	__unlink (startp);
+    }
+
+  __munmap (buf, alloc_size);
+}
@@ -0,0 +1,323 @@
+/* Relocate objects loaded at startup on several threads.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* dl_main relocates the objects loaded at startup one after the other,
+   in reverse initialization order, so that the dependencies of an
+   object are relocated before the object itself.  This matters for
+   IFUNC resolvers, which run during relocation processing and may call
+   into the dependencies of their object, and for copy relocations,
+   which read data from the objects defining the copied symbols.  With
+   the tunable glibc.rtld.parallel_relocation, most objects are instead
+   relocated by helper threads, as follows.
+
+   First, every object which defines an IFUNC symbol is relocated on
+   the current thread, after all of its dependencies, in the usual
+   order.  Binding to such a symbol calls the resolver, so these
+   objects have to be ready before any object which may refer to them.
+   The main program is left to dl_main, since it is the only object
+   with copy relocations and has to come last.
+
+   The remaining objects cannot contain a resolver which another object
+   calls.  They are relocated by the helper threads and the current
+   thread together.  An object is only started once its dependencies
+   are done, as before, so resolvers for its own IRELATIVE relocations
+   still find them relocated.  RELRO segments are protected by
+   _dl_relocate_object as usual, once the object is done.  A thread
+   whose next object still depends on one that is being relocated
+   blocks on a futex until it is done, and there are no more threads
+   than CPUs, so that waiting threads do not take CPU time from the
+   ones which relocate.
+
+   Symbol lookups update the lookup cache and the unique symbol tables,
+   which is serialized with GL(dl_parallel_relocation_lock) while
+   GL(dl_parallel_relocation) is set (see dl-lookup.c).  Profiling and
+   auditing hook into relocation processing with code which is not
+   prepared for this, and debugging output would be interleaved, so
+   the objects are relocated on a single thread if any of them is
+   enabled.  */
+
+#include <assert.h>
+#include <atomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <ldsodefs.h>
+#include <dl-helper-thread.h>
+#include <dl-main.h>
+#include <dl-tunables.h>
+
+/* Values of parallel_object.relocated.  */
+enum
+  {
+    object_pending,
+    object_relocated,
+    /* Not relocated yet, and a thread waits for it.  */
+    object_waited_for,
+  };
+
+/* The state of an object in the main map's initialization list.  */
+struct parallel_object
+{
+  /* One of the values above.  */
+  unsigned int relocated;
+
+  /* Length of the longest chain of dependencies which are relocated in
+     parallel below the object.  */
+  unsigned int level;
+
+  /* True if the object is relocated on the current thread before the
+     others.  */
+  bool serial;
+};
+
+struct parallel_relocation
+{
+  /* Indexed by l_idx.  */
+  struct parallel_object *objects;
+
+  /* The objects to relocate in parallel, by increasing level, so that
+     the dependencies of an object come before it.  */
+  struct link_map **order;
+  unsigned int count;
+
+  /* Index in ORDER of the next object to relocate.  */
+  unsigned int next;
+
+  int reloc_mode;
+};
+
+/* Return true if MAP defines a symbol of type STT_GNU_IFUNC which
+   symbol lookups can find.  */
+static bool
+defines_ifunc (struct link_map *map)
+{
+  /* Only the GNU hash table is checked.  Objects with just a DT_HASH
+     table are rare and are assumed to define IFUNC symbols.  */
+  if (map->l_gnu_bitmask == NULL)
+    return true;
+
+  const ElfW(Sym) *symtab = (const void *) D_PTR (map, l_info[DT_SYMTAB]);
+  for (Elf_Symndx bucket = 0; bucket < map->l_nbuckets; ++bucket)
+    {
+      Elf32_Word symidx = map->l_gnu_buckets[bucket];
+      if (symidx == 0)
+	continue;
+
+      const Elf32_Word *hasharr = &map->l_gnu_chain_zero[symidx];
+      do
+	{
+	  const ElfW(Sym) *sym
+	    = &symtab[ELF_MACHINE_HASH_SYMIDX (map, hasharr)];
+	  if (ELFW(ST_TYPE) (sym->st_info) == STT_GNU_IFUNC
+	      && sym->st_shndx != SHN_UNDEF)
+	    return true;
+	}
+      while ((*hasharr++ & 1u) == 0);
+    }
+  return false;
+}
+
+/* Wait until OBJECT has been relocated.  */
+static void
+wait_relocated (struct parallel_object *object)
+{
+  unsigned int state = atomic_load_acquire (&object->relocated);
+  for (int spins = 0; state != object_relocated && spins < 100; spins++)
+    {
+      atomic_spin_nop ();
+      state = atomic_load_acquire (&object->relocated);
+    }
+
+  while (state != object_relocated)
+    {
+      if (state == object_waited_for
+	  || atomic_compare_exchange_weak_relaxed (&object->relocated,
+						   &state, object_waited_for))
+	_dl_helper_thread_wait (&object->relocated, object_waited_for);
+      state = atomic_load_acquire (&object->relocated);
+    }
+}
+
+/* Relocate the objects of PR->order until none is left.  Run by the
+   helper threads and the current thread.  */
+static int
+relocate_worker (void *closure)
+{
+  struct parallel_relocation *pr = closure;
+
+  while (true)
+    {
+      unsigned int next = atomic_fetch_add_relaxed (&pr->next, 1);
+      if (next >= pr->count)
+	break;
+      struct link_map *l = pr->order[next];
+
+      /* The dependencies of L come earlier in PR->order, so they are
+	 being relocated already.  Dependencies later in the
+	 initialization list are part of a cycle and were not relocated
+	 before L in the serial order either.  */
+      if (l->l_initfini != NULL)
+	for (struct link_map **dep = &l->l_initfini[1]; *dep != NULL; ++dep)
+	  if ((*dep)->l_idx > l->l_idx)
+	    wait_relocated (&pr->objects[(*dep)->l_idx]);
+
+      _dl_relocate_object (l, l->l_scope, pr->reloc_mode, 0);
+      if (atomic_exchange_release (&pr->objects[l->l_idx].relocated,
+				   object_relocated) == object_waited_for)
+	_dl_helper_thread_wake (&pr->objects[l->l_idx].relocated);
+    }
+
+  return 0;
+}
+
+/* Relocate the objects of PR on the current thread and up to NTHREADS
+   helper threads.  */
+static void
+relocate_threads (struct parallel_relocation *pr, int nthreads)
+{
+  struct dl_helper_thread threads[nthreads];
+
+  atomic_store_relaxed (&GL(dl_parallel_relocation), 1);
+
+  /* If no thread can be created, the current thread does all the
+     work.  */
+  int started = 0;
+  while (started < nthreads
+	 && _dl_helper_thread_create (&threads[started], relocate_worker,
+				      pr))
+    ++started;
+
+  relocate_worker (pr);
+
+  for (int i = 0; i < started; ++i)
+    _dl_helper_thread_join (&threads[i]);
+
+  atomic_store_relaxed (&GL(dl_parallel_relocation), 0);
+}
+
+void
+_dl_relocate_parallel (struct link_map *main_map, int reloc_mode,
+		       int consider_profiling)
+{
+  int nthreads = TUNABLE_GET (glibc, rtld, parallel_relocation, int32_t,
+			      NULL);
+  if (nthreads <= 0 || consider_profiling || GLRO(dl_naudit) > 0
+      || GLRO(dl_debug_mask) != 0)
+    return;
+
+  /* The current thread relocates as well.  */
+  int cpus = _dl_helper_thread_cpus ();
+  if (nthreads > cpus - 1)
+    nthreads = cpus - 1;
+  if (nthreads <= 0)
+    return;
+
+  unsigned int nlist = main_map->l_searchlist.r_nlist;
+  struct link_map **list = main_map->l_initfini;
+  struct parallel_object *objects = calloc (nlist, sizeof (*objects));
+  struct link_map **order = malloc (nlist * sizeof (*order));
+  if (objects == NULL || order == NULL)
+    goto out;
+
+  for (unsigned int i = 0; i < nlist; ++i)
+    {
+      list[i]->l_idx = i;
+      objects[i].relocated = ((list[i]->l_relocated
+			       || list[i] == &GL(dl_rtld_map))
+			      ? object_relocated : object_pending);
+    }
+
+  /* The main program is relocated by dl_main.  */
+  objects[0].serial = true;
+  for (unsigned int i = 1; i < nlist; ++i)
+    if (!objects[i].relocated && defines_ifunc (list[i]))
+      objects[i].serial = true;
+
+  /* The dependencies of these objects have to be relocated before
+     them, so they are relocated serially as well.  */
+  bool changed;
+  do
+    {
+      changed = false;
+      for (unsigned int i = 1; i < nlist; ++i)
+	if (objects[i].serial && list[i]->l_initfini != NULL)
+	  for (struct link_map **dep = &list[i]->l_initfini[1];
+	       *dep != NULL; ++dep)
+	    if (!objects[(*dep)->l_idx].serial)
+	      {
+		objects[(*dep)->l_idx].serial = true;
+		changed = true;
+	      }
+    }
+  while (changed);
+
+  for (unsigned int i = nlist - 1; i > 0; --i)
+    if (objects[i].serial && !objects[i].relocated)
+      {
+	_dl_relocate_object (list[i], list[i]->l_scope, reloc_mode, 0);
+	objects[i].relocated = object_relocated;
+      }
+
+  /* Compute the levels of the other objects.  Their dependencies
+     usually come after them in the initialization list.  */
+  unsigned int count = 0;
+  unsigned int maxlevel = 0;
+  for (unsigned int i = nlist - 1; i > 0; --i)
+    if (!objects[i].relocated)
+      {
+	struct link_map *l = list[i];
+	if (l->l_initfini != NULL)
+	  for (struct link_map **dep = &l->l_initfini[1]; *dep != NULL; ++dep)
+	    {
+	      unsigned int idx = (*dep)->l_idx;
+	      if (idx > i && !objects[idx].relocated
+		  && objects[idx].level + 1 > objects[i].level)
+		objects[i].level = objects[idx].level + 1;
+	    }
+	if (objects[i].level > maxlevel)
+	  maxlevel = objects[i].level;
+	++count;
+      }
+
+  /* Nothing to gain from a single object.  */
+  if (count < 2)
+    goto out;
+
+  unsigned int n = 0;
+  for (unsigned int level = 0; level <= maxlevel; ++level)
+    for (unsigned int i = nlist - 1; i > 0; --i)
+      if (!objects[i].relocated && objects[i].level == level)
+	order[n++] = list[i];
+  assert (n == count);
+
+  struct parallel_relocation pr =
+    {
+      .objects = objects,
+      .order = order,
+      .count = count,
+      .next = 0,
+      .reloc_mode = reloc_mode,
+    };
+
+  if ((unsigned int) nthreads > count - 1)
+    nthreads = count - 1;
+  relocate_threads (&pr, nthreads);
+
+ out:
+  free (order);
+  free (objects);
+}
@@ -17,6 +17,7 @@
    License along with the GNU C Library; if not, see
    <https://www.gnu.org/licenses/>.  */
 
+#include <atomic.h>
 #include <errno.h>
 #include <libintl.h>
 #include <stdlib.h>
@@ -29,9 +30,13 @@
 #include <libc-pointer-arith.h>
 #include "dynamic-link.h"
 
-/* Statistics function.  */
+/* Statistics function.  Relocation may run on several threads during
+   startup, see _dl_relocate_parallel.  */
 #ifdef SHARED
-# define bump_num_cache_relocations() ++GL(dl_num_cache_relocations)
+# define bump_num_cache_relocations()					      \
+  (__glibc_unlikely (atomic_load_relaxed (&GL(dl_parallel_relocation)))	      \
+   ? (void) atomic_fetch_add_relaxed (&GL(dl_num_cache_relocations), 1)	      \
+   : (void) ++GL(dl_num_cache_relocations))
 #else
 # define bump_num_cache_relocations() ((void) 0)
 #endif
@@ -120,6 +125,8 @@ _dl_try_allocate_static_tls (struct link_map *map, bool optional)
 #endif
 
       dl_init_static_tls (map);
+      /* Synchronize with tls_get_addr_tail.  */
+      atomic_store_release (&map->l_tls_static_initialized, 1);
     }
   else
     map->l_need_tls_init = 1;
@@ -516,6 +516,11 @@ _dl_resize_dtv (dtv_t *dtv, size_t max_modid)
   size_t newsize = max_modid + DTV_SURPLUS;
   size_t oldsize = dtv[-1].counter;
 
+  /* Grow by at least half, so that a process which keeps loading
+     modules with TLS does not resize the DTV of every thread each
+     time.  */
+  newsize = MAX (newsize, oldsize + oldsize / 2);
+
   _dl_tls_allocate_begin ();
   if (dtv == GL(dl_initial_dtv))
     {
@@ -814,6 +819,13 @@ _dl_update_slotinfo (unsigned long int req_modid, size_t new_gen)
      to be distinguished for which relaxed mo access of gen and map is
      enough: their value is synchronized when it matters.
 
+     Every element of the list also records the largest generation of
+     its entries, stored after the entry itself.  If that is not larger
+     than old_gen, all the entries of the element are case (2) or (1),
+     and the element is skipped, so the update only looks at the
+     elements that changed.  A concurrent update that has not stored
+     the generation of the element yet is case (1).
+
      Note that a relaxed mo load may give an out-of-thin-air value since
      it is used in decisions that can affect concurrent stores.  But this
      should only happen if the OOTA value causes UB that justifies the
@@ -831,7 +843,12 @@ _dl_update_slotinfo (unsigned long int req_modid, size_t new_gen)
       listp =  GL(dl_tls_dtv_slotinfo_list);
       do
 	{
-	  for (size_t cnt = total == 0 ? 1 : 0; cnt < listp->len; ++cnt)
+	  size_t first = total == 0 ? 1 : 0;
+	  /* Case (2) or (1) for all entries of this element.  */
+	  if (atomic_load_relaxed (&listp->gen) <= dtv[0].counter)
+	    first = listp->len;
+
+	  for (size_t cnt = first; cnt < listp->len; ++cnt)
 	    {
 	      size_t modid = total + cnt;
 
@@ -915,6 +932,19 @@ _dl_update_slotinfo (unsigned long int req_modid, size_t new_gen)
 }
 
 
+/* Return the static TLS block of THE_MAP in the calling thread.  */
+static inline void *
+static_tls_block (struct link_map *the_map)
+{
+#if TLS_TCB_AT_TP
+  return (char *) THREAD_SELF - the_map->l_tls_offset;
+#elif TLS_DTV_AT_TP
+  return (char *) THREAD_SELF + the_map->l_tls_offset + TLS_PRE_TCB_SIZE;
+#else
+# error "Either TLS_TCB_AT_TP or TLS_DTV_AT_TP must be defined"
+#endif
+}
+
 static void *
 __attribute_noinline__
 tls_get_addr_tail (GET_ADDR_ARGS, dtv_t *dtv, struct link_map *the_map)
@@ -942,6 +972,19 @@ tls_get_addr_tail (GET_ADDR_ARGS, dtv_t *dtv, struct link_map *the_map)
   if (__glibc_unlikely (the_map->l_tls_offset
 			!= FORCED_DYNAMIC_TLS_OFFSET))
     {
+      /* Once the static TLS block has been set up in all threads, the
+	 decision cannot change any more.  Avoid waiting for the lock,
+	 which a concurrent dlopen holds for a long time, in every
+	 thread that accesses the variable for the first time.  */
+      if (atomic_load_acquire (&the_map->l_tls_static_initialized))
+	{
+	  void *p = static_tls_block (the_map);
+	  dtv[GET_ADDR_MODULE].pointer.to_free = NULL;
+	  dtv[GET_ADDR_MODULE].pointer.val = p;
+
+	  return (char *) p + GET_ADDR_OFFSET;
+	}
+
       __rtld_lock_lock_recursive (GL(dl_load_tls_lock));
       if (__glibc_likely (the_map->l_tls_offset == NO_TLS_OFFSET))
 	{
@@ -951,13 +994,7 @@ tls_get_addr_tail (GET_ADDR_ARGS, dtv_t *dtv, struct link_map *the_map)
       else if (__glibc_likely (the_map->l_tls_offset
 			       != FORCED_DYNAMIC_TLS_OFFSET))
 	{
-#if TLS_TCB_AT_TP
-	  void *p = (char *) THREAD_SELF - the_map->l_tls_offset;
-#elif TLS_DTV_AT_TP
-	  void *p = (char *) THREAD_SELF + the_map->l_tls_offset + TLS_PRE_TCB_SIZE;
-#else
-# error "Either TLS_TCB_AT_TP or TLS_DTV_AT_TP must be defined"
-#endif
+	  void *p = static_tls_block (the_map);
 	  __rtld_lock_unlock_recursive (GL(dl_load_tls_lock));
 
 	  dtv[GET_ADDR_MODULE].pointer.to_free = NULL;
@@ -1182,6 +1219,7 @@ cannot create TLS data structures"));
 
       listp->len = TLS_SLOTINFO_SURPLUS;
       listp->next = NULL;
+      listp->gen = 0;
       memset (listp->slotinfo, '\0',
 	      TLS_SLOTINFO_SURPLUS * sizeof (struct dtv_slotinfo));
       /* Synchronize with _dl_update_slotinfo.  */
@@ -1195,6 +1233,7 @@ cannot create TLS data structures"));
       atomic_store_relaxed (&listp->slotinfo[idx].map, l);
       atomic_store_relaxed (&listp->slotinfo[idx].gen,
 			    GL(dl_tls_generation) + 1);
+      atomic_store_relaxed (&listp->gen, GL(dl_tls_generation) + 1);
       l->l_tls_in_slotinfo = true;
     }
 
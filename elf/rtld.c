@@ -301,6 +301,7 @@ dl_main_state_init (struct dl_main_state *state)
   state->glibc_hwcaps_mask = NULL;
   state->mode = rtld_mode_normal;
   state->version_info = false;
+  state->reloc_cache = NULL;
 }
 
 #ifndef HAVE_INLINED_SYSCALLS
@@ -2284,6 +2285,12 @@ dl_main (const ElfW(Phdr) *phdr,
   /* If we are profiling we also must do lazy reloaction.  */
   GLRO(dl_lazy) |= consider_profiling;
 
+  /* Reuse the symbol lookups of an earlier run of the same program
+     if possible.  */
+  bool save_reloc_cache = false;
+  if (__glibc_unlikely (state.reloc_cache != NULL))
+    save_reloc_cache = !_dl_reloc_cache_load (state.reloc_cache, main_map);
+
   if (GL(dl_ns)[LM_ID_BASE].libc_map != NULL)
     _dl_relocate_object (GL(dl_ns)[LM_ID_BASE].libc_map,
 			 GL(dl_ns)[LM_ID_BASE].libc_map->l_scope,
@@ -2292,6 +2299,11 @@ dl_main (const ElfW(Phdr) *phdr,
   RTLD_TIMING_VAR (start);
   rtld_timer_start (&start);
   {
+    /* Possibly relocate most objects on helper threads first.  The
+       loop below skips the objects which are done.  */
+    _dl_relocate_parallel (main_map, GLRO(dl_lazy) ? RTLD_LAZY : 0,
+			   consider_profiling);
+
     unsigned i = main_map->l_searchlist.r_nlist;
     while (i-- > 0)
       {
@@ -2321,6 +2333,9 @@ dl_main (const ElfW(Phdr) *phdr,
   }
   rtld_timer_stop (&relocate_time, start);
 
+  if (__glibc_unlikely (save_reloc_cache))
+    _dl_reloc_cache_save (state.reloc_cache, main_map);
+
   /* Now enable profiling if needed.  Like the previous call,
      this has to go here because the calls it makes should use the
      rtld versions of the functions (particularly calloc()), but it
@@ -2693,7 +2708,14 @@ process_envvars_default (struct dl_main_state *state)
 	case 11:
 	  /* Path where the binary is found.  */
 	  if (memcmp (envline, "ORIGIN_PATH", 11) == 0)
-	    GLRO(dl_origin_path) = &envline[12];
+	    {
+	      GLRO(dl_origin_path) = &envline[12];
+	      break;
+	    }
+
+	  /* Where to keep the results of symbol lookups.  */
+	  if (memcmp (envline, "RELOC_CACHE", 11) == 0 && envline[12] != '\0')
+	    state->reloc_cache = &envline[12];
 	  break;
 
 	case 12:
@@ -2764,7 +2786,19 @@ process_envvars (struct dl_main_state *state)
   if (__glibc_unlikely (__libc_enable_secure))
     skip_env += process_envvars_secure (state);
   else
-    process_envvars_default (state);
+    {
+      process_envvars_default (state);
+
+      /* The relocation cache describes this program.  Other programs
+	 started from it would find it does not match and replace it.
+	 The string stays in place, so STATE->reloc_cache remains
+	 valid.  */
+      if (state->reloc_cache != NULL)
+	{
+	  skip_env++;
+	  unsetenv ("LD_RELOC_CACHE");
+	}
+    }
 
   return skip_env;
 }
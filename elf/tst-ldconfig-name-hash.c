@@ -0,0 +1,348 @@
+/* Test the name hash index of ld.so.cache.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* Run ldconfig on libraries whose names exercise the
+   cache_extension_tag_name_hash section: keys with several entries, in
+   two directories and in glibc-hwcaps subdirectories, names which only
+   differ in leading zeros of their version numbers, and enough names
+   for collisions in the table.  Check that the section indexes the
+   first entry of every key, and that dlopen finds the same files with
+   the index as with the binary search, which the dynamic loader uses
+   if the section is missing or invalid.  A corrupt index must not make
+   dlopen find a different file.  */
+
+#include <array_length.h>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <link.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <support/check.h>
+#include <support/support.h>
+#include <support/xdlfcn.h>
+#include <support/xunistd.h>
+
+#include <dl-cache.h>
+
+/* Number of libraries which only differ in a number in their name.  */
+#define NUM_COLLIDE 100
+
+/* The names looked up with dlopen.  */
+#define NUM_NAMES (NUM_COLLIDE + 7)
+static char *names[NUM_NAMES];
+
+/* The contents of ld.so.cache as written by ldconfig.  */
+static char *cache_path;
+static char *cache_data;
+static size_t cache_size;
+
+/* Invoke /sbin/ldconfig with some error checking.  */
+static void
+run_ldconfig (void)
+{
+  char *command = xasprintf ("%s/ldconfig", support_install_rootsbindir);
+  TEST_COMPARE (system (command), 0);
+  free (command);
+}
+
+/* Copy the test module MODULE from the build tree to PATH.  */
+static void
+install (const char *module, const char *path)
+{
+  char *src = xasprintf ("%s/elf/%s", support_objdir_root, module);
+  support_copy_file (src, path);
+  free (src);
+}
+
+/* Replace ld.so.cache with the DATA, which has the size of the cache
+   written by ldconfig.  The file is replaced by renaming, like
+   ldconfig does.  */
+static void
+write_cache (const char *data)
+{
+  char *tmp = xasprintf ("%s~", cache_path);
+  int fd = xopen (tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  xwrite (fd, data, cache_size);
+  xclose (fd);
+  if (rename (tmp, cache_path) != 0)
+    FAIL_EXIT1 ("rename (\"%s\", \"%s\"): %m", tmp, cache_path);
+  free (tmp);
+}
+
+/* Return the file which dlopen loads for NAME, or NULL if dlopen
+   fails.  */
+static char *
+lookup (const char *name)
+{
+  void *handle = dlopen (name, RTLD_NOW);
+  if (handle == NULL)
+    return NULL;
+  struct link_map *map;
+  TEST_COMPARE (dlinfo (handle, RTLD_DI_LINKMAP, &map), 0);
+  char *result = xstrdup (map->l_name);
+  xdlclose (handle);
+  return result;
+}
+
+/* Look up all names and store the results in RESULTS.  */
+static void
+lookup_all (char **results)
+{
+  for (int i = 0; i < NUM_NAMES; i++)
+    results[i] = lookup (names[i]);
+}
+
+static void
+free_all (char **results)
+{
+  for (int i = 0; i < NUM_NAMES; i++)
+    free (results[i]);
+}
+
+/* Check that dlopen finds the EXPECTED files with the cache DATA.  If
+   EXACT is false, dlopen may also fail.  */
+static void
+check_cache (const char *what, const char *data, char **expected,
+	     bool exact)
+{
+  printf ("info: checking lookups with %s\n", what);
+  write_cache (data);
+
+  char *results[NUM_NAMES];
+  lookup_all (results);
+  for (int i = 0; i < NUM_NAMES; i++)
+    {
+      if (expected[i] == NULL || results[i] == NULL)
+	{
+	  if (results[i] != expected[i] && (exact || results[i] != NULL))
+	    {
+	      support_record_failure ();
+	      printf ("error: %s: %s found as %s instead of %s\n", what,
+		      names[i], results[i] ? results[i] : "(none)",
+		      expected[i] ? expected[i] : "(none)");
+	    }
+	}
+      else if (strcmp (results[i], expected[i]) != 0)
+	{
+	  support_record_failure ();
+	  printf ("error: %s: %s found as %s instead of %s\n", what,
+		  names[i], results[i], expected[i]);
+	}
+    }
+  free_all (results);
+}
+
+/* Return true if PATH ends in /NAME.  */
+static bool
+is_file (const char *path, const char *name)
+{
+  size_t path_len = strlen (path);
+  size_t name_len = strlen (name);
+  return (path_len > name_len && path[path_len - name_len - 1] == '/'
+	  && strcmp (path + path_len - name_len, name) == 0);
+}
+
+static int
+do_test (void)
+{
+  if (dlopen ("libnamehash.so.1", RTLD_NOW) != NULL)
+    FAIL_EXIT1 ("libnamehash.so.1 is already on the search path");
+
+  {
+    char *conf_path = xasprintf ("%s/ld.so.conf", support_sysconfdir_prefix);
+    xmkdirp (support_sysconfdir_prefix, 0777);
+    support_write_file_string (conf_path,
+			       "/glibc-test/lib\n/glibc-test/lib2\n");
+    free (conf_path);
+  }
+  xmkdirp ("/glibc-test/lib2", 0777);
+
+  /* Entries for glibc-hwcaps subdirectories share the key of the
+     default one and come before it.  */
+  install ("libmarkermod1-1.so", "/glibc-test/lib/libmarkermod1.so");
+  static const char *const hwcaps[] = { "power9", "x86-64-v2", "z13" };
+  for (int i = 0; i < array_length (hwcaps); i++)
+    {
+      char *dir = xasprintf ("/glibc-test/lib/glibc-hwcaps/%s", hwcaps[i]);
+      xmkdirp (dir, 0777);
+      char *path = xasprintf ("%s/libmarkermod1.so", dir);
+      install ("libmarkermod1-2.so", path);
+      free (path);
+      free (dir);
+    }
+
+  /* The same key in two directories.  */
+  install ("libmarkermod2-1.so", "/glibc-test/lib/libmarkermod2.so");
+  install ("libmarkermod2-2.so", "/glibc-test/lib2/libmarkermod2.so");
+
+  /* _dl_cache_libcmp ignores leading zeros in numbers.  */
+  install ("libmarkermod3-2.so", "/glibc-test/lib/libnamehash.so.01");
+  install ("libmarkermod3-3.so", "/glibc-test/lib/libnamehash.so.10");
+
+  for (int i = 0; i < NUM_COLLIDE; i++)
+    {
+      char *path = xasprintf ("/glibc-test/lib/libnamehash-%d.so.1", i);
+      install ("libmarkermod4-2.so", path);
+      free (path);
+    }
+
+  int n = 0;
+  names[n++] = xstrdup ("libmarkermod1.so");
+  names[n++] = xstrdup ("libmarkermod2.so");
+  names[n++] = xstrdup ("libnamehash.so.1");
+  names[n++] = xstrdup ("libnamehash.so.01");
+  names[n++] = xstrdup ("libnamehash.so.001");
+  names[n++] = xstrdup ("libnamehash.so.10");
+  names[n++] = xstrdup ("libnamehash-missing.so.1");
+  for (int i = 0; i < NUM_COLLIDE; i++)
+    names[n++] = xasprintf ("libnamehash-%d.so.1", i);
+  TEST_COMPARE (n, NUM_NAMES);
+
+  run_ldconfig ();
+
+  cache_path = xasprintf ("%s/ld.so.cache", support_sysconfdir_prefix);
+  {
+    int fd = xopen (cache_path, O_RDONLY, 0);
+    struct stat64 st;
+    xfstat (fd, &st);
+    cache_size = st.st_size;
+    cache_data = xmalloc (cache_size);
+    xread (fd, cache_data, cache_size);
+    xclose (fd);
+  }
+
+  /* ldconfig writes the new format only.  */
+  struct cache_file_new *cache_new = (struct cache_file_new *) cache_data;
+  TEST_VERIFY_EXIT (cache_size > sizeof (*cache_new));
+  TEST_VERIFY_EXIT (memcmp (cache_new->magic, CACHEMAGIC_VERSION_NEW,
+			    sizeof CACHEMAGIC_VERSION_NEW - 1) == 0);
+  struct cache_extension_all_loaded loaded;
+  TEST_VERIFY_EXIT (cache_extension_load (cache_new, cache_data, cache_size,
+					  &loaded));
+  const struct cache_name_hash *hash
+    = loaded.sections[cache_extension_tag_name_hash].base;
+  TEST_VERIFY_EXIT (hash != NULL);
+  printf ("info: %u entries, %u buckets\n", cache_new->nlibs,
+	  hash->nbuckets);
+
+  /* The section has one bucket for the first entry of each key.  The
+     string table offsets are relative to the start of the file.  */
+  uint32_t keys = 0;
+  for (uint32_t i = 0; i < cache_new->nlibs; i++)
+    {
+      const char *key = cache_data + cache_new->libs[i].key;
+      bool first = (i == 0
+		    || _dl_cache_libcmp (key, (cache_data
+					       + cache_new->libs[i - 1].key))
+		       != 0);
+      keys += first;
+
+      int matched, last;
+      int index = _dl_cache_search_hashed (cache_data, cache_size,
+					   &cache_new->libs[0].entry,
+					   cache_new->nlibs,
+					   sizeof (cache_new->libs[0]), hash,
+					   key, &matched, &last);
+      int expected = _dl_cache_search_binary (cache_data, cache_size,
+					      &cache_new->libs[0].entry,
+					      cache_new->nlibs,
+					      sizeof (cache_new->libs[0]),
+					      key, &matched, &last);
+      TEST_COMPARE (index, expected);
+      if (first)
+	TEST_COMPARE (index, i);
+    }
+  uint32_t used = 0;
+  for (uint32_t i = 0; i < hash->nbuckets; i++)
+    used += hash->buckets[i].index != cache_name_hash_empty;
+  TEST_COMPARE (used, keys);
+  TEST_VERIFY (hash->nbuckets - used >= hash->nbuckets / 4);
+
+  /* Look up the names with the cache written by ldconfig.  */
+  char *expected[NUM_NAMES];
+  lookup_all (expected);
+  for (int i = 0; i < NUM_NAMES; i++)
+    if (strstr (names[i], "missing") != NULL)
+      TEST_VERIFY (expected[i] == NULL);
+    else if (expected[i] == NULL)
+      FAIL ("%s not found", names[i]);
+  TEST_VERIFY (expected[2] != NULL && is_file (expected[2],
+					       "libnamehash.so.01"));
+  TEST_VERIFY (expected[3] != NULL && is_file (expected[3],
+					       "libnamehash.so.01"));
+  TEST_VERIFY (expected[4] != NULL && is_file (expected[4],
+					       "libnamehash.so.01"));
+  TEST_VERIFY (expected[5] != NULL && is_file (expected[5],
+					       "libnamehash.so.10"));
+
+  /* Find the section in the extension directory.  */
+  const struct cache_extension *ext
+    = (const void *) (cache_data + cache_new->extension_offset);
+  uint32_t section = 0;
+  while (ext->sections[section].tag != cache_extension_tag_name_hash)
+    ++section;
+  size_t tag_offset = ((const char *) &ext->sections[section].tag
+		       - cache_data);
+  size_t hash_offset = ext->sections[section].offset;
+  char *copy = xmalloc (cache_size);
+
+  /* Without the section, the dynamic loader searches the entries.  */
+  memcpy (copy, cache_data, cache_size);
+  *(uint32_t *) (copy + tag_offset) = cache_extension_count;
+  check_cache ("binary search", copy, expected, true);
+
+  /* An invalid section is ignored.  */
+  memcpy (copy, cache_data, cache_size);
+  ((struct cache_name_hash *) (copy + hash_offset))->nbuckets = 3;
+  check_cache ("invalid bucket count", copy, expected, true);
+
+  /* Corrupt buckets may make lookups fail, but they must not find
+     other files.  */
+  memcpy (copy, cache_data, cache_size);
+  struct cache_name_hash *corrupt = (void *) (copy + hash_offset);
+  for (uint32_t i = 0; i < corrupt->nbuckets; i++)
+    if (corrupt->buckets[i].index != cache_name_hash_empty)
+      corrupt->buckets[i].index += cache_new->nlibs;
+  check_cache ("out-of-range indices", copy, expected, false);
+
+  memcpy (copy, cache_data, cache_size);
+  for (uint32_t i = 0; i < corrupt->nbuckets; i++)
+    if (corrupt->buckets[i].index != cache_name_hash_empty)
+      corrupt->buckets[i].index
+	= (corrupt->buckets[i].index + 1) % cache_new->nlibs;
+  check_cache ("shifted indices", copy, expected, false);
+
+  memcpy (copy, cache_data, cache_size);
+  for (uint32_t i = 0; i < corrupt->nbuckets; i++)
+    corrupt->buckets[i].index = 0;
+  check_cache ("no empty buckets", copy, expected, false);
+
+  /* The original cache works again.  */
+  check_cache ("restored cache", cache_data, expected, true);
+
+  free (copy);
+  free_all (expected);
+  for (int i = 0; i < NUM_NAMES; i++)
+    free (names[i]);
+  free (cache_data);
+  free (cache_path);
+  return 0;
+}
+
+#include <support/test-driver.c>
@@ -0,0 +1,132 @@
+/* Test the relocation cache selected with LD_RELOC_CACHE.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <gnu/lib-names.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <support/capture_subprocess.h>
+#include <support/check.h>
+#include <support/support.h>
+#include <support/temp_file.h>
+#include <support/xunistd.h>
+#include <sys/stat.h>
+
+static int restart;
+#define CMDLINE_OPTIONS \
+  { "restart", no_argument, &restart, 1 },
+
+static int
+handle_restart (void)
+{
+  /* The relocations of the program have to be correct whether or not
+     they came from the cache.  */
+  char *s = xasprintf ("%s %d", "restarted", (int) strlen ("restart"));
+  TEST_COMPARE_STRING (s, "restarted 7");
+  free (s);
+  /* The programs run from this one must not see the cache.  */
+  TEST_VERIFY (getenv ("LD_RELOC_CACHE") == NULL);
+  puts ("child done");
+  return 0;
+}
+
+static char **spargv;
+
+/* Run the program again and return true if it used the cache.  */
+static bool
+run (void)
+{
+  struct support_capture_subprocess result
+    = support_capture_subprogram (spargv[0], spargv, NULL);
+  support_capture_subprocess_check (&result, "tst-reloc-cache", 0,
+				    sc_allow_stdout | sc_allow_stderr);
+  TEST_COMPARE_STRING (result.out.buffer, "child done\n");
+  bool used = (result.err.buffer != NULL
+	       && strstr (result.err.buffer, "using relocation cache")
+		  != NULL);
+  support_capture_subprocess_free (&result);
+  return used;
+}
+
+static int
+do_test (int argc, char *argv[])
+{
+  /* The remaining arguments are the command to run the program with:
+     optionally ld.so, "--library-path" and the library path, and the
+     path of the program.  */
+  if (restart)
+    return handle_restart ();
+
+  spargv = xcalloc (argc + 2, sizeof (char *));
+  int i = 0;
+  for (; i < argc - 1; i++)
+    spargv[i] = argv[i + 1];
+  spargv[i++] = (char *) "--direct";
+  spargv[i++] = (char *) "--restart";
+  spargv[i] = NULL;
+
+  char *dir = support_create_temp_directory ("tst-reloc-cache-");
+  char *path = xasprintf ("%s/cache", dir);
+  add_temp_file (path);
+
+  setenv ("LD_RELOC_CACHE", path, 1);
+  setenv ("LD_BIND_NOW", "1", 1);
+  setenv ("LD_DEBUG", "reloc", 1);
+
+  /* The first run creates the cache, the second one uses it.  */
+  TEST_VERIFY (!run ());
+  struct stat64 st;
+  TEST_COMPARE (stat64 (path, &st), 0);
+  TEST_VERIFY (st.st_size > 0);
+  TEST_VERIFY (run ());
+
+  /* A damaged cache is ignored and replaced.  */
+  int fd = xopen (path, O_WRONLY, 0);
+  xwrite (fd, "damaged", strlen ("damaged"));
+  xclose (fd);
+  TEST_VERIFY (!run ());
+  TEST_VERIFY (run ());
+
+  /* So is a cache for another set of objects.  */
+  setenv ("LD_PRELOAD", LIBM_SO, 1);
+  TEST_VERIFY (!run ());
+  TEST_VERIFY (run ());
+  unsetenv ("LD_PRELOAD");
+  TEST_VERIFY (!run ());
+
+  /* A name which does not fit in PATH_MAX is not used.  */
+  char *long_path = xmalloc (PATH_MAX + 1);
+  memset (long_path, 'x', PATH_MAX);
+  long_path[PATH_MAX] = '\0';
+  setenv ("LD_RELOC_CACHE", long_path, 1);
+  TEST_VERIFY (!run ());
+  TEST_VERIFY (!run ());
+  free (long_path);
+
+  free (path);
+  free (dir);
+  free (spargv);
+  return 0;
+}
+
+#define TEST_FUNCTION_ARGV do_test
+#include <support/test-driver.c>
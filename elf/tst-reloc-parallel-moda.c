@@ -0,0 +1,33 @@
+/* Module depending on several others for tst-reloc-parallel.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include "tst-reloc-parallel.h"
+
+int
+reloc_parallel_a (void)
+{
+  return 100 + reloc_parallel_b () + reloc_parallel_d ();
+}
+
+int (*const reloc_parallel_a_table[]) (void) =
+  {
+    reloc_parallel_b,
+    reloc_parallel_b_indirect,
+    reloc_parallel_d,
+    reloc_parallel_tls_value_c,
+  };
@@ -0,0 +1,38 @@
+/* Module depending on tst-reloc-parallel-modc for tst-reloc-parallel.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include "tst-reloc-parallel.h"
+
+int
+reloc_parallel_b (void)
+{
+  return 20 + reloc_parallel_c_ptr ();
+}
+
+/* Relocated against the dependency, which has to be relocated before
+   this object for the pointer read through it to be valid.  */
+int (*const *const reloc_parallel_b_table[]) (void) =
+  {
+    &reloc_parallel_c_ptr,
+  };
+
+int
+reloc_parallel_b_indirect (void)
+{
+  return (*reloc_parallel_b_table[0]) ();
+}
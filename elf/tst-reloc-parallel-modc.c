@@ -0,0 +1,36 @@
+/* Module without dependencies for tst-reloc-parallel.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include "tst-reloc-parallel.h"
+
+__thread int reloc_parallel_tls_c = 3;
+
+int
+reloc_parallel_c (void)
+{
+  return 3;
+}
+
+/* Needs relocation, against a symbol of this object.  */
+int (*const reloc_parallel_c_ptr) (void) = reloc_parallel_c;
+
+int
+reloc_parallel_tls_value_c (void)
+{
+  return reloc_parallel_tls_c;
+}
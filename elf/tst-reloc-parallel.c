@@ -0,0 +1,58 @@
+/* Test relocation of startup objects on helper threads.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* The test is run with glibc.rtld.parallel_relocation set, so that the
+   modules without IFUNC symbols are relocated on helper threads, with
+   tst-reloc-parallel-modb after tst-reloc-parallel-modc and
+   tst-reloc-parallel-moda after both of them.  libc and its
+   dependencies are relocated first, on the main thread.  */
+
+#include <string.h>
+#include <support/check.h>
+
+#include "tst-reloc-parallel.h"
+
+static int
+do_test (void)
+{
+  TEST_COMPARE (reloc_parallel_c (), 3);
+  TEST_COMPARE (reloc_parallel_c_ptr (), 3);
+  TEST_COMPARE (reloc_parallel_b (), 23);
+  TEST_COMPARE (reloc_parallel_b_indirect (), 3);
+  TEST_COMPARE (reloc_parallel_d (), 4);
+  TEST_COMPARE (reloc_parallel_a (), 127);
+
+  TEST_COMPARE (reloc_parallel_a_table[0] (), 23);
+  TEST_COMPARE (reloc_parallel_a_table[1] (), 3);
+  TEST_COMPARE (reloc_parallel_a_table[2] (), 4);
+  TEST_COMPARE (reloc_parallel_a_table[3] (), 3);
+
+  /* Static TLS of the modules, accessed from the main program.  */
+  TEST_COMPARE (reloc_parallel_tls_c, 3);
+  TEST_COMPARE (reloc_parallel_tls_d, 4);
+  reloc_parallel_tls_c = 5;
+  TEST_COMPARE (reloc_parallel_tls_value_c (), 5);
+
+  /* libc is relocated serially, since it defines IFUNC symbols.  */
+  char buf[16];
+  TEST_COMPARE (strlen (strcpy (buf, "parallel")), 8);
+
+  return 0;
+}
+
+#include <support/test-driver.c>
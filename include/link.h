@@ -293,7 +293,8 @@ struct link_map
     ElfW(Word) l_flags_1;
     ElfW(Word) l_flags;
 
-    /* Temporarily used in `dl_close'.  */
+    /* Temporarily used in `dl_close', when saving the relocation
+       cache and during parallel relocation at startup.  */
     int l_idx;
 
     struct link_map_machine l_mach;
@@ -332,6 +333,10 @@ struct link_map
 #endif
     /* For objects present at startup time: offset in the static TLS block.  */
     ptrdiff_t l_tls_offset;
+    /* Nonzero once the static TLS block at l_tls_offset has been
+       initialized in all threads.  Stored with release MO, so that
+       __tls_get_addr can use the block without GL(dl_load_tls_lock).  */
+    int l_tls_static_initialized;
     /* Index of the module in the dtv array.  */
     size_t l_tls_modid;
 
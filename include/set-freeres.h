@@ -78,6 +78,11 @@ extern void __nss_database_freeres (void) attribute_hidden;
 extern int _IO_cleanup (void) attribute_hidden;;
 /* From dlfcn/dlerror.c */
 extern void __libc_dlerror_result_free (void) attribute_hidden;
+/* From misc/syslog.c */
+extern void __syslog_thread_freeres (void) attribute_hidden;
+extern void __syslog_flush_at_exit (void) attribute_hidden;
+/* From stdlib/arc4random.c */
+extern void __arc4random_thread_freeres (void) attribute_hidden;
 
 /* From either libc.so or libpthread.so  */
 extern void __libpthread_freeres (void) attribute_hidden;
@@ -16,5 +16,9 @@ extern void __vsyslog_internal (int pri, const char *fmt, __gnuc_va_list ap,
 
 libc_hidden_ldbl_proto (__syslog_chk)
 
+/* Reset the state of the asynchronous logd path in the child after
+   fork.  */
+extern void __syslog_fork_subprocess (void) attribute_hidden;
+
 #endif /* _ISOMAC */
 #endif /* syslog.h */
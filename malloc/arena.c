@@ -17,6 +17,8 @@
    not, see <https://www.gnu.org/licenses/>.  */
 
 #include <stdbool.h>
+#include <getcpu-cache.h>
+#include <malloc-numa.h>
 #include <setvmaname.h>
 
 #define TUNABLE_NAMESPACE malloc
@@ -126,6 +128,12 @@ static bool __malloc_initialized = false;
    is just a hint as to how much memory will be required immediately
    in the new arena. */
 
+/* Lock arena PTR and count the acquisition for malloc_info.  */
+#define arena_mutex_lock(ptr) do {					      \
+      __libc_lock_lock ((ptr)->mutex);					      \
+      ++(ptr)->lock_count;						      \
+  } while (0)
+
 #define arena_get(ptr, size) do { \
       ptr = thread_arena;						      \
       arena_lock (ptr, size);						      \
@@ -133,7 +141,7 @@ static bool __malloc_initialized = false;
 
 #define arena_lock(ptr, size) do {					      \
       if (ptr)								      \
-        __libc_lock_lock (ptr->mutex);					      \
+        arena_mutex_lock (ptr);						      \
       else								      \
         ptr = arena_get2 ((size), NULL);				      \
   } while (0)
@@ -182,6 +190,9 @@ __malloc_fork_lock_parent (void)
       if (ar_ptr == &main_arena)
         break;
     }
+
+  slab_fork_lock_parent ();
+  mmap_cache_fork_lock_parent ();
 }
 
 void
@@ -190,6 +201,9 @@ __malloc_fork_unlock_parent (void)
   if (!__malloc_initialized)
     return;
 
+  mmap_cache_fork_unlock_parent ();
+  slab_fork_unlock_parent ();
+
   for (mstate ar_ptr = &main_arena;; )
     {
       __libc_lock_unlock (ar_ptr->mutex);
@@ -228,6 +242,9 @@ __malloc_fork_unlock_child (void)
     }
 
   __libc_lock_init (list_lock);
+  slab_fork_unlock_child ();
+  mmap_cache_fork_unlock_child ();
+  malloc_decay_fork_child ();
 }
 
 #define TUNABLE_CALLBACK_FNDECL(__name, __type) \
@@ -250,9 +267,17 @@ TUNABLE_CALLBACK_FNDECL (set_arena_test, size_t)
 TUNABLE_CALLBACK_FNDECL (set_tcache_max, size_t)
 TUNABLE_CALLBACK_FNDECL (set_tcache_count, size_t)
 TUNABLE_CALLBACK_FNDECL (set_tcache_unsorted_limit, size_t)
+TUNABLE_CALLBACK_FNDECL (set_tcache_batch, size_t)
 #endif
 TUNABLE_CALLBACK_FNDECL (set_mxfast, size_t)
 TUNABLE_CALLBACK_FNDECL (set_hugetlb, size_t)
+TUNABLE_CALLBACK_FNDECL (set_slab, int32_t)
+TUNABLE_CALLBACK_FNDECL (set_decay_ms, size_t)
+TUNABLE_CALLBACK_FNDECL (set_mmap_cache_size, size_t)
+TUNABLE_CALLBACK_FNDECL (set_mmap_cache_ttl_ms, size_t)
+TUNABLE_CALLBACK_FNDECL (set_numa, int32_t)
+TUNABLE_CALLBACK_FNDECL (set_deferred_free, size_t)
+TUNABLE_CALLBACK_FNDECL (set_stats, int32_t)
 
 #if USE_TCACHE
 static void tcache_key_initialize (void);
@@ -309,9 +334,19 @@ ptmalloc_init (void)
   TUNABLE_GET (tcache_count, size_t, TUNABLE_CALLBACK (set_tcache_count));
   TUNABLE_GET (tcache_unsorted_limit, size_t,
 	       TUNABLE_CALLBACK (set_tcache_unsorted_limit));
+  TUNABLE_GET (tcache_batch, size_t, TUNABLE_CALLBACK (set_tcache_batch));
 # endif
   TUNABLE_GET (mxfast, size_t, TUNABLE_CALLBACK (set_mxfast));
   TUNABLE_GET (hugetlb, size_t, TUNABLE_CALLBACK (set_hugetlb));
+  TUNABLE_GET (slab, int32_t, TUNABLE_CALLBACK (set_slab));
+  TUNABLE_GET (decay_ms, size_t, TUNABLE_CALLBACK (set_decay_ms));
+  TUNABLE_GET (mmap_cache_size, size_t,
+	       TUNABLE_CALLBACK (set_mmap_cache_size));
+  TUNABLE_GET (mmap_cache_ttl_ms, size_t,
+	       TUNABLE_CALLBACK (set_mmap_cache_ttl_ms));
+  TUNABLE_GET (numa, int32_t, TUNABLE_CALLBACK (set_numa));
+  TUNABLE_GET (deferred_free, size_t, TUNABLE_CALLBACK (set_deferred_free));
+  TUNABLE_GET (stats, int32_t, TUNABLE_CALLBACK (set_stats));
 
   if (mp_.hp_pagesize > 0)
     {
@@ -371,12 +406,21 @@ dump_heap (heap_info *heap)
    multiple threads, but only one will succeed.  */
 static char *aligned_heap_area;
 
+/* Return the NUMA node the heaps of arena AV are placed on, or -1.
+   Arenas of emulated nodes are not bound.  */
+static inline int
+arena_bind_node (mstate av)
+{
+  return mp_.numa_bind ? av->node : -1;
+}
+
 /* Create a new heap.  size is automatically rounded up to a multiple
-   of the page size. */
+   of the page size.  If node is not negative, the pages of the heap
+   are placed on that NUMA node.  */
 
 static heap_info *
 alloc_new_heap  (size_t size, size_t top_pad, size_t pagesize,
-		 int mmap_flags)
+		 int mmap_flags, int node)
 {
   char *p1, *p2;
   unsigned long ul;
@@ -438,6 +482,10 @@ alloc_new_heap  (size_t size, size_t top_pad, size_t pagesize,
             }
         }
     }
+  /* Set the policy before the heap header is written, which faults in
+     the first page.  */
+  if (node >= 0)
+    __malloc_numa_bind (p2, max_size, node);
   if (__mprotect (p2, size, mtag_mmap_flags | PROT_READ | PROT_WRITE) != 0)
     {
       __munmap (p2, max_size);
@@ -458,16 +506,29 @@ alloc_new_heap  (size_t size, size_t top_pad, size_t pagesize,
 }
 
 static heap_info *
-new_heap (size_t size, size_t top_pad)
+new_heap (size_t size, size_t top_pad, int node)
 {
   if (__glibc_unlikely (mp_.hp_pagesize != 0))
     {
       heap_info *h = alloc_new_heap (size, top_pad, mp_.hp_pagesize,
-				     mp_.hp_flags);
+				     mp_.hp_flags, node);
+      if (h != NULL)
+	return h;
+    }
+  /* With transparent huge pages, use the huge page size as the page size
+     of the heap, so that it is grown and trimmed in whole huge pages and
+     khugepaged does not have to collapse or split them.  The heap itself
+     is aligned to its maximum size, which is then a multiple of the huge
+     page size.  */
+  else if (__glibc_unlikely (mp_.thp_pagesize != 0
+			     && mp_.thp_pagesize <= heap_max_size ()))
+    {
+      heap_info *h = alloc_new_heap (size, top_pad, mp_.thp_pagesize, 0,
+				     node);
       if (h != NULL)
 	return h;
     }
-  return alloc_new_heap (size, top_pad, GLRO (dl_pagesize), 0);
+  return alloc_new_heap (size, top_pad, GLRO (dl_pagesize), 0, node);
 }
 
 /* Grow a heap.  size is automatically rounded up to a
@@ -492,6 +553,8 @@ grow_heap (heap_info *h, long diff)
                       mtag_mmap_flags | PROT_READ | PROT_WRITE) != 0)
         return -2;
 
+      madvise_thp ((char *) h + h->mprotect_size,
+		   (unsigned long) new_size - h->mprotect_size);
       h->mprotect_size = new_size;
     }
 
@@ -515,9 +578,16 @@ shrink_heap (heap_info *h, long diff)
      inaccessible.  See malloc-sysdep.h to know when this is true.  */
   if (__glibc_unlikely (check_may_shrink_heap ()))
     {
+      /* Keep heaps that use MAP_HUGETLB backed by huge pages.  */
+      int mmap_flags = (mp_.hp_pagesize != 0
+			&& h->pagesize == mp_.hp_pagesize) ? mp_.hp_flags : 0;
       if ((char *) MMAP ((char *) h + new_size, diff, PROT_NONE,
-                         MAP_FIXED) == (char *) MAP_FAILED)
+                         MAP_FIXED | mmap_flags) == (char *) MAP_FAILED)
         return -2;
+      /* The new mapping does not inherit the NUMA policy.  */
+      if (arena_bind_node (h->ar_ptr) >= 0)
+	__malloc_numa_bind ((char *) h + new_size, diff,
+			    arena_bind_node (h->ar_ptr));
 
       h->mprotect_size = new_size;
     }
@@ -627,6 +697,20 @@ detach_arena (mstate replaced_arena)
     }
 }
 
+/* Return the NUMA node of the calling thread, or -1 if it is not known
+   or the glibc.malloc.numa tunable is not set.  Emulated nodes take the
+   CPUs in turn.  */
+static int
+arena_numa_node (void)
+{
+  if (mp_.numa_nodes == 0)
+    return -1;
+  if (mp_.numa_bind)
+    return __malloc_numa_node ();
+  int cpu = __getcpu_cached ();
+  return cpu < 0 ? -1 : cpu % mp_.numa_nodes;
+}
+
 static mstate
 _int_new_arena (size_t size)
 {
@@ -634,20 +718,25 @@ _int_new_arena (size_t size)
   heap_info *h;
   char *ptr;
   unsigned long misalign;
+  int node = arena_numa_node ();
+  /* Only real nodes have memory to bind to.  */
+  int bind_node = mp_.numa_bind ? node : -1;
 
   h = new_heap (size + (sizeof (*h) + sizeof (*a) + MALLOC_ALIGNMENT),
-                mp_.top_pad);
+                mp_.top_pad, bind_node);
   if (!h)
     {
       /* Maybe size is too large to fit in a single heap.  So, just try
          to create a minimally-sized arena and let _int_malloc() attempt
          to deal with the large request via mmap_chunk().  */
-      h = new_heap (sizeof (*h) + sizeof (*a) + MALLOC_ALIGNMENT, mp_.top_pad);
+      h = new_heap (sizeof (*h) + sizeof (*a) + MALLOC_ALIGNMENT, mp_.top_pad,
+		    bind_node);
       if (!h)
         return 0;
     }
   a = h->ar_ptr = (mstate) (h + 1);
   malloc_init_state (a);
+  a->node = node;
   a->attached_threads = 1;
   /*a->next = NULL;*/
   a->system_mem = a->max_system_mem = h->size;
@@ -691,13 +780,14 @@ _int_new_arena (size_t size)
      but this could result in a deadlock with
      __malloc_fork_lock_parent.  */
 
-  __libc_lock_lock (a->mutex);
+  arena_mutex_lock (a);
 
   return a;
 }
 
 
-/* Remove an arena from free_list.  */
+/* Remove an arena from free_list.  With NUMA nodes, only an arena of
+   the node of the calling thread is taken.  */
 static mstate
 get_free_list (void)
 {
@@ -705,11 +795,18 @@ get_free_list (void)
   mstate result = free_list;
   if (result != NULL)
     {
+      int node = arena_numa_node ();
+      mstate *previous = &free_list;
       __libc_lock_lock (free_list_lock);
-      result = free_list;
+      for (result = free_list; result != NULL; result = result->next_free)
+	{
+	  if (node < 0 || result->node == node)
+	    break;
+	  previous = &result->next_free;
+	}
       if (result != NULL)
 	{
-	  free_list = result->next_free;
+	  *previous = result->next_free;
 
 	  /* The arena will be attached to this thread.  */
 	  assert (result->attached_threads == 0);
@@ -722,7 +819,7 @@ get_free_list (void)
       if (result != NULL)
         {
           LIBC_PROBE (memory_arena_reuse_free_list, 1, result);
-          __libc_lock_lock (result->mutex);
+          arena_mutex_lock (result);
 	  thread_arena = result;
         }
     }
@@ -762,6 +859,50 @@ reused_arena (mstate avoid_arena)
   if (next_to_use == NULL)
     next_to_use = &main_arena;
 
+  /* With the CPU number cache enabled, prefer the arena that threads
+     on the current CPU share, so that threads running on the same CPU
+     tend to allocate from the same arena.  Otherwise keep going round
+     the arenas.  */
+  int cpu = __getcpu_cache_enabled () ? __getcpu_cached () : -1;
+  if (cpu >= 0)
+    {
+      next_to_use = &main_arena;
+      for (size_t i = cpu % narenas; i > 0; --i)
+        next_to_use = next_to_use->next;
+    }
+
+  /* With NUMA nodes, try the arenas of the node of the calling thread
+     first, and wait for one of them if they are all busy.  Arenas of
+     other nodes are only used if the node has none.  */
+  int node = arena_numa_node ();
+  if (node >= 0)
+    {
+      mstate local = NULL;
+      result = next_to_use;
+      do
+	{
+	  if (result->node == node)
+	    {
+	      if (!__libc_lock_trylock (result->mutex))
+		goto out;
+	      if (local == NULL && result != avoid_arena)
+		local = result;
+	    }
+	  /* FIXME: This is a data race, see _int_new_arena.  */
+	  result = result->next;
+	}
+      while (result != next_to_use);
+
+      if (local != NULL)
+	{
+	  result = local;
+	  LIBC_PROBE (memory_arena_reuse_wait, 3, &result->mutex, result,
+		      avoid_arena);
+	  __libc_lock_lock (result->mutex);
+	  goto out;
+	}
+    }
+
   /* Iterate over all arenas (including those linked from
      free_list).  */
   result = next_to_use;
@@ -785,6 +926,8 @@ reused_arena (mstate avoid_arena)
   __libc_lock_lock (result->mutex);
 
 out:
+  ++result->lock_count;
+
   /* Attach the arena to the current thread.  */
   {
     /* Update the arena thread attachment counters.   */
@@ -876,7 +1019,7 @@ arena_get_retry (mstate ar_ptr, size_t bytes)
     {
       __libc_lock_unlock (ar_ptr->mutex);
       ar_ptr = &main_arena;
-      __libc_lock_lock (ar_ptr->mutex);
+      arena_mutex_lock (ar_ptr);
     }
   else
     {
@@ -895,6 +1038,7 @@ __malloc_arena_thread_freeres (void)
      the thread arena, so do this before we put the arena on the free
      list.  */
   tcache_thread_shutdown ();
+  slab_thread_shutdown ();
 
   mstate a = thread_arena;
   thread_arena = NULL;
@@ -257,6 +257,12 @@
 #include <sys/random.h>
 #include <not-cancel.h>
 
+#if IS_IN (libc)
+/* For the decay thread.  */
+# include <futex-internal.h>
+# include <pthreadP.h>
+#endif
+
 /*
   Debugging:
 
@@ -1048,6 +1054,12 @@ libc_hidden_proto (__libc_mallopt)
   a size the application uses for transient allocations. This estimator
   is there to satisfy the new third requirement.
 
+  The glibc.malloc.mmap_cache_size tunable keeps the mappings of freed
+  mmapped chunks for reuse instead.  Transient large allocations then
+  cost neither a system call nor the zeroing of fresh pages, so the
+  threshold stays where it is and large chunks do not fragment the
+  heaps.
+
 */
 
 #define M_MMAP_THRESHOLD      -3
@@ -1056,6 +1068,12 @@ libc_hidden_proto (__libc_mallopt)
 #define DEFAULT_MMAP_THRESHOLD DEFAULT_MMAP_THRESHOLD_MIN
 #endif
 
+/* Cached mappings of freed mmapped chunks are unmapped after this many
+   milliseconds.  */
+#ifndef DEFAULT_MMAP_CACHE_TTL_MS
+#define DEFAULT_MMAP_CACHE_TTL_MS 1000
+#endif
+
 /*
   M_MMAP_MAX is the maximum number of requests to simultaneously
   service using mmap. This parameter exists because
@@ -1092,11 +1110,14 @@ static INTERNAL_SIZE_T _int_free_create_chunk (mstate,
 					       mchunkptr, INTERNAL_SIZE_T,
 					       mchunkptr, INTERNAL_SIZE_T);
 static void _int_free_maybe_consolidate (mstate, INTERNAL_SIZE_T);
+static void free_pending_push (mstate, mchunkptr);
+static void free_pending_drain (mstate, size_t);
 static void*  _int_realloc(mstate, mchunkptr, INTERNAL_SIZE_T,
 			   INTERNAL_SIZE_T);
 static void*  _int_memalign(mstate, size_t, size_t);
 #if IS_IN (libc)
 static void*  _mid_memalign(size_t, size_t, void *);
+static void malloc_decay_start (void);
 #endif
 
 static void malloc_printerr(const char *str) __attribute__ ((noreturn));
@@ -1108,6 +1129,9 @@ static mchunkptr mremap_chunk(mchunkptr p, size_t new_size);
 
 static size_t musable (void *mem);
 
+static void malloc_decay_wake (void);
+static void malloc_decay_fork_child (void);
+
 /* ------------------ MMAP support ------------------  */
 
 
@@ -1798,6 +1822,17 @@ get_max_fast (void)
    ----------- Internal state representation and initialization -----------
  */
 
+/* Allocation counters of one size class in an arena.  */
+struct malloc_class_counters
+{
+  /* Requests handled by the arena, and how many of them were split
+     from the top chunk or passed on to sysmalloc.  */
+  size_t requests;
+  size_t top;
+  /* Chunks moved to the thread cache.  */
+  size_t tcache_refills;
+};
+
 /*
    have_fastchunks indicates that there are probably some fastbin chunks.
    It is set true on entering a chunk into any fastbin, and cleared early in
@@ -1824,6 +1859,10 @@ struct malloc_state
   /* Fastbins */
   mfastbinptr fastbinsY[NFASTBINS];
 
+  /* Chunks freed but not coalesced yet, linked like fastbin chunks.
+     Only used with the glibc.malloc.deferred_free tunable.  */
+  mchunkptr free_pending;
+
   /* Base of the topmost chunk -- not otherwise kept in a bin */
   mchunkptr top;
 
@@ -1851,6 +1890,27 @@ struct malloc_state
   /* Memory allocated from the system in this arena.  */
   INTERNAL_SIZE_T system_mem;
   INTERNAL_SIZE_T max_system_mem;
+
+  /* Number of times the lock was acquired to allocate or free memory.
+     Only updated with the lock held.  */
+  INTERNAL_SIZE_T lock_count;
+
+  /* Allocation counters, indexed like the bins.  Only updated with
+     the lock held, but read without it by malloc_stats_snapshot.  */
+  struct malloc_class_counters class_stats[NBINS];
+
+  /* Number of fastbin consolidations, and the time spent in them.  */
+  size_t consolidations;
+  size_t consolidation_ns;
+
+  /* Position of the decay thread in the bins, and number of passes it
+     has completed over them.  */
+  int decay_pos;
+  size_t decay_pass;
+
+  /* NUMA node of the threads this arena was created for, or -1.  See
+     the glibc.malloc.numa tunable.  */
+  int node;
 };
 
 struct malloc_par
@@ -1881,10 +1941,35 @@ struct malloc_par
   /* Statistics */
   INTERNAL_SIZE_T mmapped_mem;
   INTERNAL_SIZE_T max_mmapped_mem;
+  /* Number of chunks mmapped and munmapped so far.  */
+  size_t mmap_count;
+  size_t munmap_count;
+  /* Nonzero if the counters read by malloc_stats_snapshot are kept.  */
+  int stats;
 
   /* First address handed out by MORECORE/sbrk.  */
   char *sbrk_base;
 
+  /* Free memory is returned to the system after about this many
+     milliseconds.  Zero disables the decay thread.  */
+  size_t decay_ms;
+
+  /* Freed mmapped chunks are cached for reuse, up to this many bytes in
+     total and for at most mmap_cache_ttl_ms milliseconds.  Zero disables
+     the cache.  */
+  size_t mmap_cache_size;
+  size_t mmap_cache_ttl_ms;
+
+  /* Number of pending chunks coalesced per allocation, zero if free
+     coalesces chunks right away.  */
+  size_t deferred_free;
+
+  /* Number of NUMA nodes that arenas are assigned to, zero if arenas
+     are shared regardless of the node.  numa_bind is false if the
+     nodes are emulated and have no memory of their own.  */
+  int numa_nodes;
+  bool numa_bind;
+
 #if USE_TCACHE
   /* Maximum number of buckets to use.  */
   size_t tcache_bins;
@@ -1894,6 +1979,9 @@ struct malloc_par
   /* Maximum number of chunks to remove from the unsorted list, which
      aren't used to prefill the cache.  */
   size_t tcache_unsorted_limit;
+  /* Number of chunks moved between a bucket and the arena under one
+     lock acquisition.  Zero or one disables batching.  */
+  size_t tcache_batch;
 #endif
 };
 
@@ -1918,6 +2006,7 @@ static struct malloc_par mp_ =
   .n_mmaps_max = DEFAULT_MMAP_MAX,
   .mmap_threshold = DEFAULT_MMAP_THRESHOLD,
   .trim_threshold = DEFAULT_TRIM_THRESHOLD,
+  .mmap_cache_ttl_ms = DEFAULT_MMAP_CACHE_TTL_MS,
 #define NARENAS_FROM_NCORES(n) ((n) * (sizeof (long) == 4 ? 2 : 8))
   .arena_test = NARENAS_FROM_NCORES (1)
 #if USE_TCACHE
@@ -1925,10 +2014,20 @@ static struct malloc_par mp_ =
   .tcache_count = TCACHE_FILL_COUNT,
   .tcache_bins = TCACHE_MAX_BINS,
   .tcache_max_bytes = tidx2usize (TCACHE_MAX_BINS-1),
-  .tcache_unsorted_limit = 0 /* No limit.  */
+  .tcache_unsorted_limit = 0, /* No limit.  */
+  .tcache_batch = 0
 #endif
 };
 
+/* Add N to COUNTER, which is only written with the arena lock held
+   but can be read without it.  */
+static __always_inline void
+stats_add (size_t *counter, size_t n)
+{
+  if (mp_.stats)
+    atomic_store_relaxed (counter, atomic_load_relaxed (counter) + n);
+}
+
 /*
    Initialize a malloc_state struct.
 
@@ -1958,6 +2057,7 @@ malloc_init_state (mstate av)
   atomic_store_relaxed (&av->have_fastchunks, false);
 
   av->top = initial_top (av);
+  av->node = -1;
 }
 
 /*
@@ -2022,6 +2122,8 @@ madvise_thp (void *p, INTERNAL_SIZE_T size)
 }
 
 /* ------------------- Support for multiple arenas -------------------- */
+#include "slab.c"
+#include "mmap-cache.c"
 #include "arena.c"
 
 /*
@@ -2418,18 +2520,28 @@ sysmalloc_mmap (INTERNAL_SIZE_T nb, size_t pagesize, int extra_flags, mstate av)
   if ((unsigned long) (size) <= (unsigned long) (nb))
     return MAP_FAILED;
 
-  char *mm = (char *) MMAP (0, size,
-			    mtag_mmap_flags | PROT_READ | PROT_WRITE,
-			    extra_flags);
-  if (mm == MAP_FAILED)
-    return mm;
+  /* Mappings of huge pages are never cached.  */
+  char *mm = NULL;
+  if (mmap_cache_enabled () && extra_flags == 0)
+    mm = mmap_cache_get (size);
+
+  if (mm == NULL)
+    {
+      mm = (char *) MMAP (0, size,
+			  mtag_mmap_flags | PROT_READ | PROT_WRITE,
+			  extra_flags);
+      if (mm == MAP_FAILED)
+	return mm;
 
 #ifdef MAP_HUGETLB
-  if (!(extra_flags & MAP_HUGETLB))
-    madvise_thp (mm, size);
+      if (!(extra_flags & MAP_HUGETLB))
+	madvise_thp (mm, size);
 #endif
 
-  __set_vma_name (mm, size, " glibc: malloc");
+      __set_vma_name (mm, size, " glibc: malloc");
+      if (mp_.stats)
+	atomic_fetch_add_relaxed (&mp_.mmap_count, 1);
+    }
 
   /*
     The offset to the start of the mmapped region is stored in the prev_size
@@ -2620,7 +2732,8 @@ sysmalloc (INTERNAL_SIZE_T nb, mstate av)
           set_head (old_top, (((char *) old_heap + old_heap->size) - (char *) old_top)
                     | PREV_INUSE);
         }
-      else if ((heap = new_heap (nb + (MINSIZE + sizeof (*heap)), mp_.top_pad)))
+      else if ((heap = new_heap (nb + (MINSIZE + sizeof (*heap)), mp_.top_pad,
+				 arena_bind_node (av))))
         {
           /* Use a newly allocated heap.  */
           heap->ar_ptr = av;
@@ -3042,6 +3155,13 @@ munmap_chunk (mchunkptr p)
   atomic_fetch_add_relaxed (&mp_.n_mmaps, -1);
   atomic_fetch_add_relaxed (&mp_.mmapped_mem, -total_size);
 
+  if (mmap_cache_enabled () && mp_.hp_pagesize == 0
+      && mmap_cache_put ((void *) block, total_size))
+    return;
+
+  if (mp_.stats)
+    atomic_fetch_add_relaxed (&mp_.munmap_count, 1);
+
   /* If munmap failed the process virtual memory address space is in a
      bad shape.  Just leave the block hanging around, the process will
      terminate shortly anyway since not much can be done.  */
@@ -3119,11 +3239,53 @@ typedef struct tcache_perthread_struct
 {
   uint16_t counts[TCACHE_MAX_BINS];
   tcache_entry *entries[TCACHE_MAX_BINS];
+  /* Requests that found a chunk in each bucket, or found it empty,
+     since the counters were last added to the process-wide totals.  */
+  uint16_t hits[TCACHE_MAX_BINS];
+  uint16_t misses[TCACHE_MAX_BINS];
+  uint16_t stats_pending;
 } tcache_perthread_struct;
 
 static __thread bool tcache_shutting_down = false;
 static __thread tcache_perthread_struct *tcache = NULL;
 
+/* Number of requests counted in a thread cache before the counters
+   are added to the process-wide totals.  Must fit the uint16_t
+   counters.  */
+#define TCACHE_STATS_BATCH 4096
+
+/* Process-wide thread cache counters, read by malloc_stats_snapshot.  */
+static size_t tcache_hits_total[TCACHE_MAX_BINS];
+static size_t tcache_misses_total[TCACHE_MAX_BINS];
+
+/* Add the counters of thread cache TC to the process-wide totals.  */
+static void
+tcache_stats_flush (tcache_perthread_struct *tc)
+{
+  for (size_t i = 0; i < TCACHE_MAX_BINS; ++i)
+    {
+      if (tc->hits[i] != 0)
+	atomic_fetch_add_relaxed (&tcache_hits_total[i], tc->hits[i]);
+      if (tc->misses[i] != 0)
+	atomic_fetch_add_relaxed (&tcache_misses_total[i], tc->misses[i]);
+    }
+  memset (tc->hits, 0, sizeof (tc->hits));
+  memset (tc->misses, 0, sizeof (tc->misses));
+  tc->stats_pending = 0;
+}
+
+/* Count a request for bucket TC_IDX in COUNTERS, which is the hits
+   or misses array of this thread's cache.  */
+static __always_inline void
+tcache_stats_count (uint16_t *counters, size_t tc_idx)
+{
+  if (!mp_.stats)
+    return;
+  ++counters[tc_idx];
+  if (__glibc_unlikely (++tcache->stats_pending == TCACHE_STATS_BATCH))
+    tcache_stats_flush (tcache);
+}
+
 /* Process-wide key to try and catch a double-free in the same thread.  */
 static uintptr_t tcache_key;
 
@@ -3206,6 +3368,44 @@ tcache_next (tcache_entry *e)
   return (tcache_entry *) REVEAL_PTR (e->next);
 }
 
+/* Return up to mp_.tcache_batch chunks of SIZE bytes from the head of
+   bin TC_IDX to arena AV, under a single acquisition of its lock.  Only
+   chunks that belong to AV are taken.  Returns false if there was none,
+   in which case the lock has not been taken.  */
+static bool
+tcache_drain (mstate av, size_t tc_idx, INTERNAL_SIZE_T size)
+{
+  tcache_entry *first = tcache->entries[tc_idx];
+  tcache_entry *e = first;
+  size_t n = 0;
+
+  /* Splice the chunks out of the bin before taking the lock.  */
+  while (n < mp_.tcache_batch && e != NULL
+	 && arena_for_chunk (mem2chunk (e)) == av)
+    {
+      if (__glibc_unlikely (!aligned_OK (e)))
+	malloc_printerr ("free(): unaligned chunk detected in tcache 3");
+      e = tcache_next (e);
+      ++n;
+    }
+  if (n == 0)
+    return false;
+  tcache->entries[tc_idx] = e;
+  tcache->counts[tc_idx] -= n;
+
+  arena_mutex_lock (av);
+  for (e = first; n > 0; --n)
+    {
+      /* Merging overwrites the link.  */
+      tcache_entry *next = tcache_next (e);
+      e->key = 0;
+      _int_free_merge_chunk (av, mem2chunk (e), size);
+      e = next;
+    }
+  __libc_lock_unlock (av->mutex);
+  return true;
+}
+
 static void
 tcache_thread_shutdown (void)
 {
@@ -3220,6 +3420,8 @@ tcache_thread_shutdown (void)
   /* Disable the tcache and prevent it from being reinitialized.  */
   tcache = NULL;
 
+  tcache_stats_flush (tcache_tmp);
+
   /* Free all of the entries and the tcache itself back to the arena
      heap for coalescing.  */
   for (i = 0; i < TCACHE_MAX_BINS; ++i)
@@ -3300,6 +3502,14 @@ __libc_malloc (size_t bytes)
 
   if (!__malloc_initialized)
     ptmalloc_init ();
+
+  if (slab_enabled () && bytes <= SLAB_MAX_SIZE)
+    {
+      victim = slab_malloc (bytes);
+      if (victim != NULL)
+	return victim;
+    }
+
 #if USE_TCACHE
   /* int_free also calls request2size, be careful to not pad twice.  */
   size_t tbytes = checked_request2size (bytes);
@@ -3313,12 +3523,15 @@ __libc_malloc (size_t bytes)
   MAYBE_INIT_TCACHE ();
 
   DIAG_PUSH_NEEDS_COMMENT;
-  if (tc_idx < mp_.tcache_bins
-      && tcache != NULL
-      && tcache->counts[tc_idx] > 0)
+  if (tc_idx < mp_.tcache_bins && tcache != NULL)
     {
-      victim = tcache_get (tc_idx);
-      return tag_new_usable (victim);
+      if (tcache->counts[tc_idx] > 0)
+	{
+	  victim = tcache_get (tc_idx);
+	  tcache_stats_count (tcache->hits, tc_idx);
+	  return tag_new_usable (victim);
+	}
+      tcache_stats_count (tcache->misses, tc_idx);
     }
   DIAG_POP_NEEDS_COMMENT;
 #endif
@@ -3370,13 +3583,22 @@ __libc_free (void *mem)
 
   int err = errno;
 
+  if (slab_contains (mem))
+    {
+      slab_free (mem);
+      __set_errno (err);
+      return;
+    }
+
   p = mem2chunk (mem);
 
   if (chunk_is_mmapped (p))                       /* release mmapped memory. */
     {
       /* See if the dynamic brk/mmap threshold needs adjusting.
-	 Dumped fake mmapped chunks do not affect the threshold.  */
-      if (!mp_.no_dyn_threshold
+	 Dumped fake mmapped chunks do not affect the threshold.  With
+	 the mmap cache, freeing a mapping is cheap, so the threshold is
+	 left alone rather than moving large requests into the heaps.  */
+      if (!mp_.no_dyn_threshold && !mmap_cache_enabled ()
           && chunksize_nomask (p) > mp_.mmap_threshold
           && chunksize_nomask (p) <= DEFAULT_MMAP_THRESHOLD_MAX)
         {
@@ -3396,6 +3618,9 @@ __libc_free (void *mem)
 
       ar_ptr = arena_for_chunk (p);
       _int_free (ar_ptr, p, 0);
+
+      if (__glibc_unlikely (mp_.decay_ms != 0))
+	malloc_decay_start ();
     }
 
   __set_errno (err);
@@ -3429,6 +3654,20 @@ __libc_realloc (void *oldmem, size_t bytes)
   if (__glibc_unlikely (mtag_enabled))
     *(volatile char*) oldmem;
 
+  if (slab_contains (oldmem))
+    {
+      size_t oldsize = slab_usable_size (oldmem);
+      if (bytes <= oldsize)
+	return oldmem;
+      newp = __libc_malloc (bytes);
+      if (newp != NULL)
+	{
+	  memcpy (newp, oldmem, oldsize);
+	  __libc_free (oldmem);
+	}
+      return newp;
+    }
+
   /* chunk corresponding to oldmem */
   const mchunkptr oldp = mem2chunk (oldmem);
 
@@ -3512,7 +3751,7 @@ __libc_realloc (void *oldmem, size_t bytes)
       return newp;
     }
 
-  __libc_lock_lock (ar_ptr->mutex);
+  arena_mutex_lock (ar_ptr);
 
   newp = _int_realloc (ar_ptr, oldp, oldsize, nb);
 
@@ -3717,8 +3956,19 @@ __libc_calloc (size_t n, size_t elem_size)
   if (!__malloc_initialized)
     ptmalloc_init ();
 
+  if (slab_enabled () && sz <= SLAB_MAX_SIZE)
+    {
+      mem = slab_malloc (sz);
+      if (mem != NULL)
+	return memset (mem, 0, sz);
+    }
+
   MAYBE_INIT_TCACHE ();
 
+  /* Set if the chunk is taken from the mmap cache.  */
+  if (mmap_cache_enabled ())
+    mmap_cache_dirty = 0;
+
   if (SINGLE_THREAD_P)
     av = &main_arena;
   else
@@ -3789,6 +4039,11 @@ __libc_calloc (size_t n, size_t elem_size)
       if (__builtin_expect (perturb_byte, 0))
         return memset (mem, 0, sz);
 
+      /* A fresh mapping is zero, and so are the pages that mremap
+	 added to a mapping from the mmap cache.  */
+      if (mmap_cache_dirty != 0)
+	return memset (mem, 0, MIN (sz, mmap_cache_dirty));
+
       return mem;
     }
 
@@ -3892,6 +4147,12 @@ _int_malloc (mstate av, size_t bytes)
       return p;
     }
 
+  struct malloc_class_counters *stats = &av->class_stats[bin_index (nb)];
+  stats_add (&stats->requests, 1);
+
+  if (__glibc_unlikely (mp_.deferred_free != 0))
+    free_pending_drain (av, mp_.deferred_free);
+
   /*
      If the size qualifies as a fastbin, first check corresponding bin.
      This code is safe to execute even if av is not yet initialized, so we
@@ -3956,6 +4217,7 @@ _int_malloc (mstate av, size_t bytes)
 			    break;
 			}
 		      tcache_put (tc_victim, tc_idx);
+		      stats_add (&stats->tcache_refills, 1);
 		    }
 		}
 #endif
@@ -4013,6 +4275,7 @@ _int_malloc (mstate av, size_t bytes)
 		      bck->fd = bin;
 
 		      tcache_put (tc_victim, tc_idx);
+		      stats_add (&stats->tcache_refills, 1);
 	            }
 		}
 	    }
@@ -4037,7 +4300,11 @@ _int_malloc (mstate av, size_t bytes)
   else
     {
       idx = largebin_index (nb);
-      if (atomic_load_relaxed (&av->have_fastchunks))
+      /* With deferred coalescing, do not sweep all fastbins and pending
+	 chunks here.  They are consolidated below if the request cannot
+	 be served otherwise.  */
+      if (atomic_load_relaxed (&av->have_fastchunks)
+	  && mp_.deferred_free == 0)
         malloc_consolidate (av);
     }
 
@@ -4141,6 +4408,7 @@ _int_malloc (mstate av, size_t bytes)
 		  && tcache->counts[tc_idx] < mp_.tcache_count)
 		{
 		  tcache_put (victim, tc_idx);
+		  stats_add (&stats->tcache_refills, 1);
 		  return_cached = 1;
 		  continue;
 		}
@@ -4448,6 +4716,7 @@ _int_malloc (mstate av, size_t bytes)
 
       if ((unsigned long) (size) >= (unsigned long) (nb + MINSIZE))
         {
+          stats_add (&stats->top, 1);
           remainder_size = size - nb;
           remainder = chunk_at_offset (victim, nb);
           av->top = remainder;
@@ -4456,6 +4725,31 @@ _int_malloc (mstate av, size_t bytes)
           set_head (remainder, remainder_size | PREV_INUSE);
 
           check_malloced_chunk (av, victim, nb);
+#if USE_TCACHE
+	  /* The bin for this size ran dry, so carve a batch of chunks
+	     while we hold the lock.  */
+	  if (tcache_nb > 0 && mp_.tcache_batch > 1
+	      && tcache->counts[tc_idx] == 0)
+	    {
+	      for (size_t n = 1; n < mp_.tcache_batch
+		   && tcache->counts[tc_idx] < mp_.tcache_count; n++)
+		{
+		  mchunkptr tc_victim = av->top;
+		  remainder_size = chunksize (tc_victim);
+		  if (remainder_size < nb + MINSIZE)
+		    break;
+		  remainder_size -= nb;
+		  remainder = chunk_at_offset (tc_victim, nb);
+		  av->top = remainder;
+		  set_head (tc_victim, nb | PREV_INUSE |
+			    (av != &main_arena ? NON_MAIN_ARENA : 0));
+		  set_head (remainder, remainder_size | PREV_INUSE);
+		  check_malloced_chunk (av, tc_victim, nb);
+		  tcache_put (tc_victim, tc_idx);
+		  stats_add (&stats->tcache_refills, 1);
+		}
+	    }
+#endif
           void *p = chunk2mem (victim);
           alloc_perturb (p, bytes);
           return p;
@@ -4478,6 +4772,7 @@ _int_malloc (mstate av, size_t bytes)
        */
       else
         {
+          stats_add (&stats->top, 1);
           void *p = sysmalloc (nb, av);
           if (p != NULL)
             alloc_perturb (p, bytes);
@@ -4549,6 +4844,17 @@ _int_free (mstate av, mchunkptr p, int have_lock)
 	    tcache_put (p, tc_idx);
 	    return;
 	  }
+
+	/* The bin is full.  Rather than taking the arena lock for this
+	   chunk alone, return a batch of cached chunks and keep P.
+	   Fast chunks are freed without the lock anyway.  */
+	if (mp_.tcache_batch > 1 && !have_lock && !SINGLE_THREAD_P
+	    && (unsigned long) size > (unsigned long) get_max_fast ()
+	    && tcache_drain (av, tc_idx, size))
+	  {
+	    tcache_put (p, tc_idx);
+	    return;
+	  }
       }
   }
 #endif
@@ -4580,7 +4886,7 @@ _int_free (mstate av, mchunkptr p, int have_lock)
 	   getting the lock.  */
 	if (!have_lock)
 	  {
-	    __libc_lock_lock (av->mutex);
+	    arena_mutex_lock (av);
 	    fail = (chunksize_nomask (chunk_at_offset (p, size)) <= CHUNK_HDR_SZ
 		    || chunksize (chunk_at_offset (p, size)) >= av->system_mem);
 	    __libc_lock_unlock (av->mutex);
@@ -4636,12 +4942,18 @@ _int_free (mstate av, mchunkptr p, int have_lock)
 
   else if (!chunk_is_mmapped(p)) {
 
+    if (__glibc_unlikely (mp_.deferred_free != 0))
+      {
+	free_pending_push (av, p);
+	return;
+      }
+
     /* If we're single-threaded, don't lock the arena.  */
     if (SINGLE_THREAD_P)
       have_lock = true;
 
     if (!have_lock)
-      __libc_lock_lock (av->mutex);
+      arena_mutex_lock (av);
 
     _int_free_merge_chunk (av, p, size);
 
@@ -4699,6 +5011,9 @@ _int_free_merge_chunk (mstate av, mchunkptr p, INTERNAL_SIZE_T size)
   /* Write the chunk header, maybe after merging with the following chunk.  */
   size = _int_free_create_chunk (av, p, size, nextchunk, nextsize);
   _int_free_maybe_consolidate (av, size);
+
+  if (__glibc_unlikely (mp_.decay_ms != 0) && size >= GLRO (dl_pagesize))
+    malloc_decay_wake ();
 }
 
 /* Create a chunk at P of SIZE bytes, with SIZE potentially increased
@@ -4775,7 +5090,10 @@ _int_free_maybe_consolidate (mstate av, INTERNAL_SIZE_T size)
      performed if FASTBIN_CONSOLIDATION_THRESHOLD is reached.  */
   if (size >= FASTBIN_CONSOLIDATION_THRESHOLD)
     {
-      if (atomic_load_relaxed (&av->have_fastchunks))
+      /* With deferred coalescing, this is called while pending chunks
+	 are coalesced, which must stay bounded.  */
+      if (atomic_load_relaxed (&av->have_fastchunks)
+	  && mp_.deferred_free == 0)
 	malloc_consolidate(av);
 
       if (av == &main_arena)
@@ -4797,6 +5115,65 @@ _int_free_maybe_consolidate (mstate av, INTERNAL_SIZE_T size)
     }
 }
 
+/*
+  ------------------------- deferred coalescing -------------------------
+
+  With the glibc.malloc.deferred_free tunable, free does not coalesce
+  chunks that are too large for the fastbins.  Like fastbin chunks, they
+  stay marked as in use and are pushed on a list of the arena with an
+  atomic operation, so that free does not take the arena lock.  Before
+  serving a request, _int_malloc coalesces up to deferred_free of them,
+  and the decay thread does the same in the background if it runs.  All
+  of them are coalesced by malloc_consolidate, which is called before
+  the arena grows and by malloc_trim.  The worst-case latency of free
+  is thus that of a compare-and-swap.
+*/
+
+static void
+free_pending_push (mstate av, mchunkptr p)
+{
+  mchunkptr old = atomic_load_relaxed (&av->free_pending), old2;
+  do
+    {
+      /* Check that the top of the list is not the chunk we are going
+	 to add (i.e., double free).  */
+      if (__glibc_unlikely (old == p))
+	malloc_printerr ("double free or corruption (pending)");
+      old2 = old;
+      p->fd = PROTECT_PTR (&p->fd, old);
+    }
+  while ((old = catomic_compare_and_exchange_val_rel (&av->free_pending, p,
+						      old2)) != old2);
+
+  /* Make sure that malloc_consolidate picks up the pending chunks.  */
+  atomic_store_relaxed (&av->have_fastchunks, true);
+}
+
+/* Coalesce up to MAX pending chunks of arena AV, which must be locked.
+   The chunks are removed one by one, so that free can keep pushing
+   chunks while this runs.  */
+static void
+free_pending_drain (mstate av, size_t max)
+{
+  for (size_t n = 0; n < max; n++)
+    {
+      mchunkptr p = atomic_load_acquire (&av->free_pending), next, old;
+      do
+	{
+	  if (p == NULL)
+	    return;
+	  if (__glibc_unlikely (misaligned_chunk (p)))
+	    malloc_printerr ("malloc(): unaligned pending chunk detected");
+	  next = REVEAL_PTR (p->fd);
+	  old = p;
+	}
+      while ((p = catomic_compare_and_exchange_val_acq (&av->free_pending,
+							next, old)) != old);
+
+      _int_free_merge_chunk (av, p, chunksize (p));
+    }
+}
+
 /*
   ------------------------- malloc_consolidate -------------------------
 
@@ -4823,8 +5200,17 @@ static void malloc_consolidate(mstate av)
   INTERNAL_SIZE_T prevsize;
   int             nextinuse;
 
+  /* Timing costs two system calls on some targets.  */
+  bool timed = mp_.stats != 0;
+  struct __timespec64 start = { 0 }, end;
+  if (timed)
+    __clock_gettime64 (CLOCK_MONOTONIC, &start);
+
   atomic_store_relaxed (&av->have_fastchunks, false);
 
+  if (mp_.deferred_free != 0)
+    free_pending_drain (av, SIZE_MAX);
+
   unsorted_bin = unsorted_chunks(av);
 
   /*
@@ -4902,6 +5288,15 @@ static void malloc_consolidate(mstate av)
 
     }
   } while (fb++ != maxfb);
+
+  if (timed)
+    {
+      __clock_gettime64 (CLOCK_MONOTONIC, &end);
+      stats_add (&av->consolidations, 1);
+      stats_add (&av->consolidation_ns,
+		 (end.tv_sec - start.tv_sec) * 1000000000
+		 + end.tv_nsec - start.tv_nsec);
+    }
 }
 
 /*
@@ -5222,10 +5617,291 @@ __malloc_trim (size_t s)
     }
   while (ar_ptr != &main_arena);
 
+  if (mmap_cache_enabled ())
+    result |= mmap_cache_flush ();
+
   return result;
 }
 
 
+/*
+   ------------------------------ malloc decay ------------------------------
+ */
+
+/* With the glibc.malloc.decay_ms tunable, a background thread returns
+   free memory to the system once it has stayed free for a while.  It
+   visits the unsorted bin, the large bins that can hold whole pages,
+   and the top chunk of each arena, a few of them per step, so that one
+   pass over all of them takes about decay_ms.  The first time it sees a
+   free chunk, it stores the pass number and the chunk size behind the
+   chunk header.  If it finds the chunk unchanged in the next pass, the
+   whole pages of the chunk are released with MADV_DONTNEED.
+
+   Arenas whose lock is busy are skipped, and the bins of an arena are
+   never walked all at once, so the thread does not hold up allocation
+   for long.  Once a whole pass finds nothing left to release, the
+   thread blocks until _int_free_merge_chunk creates a free chunk of at
+   least a page, so that an idle process is not woken up.  */
+
+#if IS_IN (libc)
+
+/* Number of bins or top chunks visited per arena and step.  */
+#define DECAY_BINS_PER_STEP 8
+
+/* Marker values stored in free chunks.  */
+#define DECAY_MAGIC ((uintptr_t) 0x9e3779b97f4a7c15ULL)
+#define DECAY_RELEASED (~DECAY_MAGIC)
+
+/* 0 if the decay thread has not been started, 1 if it is running or
+   being started, 2 if it could not be started.  */
+static int decay_state;
+
+/* Set to 1 by the decay thread before it waits for free memory.  */
+static unsigned int decay_idle;
+
+/* Bytes at the start of the top chunk that are kept, so that memory
+   about to be allocated is not released.  */
+static size_t
+decay_keep (mstate av, mchunkptr p)
+{
+  return p == av->top ? mp_.top_pad : 0;
+}
+
+/* Return the mark stored in free chunk P of arena AV, and set *START
+   and *END to the whole pages of the chunk which may be released.  */
+static uintptr_t *
+decay_range (mstate av, mchunkptr p, uintptr_t *start, uintptr_t *end)
+{
+  uintptr_t *mark = (uintptr_t *) ((char *) p + sizeof (struct malloc_chunk));
+  uintptr_t pagesize = GLRO (dl_pagesize);
+  *start = ALIGN_UP ((uintptr_t) (mark + 2) + decay_keep (av, p), pagesize);
+  *end = ALIGN_DOWN ((uintptr_t) p + chunksize (p), pagesize);
+  return mark;
+}
+
+/* Age free chunk P of arena AV, and release its whole pages if it was
+   already free in the previous pass.  Return true if the chunk still
+   has pages which are not released.  */
+static bool
+decay_chunk (mstate av, mchunkptr p)
+{
+  INTERNAL_SIZE_T size = chunksize (p);
+  uintptr_t start, end;
+  uintptr_t *mark = decay_range (av, p, &start, &end);
+
+  if (start >= end)
+    return false;
+
+  if (mark[1] == size)
+    {
+      if (mark[0] == DECAY_RELEASED)
+	return false;
+      if (mark[0] == (DECAY_MAGIC ^ av->decay_pass))
+	return true;
+      if (mark[0] == (DECAY_MAGIC ^ (av->decay_pass - 1)))
+	{
+	  __madvise ((void *) start, end - start, MADV_DONTNEED);
+	  mark[0] = DECAY_RELEASED;
+	  LIBC_PROBE (memory_decay_release, 3, av, start, end - start);
+	  return false;
+	}
+    }
+  mark[0] = DECAY_MAGIC ^ av->decay_pass;
+  mark[1] = size;
+  return true;
+}
+
+/* Visit the next DECAY_BINS_PER_STEP bins of arena AV.  Position 0 is
+   the unsorted bin, followed by the bins from FIRST_BIN on, and the
+   top chunk.  Called with the arena lock held.  Return true if any of
+   the chunks visited still has pages which are not released.  */
+static bool
+decay_step (mstate av, int first_bin)
+{
+  int last_pos = NBINS - first_bin + 1;
+  bool pending = false;
+
+  for (int n = 0; n < DECAY_BINS_PER_STEP; n++)
+    {
+      int pos = av->decay_pos;
+      if (pos == last_pos)
+	{
+	  if (av->top != initial_top (av))
+	    pending |= decay_chunk (av, av->top);
+	  av->decay_pos = 0;
+	  av->decay_pass++;
+	  break;
+	}
+
+      mbinptr bin = pos == 0 ? unsorted_chunks (av)
+			     : bin_at (av, first_bin + pos - 1);
+      for (mchunkptr p = last (bin); p != bin; p = p->bk)
+	pending |= decay_chunk (av, p);
+      av->decay_pos = pos + 1;
+    }
+  return pending;
+}
+
+/* Return true if free chunk P of arena AV has pages which are not
+   released, without aging it.  */
+static bool
+decay_chunk_pending (mstate av, mchunkptr p)
+{
+  uintptr_t start, end;
+  uintptr_t *mark = decay_range (av, p, &start, &end);
+  return (start < end
+	  && (mark[1] != chunksize (p) || mark[0] != DECAY_RELEASED));
+}
+
+/* Return true if arena AV holds free memory which the decay thread has
+   not released yet.  Called with the arena lock held.  */
+static bool
+decay_pending (mstate av, int first_bin)
+{
+  if (atomic_load_relaxed (&av->free_pending) != NULL)
+    return true;
+  if (av->top != initial_top (av) && decay_chunk_pending (av, av->top))
+    return true;
+  for (int pos = 0; pos < NBINS - first_bin + 1; pos++)
+    {
+      mbinptr bin = pos == 0 ? unsorted_chunks (av)
+			     : bin_at (av, first_bin + pos - 1);
+      for (mchunkptr p = last (bin); p != bin; p = p->bk)
+	if (decay_chunk_pending (av, p))
+	  return true;
+    }
+  return false;
+}
+
+/* Block until malloc_decay_wake is called, unless some arena holds
+   free memory which is not released.  decay_idle is set before each
+   arena is checked with its lock held, and _int_free_merge_chunk calls
+   malloc_decay_wake with the arena lock held, so a chunk is either
+   seen here or wakes the thread.  */
+static void
+decay_wait (int first_bin)
+{
+  atomic_store_relaxed (&decay_idle, 1);
+
+  mstate av = &main_arena;
+  do
+    {
+      bool pending = true;
+      if (__libc_lock_trylock (av->mutex) == 0)
+	{
+	  pending = decay_pending (av, first_bin);
+	  __libc_lock_unlock (av->mutex);
+	}
+      if (pending)
+	{
+	  atomic_store_relaxed (&decay_idle, 0);
+	  return;
+	}
+      av = av->next;
+    }
+  while (av != &main_arena);
+
+  while (atomic_load_relaxed (&decay_idle) != 0)
+    futex_wait_simple (&decay_idle, 1, FUTEX_PRIVATE);
+}
+
+static void *
+decay_thread (void *arg)
+{
+  int first_bin = bin_index (GLRO (dl_pagesize));
+  int steps = (NBINS - first_bin + 2 + DECAY_BINS_PER_STEP - 1)
+	      / DECAY_BINS_PER_STEP;
+  uint64_t ns = (uint64_t) mp_.decay_ms * 1000000 / steps;
+  /* Do not wake up more than once per millisecond.  */
+  if (ns < 1000000)
+    ns = 1000000;
+  struct timespec interval = { .tv_sec = ns / 1000000000,
+			       .tv_nsec = ns % 1000000000 };
+
+  /* Number of steps in a row which found nothing to release.  */
+  int quiet = 0;
+  for (;;)
+    {
+      __nanosleep (&interval, NULL);
+
+      bool pending = false;
+      mstate av = &main_arena;
+      do
+	{
+	  if (__libc_lock_trylock (av->mutex) == 0)
+	    {
+	      if (mp_.deferred_free != 0)
+		free_pending_drain (av, mp_.deferred_free);
+	      pending |= decay_step (av, first_bin);
+	      __libc_lock_unlock (av->mutex);
+	    }
+	  else
+	    pending = true;
+	  av = av->next;
+	}
+      while (av != &main_arena);
+
+      /* A pass over an arena takes at most STEPS + 1 steps.  */
+      quiet = pending ? 0 : quiet + 1;
+      if (quiet > steps)
+	{
+	  decay_wait (first_bin);
+	  quiet = 0;
+	}
+    }
+  return NULL;
+}
+
+/* Start the decay thread if it is not running yet.  Called from free
+   without any arena lock held.  */
+static void
+malloc_decay_start (void)
+{
+  int expected = 0;
+  if (atomic_load_relaxed (&decay_state) != 0
+      || mtag_enabled
+      || !atomic_compare_exchange_weak_acquire (&decay_state, &expected, 1))
+    return;
+
+  if (__nptl_create_helper (decay_thread, NULL) != 0)
+    atomic_store_relaxed (&decay_state, 2);
+}
+
+/* Wake up the decay thread if it waits for free memory.  Called with
+   the lock of the arena held which the memory was added to.  */
+static void
+malloc_decay_wake (void)
+{
+  if (atomic_load_relaxed (&decay_idle) != 0
+      && atomic_exchange_relaxed (&decay_idle, 0) != 0)
+    futex_wake (&decay_idle, 1, FUTEX_PRIVATE);
+}
+
+/* The decay thread does not exist in the child after fork.  It is
+   started again on the next free.  */
+static void
+malloc_decay_fork_child (void)
+{
+  if (decay_state == 1)
+    decay_state = 0;
+  decay_idle = 0;
+}
+
+#else /* !IS_IN (libc) */
+
+static void
+malloc_decay_wake (void)
+{
+}
+
+static void
+malloc_decay_fork_child (void)
+{
+}
+
+#endif /* !IS_IN (libc) */
+
+
 /*
    ------------------------- malloc_usable_size -------------------------
  */
@@ -5249,6 +5925,8 @@ __malloc_usable_size (void *m)
 {
   if (m == NULL)
     return 0;
+  if (slab_contains (m))
+    return slab_usable_size (m);
   return musable (m);
 }
 #endif
@@ -5294,6 +5972,16 @@ int_mallinfo (mstate av, struct mallinfo2 *m)
 
   avail += fastavail;
 
+  /* Pending chunks are free, but not in any bin yet.  */
+  for (p = av->free_pending; p != 0; p = REVEAL_PTR (p->fd))
+    {
+      if (__glibc_unlikely (misaligned_chunk (p)))
+	malloc_printerr ("int_mallinfo(): "
+			 "unaligned pending chunk detected");
+      ++nblocks;
+      avail += chunksize (p);
+    }
+
   /* traverse regular bins */
   for (i = 1; i < NBINS; ++i)
     {
@@ -5521,6 +6209,18 @@ do_set_tcache_unsorted_limit (size_t value)
   mp_.tcache_unsorted_limit = value;
   return 1;
 }
+
+static __always_inline int
+do_set_tcache_batch (size_t value)
+{
+  if (value <= MAX_TCACHE_COUNT)
+    {
+      LIBC_PROBE (memory_tunable_tcache_batch, 2, value, mp_.tcache_batch);
+      mp_.tcache_batch = value;
+      return 1;
+    }
+  return 0;
+}
 #endif
 
 static __always_inline int
@@ -5554,6 +6254,77 @@ do_set_hugetlb (size_t value)
   return 0;
 }
 
+static __always_inline int
+do_set_decay_ms (size_t value)
+{
+  LIBC_PROBE (memory_tunable_decay_ms, 2, value, mp_.decay_ms);
+  mp_.decay_ms = value;
+  return 1;
+}
+
+static __always_inline int
+do_set_mmap_cache_size (size_t value)
+{
+  LIBC_PROBE (memory_tunable_mmap_cache_size, 2, value, mp_.mmap_cache_size);
+  mp_.mmap_cache_size = value;
+  return 1;
+}
+
+static __always_inline int
+do_set_mmap_cache_ttl_ms (size_t value)
+{
+  LIBC_PROBE (memory_tunable_mmap_cache_ttl_ms, 2, value,
+	      mp_.mmap_cache_ttl_ms);
+  mp_.mmap_cache_ttl_ms = value;
+  return 1;
+}
+
+static __always_inline int
+do_set_deferred_free (size_t value)
+{
+  LIBC_PROBE (memory_tunable_deferred_free, 2, value, mp_.deferred_free);
+  mp_.deferred_free = value;
+  return 1;
+}
+
+static __always_inline int
+do_set_numa (int32_t value)
+{
+  LIBC_PROBE (memory_tunable_numa, 2, value, mp_.numa_nodes);
+  if (value == 1)
+    {
+      /* There is nothing to gain on a single node.  */
+      int nodes = __malloc_numa_nodes ();
+      if (nodes > 1)
+	{
+	  mp_.numa_nodes = nodes;
+	  mp_.numa_bind = true;
+	}
+    }
+  else if (value >= 2)
+    {
+      mp_.numa_nodes = value;
+      mp_.numa_bind = false;
+    }
+  return 0;
+}
+
+static __always_inline int
+do_set_stats (int32_t value)
+{
+  mp_.stats = value;
+  return 0;
+}
+
+static __always_inline int
+do_set_slab (int32_t value)
+{
+  /* Slab objects have no chunk headers, which memory tagging needs.  */
+  if (value == 1 && !mtag_enabled)
+    slab_init ();
+  return 0;
+}
+
 int
 __libc_mallopt (int param_number, int value)
 {
@@ -5825,6 +6596,7 @@ __malloc_info (int options, FILE *fp)
   size_t total_max_system = 0;
   size_t total_aspace = 0;
   size_t total_aspace_mprotect = 0;
+  size_t total_locks = 0;
 
 
 
@@ -5965,9 +6737,12 @@ __malloc_info (int options, FILE *fp)
 	       "</sizes>\n<total type=\"fast\" count=\"%zu\" size=\"%zu\"/>\n"
 	       "<total type=\"rest\" count=\"%zu\" size=\"%zu\"/>\n"
 	       "<system type=\"current\" size=\"%zu\"/>\n"
-	       "<system type=\"max\" size=\"%zu\"/>\n",
+	       "<system type=\"max\" size=\"%zu\"/>\n"
+	       "<locks count=\"%zu\"/>\n",
 	       nfastblocks, fastavail, nblocks, avail,
-	       ar_ptr->system_mem, ar_ptr->max_system_mem);
+	       ar_ptr->system_mem, ar_ptr->max_system_mem,
+	       (size_t) ar_ptr->lock_count);
+      total_locks += ar_ptr->lock_count;
 
       if (ar_ptr != &main_arena)
 	{
@@ -6002,16 +6777,110 @@ __malloc_info (int options, FILE *fp)
 	   "<system type=\"max\" size=\"%zu\"/>\n"
 	   "<aspace type=\"total\" size=\"%zu\"/>\n"
 	   "<aspace type=\"mprotect\" size=\"%zu\"/>\n"
+	   "<locks count=\"%zu\"/>\n"
 	   "</malloc>\n",
 	   total_nfastblocks, total_fastavail, total_nblocks, total_avail,
 	   mp_.n_mmaps, mp_.mmapped_mem,
 	   total_system, total_max_system,
-	   total_aspace, total_aspace_mprotect);
+	   total_aspace, total_aspace_mprotect, total_locks);
 
   return 0;
 }
+
+/* Return the largest chunk size that is placed in bin IDX.  */
+static size_t
+bin_max_chunk_size (unsigned int idx)
+{
+  /* bin_index grows with the size, so look for the smallest chunk
+     size that goes into a later bin.  */
+  size_t lo = MINSIZE;
+  size_t hi = PTRDIFF_MAX & ~MALLOC_ALIGN_MASK;
+  if (bin_index (hi) <= idx)
+    return hi;
+  while (lo < hi)
+    {
+      size_t mid = ALIGN_DOWN (lo + (hi - lo) / 2, MALLOC_ALIGNMENT);
+      if (bin_index (mid) > idx)
+	hi = mid;
+      else
+	lo = mid + MALLOC_ALIGNMENT;
+    }
+  return lo - MALLOC_ALIGNMENT;
+}
+
+size_t
+__malloc_stats_snapshot (struct malloc_global_stats *global,
+			 struct malloc_class_stats *classes, size_t nclasses)
+{
+  unsigned int first = bin_index (MINSIZE);
+  unsigned int last = bin_index (PTRDIFF_MAX & ~MALLOC_ALIGN_MASK);
+  size_t total = last - first + 1;
+
+  if (!__malloc_initialized)
+    ptmalloc_init ();
+
+  if (classes == NULL)
+    nclasses = 0;
+  nclasses = MIN (nclasses, total);
+  for (size_t i = 0; i < nclasses; ++i)
+    {
+      classes[i] = (struct malloc_class_stats) { 0 };
+      classes[i].size = bin_max_chunk_size (first + i) - SIZE_SZ;
+    }
+  if (global != NULL)
+    {
+      *global = (struct malloc_global_stats) { 0 };
+      global->mmaps = atomic_load_relaxed (&mp_.mmap_count);
+      global->munmaps = atomic_load_relaxed (&mp_.munmap_count);
+    }
+
+  /* The arena counters are read without taking the arena locks.  */
+  mstate ar_ptr = &main_arena;
+  do
+    {
+      for (size_t i = 0; i < nclasses; ++i)
+	{
+	  struct malloc_class_counters *c = &ar_ptr->class_stats[first + i];
+	  classes[i].requests += atomic_load_relaxed (&c->requests);
+	  classes[i].top += atomic_load_relaxed (&c->top);
+	  classes[i].tcache_refills += atomic_load_relaxed (&c->tcache_refills);
+	}
+      if (global != NULL)
+	{
+	  global->arena_locks += atomic_load_relaxed (&ar_ptr->lock_count);
+	  global->consolidations
+	    += atomic_load_relaxed (&ar_ptr->consolidations);
+	  global->consolidation_ns
+	    += atomic_load_relaxed (&ar_ptr->consolidation_ns);
+	}
+      ar_ptr = ar_ptr->next;
+    }
+  while (ar_ptr != &main_arena);
+
+#if USE_TCACHE
+  /* Other threads add their counters in batches, but the caller
+     should see all of its own requests.  */
+  if (tcache != NULL)
+    tcache_stats_flush (tcache);
+  for (size_t i = 0; i < TCACHE_MAX_BINS; ++i)
+    {
+      size_t idx = bin_index (MINSIZE + i * MALLOC_ALIGNMENT) - first;
+      if (idx < nclasses)
+	{
+	  classes[idx].tcache_hits
+	    += atomic_load_relaxed (&tcache_hits_total[i]);
+	  classes[idx].tcache_misses
+	    += atomic_load_relaxed (&tcache_misses_total[i]);
+	}
+    }
+#endif
+
+  return total;
+}
+
 #if IS_IN (libc)
 weak_alias (__malloc_info, malloc_info)
+weak_alias (__malloc_stats_snapshot, malloc_stats_snapshot)
 
 strong_alias (__libc_calloc, __calloc) weak_alias (__libc_calloc, calloc)
 strong_alias (__libc_free, __free) strong_alias (__libc_free, free)
@@ -157,5 +157,34 @@ extern void malloc_stats (void) __THROW;
 /* Output information about state of allocator to stream FP.  */
 extern int malloc_info (int __options, FILE *__fp) __THROW;
 
+/* Counters for the requests of one size class.  */
+struct malloc_class_stats
+{
+  size_t size;           /* largest request size in this class */
+  size_t requests;       /* requests handled by an arena */
+  size_t top;            /* of these, split from the top chunk or mmapped */
+  size_t tcache_hits;    /* requests served by the thread cache */
+  size_t tcache_misses;  /* requests that found the thread cache empty */
+  size_t tcache_refills; /* chunks moved from an arena to a thread cache */
+};
+
+/* Counters that apply to all size classes.  */
+struct malloc_global_stats
+{
+  size_t arena_locks;      /* arena lock acquisitions to allocate or free */
+  size_t mmaps;            /* chunks allocated with mmap */
+  size_t munmaps;          /* mmapped chunks returned to the system */
+  size_t consolidations;   /* fastbin consolidations */
+  size_t consolidation_ns; /* time spent in consolidations */
+};
+
+/* Store the global allocator counters in *__GLOBAL, and the counters
+   of up to __NCLASSES size classes in __CLASSES, ordered by size.
+   Either pointer may be null.  Return the number of size classes.
+   No locks are taken, so the counters can be slightly out of date.  */
+extern size_t malloc_stats_snapshot (struct malloc_global_stats *__global,
+				     struct malloc_class_stats *__classes,
+				     size_t __nclasses) __THROW;
+
 __END_DECLS
 #endif /* malloc.h */
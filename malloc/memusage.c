@@ -22,6 +22,8 @@
 #include <error.h>
 #include <fcntl.h>
 #include <libintl.h>
+#include <limits.h>
+#include <malloc.h>
 #include <stdatomic.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -115,6 +117,27 @@ static struct entry buffer[2 * DEFAULT_BUFFER_SIZE];
 static _Atomic uint32_t buffer_cnt;
 static struct entry first;
 
+/* Sampled allocation sites.  With MEMUSAGE_SAMPLE set, one allocation
+   is sampled about every SAMPLE_INTERVAL bytes, and its caller is
+   recorded in a fixed-size hash table.  */
+static size_t sample_interval;
+static __thread ssize_t sample_countdown;
+static __thread uint32_t sample_seed;
+
+#define NSITES		4096
+#define SITE_PROBES	16
+#define NTOP_SITES	20
+
+struct site
+{
+  _Atomic uintptr_t caller;
+  _Atomic unsigned long int samples;
+  _Atomic size_t bytes;
+};
+
+static struct site sites[NSITES];
+static _Atomic unsigned long int sites_dropped;
+
 static void
 gettime (struct entry *e)
 {
@@ -223,6 +246,64 @@ update_data (struct header *result, size_t len, size_t old_len)
 }
 
 
+/* Return the number of bytes until the next sample, which is uniformly
+   distributed with a mean of SAMPLE_INTERVAL.  */
+static ssize_t
+next_sample (void)
+{
+  /* xorshift32.  */
+  sample_seed ^= sample_seed << 13;
+  sample_seed ^= sample_seed >> 17;
+  sample_seed ^= sample_seed << 5;
+  return 1 + sample_seed % (2 * sample_interval);
+}
+
+/* Account LEN bytes allocated by CALLER, and record a sample if the
+   countdown to the next one has run out.  */
+static void
+sample_allocation (size_t len, const void *caller)
+{
+  if (sample_interval == 0)
+    return;
+
+  if (__glibc_unlikely (sample_seed == 0))
+    {
+      sample_seed = (uintptr_t) &sample_seed | 1;
+      sample_countdown = next_sample ();
+    }
+
+  sample_countdown -= len;
+  if (sample_countdown > 0)
+    return;
+  sample_countdown = next_sample ();
+
+  /* Each sample stands for SAMPLE_INTERVAL bytes, unless the
+     allocation itself was larger.  */
+  size_t bytes = len > sample_interval ? len : sample_interval;
+  uintptr_t key = (uintptr_t) caller;
+  size_t hash = (key >> 4) * 0x9e3779b1U;
+  for (int i = 0; i < SITE_PROBES; i++)
+    {
+      struct site *site = &sites[(hash + i) % NSITES];
+      uintptr_t old = atomic_load_explicit (&site->caller,
+					    memory_order_relaxed);
+      if (old == 0)
+	{
+	  if (atomic_compare_exchange_strong (&site->caller, &old, key))
+	    old = key;
+	}
+      if (old == key)
+	{
+	  atomic_fetch_add_explicit (&site->samples, 1, memory_order_relaxed);
+	  atomic_fetch_add_explicit (&site->bytes, bytes,
+				     memory_order_relaxed);
+	  return;
+	}
+    }
+  atomic_fetch_add_explicit (&sites_dropped, 1, memory_order_relaxed);
+}
+
+
 /* Interrupt handler.  */
 static void
 int_handler (int signo)
@@ -247,7 +328,10 @@ int_handler (int signo)
    one effectively selects unbuffered operation.
 
    If MEMUSAGE_NO_TIMER is not present an alarm handler is installed
-   which at the highest possible frequency records the stack pointer.  */
+   which at the highest possible frequency records the stack pointer.
+
+   If MEMUSAGE_SAMPLE is set its numerical value is the mean number of
+   bytes allocated between two samples of the allocation site.  */
 static void
 me (void)
 {
@@ -342,6 +426,14 @@ me (void)
 
       if (!not_me && getenv ("MEMUSAGE_TRACE_MMAP") != NULL)
         trace_mmap = true;
+
+      const char *str_sample = getenv ("MEMUSAGE_SAMPLE");
+      if (!not_me && str_sample != NULL)
+	{
+	  sample_interval = strtoul (str_sample, NULL, 0);
+	  if (sample_interval > SSIZE_MAX / 2)
+	    sample_interval = SSIZE_MAX / 2;
+	}
     }
 }
 
@@ -402,6 +494,7 @@ malloc (size_t len)
 
   /* Update the allocation data and write out the records if necessary.  */
   update_data (result, len, 0);
+  sample_allocation (len, RETURN_ADDRESS (0));
 
   /* Return the pointer to the user buffer.  */
   return (void *) (result + 1);
@@ -501,6 +594,8 @@ realloc (void *old, size_t len)
 
   /* Update the allocation data and write out the records if necessary.  */
   update_data (result, len, old_len);
+  if (len > old_len)
+    sample_allocation (len - old_len, RETURN_ADDRESS (0));
 
   /* Return the pointer to the user buffer.  */
   return (void *) (result + 1);
@@ -554,6 +649,7 @@ calloc (size_t n, size_t len)
 
   /* Update the allocation data and write out the records if necessary.  */
   update_data (result, size, 0);
+  sample_allocation (size, RETURN_ADDRESS (0));
 
   /* Do what `calloc' would have done and return the buffer to the caller.  */
   return memset (result + 1, '\0', size);
@@ -836,6 +932,89 @@ munmap (void *start, size_t len)
 }
 
 
+/* Write out the sampled allocation sites that allocated the most.  */
+static void
+print_sites (void)
+{
+  unsigned long int total_samples = 0;
+  for (int i = 0; i < NSITES; i++)
+    total_samples += sites[i].samples;
+  if (total_samples == 0)
+    return;
+
+  fprintf (stderr, "\e[01;32mSampled allocation sites:\e[0;0m \
+%lu samples, one per %zu bytes\n\
+\e[04;34m      est. bytes    samples   caller\e[0m\n",
+	   total_samples, sample_interval);
+
+  /* Repeatedly select the site with the most bytes.  The table is
+     small enough, and this does not allocate.  */
+  bool printed[NSITES] = { false };
+  for (int n = 0; n < NTOP_SITES; n++)
+    {
+      int best = -1;
+      for (int i = 0; i < NSITES; i++)
+	if (!printed[i] && sites[i].samples != 0
+	    && (best < 0 || sites[i].bytes > sites[best].bytes))
+	  best = i;
+      if (best < 0)
+	break;
+      printed[best] = true;
+
+      void *caller = (void *) sites[best].caller;
+      Dl_info info;
+      fprintf (stderr, "%16llu %10lu   ",
+	       (unsigned long long int) sites[best].bytes,
+	       (unsigned long int) sites[best].samples);
+      if (dladdr (caller, &info) == 0)
+	fprintf (stderr, "%p\n", caller);
+      else if (info.dli_sname != NULL)
+	fprintf (stderr, "%s+%#lx (%s)\n", info.dli_sname,
+		 (unsigned long int) ((uintptr_t) caller
+				      - (uintptr_t) info.dli_saddr),
+		 info.dli_fname);
+      else if (info.dli_fname != NULL)
+	fprintf (stderr, "%p (%s+%#lx)\n", caller, info.dli_fname,
+		 (unsigned long int) ((uintptr_t) caller
+				      - (uintptr_t) info.dli_fbase));
+      else
+	fprintf (stderr, "%p\n", caller);
+    }
+
+  if (sites_dropped != 0)
+    fprintf (stderr, "%lu samples from other sites were dropped\n",
+	     (unsigned long int) sites_dropped);
+}
+
+
+/* Write out the counters of the allocator for the size classes that
+   were used.  The sizes include the header added by this library.  */
+static void
+print_size_classes (void)
+{
+  struct malloc_global_stats global;
+  struct malloc_class_stats classes[128];
+  size_t n = malloc_stats_snapshot (&global, classes, 128);
+  if (n > 128)
+    n = 128;
+
+  fprintf (stderr, "\e[01;32mAllocator counters:\e[0;0m \
+arena locks: %zu, mmap: %zu, munmap: %zu, consolidations: %zu (%zu ns)\n\
+\e[04;34m     up to    tcache hit   tcache miss      refills     \
+requests      top\e[0m\n",
+	   global.arena_locks, global.mmaps, global.munmaps,
+	   global.consolidations, global.consolidation_ns);
+  for (size_t i = 0; i < n; i++)
+    if (classes[i].tcache_hits != 0 || classes[i].tcache_misses != 0
+	|| classes[i].requests != 0)
+      fprintf (stderr, "%10zu  %12zu  %12zu %12zu %12zu %8zu\n",
+	       classes[i].size,
+	       classes[i].tcache_hits, classes[i].tcache_misses,
+	       classes[i].tcache_refills, classes[i].requests,
+	       classes[i].top);
+}
+
+
 /* Write some statistics to standard error.  */
 static void
 __attribute__ ((destructor))
@@ -985,6 +1164,12 @@ dest (void)
       fputs ("\e[0;0m\n", stderr);
     }
 
+  if (sample_interval != 0)
+    {
+      print_sites ();
+      print_size_classes ();
+    }
+
   /* Any following malloc/free etc. calls should generate statistics again,
      because otherwise freeing something that has been malloced before
      this destructor (including struct header in front of it) wouldn't
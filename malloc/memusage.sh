@@ -44,6 +44,7 @@ Profile memory usage of PROGRAM.
    -b,--buffer=SIZE       Collect SIZE entries before writing them out
       --no-timer          Don't collect additional information through timer
    -m,--mmap              Also trace mmap & friends
+   -S,--sample=SIZE       Sample allocation sites about every SIZE bytes
 
    -?,--help              Print this help and exit
       --usage             Give a short usage message
@@ -83,6 +84,7 @@ memusagestat_args=
 notimer=
 png=
 progname=
+sample=
 tracemmap=
 
 # Process arguments.  But stop as soon as the program name is found.
@@ -96,7 +98,7 @@ while test $# -gt 0; do
     ;;
   --us | --usa | --usag | --usage)
     echo $"Syntax: memusage [--data=FILE] [--progname=NAME] [--png=FILE] [--unbuffered]
-	    [--buffer=SIZE] [--no-timer] [--time-based] [--total]
+	    [--buffer=SIZE] [--no-timer] [--sample=SIZE] [--time-based] [--total]
 	    [--title=STRING] [--x-size=SIZE] [--y-size=SIZE]
 	    PROGRAM [PROGRAMOPTION]..."
     exit 0
@@ -150,6 +152,16 @@ while test $# -gt 0; do
   -m | --m | --mm | --mma | --mmap)
     tracemmap=yes
     ;;
+  -S | --s | --sa | --sam | --samp | --sampl | --sample)
+    if test $# -eq 1; then
+      do_missing_arg $1
+    fi
+    shift
+    sample="$1"
+    ;;
+  --s=* | --sa=* | --sam=* | --samp=* | --sampl=* | --sample=*)
+    sample=${1##*=}
+    ;;
   -t | --tim | --time | --time- | --time-b | --time-ba | --time-bas | --time-base | --time-based)
     memusagestat_args="$memusagestat_args -t"
     ;;
@@ -248,6 +260,13 @@ if test -n "$tracemmap"; then
   add_env="$add_env MEMUSAGE_TRACE_MMAP=yes"
 fi
 
+# Sample allocation sites, and have malloc keep the counters that are
+# printed with them.
+if test -n "$sample"; then
+  add_env="$add_env MEMUSAGE_SAMPLE=$sample"
+  add_env="$add_env GLIBC_TUNABLES=\"${GLIBC_TUNABLES:+$GLIBC_TUNABLES:}glibc.malloc.stats=1\""
+fi
+
 # Execute the program itself.
 eval $add_env '"$@"'
 result=$?
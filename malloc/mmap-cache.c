@@ -0,0 +1,291 @@
+/* Cache of freed mmapped chunks.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License as
+   published by the Free Software Foundation; either version 2.1 of the
+   License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; see the file COPYING.LIB.  If
+   not, see <https://www.gnu.org/licenses/>.  */
+
+/* When the glibc.malloc.mmap_cache_size tunable is set, the mappings of
+   freed mmapped chunks are kept, up to that many bytes in total, and
+   reused for later mmapped chunks.  This saves the mmap and munmap
+   system calls, the TLB shootdowns caused by munmap in multi-threaded
+   processes, and the page faults on the reused pages.  A mapping stays
+   in the cache for at most glibc.malloc.mmap_cache_ttl_ms milliseconds.
+
+   The mappings are bucketed by the binary logarithm of their page
+   count.  A request takes the smallest mapping of its bucket that is
+   large enough, else any mapping of the next bucket, else the largest
+   mapping of its bucket, and resizes it with mremap if needed.  mremap
+   moves the existing pages, so only the pages added by growing a
+   mapping are faulted in again.  */
+
+#define MMAP_CACHE_BUCKETS 32
+#define MMAP_CACHE_SLOTS 8
+
+/* A single mapping may use at most this fraction of the cache.  */
+#define MMAP_CACHE_MIN_ENTRIES 4
+
+struct mmap_cache_entry
+{
+  /* NULL if the slot is empty.  */
+  void *addr;
+  size_t size;
+  /* When the mapping was added, in milliseconds.  */
+  uint64_t time;
+};
+
+static struct mmap_cache_entry
+  mmap_cache[MMAP_CACHE_BUCKETS][MMAP_CACHE_SLOTS];
+
+/* Total size of the cached mappings.  */
+static size_t mmap_cache_bytes;
+
+/* Protects the cache.  No system call is made with it held.  */
+__libc_lock_define_initialized (static, mmap_cache_lock);
+
+/* Number of bytes at the start of the last mapping that mmap_cache_get
+   returned on this thread which may be nonzero: the mapping is dirty up
+   to its old size, the pages added by mremap are zero.  calloc resets
+   it, so that it can tell cached mappings from fresh ones.  */
+static __thread size_t mmap_cache_dirty attribute_tls_model_ie;
+
+static __always_inline bool
+mmap_cache_enabled (void)
+{
+  return mp_.mmap_cache_size != 0;
+}
+
+/* Largest mapping that is cached.  */
+static __always_inline size_t
+mmap_cache_max_entry (void)
+{
+  return mp_.mmap_cache_size / MMAP_CACHE_MIN_ENTRIES;
+}
+
+static uint64_t
+mmap_cache_now (void)
+{
+  struct __timespec64 ts;
+  __clock_gettime64 (CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static unsigned int
+mmap_cache_bucket (size_t size)
+{
+  unsigned long int pages = size / GLRO (dl_pagesize);
+  unsigned int bucket = ULONG_WIDTH - 1 - __builtin_clzl (pages);
+  return MIN (bucket, MMAP_CACHE_BUCKETS - 1);
+}
+
+/* Remove entry E from the cache and push its mapping on the list at
+   *VICTIMS, to be unmapped once the lock is released.  The list is
+   linked through the mappings themselves.  */
+static void
+mmap_cache_evict (struct mmap_cache_entry *e, void **victims)
+{
+  void **victim = e->addr;
+  victim[0] = *victims;
+  victim[1] = (void *) e->size;
+  *victims = victim;
+  mmap_cache_bytes -= e->size;
+  e->addr = NULL;
+  LIBC_PROBE (memory_mmap_cache_evict, 2, victim, e->size);
+}
+
+static void
+mmap_cache_unmap (void *victims)
+{
+  while (victims != NULL)
+    {
+      void **victim = victims;
+      victims = victim[0];
+      __munmap (victim, (size_t) victim[1]);
+    }
+}
+
+/* Evict the mappings that have been cached for too long.  */
+static void
+mmap_cache_expire (uint64_t now, void **victims)
+{
+  if (mmap_cache_bytes == 0)
+    return;
+
+  for (int b = 0; b < MMAP_CACHE_BUCKETS; b++)
+    for (int s = 0; s < MMAP_CACHE_SLOTS; s++)
+      {
+	struct mmap_cache_entry *e = &mmap_cache[b][s];
+	if (e->addr != NULL && now - e->time >= mp_.mmap_cache_ttl_ms)
+	  mmap_cache_evict (e, victims);
+      }
+}
+
+/* Return a mapping of SIZE bytes from the cache, or NULL if there is
+   none.  Sets mmap_cache_dirty for a mapping that is returned.  */
+static void *
+mmap_cache_get (size_t size)
+{
+  void *victims = NULL;
+  struct mmap_cache_entry *best = NULL;
+  uint64_t now = mmap_cache_now ();
+  unsigned int b = mmap_cache_bucket (size);
+  void *addr = NULL;
+  size_t old_size = 0;
+
+  __libc_lock_lock (mmap_cache_lock);
+  mmap_cache_expire (now, &victims);
+
+  if (mmap_cache_bytes != 0)
+    {
+      for (int s = 0; s < MMAP_CACHE_SLOTS; s++)
+	{
+	  struct mmap_cache_entry *e = &mmap_cache[b][s];
+	  if (e->addr != NULL && e->size >= size
+	      && (best == NULL || e->size < best->size))
+	    best = e;
+	}
+      if (best == NULL && b + 1 < MMAP_CACHE_BUCKETS)
+	for (int s = 0; s < MMAP_CACHE_SLOTS; s++)
+	  {
+	    struct mmap_cache_entry *e = &mmap_cache[b + 1][s];
+	    if (e->addr != NULL && (best == NULL || e->size < best->size))
+	      best = e;
+	  }
+      if (best == NULL)
+	for (int s = 0; s < MMAP_CACHE_SLOTS; s++)
+	  {
+	    struct mmap_cache_entry *e = &mmap_cache[b][s];
+	    if (e->addr != NULL && (best == NULL || e->size > best->size))
+	      best = e;
+	  }
+    }
+  if (best != NULL)
+    {
+      addr = best->addr;
+      old_size = best->size;
+      best->addr = NULL;
+      mmap_cache_bytes -= old_size;
+    }
+
+  __libc_lock_unlock (mmap_cache_lock);
+  mmap_cache_unmap (victims);
+
+  if (addr == NULL)
+    return NULL;
+  if (old_size == size)
+    {
+      mmap_cache_dirty = size;
+      return addr;
+    }
+
+  void *p = __mremap (addr, old_size, size, MREMAP_MAYMOVE);
+  if (p == MAP_FAILED)
+    {
+      __munmap (addr, old_size);
+      return NULL;
+    }
+  LIBC_PROBE (memory_mmap_cache_resize, 4, addr, old_size, p, size);
+  mmap_cache_dirty = MIN (old_size, size);
+  return p;
+}
+
+/* Add the mapping of SIZE bytes at ADDR to the cache.  Return false if
+   it is too large, in which case the caller has to unmap it.  */
+static bool
+mmap_cache_put (void *addr, size_t size)
+{
+  if (size > mmap_cache_max_entry ())
+    return false;
+
+  void *victims = NULL;
+  uint64_t now = mmap_cache_now ();
+  unsigned int b = mmap_cache_bucket (size);
+
+  __libc_lock_lock (mmap_cache_lock);
+  mmap_cache_expire (now, &victims);
+
+  /* Use an empty slot of the bucket, or else its oldest one.  */
+  struct mmap_cache_entry *slot = NULL;
+  for (int s = 0; s < MMAP_CACHE_SLOTS; s++)
+    {
+      struct mmap_cache_entry *e = &mmap_cache[b][s];
+      if (e->addr == NULL)
+	{
+	  slot = e;
+	  break;
+	}
+      if (slot == NULL || e->time < slot->time)
+	slot = e;
+    }
+  if (slot->addr != NULL)
+    mmap_cache_evict (slot, &victims);
+
+  /* Evict the oldest mappings of any size until the new one fits.  */
+  while (mmap_cache_bytes + size > mp_.mmap_cache_size)
+    {
+      struct mmap_cache_entry *oldest = NULL;
+      for (int i = 0; i < MMAP_CACHE_BUCKETS; i++)
+	for (int s = 0; s < MMAP_CACHE_SLOTS; s++)
+	  {
+	    struct mmap_cache_entry *e = &mmap_cache[i][s];
+	    if (e->addr != NULL && (oldest == NULL || e->time < oldest->time))
+	      oldest = e;
+	  }
+      mmap_cache_evict (oldest, &victims);
+    }
+
+  slot->addr = addr;
+  slot->size = size;
+  slot->time = now;
+  mmap_cache_bytes += size;
+
+  __libc_lock_unlock (mmap_cache_lock);
+  mmap_cache_unmap (victims);
+  return true;
+}
+
+/* Unmap all cached mappings.  Return true if there were any.  */
+static bool
+mmap_cache_flush (void)
+{
+  void *victims = NULL;
+
+  __libc_lock_lock (mmap_cache_lock);
+  for (int b = 0; b < MMAP_CACHE_BUCKETS; b++)
+    for (int s = 0; s < MMAP_CACHE_SLOTS; s++)
+      if (mmap_cache[b][s].addr != NULL)
+	mmap_cache_evict (&mmap_cache[b][s], &victims);
+  __libc_lock_unlock (mmap_cache_lock);
+
+  mmap_cache_unmap (victims);
+  return victims != NULL;
+}
+
+static void
+mmap_cache_fork_lock_parent (void)
+{
+  __libc_lock_lock (mmap_cache_lock);
+}
+
+static void
+mmap_cache_fork_unlock_parent (void)
+{
+  __libc_lock_unlock (mmap_cache_lock);
+}
+
+static void
+mmap_cache_fork_unlock_child (void)
+{
+  __libc_lock_init (mmap_cache_lock);
+}
@@ -0,0 +1,513 @@
+/* Slab allocator for small requests.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License as
+   published by the Free Software Foundation; either version 2.1 of the
+   License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; see the file COPYING.LIB.  If
+   not, see <https://www.gnu.org/licenses/>.  */
+
+/* When the glibc.malloc.slab tunable is set, requests of up to
+   SLAB_MAX_SIZE bytes are served from slabs instead of the arenas.  A
+   slab is a SLAB_SIZE block of memory that holds objects of a single
+   size class back to back, without chunk headers.  The bitmap of free
+   objects and the other bookkeeping of each slab live in a separate
+   array, so that the objects themselves stay densely packed.
+
+   All slabs are carved from one region of address space that is
+   reserved at startup, so free can tell slab objects from chunks by
+   their address alone.  If the region is exhausted, requests fall back
+   to the arenas.
+
+   Each thread caches a few free objects of every size class, much like
+   the tcache, and moves them to and from the slabs in batches under the
+   lock of the size class.  As with the tcache, cached objects are marked
+   with a random key, so that freeing one of them again is caught before
+   it ends up in the cache twice.  Slabs that become entirely free are given
+   back to the system, except for one per size class.  */
+
+#if IS_IN (libc)
+
+/* Largest request served from slabs.  */
+#define SLAB_MAX_SIZE 256
+/* Size classes are multiples of MALLOC_ALIGNMENT.  */
+#define SLAB_CLASSES (SLAB_MAX_SIZE / MALLOC_ALIGNMENT)
+#define slab_class_size(cls) (((cls) + 1) * MALLOC_ALIGNMENT)
+
+#define SLAB_SIZE (64 * 1024)
+#define SLAB_MAX_OBJECTS (SLAB_SIZE / MALLOC_ALIGNMENT)
+#define SLAB_BITMAP_WORDS (SLAB_MAX_OBJECTS / ULONG_WIDTH)
+
+#if __WORDSIZE == 64
+# define SLAB_REGION_SIZE ((size_t) 1 << 32)
+#else
+# define SLAB_REGION_SIZE ((size_t) 1 << 28)
+#endif
+#define SLAB_COUNT (SLAB_REGION_SIZE / SLAB_SIZE)
+
+/* Maximum number of free objects of each size class cached per thread,
+   and the number of objects moved between the cache and the slabs at
+   once.  */
+#define SLAB_CACHE_COUNT 32
+#define SLAB_CACHE_BATCH 16
+
+struct slab
+{
+  /* List of slabs of the size class with free objects, or of unused
+     slabs.  */
+  struct slab *next;
+  struct slab *prev;
+  /* Size class plus one, or zero if the slab is not in use.  */
+  unsigned int cls;
+  /* Number of free objects.  */
+  unsigned int nfree;
+  /* Set bits mark free objects.  */
+  unsigned long bitmap[SLAB_BITMAP_WORDS];
+};
+
+struct slab_class
+{
+  __libc_lock_define (, lock);
+  /* Slabs that have free objects.  */
+  struct slab *partial;
+};
+
+/* A free object cached by a thread.  The smallest objects are
+   MALLOC_ALIGNMENT bytes, which leaves room for both words.  */
+struct slab_entry
+{
+  struct slab_entry *next;
+  /* slab_key while the object is cached, to detect double frees.  */
+  uintptr_t key;
+};
+
+/* Free objects cached by a thread.  */
+struct slab_cache
+{
+  uint16_t counts[SLAB_CLASSES];
+  struct slab_entry *entries[SLAB_CLASSES];
+};
+
+static char *slab_base;
+/* Zero if slabs are not used.  */
+static size_t slab_region_size;
+static struct slab *slab_meta;
+static struct slab_class slab_classes[SLAB_CLASSES];
+/* Like tcache_key, random and process-wide.  */
+static uintptr_t slab_key;
+
+/* Protects slab_used and slab_free_list.  Nests inside the locks of
+   the size classes.  */
+__libc_lock_define_initialized (static, slab_list_lock);
+/* Number of slabs that have been made accessible.  */
+static size_t slab_used;
+/* Accessible slabs that are not in use.  */
+static struct slab *slab_free_list;
+
+static __thread struct slab_cache slab_cache attribute_tls_model_ie;
+
+#define slab_enabled() (slab_region_size != 0)
+
+static __always_inline bool
+slab_contains (void *mem)
+{
+  return (uintptr_t) mem - (uintptr_t) slab_base < slab_region_size;
+}
+
+static __always_inline char *
+slab_start (struct slab *s)
+{
+  return slab_base + (size_t) (s - slab_meta) * SLAB_SIZE;
+}
+
+/* Return the slab that holds MEM after checking that MEM points to an
+   object in it, and store its size class in *CLS.  */
+static struct slab *
+slab_for_ptr (void *mem, size_t *cls)
+{
+  size_t idx = ((char *) mem - slab_base) / SLAB_SIZE;
+  if (__glibc_unlikely (idx >= atomic_load_relaxed (&slab_used)))
+    malloc_printerr ("free(): invalid pointer");
+
+  struct slab *s = &slab_meta[idx];
+  *cls = s->cls - 1;
+  if (__glibc_unlikely (*cls >= SLAB_CLASSES
+			|| ((char *) mem - slab_start (s))
+			   % slab_class_size (*cls) != 0))
+    malloc_printerr ("free(): invalid pointer");
+  return s;
+}
+
+static void
+slab_link (struct slab_class *c, struct slab *s)
+{
+  s->prev = NULL;
+  s->next = c->partial;
+  if (c->partial != NULL)
+    c->partial->prev = s;
+  c->partial = s;
+}
+
+static void
+slab_unlink (struct slab_class *c, struct slab *s)
+{
+  if (s->prev != NULL)
+    s->prev->next = s->next;
+  else
+    c->partial = s->next;
+  if (s->next != NULL)
+    s->next->prev = s->prev;
+}
+
+/* Set up a slab for size class CLS.  Returns NULL if the region is
+   exhausted.  Called with the lock of the class held.  */
+static struct slab *
+slab_new (size_t cls)
+{
+  struct slab *s;
+  bool fresh = false;
+
+  __libc_lock_lock (slab_list_lock);
+  s = slab_free_list;
+  if (s != NULL)
+    slab_free_list = s->next;
+  else if (slab_used < SLAB_COUNT)
+    {
+      s = &slab_meta[slab_used];
+      fresh = true;
+    }
+  if (fresh)
+    {
+      /* Make the slab and its bookkeeping accessible before publishing
+	 it through slab_used.  */
+      uintptr_t pagesize = GLRO (dl_pagesize);
+      uintptr_t meta = ALIGN_DOWN ((uintptr_t) s, pagesize);
+      uintptr_t meta_end = ALIGN_UP ((uintptr_t) (s + 1), pagesize);
+      if (__mprotect (slab_start (s), SLAB_SIZE, PROT_READ | PROT_WRITE) != 0
+	  || __mprotect ((void *) meta, meta_end - meta,
+			 PROT_READ | PROT_WRITE) != 0)
+	s = NULL;
+      else
+	atomic_store_relaxed (&slab_used, slab_used + 1);
+    }
+  __libc_lock_unlock (slab_list_lock);
+  if (s == NULL)
+    return NULL;
+
+  size_t n = SLAB_SIZE / slab_class_size (cls);
+  s->cls = cls + 1;
+  s->nfree = n;
+  memset (s->bitmap, 0, sizeof (s->bitmap));
+  memset (s->bitmap, 0xff, n / ULONG_WIDTH * sizeof (unsigned long));
+  if (n % ULONG_WIDTH != 0)
+    s->bitmap[n / ULONG_WIDTH] = (1UL << (n % ULONG_WIDTH)) - 1;
+  return s;
+}
+
+/* Give the memory of slab S back to the system and make it available
+   to all size classes.  Called with the lock of its class held.  */
+static void
+slab_release (struct slab *s)
+{
+  s->cls = 0;
+  __madvise (slab_start (s), SLAB_SIZE, MADV_DONTNEED);
+
+  __libc_lock_lock (slab_list_lock);
+  s->next = slab_free_list;
+  slab_free_list = s;
+  __libc_lock_unlock (slab_list_lock);
+}
+
+/* Take up to COUNT free objects of size class CLS from the slabs and
+   store them in OBJS.  Returns the number of objects taken.  Called
+   with the lock of the class held.  */
+static size_t
+slab_take (size_t cls, void **objs, size_t count)
+{
+  struct slab_class *c = &slab_classes[cls];
+  size_t size = slab_class_size (cls);
+  size_t n = 0;
+
+  while (n < count)
+    {
+      struct slab *s = c->partial;
+      if (s == NULL)
+	{
+	  s = slab_new (cls);
+	  if (s == NULL)
+	    break;
+	  slab_link (c, s);
+	}
+
+      char *start = slab_start (s);
+      for (size_t w = 0; n < count && s->nfree > 0; w++)
+	{
+	  unsigned long bits = s->bitmap[w];
+	  while (bits != 0 && n < count)
+	    {
+	      size_t bit = __builtin_ctzl (bits);
+	      bits &= bits - 1;
+	      objs[n++] = start + (w * ULONG_WIDTH + bit) * size;
+	      s->nfree--;
+	    }
+	  s->bitmap[w] = bits;
+	}
+      if (s->nfree == 0)
+	slab_unlink (c, s);
+    }
+
+  return n;
+}
+
+/* Return object MEM of size class CLS to its slab S.  Called with the
+   lock of the class held.  */
+static void
+slab_put (size_t cls, struct slab *s, void *mem)
+{
+  struct slab_class *c = &slab_classes[cls];
+  size_t size = slab_class_size (cls);
+  size_t i = ((char *) mem - slab_start (s)) / size;
+  unsigned long mask = 1UL << (i % ULONG_WIDTH);
+
+  if (__glibc_unlikely (s->bitmap[i / ULONG_WIDTH] & mask))
+    malloc_printerr ("free(): double free detected in slab");
+  s->bitmap[i / ULONG_WIDTH] |= mask;
+
+  if (s->nfree++ == 0)
+    slab_link (c, s);
+  else if (s->nfree == SLAB_SIZE / size
+	   && (c->partial != s || s->next != NULL))
+    {
+      /* Keep one free slab per size class to avoid thrashing.  */
+      slab_unlink (c, s);
+      slab_release (s);
+    }
+}
+
+static __always_inline void
+slab_cache_push (struct slab_cache *tc, size_t cls, void *mem)
+{
+  struct slab_entry *e = mem;
+  e->next = PROTECT_PTR (&e->next, tc->entries[cls]);
+  e->key = slab_key;
+  tc->entries[cls] = e;
+  ++tc->counts[cls];
+}
+
+static __always_inline void *
+slab_cache_pop (struct slab_cache *tc, size_t cls)
+{
+  struct slab_entry *e = tc->entries[cls];
+  if (__glibc_unlikely (!aligned_OK (e)))
+    malloc_printerr ("malloc(): unaligned slab cache entry detected");
+  tc->entries[cls] = REVEAL_PTR (e->next);
+  e->key = 0;
+  --tc->counts[cls];
+  return e;
+}
+
+/* MEM carries the key of cached objects.  This is a double free if MEM
+   is in the cache; otherwise the application left the key in it by
+   chance.  */
+static void
+slab_cache_check (struct slab_cache *tc, size_t cls, void *mem)
+{
+  size_t n = 0;
+  for (struct slab_entry *e = tc->entries[cls]; e != NULL;
+       e = REVEAL_PTR (e->next))
+    {
+      if (__glibc_unlikely (n++ >= tc->counts[cls]))
+	malloc_printerr ("free(): too many chunks detected in slab cache");
+      if (__glibc_unlikely (!aligned_OK (e)))
+	malloc_printerr ("free(): unaligned slab cache entry detected");
+      if (__glibc_unlikely (e == mem))
+	malloc_printerr ("free(): double free detected in slab cache");
+    }
+}
+
+/* Return up to COUNT cached objects of size class CLS to the slabs.  */
+static void
+slab_cache_flush (struct slab_cache *tc, size_t cls, size_t count)
+{
+  struct slab_class *c = &slab_classes[cls];
+
+  __libc_lock_lock (c->lock);
+  while (count-- > 0 && tc->entries[cls] != NULL)
+    {
+      void *mem = slab_cache_pop (tc, cls);
+      size_t mem_cls;
+      struct slab *s = slab_for_ptr (mem, &mem_cls);
+      if (__glibc_unlikely (mem_cls != cls))
+	malloc_printerr ("free(): corrupted slab cache");
+      slab_put (cls, s, mem);
+    }
+  __libc_lock_unlock (c->lock);
+}
+
+/* Allocate an object of at least BYTES bytes, which must not exceed
+   SLAB_MAX_SIZE.  Returns NULL if the slab region is exhausted.  */
+static void *
+slab_malloc (size_t bytes)
+{
+  size_t cls = bytes == 0 ? 0 : (bytes - 1) / MALLOC_ALIGNMENT;
+  struct slab_cache *tc = &slab_cache;
+
+  if (tc->entries[cls] != NULL)
+    return slab_cache_pop (tc, cls);
+
+  void *objs[SLAB_CACHE_BATCH];
+  struct slab_class *c = &slab_classes[cls];
+  __libc_lock_lock (c->lock);
+  size_t n = slab_take (cls, objs, SLAB_CACHE_BATCH);
+  __libc_lock_unlock (c->lock);
+
+  if (n == 0)
+    return NULL;
+  for (size_t i = 1; i < n; i++)
+    slab_cache_push (tc, cls, objs[i]);
+  return objs[0];
+}
+
+static void
+slab_free (void *mem)
+{
+  size_t cls;
+  slab_for_ptr (mem, &cls);
+
+  struct slab_cache *tc = &slab_cache;
+  if (__glibc_unlikely (((struct slab_entry *) mem)->key == slab_key))
+    slab_cache_check (tc, cls, mem);
+  if (tc->counts[cls] >= SLAB_CACHE_COUNT)
+    slab_cache_flush (tc, cls, SLAB_CACHE_BATCH);
+  slab_cache_push (tc, cls, mem);
+}
+
+static size_t
+slab_usable_size (void *mem)
+{
+  size_t cls;
+  slab_for_ptr (mem, &cls);
+  return slab_class_size (cls);
+}
+
+/* Reserve the address space for the slabs.  If that fails, slabs are
+   not used.  */
+static void
+slab_init (void)
+{
+  size_t meta_size = ALIGN_UP (SLAB_COUNT * sizeof (struct slab),
+			       GLRO (dl_pagesize));
+  char *base = (char *) MMAP (NULL, SLAB_REGION_SIZE, PROT_NONE,
+			      MAP_NORESERVE);
+  if (base == MAP_FAILED)
+    return;
+  struct slab *meta = (struct slab *) MMAP (NULL, meta_size, PROT_NONE,
+					    MAP_NORESERVE);
+  if (meta == MAP_FAILED)
+    {
+      __munmap (base, SLAB_REGION_SIZE);
+      return;
+    }
+  __set_vma_name (base, SLAB_REGION_SIZE, " glibc: malloc slab");
+
+  /* We need to use the _nostatus version here, see BZ 29624.  */
+  if (__getrandom_nocancel_nostatus (&slab_key, sizeof (slab_key),
+				     GRND_NONBLOCK)
+      != sizeof (slab_key))
+    {
+      slab_key = random_bits ();
+#if __WORDSIZE == 64
+      slab_key = (slab_key << 32) | random_bits ();
+#endif
+    }
+
+  for (size_t i = 0; i < SLAB_CLASSES; i++)
+    __libc_lock_init (slab_classes[i].lock);
+  slab_base = base;
+  slab_meta = meta;
+  slab_region_size = SLAB_REGION_SIZE;
+}
+
+/* Give the objects cached by the exiting thread back to the slabs.  */
+static void
+slab_thread_shutdown (void)
+{
+  if (!slab_enabled ())
+    return;
+
+  for (size_t cls = 0; cls < SLAB_CLASSES; cls++)
+    if (slab_cache.counts[cls] > 0)
+      slab_cache_flush (&slab_cache, cls, slab_cache.counts[cls]);
+}
+
+static void
+slab_fork_lock_parent (void)
+{
+  if (!slab_enabled ())
+    return;
+
+  for (size_t i = 0; i < SLAB_CLASSES; i++)
+    __libc_lock_lock (slab_classes[i].lock);
+  __libc_lock_lock (slab_list_lock);
+}
+
+static void
+slab_fork_unlock_parent (void)
+{
+  if (!slab_enabled ())
+    return;
+
+  __libc_lock_unlock (slab_list_lock);
+  for (size_t i = 0; i < SLAB_CLASSES; i++)
+    __libc_lock_unlock (slab_classes[i].lock);
+}
+
+static void
+slab_fork_unlock_child (void)
+{
+  if (!slab_enabled ())
+    return;
+
+  /* Objects cached by other threads are lost, as with the tcache.  */
+  __libc_lock_init (slab_list_lock);
+  for (size_t i = 0; i < SLAB_CLASSES; i++)
+    __libc_lock_init (slab_classes[i].lock);
+}
+
+#else /* !IS_IN (libc) */
+
+static void
+slab_init (void)
+{
+}
+
+static void
+slab_thread_shutdown (void)
+{
+}
+
+static void
+slab_fork_lock_parent (void)
+{
+}
+
+static void
+slab_fork_unlock_parent (void)
+{
+}
+
+static void
+slab_fork_unlock_child (void)
+{
+}
+
+#endif /* !IS_IN (libc) */
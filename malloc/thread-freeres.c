@@ -35,6 +35,8 @@ __libc_thread_freeres (void)
   call_function_static_weak (__res_thread_freeres);
   call_function_static_weak (__glibc_tls_internal_free);
   call_function_static_weak (__libc_dlerror_result_free);
+  call_function_static_weak (__syslog_thread_freeres);
+  call_function_static_weak (__arc4random_thread_freeres);
 
   /* This should come last because it shuts down malloc for this
      thread and the other shutdown functions might well call free.  */
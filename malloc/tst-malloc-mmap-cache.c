@@ -0,0 +1,93 @@
+/* Test the reuse of freed mmapped chunks with glibc.malloc.mmap_cache_size.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <malloc.h>
+#include <stdlib.h>
+#include <string.h>
+#include <support/check.h>
+
+#include "tst-malloc-aux.h"
+
+#define SIZE (1024 * 1024)
+
+static size_t
+mmaps (void)
+{
+  struct malloc_global_stats global;
+  malloc_stats_snapshot (&global, NULL, 0);
+  return global.mmaps;
+}
+
+static void
+check_zero (const char *p, size_t size)
+{
+  for (size_t i = 0; i < size; ++i)
+    if (p[i] != 0)
+      FAIL_EXIT1 ("byte %zu of %zu is not zero", i, size);
+}
+
+static int
+do_test (void)
+{
+  /* A freed mapping is reused for a request of the same size.  */
+  char *p = malloc (SIZE);
+  TEST_VERIFY_EXIT (p != NULL);
+  memset (p, 0xaa, SIZE);
+  free (p);
+  size_t before = mmaps ();
+  char *q = malloc (SIZE);
+  TEST_VERIFY_EXIT (q != NULL);
+  TEST_VERIFY (q == p);
+  TEST_COMPARE (mmaps (), before);
+  memset (q, 0xaa, SIZE);
+  free (q);
+
+  /* calloc clears a reused mapping, also after growing it.  */
+  p = calloc (1, SIZE);
+  TEST_VERIFY_EXIT (p != NULL);
+  TEST_COMPARE (mmaps (), before);
+  check_zero (p, SIZE);
+  memset (p, 0xaa, SIZE);
+  free (p);
+  p = calloc (1, SIZE + SIZE / 2);
+  TEST_VERIFY_EXIT (p != NULL);
+  TEST_COMPARE (mmaps (), before);
+  check_zero (p, SIZE + SIZE / 2);
+  free (p);
+
+  /* malloc_trim empties the cache.  */
+  TEST_COMPARE (malloc_trim (0), 1);
+  p = malloc (SIZE);
+  TEST_VERIFY_EXIT (p != NULL);
+  TEST_COMPARE (mmaps (), before + 1);
+  free (p);
+
+  /* Mappings larger than a quarter of the cache are not kept.  */
+  p = malloc (32 * SIZE);
+  TEST_VERIFY_EXIT (p != NULL);
+  free (p);
+  before = mmaps ();
+  p = malloc (32 * SIZE);
+  TEST_VERIFY_EXIT (p != NULL);
+  TEST_COMPARE (mmaps (), before + 1);
+  free (p);
+
+  return 0;
+}
+
+#include <support/test-driver.c>
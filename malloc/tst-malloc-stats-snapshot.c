@@ -0,0 +1,116 @@
+/* Test the allocator counters returned by malloc_stats_snapshot.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <malloc.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <support/check.h>
+#include <support/support.h>
+
+#include "tst-malloc-aux.h"
+
+static size_t nclasses;
+static struct malloc_class_stats *before;
+static struct malloc_class_stats *after;
+static struct malloc_global_stats global_before;
+static struct malloc_global_stats global_after;
+
+/* Return the index of the size class of requests of SIZE bytes.  */
+static size_t
+class_of (size_t size)
+{
+  for (size_t i = 0; i < nclasses; ++i)
+    if (after[i].size >= size)
+      return i;
+  FAIL_EXIT1 ("no size class for %zu bytes", size);
+}
+
+static void
+snapshot (struct malloc_global_stats *global,
+	  struct malloc_class_stats *classes)
+{
+  TEST_COMPARE (malloc_stats_snapshot (global, classes, nclasses), nclasses);
+}
+
+static int
+do_test (void)
+{
+  nclasses = malloc_stats_snapshot (NULL, NULL, 0);
+  TEST_VERIFY_EXIT (nclasses > 0);
+  before = xcalloc (nclasses, sizeof (*before));
+  after = xcalloc (nclasses, sizeof (*after));
+
+  /* The size classes are ordered, and the last one takes any size.  */
+  snapshot (NULL, after);
+  for (size_t i = 1; i < nclasses; ++i)
+    TEST_VERIFY (after[i].size > after[i - 1].size);
+  TEST_VERIFY (after[nclasses - 1].size >= PTRDIFF_MAX / 2);
+
+  /* A smaller array is filled partially.  */
+  struct malloc_class_stats one = { 0 };
+  TEST_COMPARE (malloc_stats_snapshot (NULL, &one, 1), nclasses);
+  TEST_COMPARE (one.size, after[0].size);
+
+  /* Requests that are freed right away are served by the thread cache
+     from the second one on.  */
+  size_t small = class_of (100);
+  snapshot (&global_before, before);
+  for (int i = 0; i < 1000; ++i)
+    free (malloc (100));
+  snapshot (&global_after, after);
+  TEST_VERIFY (after[small].tcache_hits >= before[small].tcache_hits + 999);
+  TEST_VERIFY (after[small].tcache_misses >= before[small].tcache_misses);
+
+  /* A request that no cache can serve reaches an arena.  */
+  size_t medium = class_of (100000);
+  snapshot (&global_before, before);
+  void *p = malloc (100000);
+  TEST_VERIFY_EXIT (p != NULL);
+  snapshot (&global_after, after);
+  TEST_VERIFY (after[medium].requests > before[medium].requests);
+  free (p);
+
+  /* Large requests are mmapped.  */
+  snapshot (&global_before, before);
+  p = malloc (64 * 1024 * 1024);
+  TEST_VERIFY_EXIT (p != NULL);
+  free (p);
+  snapshot (&global_after, after);
+  TEST_VERIFY (global_after.mmaps > global_before.mmaps);
+  TEST_VERIFY (global_after.munmaps > global_before.munmaps);
+
+  /* Freeing many small chunks fills the fastbins once the thread cache
+     is full, and a large request consolidates them.  */
+  void *chunks[64];
+  for (int i = 0; i < 64; ++i)
+    chunks[i] = xmalloc (24);
+  for (int i = 0; i < 64; ++i)
+    free (chunks[i]);
+  snapshot (&global_before, NULL);
+  p = malloc (100000);
+  TEST_VERIFY_EXIT (p != NULL);
+  snapshot (&global_after, NULL);
+  TEST_VERIFY (global_after.consolidations > global_before.consolidations);
+  free (p);
+
+  free (before);
+  free (after);
+  return 0;
+}
+
+#include <support/test-driver.c>
@@ -29,7 +29,16 @@
 #include <errno.h>
 #include <ctype.h>
 #include <assert.h>
+#include <atomic.h>
+#include <futex-internal.h>
+#include <libc-lock.h>
 #include <libio/libioP.h>
+#include <not-cancel.h>
+#include <pthreadP.h>
+#include <set-freeres.h>
+
+#define TUNABLE_NAMESPACE syslog
+#include <elf/dl-tunables.h>
 
 #define ANDROID_LOG_VERBOSE 2 // not used :/
 #define ANDROID_LOG_DEBUG 3
@@ -456,10 +465,378 @@ int async_safe_format_log(int priority, const char* tag, const char* format, ...
 	return result;
 }
 
+// ======================
+// logd connection and asynchronous mode
+//
+// The synchronous path keeps one connection to logd open, like glibc's
+// syslog, instead of opening a socket for every message.  With the
+// glibc.syslog.batch tunable set, messages are instead copied into a
+// ring buffer owned by the calling thread, and a helper thread sends
+// them to logd in batches of up to that many datagrams with sendmmsg.
+// Producers do not take any lock unless their ring is full.
+
+// Size of the logd packet header: log id, tid, timestamp and priority.
+#define LOGD_HEADER_SIZE (1 + sizeof(uint16_t) + sizeof(log_time) + 1)
+
+// Tags are truncated to this size (including the NUL) in ring records.
+#define SYSLOG_TAG_MAX 128
+// Number of records in a thread's ring.
+#define SYSLOG_RING_SIZE 32
+// Upper limit of the glibc.syslog.batch tunable.
+#define SYSLOG_BATCH_MAX 64
+
+struct syslog_record {
+	uint16_t len;
+	char packet[LOGD_HEADER_SIZE + SYSLOG_TAG_MAX + 1024];
+};
+
+struct syslog_ring {
+	// Rings are never freed, so the list only grows at its head.
+	struct syslog_ring* next;
+	// Nonzero while a thread uses the ring.
+	int in_use;
+	uint16_t tid;
+	// Only advanced by the owning thread.
+	unsigned int head;
+	// Only advanced with syslog_flush_lock held.
+	unsigned int tail;
+	struct syslog_record records[SYSLOG_RING_SIZE];
+};
+
+// Protects syslog_fd.
+__libc_lock_define_initialized(static, syslog_lock)
+static int syslog_fd = -1;
+
+// Held by whoever drains the rings.
+__libc_lock_define_initialized(static, syslog_flush_lock)
+static struct syslog_ring* syslog_rings;
+static __thread struct syslog_ring* syslog_thread_ring attribute_tls_model_ie;
+
+// Maximum number of messages per sendmmsg call; zero selects the
+// synchronous path.
+static int syslog_batch;
+__libc_once_define(static, syslog_once);
+
+static bool syslog_flusher_running;
+// Set to 1 by the flusher before it waits for new messages.
+static unsigned int syslog_flusher_idle;
+// How long the flusher lets messages accumulate after sending a batch.
+static const struct timespec syslog_flush_delay = { 0, 10000000 };
+
+// Batch being sent; protected by syslog_flush_lock.
+static struct mmsghdr syslog_msgs[SYSLOG_BATCH_MAX];
+static struct iovec syslog_vecs[SYSLOG_BATCH_MAX];
+static struct syslog_ring* syslog_msg_rings[SYSLOG_BATCH_MAX];
+
+static void syslog_unlock(void* arg) {
+	__libc_lock_unlock(syslog_lock);
+}
+
+static void syslog_flush_unlock(void* arg) {
+	__libc_lock_unlock(syslog_flush_lock);
+}
+
+static void syslog_init(void) {
+	syslog_batch = TUNABLE_GET(batch, int32_t, NULL);
+}
+
+// Called with syslog_lock held.
+static int logd_connect_locked(void) {
+	if (syslog_fd == -1)
+		syslog_fd = open_log_socket();
+	return syslog_fd;
+}
+
+// Send COUNT datagrams to logd, reconnecting once if logd went away.
+// Messages that do not fit into the socket buffer are dropped, as in
+// async_safe_write_log.  Returns -1 if there is no connection to logd.
+// Called with syslog_lock held.
+static int logd_send_locked(struct mmsghdr* msgs, unsigned int count) {
+	bool reconnected = false;
+	unsigned int sent = 0;
+	if (logd_connect_locked() == -1)
+		return -1;
+	while (sent < count) {
+		int result = __sendmmsg(syslog_fd, msgs + sent, count - sent, 0);
+		if (result > 0) {
+			sent += result;
+			continue;
+		}
+		if (result < 0 && errno == EINTR)
+			continue;
+		if (result == 0 || errno == EAGAIN || reconnected)
+			break;
+		__close_nocancel_nostatus(syslog_fd);
+		syslog_fd = open_log_socket();
+		if (syslog_fd == -1)
+			return -1;
+		reconnected = true;
+	}
+	return 0;
+}
+
+static void logd_header(char* header, int priority, uint16_t tid) {
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	struct log_time realtime_ts;
+	realtime_ts.tv_sec = ts.tv_sec;
+	realtime_ts.tv_nsec = ts.tv_nsec;
+
+	header[0] = (priority == ANDROID_LOG_FATAL) ? LOG_ID_CRASH : LOG_ID_MAIN;
+	memcpy(header + 1, &tid, sizeof(tid));
+	memcpy(header + 1 + sizeof(tid), &realtime_ts, sizeof(realtime_ts));
+	header[LOGD_HEADER_SIZE - 1] = priority;
+}
+
+// Send one message right away.
+static void syslog_write(int priority, const char* tag, const char* msg, size_t msg_len) {
+	char header[LOGD_HEADER_SIZE];
+	logd_header(header, priority, INTERNAL_SYSCALL_CALL(gettid));
+
+	struct iovec vec[3];
+	vec[0].iov_base = header;
+	vec[0].iov_len = sizeof(header);
+	vec[1].iov_base = (char*)tag;
+	vec[1].iov_len = strlen(tag) + 1;
+	vec[2].iov_base = (char*)msg;
+	vec[2].iov_len = msg_len + 1;
+	struct mmsghdr mmsg;
+	memset(&mmsg, 0, sizeof(mmsg));
+	mmsg.msg_hdr.msg_iov = vec;
+	mmsg.msg_hdr.msg_iovlen = 3;
+
+	int result;
+	__libc_cleanup_push(syslog_unlock, NULL);
+	__libc_lock_lock(syslog_lock);
+	result = logd_send_locked(&mmsg, 1);
+	__libc_cleanup_pop(1);
+	if (result == -1)
+		// Try stderr instead.
+		write_stderr(tag, msg);
+}
+
+// Send the COUNT records collected in syslog_msgs and hand their slots
+// back to the producers.  Called with syslog_flush_lock held.
+static void syslog_send_batch(unsigned int count) {
+	int result;
+	__libc_cleanup_push(syslog_unlock, NULL);
+	__libc_lock_lock(syslog_lock);
+	result = logd_send_locked(syslog_msgs, count);
+	__libc_cleanup_pop(1);
+	if (result == -1)
+		for (unsigned int i = 0; i < count; i++) {
+			const char* tag = (const char*)syslog_vecs[i].iov_base + LOGD_HEADER_SIZE;
+			write_stderr(tag, tag + strlen(tag) + 1);
+		}
+
+	for (unsigned int i = 0; i < count; i++) {
+		struct syslog_ring* ring = syslog_msg_rings[i];
+		atomic_store_release(&ring->tail, ring->tail + 1);
+	}
+}
+
+// Send all queued messages.  Returns true if there were any.  Called
+// with syslog_flush_lock held.
+static bool syslog_drain(void) {
+	unsigned int batch = atomic_load_relaxed(&syslog_batch);
+	if (batch == 0 || batch > SYSLOG_BATCH_MAX)
+		batch = SYSLOG_BATCH_MAX;
+	unsigned int count = 0;
+	bool any = false;
+
+	for (struct syslog_ring* ring = atomic_load_acquire(&syslog_rings); ring != NULL; ring = ring->next) {
+		unsigned int head = atomic_load_acquire(&ring->head);
+		for (unsigned int tail = ring->tail; tail != head; tail++) {
+			struct syslog_record* record = &ring->records[tail % SYSLOG_RING_SIZE];
+			syslog_vecs[count].iov_base = record->packet;
+			syslog_vecs[count].iov_len = record->len;
+			memset(&syslog_msgs[count], 0, sizeof(syslog_msgs[count]));
+			syslog_msgs[count].msg_hdr.msg_iov = &syslog_vecs[count];
+			syslog_msgs[count].msg_hdr.msg_iovlen = 1;
+			syslog_msg_rings[count] = ring;
+			if (++count == batch) {
+				syslog_send_batch(count);
+				count = 0;
+			}
+			any = true;
+		}
+	}
+	if (count > 0)
+		syslog_send_batch(count);
+	return any;
+}
+
+static void syslog_flush(void) {
+	__libc_cleanup_push(syslog_flush_unlock, NULL);
+	__libc_lock_lock(syslog_flush_lock);
+	syslog_drain();
+	__libc_cleanup_pop(1);
+}
+
+static bool syslog_pending(void) {
+	for (struct syslog_ring* ring = atomic_load_acquire(&syslog_rings); ring != NULL; ring = ring->next)
+		if (atomic_load_relaxed(&ring->head) != atomic_load_relaxed(&ring->tail))
+			return true;
+	return false;
+}
+
+static void* syslog_flusher(void* arg) {
+	for (;;) {
+		__libc_lock_lock(syslog_flush_lock);
+		bool sent = syslog_drain();
+		__libc_lock_unlock(syslog_flush_lock);
+		if (sent) {
+			// Let more messages accumulate, so that they go out in
+			// one batch.
+			__nanosleep(&syslog_flush_delay, NULL);
+			continue;
+		}
+
+		// Producers publish their record before they check
+		// syslog_flusher_idle, so either they see it set and wake us,
+		// or we see their record here.
+		atomic_store_relaxed(&syslog_flusher_idle, 1);
+		atomic_full_barrier();
+		if (!syslog_pending())
+			futex_wait_simple(&syslog_flusher_idle, 1, FUTEX_PRIVATE);
+		atomic_store_relaxed(&syslog_flusher_idle, 0);
+	}
+	return NULL;
+}
+
+// Start the flusher thread if it is not running yet.  Falls back to the
+// synchronous path if it cannot be started.
+static bool syslog_start_flusher(void) {
+	bool running;
+	__libc_cleanup_push(syslog_flush_unlock, NULL);
+	__libc_lock_lock(syslog_flush_lock);
+	running = syslog_flusher_running;
+	if (!running) {
+		running = __nptl_create_helper(syslog_flusher, NULL) == 0;
+		if (running)
+			atomic_store_relaxed(&syslog_flusher_running, true);
+		else
+			atomic_store_relaxed(&syslog_batch, 0);
+	}
+	__libc_cleanup_pop(1);
+	return running;
+}
+
+static struct syslog_ring* syslog_get_ring(void) {
+	struct syslog_ring* ring = syslog_thread_ring;
+	if (ring != NULL)
+		return ring;
+
+	// Reuse the ring of a thread that has exited, if there is one.
+	for (ring = atomic_load_acquire(&syslog_rings); ring != NULL; ring = ring->next) {
+		int expected = 0;
+		if (atomic_load_relaxed(&ring->in_use) == 0
+		    && atomic_compare_exchange_weak_acquire(&ring->in_use, &expected, 1))
+			break;
+	}
+	if (ring == NULL) {
+		ring = calloc(1, sizeof(*ring));
+		if (ring == NULL)
+			return NULL;
+		ring->in_use = 1;
+		struct syslog_ring* first = atomic_load_relaxed(&syslog_rings);
+		do
+			ring->next = first;
+		while (!atomic_compare_exchange_weak_release(&syslog_rings, &first, ring));
+	}
+	ring->tid = INTERNAL_SYSCALL_CALL(gettid);
+	syslog_thread_ring = ring;
+	return ring;
+}
+
+// Queue one message for the flusher.  Returns false if the message has
+// to be sent synchronously instead.
+static bool syslog_enqueue(int priority, const char* tag, const char* msg, size_t msg_len) {
+	if (!atomic_load_relaxed(&syslog_flusher_running) && !syslog_start_flusher())
+		return false;
+	struct syslog_ring* ring = syslog_get_ring();
+	if (ring == NULL)
+		return false;
+
+	unsigned int head = ring->head;
+	if (head - atomic_load_acquire(&ring->tail) == SYSLOG_RING_SIZE)
+		// The flusher cannot keep up; send the queued messages
+		// ourselves.
+		syslog_flush();
+
+	struct syslog_record* record = &ring->records[head % SYSLOG_RING_SIZE];
+	logd_header(record->packet, priority, ring->tid);
+	char* p = record->packet + LOGD_HEADER_SIZE;
+	size_t tag_len = strnlen(tag, SYSLOG_TAG_MAX - 1);
+	memcpy(p, tag, tag_len);
+	p[tag_len] = '\0';
+	p += tag_len + 1;
+	memcpy(p, msg, msg_len);
+	p[msg_len] = '\0';
+	p += msg_len + 1;
+	record->len = p - record->packet;
+	atomic_store_release(&ring->head, head + 1);
+
+	// See syslog_flusher.
+	atomic_full_barrier();
+	if (atomic_load_relaxed(&syslog_flusher_idle) != 0) {
+		atomic_store_relaxed(&syslog_flusher_idle, 0);
+		futex_wake(&syslog_flusher_idle, 1, FUTEX_PRIVATE);
+	}
+	return true;
+}
+
+// Called at thread exit.  The flusher still sends what is left in the
+// ring, and a new thread can take it over afterwards.
+void __syslog_thread_freeres(void) {
+	struct syslog_ring* ring = syslog_thread_ring;
+	if (ring == NULL)
+		return;
+	syslog_thread_ring = NULL;
+	atomic_store_release(&ring->in_use, 0);
+}
+
+static void syslog_flush_pending(void) {
+	if (atomic_load_acquire(&syslog_rings) != NULL)
+		syslog_flush();
+}
+
+// Called from exit.
+void __syslog_flush_at_exit(void) {
+	syslog_flush_pending();
+}
+
+// Called in the child after fork.  The parent sends the messages that
+// were queued at the time of the fork, and only the forking thread
+// still exists.
+void __syslog_fork_subprocess(void) {
+	__libc_lock_init(syslog_lock);
+	__libc_lock_init(syslog_flush_lock);
+	syslog_flusher_running = false;
+	syslog_flusher_idle = 0;
+	for (struct syslog_ring* ring = syslog_rings; ring != NULL; ring = ring->next) {
+		ring->tail = ring->head;
+		if (ring != syslog_thread_ring)
+			ring->in_use = 0;
+	}
+	if (syslog_thread_ring != NULL)
+		syslog_thread_ring->tid = INTERNAL_SYSCALL_CALL(gettid);
+}
+
 // ======================
 // syslog functions
 
 void closelog(void) {
+	syslog_flush_pending();
+
+	__libc_cleanup_push(syslog_unlock, NULL);
+	__libc_lock_lock(syslog_lock);
+	if (syslog_fd != -1) {
+		__close_nocancel_nostatus(syslog_fd);
+		syslog_fd = -1;
+	}
+	__libc_cleanup_pop(1);
+
 	syslog_log_tag = NULL;
 	syslog_options = 0;
 }
@@ -467,6 +844,12 @@ void closelog(void) {
 void openlog(const char* log_tag, int options, int /*facility*/) {
 	syslog_log_tag = log_tag;
 	syslog_options = options;
+	if ((options & LOG_NDELAY) != 0) {
+		__libc_cleanup_push(syslog_unlock, NULL);
+		__libc_lock_lock(syslog_lock);
+		logd_connect_locked();
+		__libc_cleanup_pop(1);
+	}
 }
 
 int setlogmask(int new_mask) {
@@ -506,8 +889,12 @@ void __vsyslog_internal(int priority, const char* fmt, va_list args, unsigned in
 	char log_line[1024];
 	int n = __vsnprintf_internal(log_line, sizeof(log_line), fmt, args, mode_flags);
 	if (n < 0) return;
+	size_t len = (size_t)n < sizeof(log_line) ? (size_t)n : sizeof(log_line) - 1;
 
-	async_safe_format_log(android_log_priority, log_tag, "%s", log_line);
+	__libc_once(syslog_once, syslog_init);
+	if (atomic_load_relaxed(&syslog_batch) == 0
+	    || !syslog_enqueue(android_log_priority, log_tag, log_line, len))
+		syslog_write(android_log_priority, log_tag, log_line, len);
 	if ((syslog_options & LOG_PERROR) != 0) {
 		bool have_newline =
 				(n > 0 && n < (int)sizeof(log_line) && log_line[n - 1] == '\n');
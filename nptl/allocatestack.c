@@ -180,6 +180,228 @@ setup_stack_prot (char *mem, size_t size, char *guard, size_t guardsize,
   return 0;
 }
 
+/* Set up a new stack of SIZE bytes at MEM, which has just been mapped
+   with PROT_NONE if GUARDSIZE is not zero: place the thread descriptor
+   at its end, make everything but the guard accessible with PROT and
+   allocate the DTV.  Return the thread descriptor, or NULL with errno
+   set.  The memory is not unmapped on failure.  */
+static struct pthread *
+setup_new_stack (void *mem, size_t size, size_t guardsize, const int prot,
+		 size_t pagesize_m1)
+{
+  struct pthread *pd;
+  size_t tls_static_align_m1 = GLRO (dl_tls_static_align) - 1;
+
+  /* Place the thread descriptor at the end of the stack.  */
+#if TLS_TCB_AT_TP
+  pd = (struct pthread *) ((((uintptr_t) mem + size)
+			    - TLS_TCB_SIZE)
+			   & ~tls_static_align_m1);
+#elif TLS_DTV_AT_TP
+  pd = (struct pthread *) ((((uintptr_t) mem + size
+			    - __nptl_tls_static_size_for_stack ())
+			    & ~tls_static_align_m1)
+			   - TLS_PRE_TCB_SIZE);
+#endif
+
+  /* Now mprotect the required region excluding the guard area.  */
+  if (__glibc_likely (guardsize > 0))
+    {
+      char *guard = guard_position (mem, size, guardsize, pd,
+				    pagesize_m1);
+      if (setup_stack_prot (mem, size, guard, guardsize, prot) != 0)
+	return NULL;
+    }
+
+  /* Remember the stack-related values.  */
+  pd->stackblock = mem;
+  pd->stackblock_size = size;
+  /* Update guardsize for newly allocated guardsize to avoid
+     an mprotect in guard resize below.  */
+  pd->guardsize = guardsize;
+
+  /* We allocated the first block thread-specific data array.
+     This address will not change for the lifetime of this
+     descriptor.  */
+  pd->specific[0] = pd->specific_1stblock;
+
+  /* This is at least the second thread.  */
+  pd->header.multiple_threads = 1;
+
+#ifdef NEED_DL_SYSINFO
+  SETUP_THREAD_SYSINFO (pd);
+#endif
+
+  /* Don't allow setxid until cloned.  */
+  pd->setxid_futex = -1;
+
+  /* Allocate the DTV for this thread.  */
+  if (_dl_allocate_tls (TLS_TPADJ (pd)) == NULL)
+    {
+      /* Something went wrong.  */
+      assert (errno == ENOMEM);
+      return NULL;
+    }
+
+  return pd;
+}
+
+/* Create up to COUNT stacks of SIZE bytes with a guard of GUARDSIZE
+   bytes in one mapping and put them into the cache, where the next
+   threads find them.  Used with glibc.pthread.stack_pool set, after a
+   miss in the stack cache, since such misses usually come in bursts of
+   thread creation, and by the refill thread below.  */
+static void
+fill_stack_cache (size_t size, size_t guardsize, const int prot,
+		  size_t pagesize_m1, size_t count)
+{
+  size_t stride = (size + pagesize_m1) & ~pagesize_m1;
+  count = MIN (count, __nptl_stack_cache_maxsize / stride);
+  if (count == 0)
+    return;
+
+  char *mem = __mmap (NULL, count * stride,
+		      (guardsize == 0) ? prot : PROT_NONE,
+		      MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+  if (mem == MAP_FAILED)
+    return;
+  if (__glibc_unlikely (__nptl_stack_hugetlb == 0))
+    __madvise (mem, count * stride, MADV_NOHUGEPAGE);
+
+  /* The stacks are unmapped separately once they leave the cache.  */
+  struct pthread *stacks[count];
+  size_t ready = 0;
+  for (size_t i = 0; i < count; i++)
+    {
+      stacks[ready] = setup_new_stack (mem + i * stride, size, guardsize,
+				       prot, pagesize_m1);
+      if (stacks[ready] != NULL)
+	ready++;
+      else
+	(void) __munmap (mem + i * stride, stride);
+    }
+
+  lll_lock (GL (dl_stack_cache_lock), LLL_PRIVATE);
+
+  for (size_t i = 0; i < ready; i++)
+    {
+      struct pthread *pd = stacks[i];
+
+      /* The stacks in the cache are made executable along with the
+	 others, but these ones might have missed that.  */
+      if (__glibc_unlikely ((GL(dl_stack_flags) & PF_X) != 0
+			    && (prot & PROT_EXEC) == 0)
+	  && __nptl_change_stack_perm (pd) != 0)
+	{
+	  _dl_deallocate_tls (TLS_TPADJ (pd), false);
+	  (void) __munmap (pd->stackblock, pd->stackblock_size);
+	  continue;
+	}
+
+      __nptl_stack_list_add (&pd->list, &GL (dl_stack_cache));
+      GL (dl_stack_cache_actsize) += pd->stackblock_size;
+    }
+  if (GL (dl_stack_cache_actsize) > __nptl_stack_cache_maxsize)
+    __nptl_free_stacks (__nptl_stack_cache_maxsize);
+
+  lll_unlock (GL (dl_stack_cache_lock), LLL_PRIVATE);
+}
+
+/* The kind of stack the refill thread keeps in the cache, set by the
+   last thread which took a stack from it.  Protected by
+   dl_stack_cache_lock.  */
+static struct
+{
+  size_t size;
+  size_t guardsize;
+  int prot;
+
+  /* True if the fields above have not been looked at yet.  */
+  bool pending;
+
+  /* Set to 1 by the refill thread before it waits for a request.  */
+  unsigned int idle;
+} stack_refill;
+
+/* With glibc.pthread.stack_pool set, keep at least half as many stacks
+   of the requested kind in the cache, so that long bursts of thread
+   creation do not have to map stacks themselves once the batch made
+   on the first miss is used up.  */
+static void *
+stack_refill_thread (void *arg)
+{
+  size_t pagesize_m1 = __getpagesize () - 1;
+
+  for (;;)
+    {
+      lll_lock (GL (dl_stack_cache_lock), LLL_PRIVATE);
+      if (!stack_refill.pending)
+	{
+	  atomic_store_relaxed (&stack_refill.idle, 1);
+	  lll_unlock (GL (dl_stack_cache_lock), LLL_PRIVATE);
+	  futex_wait_simple (&stack_refill.idle, 1, FUTEX_PRIVATE);
+	  continue;
+	}
+
+      size_t size = stack_refill.size;
+      size_t guardsize = stack_refill.guardsize;
+      int prot = stack_refill.prot;
+      stack_refill.pending = false;
+
+      size_t cached = 0;
+      list_t *entry;
+      list_for_each (entry, &GL (dl_stack_cache))
+	{
+	  struct pthread *curr = list_entry (entry, struct pthread, list);
+	  if (__nptl_stack_in_use (curr) && curr->stackblock_size == size)
+	    cached++;
+	}
+
+      lll_unlock (GL (dl_stack_cache_lock), LLL_PRIVATE);
+
+      if (cached < (size_t) __nptl_stack_pool / 2)
+	fill_stack_cache (size, guardsize, prot, pagesize_m1,
+			  __nptl_stack_pool - cached);
+    }
+  return NULL;
+}
+
+/* Ask the refill thread to keep stacks of SIZE bytes with a guard of
+   GUARDSIZE bytes in the cache, and start it if it is not running
+   yet.  Called after a stack has been taken from the cache, without
+   dl_stack_cache_lock held.  */
+static void
+request_stack_refill (size_t size, size_t guardsize, const int prot)
+{
+  unsigned int state = atomic_load_relaxed (&__nptl_stack_refill_state);
+  if (state == 2)
+    return;
+  if (state == 0
+      && atomic_compare_exchange_weak_acquire (&__nptl_stack_refill_state,
+					       &state, 1))
+    {
+      /* The thread's own stack might come from the cache and make it
+	 request a refill as well, which is overridden below.  */
+      if (__nptl_create_helper (stack_refill_thread, NULL) != 0)
+	{
+	  atomic_store_relaxed (&__nptl_stack_refill_state, 2);
+	  return;
+	}
+    }
+
+  lll_lock (GL (dl_stack_cache_lock), LLL_PRIVATE);
+  stack_refill.size = size;
+  stack_refill.guardsize = guardsize;
+  stack_refill.prot = prot;
+  stack_refill.pending = true;
+  bool wake = atomic_load_relaxed (&stack_refill.idle) != 0;
+  atomic_store_relaxed (&stack_refill.idle, 0);
+  lll_unlock (GL (dl_stack_cache_lock), LLL_PRIVATE);
+
+  if (wake)
+    futex_wake (&stack_refill.idle, 1, FUTEX_PRIVATE);
+}
+
 /* Mark the memory of the stack as usable to the kernel.  It frees everything
    except for the space used for the TCB itself.  */
 static __always_inline void
@@ -379,62 +601,15 @@ allocate_stack (const struct pthread_attr *attr, struct pthread **pdp,
 	     So we can never get a null pointer back from mmap.  */
 	  assert (mem != NULL);
 
-	  /* Place the thread descriptor at the end of the stack.  */
-#if TLS_TCB_AT_TP
-	  pd = (struct pthread *) ((((uintptr_t) mem + size)
-				    - TLS_TCB_SIZE)
-				   & ~tls_static_align_m1);
-#elif TLS_DTV_AT_TP
-	  pd = (struct pthread *) ((((uintptr_t) mem + size
-				    - tls_static_size_for_stack)
-				    & ~tls_static_align_m1)
-				   - TLS_PRE_TCB_SIZE);
-#endif
-
-	  /* Now mprotect the required region excluding the guard area.  */
-	  if (__glibc_likely (guardsize > 0))
+	  pd = setup_new_stack (mem, size, guardsize, prot, pagesize_m1);
+	  if (pd == NULL)
 	    {
-	      char *guard = guard_position (mem, size, guardsize, pd,
-					    pagesize_m1);
-	      if (setup_stack_prot (mem, size, guard, guardsize, prot) != 0)
-		{
-		  __munmap (mem, size);
-		  return errno;
-		}
-	    }
-
-	  /* Remember the stack-related values.  */
-	  pd->stackblock = mem;
-	  pd->stackblock_size = size;
-	  /* Update guardsize for newly allocated guardsize to avoid
-	     an mprotect in guard resize below.  */
-	  pd->guardsize = guardsize;
-
-	  /* We allocated the first block thread-specific data array.
-	     This address will not change for the lifetime of this
-	     descriptor.  */
-	  pd->specific[0] = pd->specific_1stblock;
-
-	  /* This is at least the second thread.  */
-	  pd->header.multiple_threads = 1;
-
-#ifdef NEED_DL_SYSINFO
-	  SETUP_THREAD_SYSINFO (pd);
-#endif
-
-	  /* Don't allow setxid until cloned.  */
-	  pd->setxid_futex = -1;
-
-	  /* Allocate the DTV for this thread.  */
-	  if (_dl_allocate_tls (TLS_TPADJ (pd)) == NULL)
-	    {
-	      /* Something went wrong.  */
-	      assert (errno == ENOMEM);
+	      int err = errno;
 
 	      /* Free the stack memory we just allocated.  */
 	      (void) __munmap (mem, size);
 
-	      return errno;
+	      return err;
 	    }
 
 
@@ -464,6 +639,11 @@ allocate_stack (const struct pthread_attr *attr, struct pthread **pdp,
 		}
 	    }
 
+	  /* Prepare the stacks of the next threads in the burst.  */
+	  if (__nptl_stack_pool > 0)
+	    fill_stack_cache (size, guardsize, prot, pagesize_m1,
+			      __nptl_stack_pool);
+
 
 	  /* Note that all of the stack and the thread descriptor is
 	     zeroed.  This means we do not have to initialize fields
@@ -472,6 +652,9 @@ allocate_stack (const struct pthread_attr *attr, struct pthread **pdp,
 	     stack is not used anymore and for the 'guardsize' field
 	     which will be read next.  */
 	}
+      else if (__nptl_stack_pool > 0)
+	/* Replace the stack in the background.  */
+	request_stack_refill (reqsize, guardsize, prot);
 
       /* Create or resize the guard area if necessary.  */
       if (__glibc_unlikely (guardsize > pd->guardsize))
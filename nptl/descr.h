@@ -404,6 +404,12 @@ struct pthread
   /* Used on strsignal.  */
   struct tls_internal_t tls_state;
 
+  /* CPU number cached by __getcpu_cached when rseq is unavailable, and
+     the number of lookups it may still serve before it is queried
+     again.  */
+  int getcpu_cache_cpu;
+  unsigned int getcpu_cache_countdown;
+
   /* rseq area registered with the kernel.  Use a custom definition
      here to isolate from kernel struct rseq changes.  The
      implementation of sched_getcpu needs acccess to the cpu_id field;
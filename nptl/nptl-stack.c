@@ -22,6 +22,8 @@
 
 size_t __nptl_stack_cache_maxsize = 40 * 1024 * 1024;
 int32_t __nptl_stack_hugetlb = 1;
+int32_t __nptl_stack_pool;
+unsigned int __nptl_stack_refill_state;
 
 void
 __nptl_stack_list_del (list_t *elem)
@@ -30,6 +30,15 @@ extern size_t __nptl_stack_cache_maxsize attribute_hidden;
 /* Should allow stacks to use hugetlb. (1) is default.  */
 extern int32_t __nptl_stack_hugetlb;
 
+/* Number of stacks to add to the cache when it has no stack for a new
+   thread.  Zero by default.  */
+extern int32_t __nptl_stack_pool attribute_hidden;
+
+/* State of the thread which refills the stack cache for
+   glibc.pthread.stack_pool: 0 if it has not been started, 1 if it is
+   running, 2 if it could not be started.  */
+extern unsigned int __nptl_stack_refill_state attribute_hidden;
+
 /* Check whether the stack is still used or not.  */
 static inline bool
 __nptl_stack_in_use (struct pthread *pd)
@@ -0,0 +1,43 @@
+/* Start a helper thread for the implementation.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <pthreadP.h>
+#include <signal.h>
+
+int
+__nptl_create_helper (void *(*start_routine) (void *), void *arg)
+{
+  /* The thread needs only very little resources.  Block all signals
+     in it but SIGSETXID.  */
+  pthread_attr_t attr;
+  __pthread_attr_init (&attr);
+  struct pthread_attr *iattr = (struct pthread_attr *) &attr;
+  iattr->flags |= ATTR_FLAG_DETACHSTATE | ATTR_FLAG_HELPER;
+  __pthread_attr_setstacksize (&attr, __pthread_get_minstack (&attr));
+  sigset_t ss;
+  __sigfillset (&ss);
+  __sigdelset (&ss, SIGSETXID);
+  int ret = __pthread_attr_setsigmask_internal (&attr, &ss);
+  if (ret == 0)
+    {
+      pthread_t th;
+      ret = __pthread_create (&th, &attr, start_routine, arg);
+    }
+  __pthread_attr_destroy (&attr);
+  return ret;
+}
@@ -29,6 +29,25 @@
 #include "pthread_cond_common.c"
 
 
+/* Wake all waiters blocked on the futex of group G.  If MUTEX is not
+   NULL, all of them use it, and they would only contend for it once
+   woken.  Wake just one of them and requeue the others to the futex of
+   MUTEX instead.  The woken waiter marks MUTEX as contended when it
+   acquires it, so that releasing it wakes a requeued waiter, which does
+   the same, and so on.  If the futex word changed, which requeueing
+   checks, fall back to waking all waiters.  */
+static void
+__condvar_broadcast_wake (pthread_cond_t *cond, unsigned int g,
+			  pthread_mutex_t *mutex, int private)
+{
+  unsigned int *futex = cond->__data.__g_signals + g;
+  if (mutex != NULL
+      && lll_futex_requeue (futex, 1, INT_MAX, &mutex->__data.__lock,
+			    atomic_load_relaxed (futex), private) == 0)
+    return;
+  futex_wake (futex, INT_MAX, private);
+}
+
 /* We do the following steps from __pthread_cond_signal in one critical
    section: (1) signal all waiters in G1, (2) close G1 so that it can become
    the new G2 and make G2 the new G1, and (3) signal all waiters in the new
@@ -51,6 +70,7 @@ ___pthread_cond_broadcast (pthread_cond_t *cond)
   unsigned int g1 = g2 ^ 1;
   wseq >>= 1;
   bool do_futex_wake = false;
+  pthread_mutex_t *mutex = NULL;
 
   /* Step (1): signal all waiters remaining in G1.  */
   if (cond->__data.__g_size[g1] != 0)
@@ -64,7 +84,9 @@ ___pthread_cond_broadcast (pthread_cond_t *cond)
       /* TODO Only set it if there are indeed futex waiters.  We could
 	 also try to move this out of the critical section in cases when
 	 G2 is empty (and we don't need to quiesce).  */
-      futex_wake (cond->__data.__g_signals + g1, INT_MAX, private);
+      __condvar_broadcast_wake (cond, g1,
+				__condvar_requeue_mutex (cond, private),
+				private);
     }
 
   /* G1 is complete.  Step (2) is next unless there are no waiters in G2, in
@@ -77,12 +99,14 @@ ___pthread_cond_broadcast (pthread_cond_t *cond)
       cond->__data.__g_size[g1] = 0;
       /* TODO Only set it if there are indeed futex waiters.  */
       do_futex_wake = true;
+      /* Switching groups observed the waiters in the new G1.  */
+      mutex = __condvar_requeue_mutex (cond, private);
     }
 
   __condvar_release_lock (cond, private);
 
   if (do_futex_wake)
-    futex_wake (cond->__data.__g_signals + g1, INT_MAX, private);
+    __condvar_broadcast_wake (cond, g1, mutex, private);
 
   return 0;
 }
@@ -18,6 +18,7 @@
 
 #include <atomic.h>
 #include <atomic_wide_counter.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <pthread.h>
 
@@ -189,6 +190,73 @@ __condvar_get_private (int flags)
     return FUTEX_SHARED;
 }
 
+/* Waiters record the mutex they use in the two words after __g_signals,
+   which pthread_cond_init and PTHREAD_COND_INITIALIZER zero but which
+   are otherwise unused.  The value is zero if no waiter has recorded a
+   mutex yet, the mutex if all waiters used the same one, and
+   __CONDVAR_MUTEX_MIXED once waiters used different mutexes.  */
+#define __CONDVAR_MUTEX_MIXED ((uintptr_t) 1)
+
+static inline uintptr_t *
+__condvar_mutex_word (pthread_cond_t *cond)
+{
+  _Static_assert (offsetof (struct __pthread_cond_s, __unused_initialized_2)
+		  == (offsetof (struct __pthread_cond_s,
+				__unused_initialized_1)
+		      + sizeof (unsigned int)),
+		  "unused condvar words are adjacent");
+  _Static_assert (sizeof (uintptr_t) <= 2 * sizeof (unsigned int)
+		  && (offsetof (struct __pthread_cond_s,
+				__unused_initialized_1)
+		      % sizeof (uintptr_t)) == 0,
+		  "unused condvar words can hold a pointer");
+  return (uintptr_t *) &cond->__data.__unused_initialized_1;
+}
+
+/* Record that a waiter, which has acquired MUTEX, waits on COND.  */
+static inline void
+__condvar_record_mutex (pthread_cond_t *cond, pthread_mutex_t *mutex)
+{
+  uintptr_t *word = __condvar_mutex_word (cond);
+  uintptr_t m = atomic_load_relaxed (word);
+  while (m == 0)
+    if (atomic_compare_exchange_weak_relaxed (word, &m, (uintptr_t) mutex))
+      return;
+  if (__glibc_unlikely (m != (uintptr_t) mutex)
+      && m != __CONDVAR_MUTEX_MIXED)
+    atomic_store_relaxed (word, __CONDVAR_MUTEX_MIXED);
+}
+
+/* Return the mutex that the waiters of COND use if a broadcast can
+   requeue them to its futex, or NULL.  The caller must have observed the
+   waiters' positions in __wseq.  */
+static inline pthread_mutex_t *
+__condvar_requeue_mutex (pthread_cond_t *cond, int private)
+{
+  if (private != FUTEX_PRIVATE)
+    return NULL;
+
+  /* Synchronize with the release fence of the waiters we observed in
+     __wseq, so that we see the mutexes they recorded.  */
+  atomic_thread_fence_acquire ();
+  uintptr_t m = atomic_load_relaxed (__condvar_mutex_word (cond));
+  if (m == 0 || m == __CONDVAR_MUTEX_MIXED)
+    return NULL;
+
+  /* Requeued waiters are woken only by an unlock that sees the mutex
+     marked as contended, which is what __pthread_mutex_cond_lock leaves
+     behind for the plain futex-based mutex types.  Robust, PI and PP
+     mutexes use different protocols, elided locks do not mark anything
+     and process-shared mutexes wake shared futex waiters.  */
+  pthread_mutex_t *mutex = (pthread_mutex_t *) m;
+  if ((atomic_load_relaxed (&mutex->__data.__kind)
+       & (PTHREAD_MUTEX_ROBUST_NORMAL_NP | PTHREAD_MUTEX_PRIO_INHERIT_NP
+	  | PTHREAD_MUTEX_PRIO_PROTECT_NP | PTHREAD_MUTEX_PSHARED_BIT
+	  | PTHREAD_MUTEX_ELISION_NP)) != 0)
+    return NULL;
+  return mutex;
+}
+
 /* This closes G1 (whose index is in G1INDEX), converts G1 into a fresh G2,
    and then switches group roles so that the former G2 becomes the new G1
    ending at the current __wseq value when we eventually make the switch
@@ -48,6 +48,13 @@ __pthread_cond_destroy (pthread_cond_t *cond)
      that they finished.  */
   unsigned int wrefs = atomic_fetch_or_acquire (&cond->__data.__wrefs, 4);
   int private = __condvar_get_private (wrefs);
+  /* Waiters that a broadcast requeued to the mutex only confirm once the
+     mutex is released, which the caller might never do before we return;
+     wake them.  The mutex is still valid because they will acquire it.  */
+  pthread_mutex_t *mutex;
+  if (wrefs >> 3 != 0
+      && (mutex = __condvar_requeue_mutex (cond, private)) != NULL)
+    futex_wake ((unsigned int *) &mutex->__data.__lock, INT_MAX, private);
   while (wrefs >> 3 != 0)
     {
       futex_wait_simple (&cond->__data.__wrefs, wrefs, private);
@@ -352,6 +352,11 @@ __pthread_cond_wait_common (pthread_cond_t *cond, pthread_mutex_t *mutex,
      signalers (see __pthread_cond_signal); modification order alone
      establishes a total order of waiters/signals.  We do need acquire MO
      to synchronize with group reinitialization in __condvar_switch_g1.  */
+  /* Let broadcasts requeue us to MUTEX; see __pthread_cond_broadcast.
+     The release fence makes the record visible to broadcasts that
+     observe our position in __wseq.  */
+  __condvar_record_mutex (cond, mutex);
+  atomic_thread_fence_release ();
   uint64_t wseq = __condvar_fetch_add_wseq_acquire (cond, 2);
   /* Find our group's index.  We always go into what was G2 when we acquired
      our position.  */
@@ -481,7 +481,10 @@ start_thread (void *arg)
      the breakpoint reports TD_THR_RUN state rather than TD_THR_ZOMBIE.  */
   atomic_fetch_or_relaxed (&pd->cancelhandling, EXITING_BITMASK);
 
-  if (__glibc_unlikely (atomic_fetch_add_relaxed (&__nptl_nthreads, -1) == 1))
+  /* Helper threads of the implementation are not counted.  */
+  if ((pd->flags & ATTR_FLAG_HELPER) == 0
+      && __glibc_unlikely (atomic_fetch_add_relaxed (&__nptl_nthreads, -1)
+			   == 1))
     /* This was the last thread.  */
     exit (0);
 
@@ -753,8 +756,12 @@ __pthread_create_2_1 (pthread_t *newthread, const pthread_attr_t *attr,
      might mistakenly think it was the only thread.  In the failure case,
      we momentarily store a false value; this doesn't matter because there
      is no kosher thing a signal handler interrupting us right here can do
-     that cares whether the thread count is correct.  */
-  atomic_fetch_add_relaxed (&__nptl_nthreads, 1);
+     that cares whether the thread count is correct.  Helper threads
+     of the implementation are not counted, so that they do not keep
+     the process alive after the last application thread has exited.  */
+  bool counted = (iattr->flags & ATTR_FLAG_HELPER) == 0;
+  if (counted)
+    atomic_fetch_add_relaxed (&__nptl_nthreads, 1);
 
   /* Our local value of stopped_start and thread_ran can be accessed at
      any time. The PD->stopped_start may only be accessed if we have
@@ -856,7 +863,8 @@ __pthread_create_2_1 (pthread_t *newthread, const pthread_attr_t *attr,
 	 NOTES above).  */
 
       /* Oops, we lied for a second.  */
-      atomic_fetch_add_relaxed (&__nptl_nthreads, -1);
+      if (counted)
+	atomic_fetch_add_relaxed (&__nptl_nthreads, -1);
 
       /* Free the resources.  */
       __nptl_deallocate_stack (pd);
@@ -22,6 +22,7 @@
 #include <stdbool.h>
 #include <unistd.h>  /* Get STDOUT_FILENO for _dl_printf.  */
 #include <elf/dl-tunables.h>
+#include <getcpu-cache.h>
 #include <nptl-stack.h>
 
 struct mutex_config __mutex_aconf =
@@ -38,6 +39,12 @@ TUNABLE_CALLBACK (set_mutex_spin_count) (tunable_val_t *valp)
   __mutex_aconf.spin_count = (int32_t) (valp)->numval;
 }
 
+static void
+TUNABLE_CALLBACK (set_mutex_adaptive_spin) (tunable_val_t *valp)
+{
+  __mutex_aconf.adaptive_spin = (int32_t) (valp)->numval;
+}
+
 static void
 TUNABLE_CALLBACK (set_stack_cache_size) (tunable_val_t *valp)
 {
@@ -50,13 +57,31 @@ TUNABLE_CALLBACK (set_stack_hugetlb) (tunable_val_t *valp)
   __nptl_stack_hugetlb = (int32_t) valp->numval;
 }
 
+static void
+TUNABLE_CALLBACK (set_stack_pool) (tunable_val_t *valp)
+{
+  __nptl_stack_pool = (int32_t) valp->numval;
+}
+
+static void
+TUNABLE_CALLBACK (set_getcpu_cache) (tunable_val_t *valp)
+{
+  __getcpu_cache_refresh = (int32_t) valp->numval;
+}
+
 void
 __pthread_tunables_init (void)
 {
   TUNABLE_GET (mutex_spin_count, int32_t,
                TUNABLE_CALLBACK (set_mutex_spin_count));
+  TUNABLE_GET (mutex_adaptive_spin, int32_t,
+	       TUNABLE_CALLBACK (set_mutex_adaptive_spin));
   TUNABLE_GET (stack_cache_size, size_t,
                TUNABLE_CALLBACK (set_stack_cache_size));
   TUNABLE_GET (stack_hugetlb, int32_t,
 	       TUNABLE_CALLBACK (set_stack_hugetlb));
+  TUNABLE_GET (stack_pool, int32_t,
+	       TUNABLE_CALLBACK (set_stack_pool));
+  TUNABLE_GET (getcpu_cache, int32_t,
+	       TUNABLE_CALLBACK (set_getcpu_cache));
 }
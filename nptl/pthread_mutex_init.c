@@ -91,6 +91,15 @@ ___pthread_mutex_init (pthread_mutex_t *mutex,
   /* Copy the values from the attribute.  */
   int mutex_kind = imutexattr->mutexkind & ~PTHREAD_MUTEXATTR_FLAG_BITS;
 
+  if (mutex_kind == PTHREAD_MUTEX_ADAPTIVE_NP
+      && __mutex_aconf.adaptive_spin != 0)
+    mutex_kind = PTHREAD_MUTEX_ADAPTIVE_SPIN_NP;
+
+  /* Robust and priority-aware mutexes spin like adaptive mutexes.  */
+  if ((imutexattr->mutexkind & (PTHREAD_MUTEXATTR_FLAG_ROBUST
+				| PTHREAD_MUTEXATTR_PROTOCOL_MASK)) != 0)
+    mutex_kind &= ~PTHREAD_MUTEX_SPIN_HISTORY_NP;
+
   if ((imutexattr->mutexkind & PTHREAD_MUTEXATTR_FLAG_ROBUST) != 0)
     {
 #ifndef __ASSUME_SET_ROBUST_LIST
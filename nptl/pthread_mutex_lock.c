@@ -26,6 +26,7 @@
 #include <futex-internal.h>
 #include <stap-probe.h>
 #include <shlib-compat.h>
+#include <pthread_mutex_spin.h>
 
 /* Some of the following definitions differ when pthread_mutex_cond_lock.c
    includes this file.  */
@@ -82,7 +83,8 @@ PTHREAD_MUTEX_LOCK (pthread_mutex_t *mutex)
   LIBC_PROBE (mutex_entry, 1, mutex);
 
   if (__builtin_expect (type & ~(PTHREAD_MUTEX_KIND_MASK_NP
-				 | PTHREAD_MUTEX_ELISION_FLAGS_NP), 0))
+				 | PTHREAD_MUTEX_ELISION_FLAGS_NP
+				 | PTHREAD_MUTEX_SPIN_HISTORY_NP), 0))
     return __pthread_mutex_lock_full (mutex);
 
   if (__glibc_likely (type == PTHREAD_MUTEX_TIMED_NP))
@@ -166,6 +168,33 @@ PTHREAD_MUTEX_LOCK (pthread_mutex_t *mutex)
 	}
       assert (mutex->__data.__owner == 0);
     }
+  else if (__builtin_expect (PTHREAD_MUTEX_TYPE (mutex)
+			     == PTHREAD_MUTEX_ADAPTIVE_SPIN_NP, 1))
+    {
+      if (LLL_MUTEX_TRYLOCK (mutex) != 0)
+	{
+	  int cnt = 0;
+	  int max_cnt = adaptive_spin_budget (mutex);
+	  int cpu = adaptive_spin_self_cpu (mutex);
+	  bool acquired = true;
+	  while (LLL_MUTEX_READ_LOCK (mutex) != 0
+		 || LLL_MUTEX_TRYLOCK (mutex) != 0)
+	    {
+	      if (cnt++ >= max_cnt
+		  || adaptive_spin_owner_preempted (mutex, cpu))
+		{
+		  LLL_MUTEX_LOCK (mutex);
+		  acquired = false;
+		  break;
+		}
+	      atomic_spin_nop ();
+	    }
+
+	  adaptive_spin_update (mutex, cnt, acquired);
+	}
+      adaptive_spin_set_owner (mutex);
+      assert (mutex->__data.__owner == 0);
+    }
   else
     {
       pid_t id = THREAD_GETMEM (THREAD_SELF, tid);
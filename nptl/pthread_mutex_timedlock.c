@@ -25,6 +25,7 @@
 #include <lowlevellock.h>
 #include <not-cancel.h>
 #include <futex-internal.h>
+#include <pthread_mutex_spin.h>
 
 #include <stap-probe.h>
 
@@ -121,6 +122,34 @@ __pthread_mutex_clocklock_common (pthread_mutex_t *mutex,
 	}
       break;
 
+    case PTHREAD_MUTEX_ADAPTIVE_SPIN_NP:
+      if (lll_trylock (mutex->__data.__lock) != 0)
+	{
+	  int cnt = 0;
+	  int max_cnt = adaptive_spin_budget (mutex);
+	  int cpu = adaptive_spin_self_cpu (mutex);
+	  bool acquired = true;
+	  do
+	    {
+	      if (cnt++ >= max_cnt
+		  || adaptive_spin_owner_preempted (mutex, cpu))
+		{
+		  result = __futex_clocklock64 (&mutex->__data.__lock,
+						clockid, abstime,
+						PTHREAD_MUTEX_PSHARED (mutex));
+		  acquired = false;
+		  break;
+		}
+	      atomic_spin_nop ();
+	    }
+	  while (lll_trylock (mutex->__data.__lock) != 0);
+
+	  adaptive_spin_update (mutex, cnt, acquired);
+	}
+      if (result == 0)
+	adaptive_spin_set_owner (mutex);
+      break;
+
     case PTHREAD_MUTEX_ROBUST_RECURSIVE_NP:
     case PTHREAD_MUTEX_ROBUST_ERRORCHECK_NP:
     case PTHREAD_MUTEX_ROBUST_NORMAL_NP:
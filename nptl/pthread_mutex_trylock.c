@@ -21,6 +21,7 @@
 #include "pthreadP.h"
 #include <lowlevellock.h>
 #include <futex-internal.h>
+#include <pthread_mutex_spin.h>
 
 int
 ___pthread_mutex_trylock (pthread_mutex_t *mutex)
@@ -80,6 +81,17 @@ ___pthread_mutex_trylock (pthread_mutex_t *mutex)
 
       return 0;
 
+    case PTHREAD_MUTEX_ADAPTIVE_SPIN_NP:
+      if (lll_trylock (mutex->__data.__lock) != 0)
+	break;
+
+      /* Record the ownership.  */
+      adaptive_spin_set_owner (mutex);
+      mutex->__data.__owner = id;
+      ++mutex->__data.__nusers;
+
+      return 0;
+
     case PTHREAD_MUTEX_ROBUST_RECURSIVE_NP:
     case PTHREAD_MUTEX_ROBUST_ERRORCHECK_NP:
     case PTHREAD_MUTEX_ROBUST_NORMAL_NP:
@@ -51,7 +51,8 @@ __pthread_mutex_unlock_usercnt (pthread_mutex_t *mutex, int decr)
   int type = PTHREAD_MUTEX_TYPE_ELISION (mutex);
   if (__builtin_expect (type
 			& ~(PTHREAD_MUTEX_KIND_MASK_NP
-			    |PTHREAD_MUTEX_ELISION_FLAGS_NP), 0))
+			    |PTHREAD_MUTEX_ELISION_FLAGS_NP
+			    |PTHREAD_MUTEX_SPIN_HISTORY_NP), 0))
     return __pthread_mutex_unlock_full (mutex, decr);
 
   if (__builtin_expect (type, PTHREAD_MUTEX_TIMED_NP)
@@ -89,7 +90,8 @@ __pthread_mutex_unlock_usercnt (pthread_mutex_t *mutex, int decr)
 	return 0;
       goto normal;
     }
-  else if (__builtin_expect (PTHREAD_MUTEX_TYPE (mutex)
+  else if (__builtin_expect ((PTHREAD_MUTEX_TYPE (mutex)
+			       & ~PTHREAD_MUTEX_SPIN_HISTORY_NP)
 			      == PTHREAD_MUTEX_ADAPTIVE_NP, 1))
     goto normal;
   else
@@ -17,6 +17,8 @@
    <https://www.gnu.org/licenses/>.  */
 
 #include <errno.h>
+#include <sched.h>
+#include <stdint.h>
 #include <sysdep.h>
 #include <pthread.h>
 #include <pthreadP.h>
@@ -24,6 +26,7 @@
 #include <stap-probe.h>
 #include <atomic.h>
 #include <futex-internal.h>
+#include <sys/param.h>
 #include <time.h>
 
 
@@ -221,6 +224,247 @@ __pthread_rwlock_get_private (pthread_rwlock_t *rwlock)
   return rwlock->__data.__shared != 0 ? FUTEX_SHARED : FUTEX_PRIVATE;
 }
 
+
+/* Rwlocks of kind PTHREAD_RWLOCK_PREFER_READER_SCALABLE_NP let readers
+   bypass __readers, which is a single cache line that all readers modify
+   otherwise.  While the lock is biased towards readers, a reader instead
+   claims the slot of a process-wide table that belongs to the pair of
+   lock and thread, by storing the address of the lock in it.  The slots
+   are pointers, so with 64-byte cache lines eight of them share a line,
+   and readers on different threads write to the same line with a
+   probability of about eight in PTHREAD_RWLOCK_BIAS_SLOTS rather than
+   always.  A writer first
+   revokes the bias and waits until no slot refers to the lock anymore.
+   Meanwhile readers acquire the lock through __readers, so a reader that
+   holds a slot can still acquire the lock recursively.  Only then does
+   the writer acquire __readers as usual.  A reader may have restored the
+   bias in between and claimed a slot, so the writer checks the slots
+   again once it holds the lock; if one is taken, it releases the lock
+   and starts over.  Revocation scans the whole table, so the bias is
+   only restored by a reader that acquires the lock through __readers a
+   while after the revocation, in proportion to how long the scan took,
+   and not while a writer still waits for the slots.
+
+   Read locks are interchangeable: if the slot of a thread refers to the
+   lock when it unlocks, it releases the slot even if another thread with
+   the same slot claimed it, and that thread then releases its read lock
+   through __readers.  Each unlock still releases exactly one read lock.
+   This requires recursive read locks, so these rwlocks prefer readers.
+
+   The table is private to the process, so process-shared rwlocks do not
+   use it.  __pad3 holds the PTHREAD_RWLOCK_BIAS_* flags, and __pad4 the
+   time in microseconds, truncated to 32 bits, until which the bias stays
+   revoked.  PTHREAD_RWLOCK_BIAS_REVOKING is set from the revocation until
+   a writer has found all slots free, or until the writer that revoked
+   the bias gives up waiting (trywrlock, or a timeout) and enables the
+   bias again.  */
+
+/* The bias stays revoked for this many times the duration of the last
+   revocation, but at most for PTHREAD_RWLOCK_BIAS_INHIBIT_MAX
+   microseconds.  */
+#define PTHREAD_RWLOCK_BIAS_INHIBIT	9
+#define PTHREAD_RWLOCK_BIAS_INHIBIT_MAX	1000000
+
+static __always_inline bool
+__pthread_rwlock_bias_supported (pthread_rwlock_t *rwlock)
+{
+  return (atomic_load_relaxed (&rwlock->__data.__pad3)
+	  & PTHREAD_RWLOCK_BIAS_SUPPORTED) != 0;
+}
+
+static inline unsigned int
+__pthread_rwlock_bias_now (void)
+{
+  struct __timespec64 ts;
+  __clock_gettime64 (CLOCK_MONOTONIC, &ts);
+  return (unsigned int) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* Return the slot of the calling thread for RWLOCK.  */
+static __always_inline pthread_rwlock_t **
+__pthread_rwlock_bias_slot (pthread_rwlock_t *rwlock)
+{
+  uintptr_t h = ((uintptr_t) rwlock >> 4) ^ ((uintptr_t) THREAD_SELF >> 6);
+  h *= (uintptr_t) 0x9e3779b97f4a7c15ULL;
+  return &__pthread_rwlock_bias_table[h >> (sizeof (uintptr_t) * 8
+					    - PTHREAD_RWLOCK_BIAS_SLOTS_LOG2)];
+}
+
+/* Try to acquire a read lock on RWLOCK through the slot of the calling
+   thread.  */
+static __always_inline bool
+__pthread_rwlock_bias_rdlock (pthread_rwlock_t *rwlock)
+{
+  if ((atomic_load_relaxed (&rwlock->__data.__pad3)
+       & PTHREAD_RWLOCK_BIAS_ENABLED) == 0)
+    return false;
+
+  pthread_rwlock_t **slot = __pthread_rwlock_bias_slot (rwlock);
+  pthread_rwlock_t *expected = NULL;
+  if (atomic_load_relaxed (slot) != NULL
+      || !atomic_compare_exchange_weak_acquire (slot, &expected, rwlock))
+    return false;
+
+  /* Pairs with the fence in __pthread_rwlock_bias_revoke: either the
+     writer observes the claimed slot, or we observe that the bias has
+     been revoked.  Acquire MO so that we synchronize with the reader
+     that enabled the bias, and thus with the writers before it.  */
+  atomic_thread_fence_seq_cst ();
+  if ((atomic_load_acquire (&rwlock->__data.__pad3)
+       & PTHREAD_RWLOCK_BIAS_ENABLED) != 0)
+    return true;
+
+  atomic_store_relaxed (slot, NULL);
+  return false;
+}
+
+/* Release a read lock on RWLOCK through the slot of the calling thread.
+   Return false if the slot does not refer to RWLOCK.  */
+static __always_inline bool
+__pthread_rwlock_bias_rdunlock (pthread_rwlock_t *rwlock)
+{
+  pthread_rwlock_t **slot = __pthread_rwlock_bias_slot (rwlock);
+  pthread_rwlock_t *expected = rwlock;
+  /* Release MO so that the critical section happens before the writer
+     that observes the empty slot.  */
+  while (!atomic_compare_exchange_weak_release (slot, &expected, NULL))
+    if (expected != rwlock)
+      return false;
+  return true;
+}
+
+/* Called by a reader that acquired RWLOCK through __readers: enable the
+   bias again once it has been revoked for long enough.  */
+static __always_inline void
+__pthread_rwlock_bias_restore (pthread_rwlock_t *rwlock)
+{
+  if (atomic_load_relaxed (&rwlock->__data.__pad3)
+      != PTHREAD_RWLOCK_BIAS_SUPPORTED)
+    return;
+
+  unsigned int left = atomic_load_relaxed (&rwlock->__data.__pad4)
+		      - __pthread_rwlock_bias_now ();
+  /* The time wraps around, so also restore the bias if it seems to stay
+     revoked for longer than possible.  */
+  unsigned int expected = PTHREAD_RWLOCK_BIAS_SUPPORTED;
+  if ((int) left <= 0 || left > PTHREAD_RWLOCK_BIAS_INHIBIT_MAX)
+    /* Release MO so that readers that claim a slot synchronize with the
+       writers we synchronized with.  A CAS so that we do not undo a
+       revocation that started after our check.  If the CAS fails
+       spuriously, the next reader restores the bias.  */
+    atomic_compare_exchange_weak_release (&rwlock->__data.__pad3,
+					  &expected,
+					  PTHREAD_RWLOCK_BIAS_SUPPORTED
+					  | PTHREAD_RWLOCK_BIAS_ENABLED);
+}
+
+/* Return true if ABSTIME, measured against CLOCKID, has passed.  */
+static bool
+__pthread_rwlock_bias_expired (clockid_t clockid,
+			       const struct __timespec64 *abstime)
+{
+  struct __timespec64 ts;
+  __clock_gettime64 (clockid, &ts);
+  return (ts.tv_sec > abstime->tv_sec
+	  || (ts.tv_sec == abstime->tv_sec && ts.tv_nsec >= abstime->tv_nsec));
+}
+
+/* Called by a writer: stop readers from claiming slots for RWLOCK.  */
+static void
+__pthread_rwlock_bias_disable (pthread_rwlock_t *rwlock)
+{
+  atomic_store_relaxed (&rwlock->__data.__pad3,
+			PTHREAD_RWLOCK_BIAS_SUPPORTED
+			| PTHREAD_RWLOCK_BIAS_REVOKING);
+  /* See __pthread_rwlock_bias_rdlock.  */
+  atomic_thread_fence_seq_cst ();
+}
+
+/* Called by a writer that gives up revoking the bias of RWLOCK: enable
+   the bias again if the writer disabled it, as BIAS says, and return
+   RESULT.  Otherwise the bias would stay disabled for good, since
+   __pthread_rwlock_bias_restore ignores locks whose bias is being
+   revoked.  */
+static int
+__pthread_rwlock_bias_cancel (pthread_rwlock_t *rwlock, unsigned int bias,
+			      int result)
+{
+  /* A CAS so that we do not enable the bias if another writer has
+     found all slots free in the meantime.  */
+  unsigned int expected = (PTHREAD_RWLOCK_BIAS_SUPPORTED
+			   | PTHREAD_RWLOCK_BIAS_REVOKING);
+  if ((bias & PTHREAD_RWLOCK_BIAS_ENABLED) != 0)
+    while (!atomic_compare_exchange_weak_relaxed (&rwlock->__data.__pad3,
+						  &expected, bias)
+	   && expected == (PTHREAD_RWLOCK_BIAS_SUPPORTED
+			   | PTHREAD_RWLOCK_BIAS_REVOKING))
+      continue;
+  return result;
+}
+
+/* Called by a writer: revoke the bias of RWLOCK and wait until no slot
+   refers to it, then return 0.  If WAIT is false, return EBUSY instead
+   of waiting for a slot.  Otherwise return ETIMEDOUT if ABSTIME passes
+   first, unless it is NULL.  The bias stays revoked if 0 is returned,
+   and is enabled again otherwise if this writer revoked it.  */
+static int
+__pthread_rwlock_bias_revoke (pthread_rwlock_t *rwlock, bool wait,
+			      clockid_t clockid,
+			      const struct __timespec64 *abstime)
+{
+  unsigned int bias = atomic_load_relaxed (&rwlock->__data.__pad3);
+  if (bias == PTHREAD_RWLOCK_BIAS_SUPPORTED)
+    return 0;
+
+  unsigned int start = __pthread_rwlock_bias_now ();
+  if ((bias & PTHREAD_RWLOCK_BIAS_ENABLED) != 0)
+    __pthread_rwlock_bias_disable (rwlock);
+
+  /* Acquire MO so that we synchronize with the readers that release
+     their slots.  */
+  for (size_t i = 0; i < PTHREAD_RWLOCK_BIAS_SLOTS; i++)
+    for (int spins = 0;
+	 atomic_load_acquire (&__pthread_rwlock_bias_table[i]) == rwlock;
+	 spins++)
+      {
+	if (!wait)
+	  return __pthread_rwlock_bias_cancel (rwlock, bias, EBUSY);
+	if (spins < 100)
+	  atomic_spin_nop ();
+	else if (abstime != NULL
+		 && __pthread_rwlock_bias_expired (clockid, abstime))
+	  return __pthread_rwlock_bias_cancel (rwlock, bias, ETIMEDOUT);
+	else
+	  {
+	    /* Another writer that revoked the bias may have given up
+	       and enabled it again.  Take over the revocation.  */
+	    unsigned int current = atomic_load_relaxed (&rwlock->__data.__pad3);
+	    if ((current & PTHREAD_RWLOCK_BIAS_ENABLED) != 0)
+	      {
+		bias = current;
+		__pthread_rwlock_bias_disable (rwlock);
+	      }
+	    __sched_yield ();
+	  }
+      }
+
+  unsigned int now = __pthread_rwlock_bias_now ();
+  unsigned int inhibit = (now - start) * PTHREAD_RWLOCK_BIAS_INHIBIT;
+  atomic_store_relaxed (&rwlock->__data.__pad4,
+			now + MIN (inhibit, PTHREAD_RWLOCK_BIAS_INHIBIT_MAX));
+
+  /* Allow readers to restore the bias.  One may have restored it
+     already, in which case the next writer revokes it again.  */
+  bias = PTHREAD_RWLOCK_BIAS_SUPPORTED | PTHREAD_RWLOCK_BIAS_REVOKING;
+  while (!atomic_compare_exchange_weak_relaxed (&rwlock->__data.__pad3,
+						&bias,
+						PTHREAD_RWLOCK_BIAS_SUPPORTED)
+	 && bias == (PTHREAD_RWLOCK_BIAS_SUPPORTED
+		     | PTHREAD_RWLOCK_BIAS_REVOKING))
+    continue;
+  return 0;
+}
+
 static __always_inline void
 __pthread_rwlock_rdunlock (pthread_rwlock_t *rwlock)
 {
@@ -278,8 +522,9 @@ __pthread_rwlock_rdunlock (pthread_rwlock_t *rwlock)
 
 
 static __always_inline int
-__pthread_rwlock_rdlock_full64 (pthread_rwlock_t *rwlock, clockid_t clockid,
-                                const struct __timespec64 *abstime)
+__pthread_rwlock_rdlock_readers64 (pthread_rwlock_t *rwlock,
+				   clockid_t clockid,
+				   const struct __timespec64 *abstime)
 {
   unsigned int r;
 
@@ -523,6 +768,24 @@ __pthread_rwlock_rdlock_full64 (pthread_rwlock_t *rwlock, clockid_t clockid,
 }
 
 
+static __always_inline int
+__pthread_rwlock_rdlock_full64 (pthread_rwlock_t *rwlock, clockid_t clockid,
+                                const struct __timespec64 *abstime)
+{
+  if (__glibc_likely (!__pthread_rwlock_bias_supported (rwlock)))
+    return __pthread_rwlock_rdlock_readers64 (rwlock, clockid, abstime);
+
+  /* A writer revokes the bias before it returns, so a writer that tries
+     to acquire a read lock still fails with EDEADLK below.  */
+  if (__pthread_rwlock_bias_rdlock (rwlock))
+    return 0;
+  int result = __pthread_rwlock_rdlock_readers64 (rwlock, clockid, abstime);
+  if (result == 0)
+    __pthread_rwlock_bias_restore (rwlock);
+  return result;
+}
+
+
 static __always_inline void
 __pthread_rwlock_wrunlock (pthread_rwlock_t *rwlock)
 {
@@ -584,26 +847,13 @@ __pthread_rwlock_wrunlock (pthread_rwlock_t *rwlock)
 }
 
 
+/* Acquire a write lock on RWLOCK through __readers, without setting
+   __cur_writer.  */
 static __always_inline int
-__pthread_rwlock_wrlock_full64 (pthread_rwlock_t *rwlock, clockid_t clockid,
-                                const struct __timespec64 *abstime)
+__pthread_rwlock_wrlock_readers64 (pthread_rwlock_t *rwlock,
+				   clockid_t clockid,
+				   const struct __timespec64 *abstime)
 {
-  /* Make sure any passed in clockid and timeout value are valid.  Note that
-     the previous implementation assumed that this check *must* not be
-     performed if there would in fact be no blocking; however, POSIX only
-     requires that "the validity of the abstime parameter need not be checked
-     if the lock can be immediately acquired" (i.e., we need not but may check
-     it).  */
-  if (abstime && __glibc_unlikely (!futex_abstimed_supported_clockid (clockid)
-      || ! valid_nanoseconds (abstime->tv_nsec)))
-    return EINVAL;
-
-  /* Make sure we are not holding the rwlock as a writer.  This is a deadlock
-     situation we recognize and report.  */
-  if (__glibc_unlikely (atomic_load_relaxed (&rwlock->__data.__cur_writer)
-			== THREAD_GETMEM (THREAD_SELF, tid)))
-    return EDEADLK;
-
   /* First we try to acquire the role of primary writer by setting WRLOCKED;
      if it was set before, there already is a primary writer.  Acquire MO so
      that we synchronize with previous primary writers.
@@ -944,6 +1194,58 @@ __pthread_rwlock_wrlock_full64 (pthread_rwlock_t *rwlock, clockid_t clockid,
     }
 
  done:
+  return 0;
+}
+
+
+static __always_inline int
+__pthread_rwlock_wrlock_full64 (pthread_rwlock_t *rwlock, clockid_t clockid,
+                                const struct __timespec64 *abstime)
+{
+  /* Make sure any passed in clockid and timeout value are valid.  Note that
+     the previous implementation assumed that this check *must* not be
+     performed if there would in fact be no blocking; however, POSIX only
+     requires that "the validity of the abstime parameter need not be checked
+     if the lock can be immediately acquired" (i.e., we need not but may check
+     it).  */
+  if (abstime && __glibc_unlikely (!futex_abstimed_supported_clockid (clockid)
+      || ! valid_nanoseconds (abstime->tv_nsec)))
+    return EINVAL;
+
+  /* Make sure we are not holding the rwlock as a writer.  This is a deadlock
+     situation we recognize and report.  */
+  if (__glibc_unlikely (atomic_load_relaxed (&rwlock->__data.__cur_writer)
+			== THREAD_GETMEM (THREAD_SELF, tid)))
+    return EDEADLK;
+
+  if (__glibc_likely (!__pthread_rwlock_bias_supported (rwlock)))
+    {
+      int result = __pthread_rwlock_wrlock_readers64 (rwlock, clockid,
+						      abstime);
+      if (result != 0)
+	return result;
+    }
+  else
+    /* The slots are drained before we acquire __readers: a reader that
+       holds a slot may acquire the lock again through __readers, which
+       it could not do once we hold the lock.  */
+    for (;;)
+      {
+	int result = __pthread_rwlock_bias_revoke (rwlock, true, clockid,
+						   abstime);
+	if (result == 0)
+	  result = __pthread_rwlock_wrlock_readers64 (rwlock, clockid,
+						      abstime);
+	if (result != 0)
+	  return result;
+	if (__pthread_rwlock_bias_revoke (rwlock, false, clockid,
+					  abstime) == 0)
+	  break;
+	/* The bias was restored before we acquired the lock, and a
+	   reader has claimed a slot since.  */
+	__pthread_rwlock_wrunlock (rwlock);
+      }
+
   atomic_store_relaxed (&rwlock->__data.__cur_writer,
 			THREAD_GETMEM (THREAD_SELF, tid));
   return 0;
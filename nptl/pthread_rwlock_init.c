@@ -26,6 +26,8 @@ static const struct pthread_rwlockattr default_rwlockattr =
     .pshared = PTHREAD_PROCESS_PRIVATE
   };
 
+pthread_rwlock_t *__pthread_rwlock_bias_table[PTHREAD_RWLOCK_BIAS_SLOTS];
+
 
 /* See pthread_rwlock_common.c.  */
 int
@@ -52,6 +54,17 @@ ___pthread_rwlock_init (pthread_rwlock_t *rwlock,
   /* The value of __SHARED in a private rwlock must be zero.  */
   rwlock->__data.__shared = (iattr->pshared != PTHREAD_PROCESS_PRIVATE);
 
+  /* A scalable rwlock is a reader-preferring one whose readers use the
+     reader slots while there are no writers.  The slots are private to
+     the process.  */
+  if (iattr->lockkind == PTHREAD_RWLOCK_PREFER_READER_SCALABLE_NP)
+    {
+      rwlock->__data.__flags = PTHREAD_RWLOCK_PREFER_READER_NP;
+      if (iattr->pshared == PTHREAD_PROCESS_PRIVATE)
+	rwlock->__data.__pad3 = (PTHREAD_RWLOCK_BIAS_SUPPORTED
+				 | PTHREAD_RWLOCK_BIAS_ENABLED);
+    }
+
   return 0;
 }
 versioned_symbol (libc, ___pthread_rwlock_init, pthread_rwlock_init,
@@ -19,6 +19,7 @@
 #include "pthreadP.h"
 #include <atomic.h>
 #include <shlib-compat.h>
+#include "pthread_rwlock_common.c"
 
 /* See pthread_rwlock_common.c for an overview.  */
 int
@@ -55,6 +56,13 @@ ___pthread_rwlock_trywrlock (pthread_rwlock_t *rwlock)
 	     may have set the PTHREAD_RWLOCK_FUTEX_USED in the meantime.  */
 	  if ((r & PTHREAD_RWLOCK_WRPHASE) == 0)
 	    atomic_store_relaxed (&rwlock->__data.__wrphase_futex, 1);
+	  /* Fail if readers still hold the lock through their slots.  */
+	  if (__glibc_unlikely (__pthread_rwlock_bias_supported (rwlock))
+	      && __pthread_rwlock_bias_revoke (rwlock, false, 0, NULL) != 0)
+	    {
+	      __pthread_rwlock_wrunlock (rwlock);
+	      return EBUSY;
+	    }
 	  atomic_store_relaxed (&rwlock->__data.__cur_writer,
 	      THREAD_GETMEM (THREAD_SELF, tid));
 	  return 0;
@@ -38,7 +38,10 @@ ___pthread_rwlock_unlock (pthread_rwlock_t *rwlock)
   if (atomic_load_relaxed (&rwlock->__data.__cur_writer)
       == THREAD_GETMEM (THREAD_SELF, tid))
       __pthread_rwlock_wrunlock (rwlock);
-  else
+  /* A read lock acquired through the slot of this thread; see
+     pthread_rwlock_common.c.  */
+  else if (!__glibc_unlikely (__pthread_rwlock_bias_supported (rwlock))
+	   || !__pthread_rwlock_bias_rdunlock (rwlock))
     __pthread_rwlock_rdunlock (rwlock);
   return 0;
 }
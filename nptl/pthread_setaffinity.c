@@ -20,6 +20,7 @@
 #include <sysdep.h>
 #include <sys/types.h>
 #include <shlib-compat.h>
+#include <getcpu-cache.h>
 
 
 int
@@ -32,6 +33,10 @@ __pthread_setaffinity_new (pthread_t th, size_t cpusetsize,
   res = INTERNAL_SYSCALL_CALL (sched_setaffinity, pd->tid, cpusetsize,
 			       cpuset);
 
+  /* The calling thread may have to move to another CPU.  */
+  if (!INTERNAL_SYSCALL_ERROR_P (res) && pd == THREAD_SELF)
+    __getcpu_cache_invalidate ();
+
   return (INTERNAL_SYSCALL_ERROR_P (res)
 	  ? INTERNAL_SYSCALL_ERRNO (res)
 	  : 0);
@@ -0,0 +1,135 @@
+/* Test that broadcasts requeue waiters to their mutex correctly.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* pthread_cond_broadcast wakes one waiter and requeues the others to the
+   futex of the mutex if all of them use the same suitable mutex.  Check
+   that every waiter eventually returns with the mutex acquired, for each
+   mutex type, also when the condvar is destroyed while the requeued
+   waiters still wait for the mutex, and after the condvar was used with
+   another mutex.  */
+
+#include <stdbool.h>
+#include <support/check.h>
+#include <support/xthread.h>
+
+#define NTHREADS 16
+#define ROUNDS 50
+
+static pthread_cond_t cond;
+static pthread_mutex_t *mutex;
+static pthread_barrier_t barrier;
+static int waiting;
+static bool go;
+static bool owned;
+
+static void *
+waiter (void *closure)
+{
+  for (int round = 0; round < ROUNDS; round++)
+    {
+      xpthread_mutex_lock (mutex);
+      waiting++;
+      while (!go)
+	xpthread_cond_wait (&cond, mutex);
+      /* Check mutual exclusion.  */
+      TEST_VERIFY (!owned);
+      owned = true;
+      if (--waiting == 0)
+	go = false;
+      owned = false;
+      xpthread_mutex_unlock (mutex);
+
+      /* Wait until all waiters have left the condvar.  */
+      xpthread_barrier_wait (&barrier);
+    }
+  return NULL;
+}
+
+static void
+test_mutex (pthread_mutex_t *m, bool destroy)
+{
+  pthread_t threads[NTHREADS];
+
+  mutex = m;
+  xpthread_barrier_init (&barrier, NULL, NTHREADS + 1);
+  for (int i = 0; i < NTHREADS; i++)
+    threads[i] = xpthread_create (NULL, waiter, NULL);
+
+  for (int round = 0; round < ROUNDS; round++)
+    {
+      /* Broadcast once all threads wait.  */
+      while (true)
+	{
+	  xpthread_mutex_lock (mutex);
+	  if (waiting == NTHREADS)
+	    break;
+	  xpthread_mutex_unlock (mutex);
+	}
+      go = true;
+      TEST_COMPARE (pthread_cond_broadcast (&cond), 0);
+      if (destroy)
+	{
+	  /* All waiters have been woken, so the condvar can be destroyed
+	     although they still wait for the mutex we hold.  */
+	  TEST_COMPARE (pthread_cond_destroy (&cond), 0);
+	  TEST_COMPARE (pthread_cond_init (&cond, NULL), 0);
+	}
+      xpthread_mutex_unlock (mutex);
+      xpthread_barrier_wait (&barrier);
+    }
+
+  for (int i = 0; i < NTHREADS; i++)
+    xpthread_join (threads[i]);
+  xpthread_barrier_destroy (&barrier);
+}
+
+static int
+do_test (void)
+{
+  static const int types[] =
+    {
+      PTHREAD_MUTEX_NORMAL,
+      PTHREAD_MUTEX_RECURSIVE,
+      PTHREAD_MUTEX_ERRORCHECK,
+      PTHREAD_MUTEX_ADAPTIVE_NP,
+    };
+
+  /* Alternate between two mutexes, so that each one is used with the
+     condvar after the other one.  */
+  static pthread_mutex_t mutexes[2];
+
+  TEST_COMPARE (pthread_cond_init (&cond, NULL), 0);
+  for (int destroy = 0; destroy < 2; destroy++)
+    for (int i = 0; i < sizeof (types) / sizeof (types[0]); i++)
+      {
+	pthread_mutex_t *m = &mutexes[i % 2];
+	pthread_mutexattr_t attr;
+	xpthread_mutexattr_init (&attr);
+	xpthread_mutexattr_settype (&attr, types[i]);
+	xpthread_mutex_init (m, &attr);
+	xpthread_mutexattr_destroy (&attr);
+
+	test_mutex (m, destroy);
+
+	xpthread_mutex_destroy (m);
+      }
+
+  return 0;
+}
+
+#include <support/test-driver.c>
@@ -0,0 +1,2 @@
+#define TYPE PTHREAD_MUTEX_ADAPTIVE_SPIN_NP
+#include "tst-mutex7.c"
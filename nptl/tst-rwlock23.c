@@ -0,0 +1,2 @@
+#define TYPE PTHREAD_RWLOCK_PREFER_READER_SCALABLE_NP
+#include "tst-rwlock2.c"
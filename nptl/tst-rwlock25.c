@@ -0,0 +1,91 @@
+/* Test that writers of reader-biased rwlocks wait for reader slots
+   without blocking readers and within their timeout.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <support/check.h>
+#include <support/timespec.h>
+#include <support/xthread.h>
+#include <support/xtime.h>
+
+static pthread_rwlock_t lock;
+
+static void *
+writer (void *closure)
+{
+  xpthread_rwlock_wrlock (&lock);
+  xpthread_rwlock_unlock (&lock);
+  return NULL;
+}
+
+static void *
+timed_writer (void *closure)
+{
+  struct timespec abstime = timespec_add (xclock_now (CLOCK_REALTIME),
+					  make_timespec (0, 100000000));
+  TEST_COMPARE (pthread_rwlock_timedwrlock (&lock, &abstime), ETIMEDOUT);
+
+  abstime = timespec_add (xclock_now (CLOCK_MONOTONIC),
+			  make_timespec (0, 100000000));
+  TEST_COMPARE (pthread_rwlock_clockwrlock (&lock, CLOCK_MONOTONIC,
+					    &abstime), ETIMEDOUT);
+  return NULL;
+}
+
+static int
+do_test (void)
+{
+  pthread_rwlockattr_t attr;
+  xpthread_rwlockattr_init (&attr);
+  xpthread_rwlockattr_setkind_np (&attr,
+				  PTHREAD_RWLOCK_PREFER_READER_SCALABLE_NP);
+  xpthread_rwlock_init (&lock, &attr);
+
+  /* The first read lock takes the slot of this thread.  A writer must
+     not block the read lock taken again meanwhile.  */
+  xpthread_rwlock_rdlock (&lock);
+  pthread_t thr = xpthread_create (NULL, writer, NULL);
+  struct timespec delay = { 0, 50000000 };
+  nanosleep (&delay, NULL);
+  xpthread_rwlock_rdlock (&lock);
+  xpthread_rwlock_unlock (&lock);
+  xpthread_rwlock_unlock (&lock);
+  xpthread_join (thr);
+
+  /* Wait until the bias may be restored, which the next read lock
+     does, and take a slot again.  Timed writers give up on time while
+     the slot is held.  */
+  nanosleep (&(struct timespec) { 1, 100000000 }, NULL);
+  xpthread_rwlock_rdlock (&lock);
+  xpthread_rwlock_unlock (&lock);
+  xpthread_rwlock_rdlock (&lock);
+  thr = xpthread_create (NULL, timed_writer, NULL);
+  xpthread_join (thr);
+  xpthread_rwlock_unlock (&lock);
+
+  /* The lock still works afterwards.  */
+  xpthread_rwlock_wrlock (&lock);
+  xpthread_rwlock_unlock (&lock);
+
+  xpthread_rwlock_destroy (&lock);
+  return 0;
+}
+
+#include <support/test-driver.c>
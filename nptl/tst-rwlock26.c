@@ -0,0 +1,94 @@
+/* Test that failed write locks keep the reader bias of an rwlock.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* A writer that gives up while a reader holds its slot of a
+   PTHREAD_RWLOCK_PREFER_READER_SCALABLE_NP rwlock has to enable the
+   bias again, since readers only restore the bias after a writer has
+   found all slots free.  */
+
+#include <array_length.h>
+#include <errno.h>
+#include <pthread.h>
+#include <pthreadP.h>
+#include <time.h>
+#include <support/check.h>
+#include <support/timespec.h>
+#include <support/xthread.h>
+#include <support/xtime.h>
+
+static pthread_rwlock_t lock;
+
+#define BIAS_ON (PTHREAD_RWLOCK_BIAS_SUPPORTED | PTHREAD_RWLOCK_BIAS_ENABLED)
+
+static void *
+try_writer (void *closure)
+{
+  TEST_COMPARE (pthread_rwlock_trywrlock (&lock), EBUSY);
+  return NULL;
+}
+
+static void *
+timed_writer (void *closure)
+{
+  struct timespec abstime = timespec_add (xclock_now (CLOCK_REALTIME),
+					  make_timespec (0, 100000000));
+  TEST_COMPARE (pthread_rwlock_timedwrlock (&lock, &abstime), ETIMEDOUT);
+  return NULL;
+}
+
+static void *
+clock_writer (void *closure)
+{
+  struct timespec abstime = timespec_add (xclock_now (CLOCK_MONOTONIC),
+					  make_timespec (0, 100000000));
+  TEST_COMPARE (pthread_rwlock_clockwrlock (&lock, CLOCK_MONOTONIC,
+					    &abstime), ETIMEDOUT);
+  return NULL;
+}
+
+static int
+do_test (void)
+{
+  pthread_rwlockattr_t attr;
+  xpthread_rwlockattr_init (&attr);
+  xpthread_rwlockattr_setkind_np (&attr,
+				  PTHREAD_RWLOCK_PREFER_READER_SCALABLE_NP);
+  xpthread_rwlock_init (&lock, &attr);
+  TEST_COMPARE (lock.__data.__pad3, BIAS_ON);
+
+  /* The read lock takes the slot of this thread, which makes the
+     writers give up.  */
+  void *(*writers[]) (void *) = { try_writer, timed_writer, clock_writer };
+  for (int i = 0; i < array_length (writers); i++)
+    {
+      xpthread_rwlock_rdlock (&lock);
+      xpthread_join (xpthread_create (NULL, writers[i], NULL));
+      TEST_COMPARE (lock.__data.__pad3, BIAS_ON);
+      xpthread_rwlock_unlock (&lock);
+    }
+
+  /* A writer that finds all slots free revokes the bias.  */
+  xpthread_rwlock_wrlock (&lock);
+  xpthread_rwlock_unlock (&lock);
+  TEST_COMPARE (lock.__data.__pad3, PTHREAD_RWLOCK_BIAS_SUPPORTED);
+
+  xpthread_rwlock_destroy (&lock);
+  return 0;
+}
+
+#include <support/test-driver.c>
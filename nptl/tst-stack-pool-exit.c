@@ -0,0 +1,55 @@
+/* Test that the stack refill thread does not keep the process alive.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* Run with glibc.pthread.stack_pool set.  Threads which find their
+   stack in the cache start the refill thread.  The main thread then
+   calls pthread_exit, and the process has to terminate once the last
+   other thread is done, instead of running into the test timeout.  */
+
+#include <pthread.h>
+#include <support/xthread.h>
+#include <support/xunistd.h>
+
+static void *
+threadfunc (void *closure)
+{
+  return closure;
+}
+
+static void *
+lastfunc (void *closure)
+{
+  /* Let the refill thread fill the cache and go to sleep.  */
+  usleep (100 * 1000);
+  return NULL;
+}
+
+static int
+do_test (void)
+{
+  /* The first thread maps a batch of stacks, the following ones take
+     theirs from the cache.  */
+  for (int i = 0; i < 16; i++)
+    xpthread_join (xpthread_create (NULL, threadfunc, NULL));
+
+  xpthread_detach (xpthread_create (NULL, lastfunc, NULL));
+  pthread_exit (NULL);
+  return 1;                     /* Not reached.  */
+}
+
+#include <support/test-driver.c>
@@ -0,0 +1,118 @@
+/* Test thread creation with a pool of prepared stacks.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* Run with glibc.pthread.stack_pool set, so that most threads get a
+   stack that was prepared along with the stack of another thread or
+   by the refill thread.  Check that every thread gets its own stack
+   with the requested size and guard, also when the stacks come from
+   the cache in later rounds and in a child process.  */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <support/check.h>
+#include <support/xthread.h>
+#include <support/xunistd.h>
+
+#define NTHREADS 64
+#define ROUNDS 3
+
+static pthread_barrier_t barrier;
+static size_t stacksize;
+static size_t guardsize;
+
+static void *
+thread_func (void *closure)
+{
+  uintptr_t *stackaddr = closure;
+  pthread_attr_t attr;
+  void *addr;
+  size_t size;
+
+  TEST_COMPARE (pthread_getattr_np (pthread_self (), &attr), 0);
+  TEST_COMPARE (pthread_attr_getstack (&attr, &addr, &size), 0);
+  TEST_VERIFY (size >= stacksize);
+  TEST_COMPARE (pthread_attr_getguardsize (&attr, &size), 0);
+  TEST_COMPARE (size, guardsize);
+  xpthread_attr_destroy (&attr);
+
+  /* Use a good part of the stack.  */
+  char buf[stacksize / 2];
+  memset (buf, 0xa5, sizeof buf);
+  TEST_VERIFY ((uintptr_t) buf >= (uintptr_t) addr);
+  *stackaddr = (uintptr_t) addr;
+
+  /* Keep all threads alive at the same time.  */
+  xpthread_barrier_wait (&barrier);
+  TEST_VERIFY (buf[0] == (char) 0xa5 && buf[sizeof buf - 1] == (char) 0xa5);
+  return NULL;
+}
+
+static void
+run_round (pthread_attr_t *attr)
+{
+  pthread_t threads[NTHREADS];
+  uintptr_t stackaddrs[NTHREADS];
+
+  for (int i = 0; i < NTHREADS; i++)
+    threads[i] = xpthread_create (attr, thread_func, &stackaddrs[i]);
+  for (int i = 0; i < NTHREADS; i++)
+    xpthread_join (threads[i]);
+
+  for (int i = 0; i < NTHREADS; i++)
+    for (int j = i + 1; j < NTHREADS; j++)
+      TEST_VERIFY (stackaddrs[i] != stackaddrs[j]);
+}
+
+static int
+do_test (void)
+{
+  long pagesize = sysconf (_SC_PAGESIZE);
+  stacksize = 16 * pagesize;
+  guardsize = 2 * pagesize;
+
+  pthread_attr_t attr;
+  xpthread_attr_init (&attr);
+  xpthread_attr_setstacksize (&attr, stacksize);
+  xpthread_attr_setguardsize (&attr, guardsize);
+  xpthread_barrier_init (&barrier, NULL, NTHREADS);
+
+  for (int round = 0; round < ROUNDS; round++)
+    run_round (&attr);
+
+  /* The thread refilling the cache has to be started again in the
+     child.  */
+  pid_t pid = xfork ();
+  if (pid == 0)
+    {
+      run_round (&attr);
+      run_round (&attr);
+      exit (0);
+    }
+  int status;
+  xwaitpid (pid, &status, 0);
+  TEST_VERIFY (WIFEXITED (status) && WEXITSTATUS (status) == 0);
+
+  xpthread_barrier_destroy (&barrier);
+  xpthread_attr_destroy (&attr);
+  return 0;
+}
+
+#include <support/test-driver.c>
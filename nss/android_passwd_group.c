@@ -9,17 +9,43 @@
 #include "android_ids.h"
 #include "android_passwd_group.h"
 
-struct android_id_info * find_android_id_info_by_id(unsigned id) {
-	for (size_t n = 0; n < android_id_count; ++n)
-		if (android_ids[n].aid == id)
-			return &android_ids[n];
+/* The system IDs are looked up in the tables generated from
+   android_system_user_ids.h by gen-android-ids.py, which are sorted
+   so that both lookups are binary searches.  */
+#include <android-id-index.h>
+
+#define android_id_index_count \
+	(sizeof(android_ids_by_name)/sizeof(android_ids_by_name[0]))
+
+const struct android_id_entry * find_android_id_info_by_id(unsigned id) {
+	size_t left = 0, right = android_id_index_count;
+
+	while (left < right) {
+		size_t middle = left + (right - left) / 2;
+		const struct android_id_entry *e = &android_ids_by_name[android_ids_by_aid[middle]];
+		if (e->aid == id)
+			return e;
+		if (e->aid > id)
+			right = middle;
+		else
+			left = middle + 1;
+	}
 	return NULL;
 }
 
-struct android_id_info * find_android_id_info_by_name(const char* name) {
-	for (size_t n = 0; n < android_id_count; ++n)
-		if (!strcmp(android_ids[n].name, name))
-			return &android_ids[n];
+const struct android_id_entry * find_android_id_info_by_name(const char* name) {
+	size_t left = 0, right = android_id_index_count;
+
+	while (left < right) {
+		size_t middle = left + (right - left) / 2;
+		int cmp = strcmp(name, android_ids_by_name[middle].name);
+		if (cmp == 0)
+			return &android_ids_by_name[middle];
+		if (cmp < 0)
+			right = middle;
+		else
+			left = middle + 1;
+	}
 	return NULL;
 }
 
@@ -65,6 +91,9 @@ int is_valid_id_android(id_t id, int is_group) {
 
 id_t oem_id_from_name_android(const char* name) {
 	unsigned int id;
+	/* Most names are not OEM names; reject them without sscanf.  */
+	if (strncmp(name, "oem_", 4) != 0)
+		return 0;
 	if (sscanf(name, "oem_%u", &id) != 1) {
 		return 0;
 	}
@@ -77,13 +106,11 @@ id_t oem_id_from_name_android(const char* name) {
 id_t app_id_from_name_android(const char* name, int is_group) {
 	char* end;
 	unsigned long userid;
-	struct android_id_info* info;
+	const struct android_id_entry* info;
 	int is_shared_gid = 0;
 
 	if (is_group && name[0] == 'a' && name[1] == 'l' && name[2] == 'l') {
-		end = malloc(strlen(name));
-		for (int i=3; i<strlen(name); i++)
-			strncat(end, &name[i], 1);
+		end = (char *)name + 3;
 		userid = 0;
 		is_shared_gid = 1;
 	} else if (name[0] == 'u' && isdigit(name[1])) {
@@ -147,7 +174,7 @@ id_t app_id_from_name_android(const char* name, int is_group) {
 void get_name_by_uid_android(uid_t uid, char *name_u) {
 	uid_t appid = uid % AID_USER_OFFSET;
 	uid_t userid = uid / AID_USER_OFFSET;
-	struct android_id_info* info;
+	const struct android_id_entry* info;
 
 	if (appid >= AID_ISOLATED_START) {
 		sprintf(name_u, "u%u_i%u", userid, appid - AID_ISOLATED_START);
@@ -162,7 +189,7 @@ void get_name_by_uid_android(uid_t uid, char *name_u) {
 void get_name_by_gid_android(gid_t gid, char *name_g) {
 	uid_t appid = gid % AID_USER_OFFSET;
 	uid_t userid = gid / AID_USER_OFFSET;
-	struct android_id_info* info;
+	const struct android_id_entry* info;
 
 	if (appid >= AID_ISOLATED_START) {
 		sprintf(name_g, "u%u_i%u", userid, appid - AID_ISOLATED_START);
@@ -241,7 +268,7 @@ struct group * getgrgid_android(gid_t gid) {
 
 struct passwd * getpwnam_android(const char* name) {
 	uid_t uid;
-	struct android_id_info* info;
+	const struct android_id_entry* info;
 
 	uid = app_id_from_name_android(name, 0);
 	if (uid != 0)
@@ -260,7 +287,7 @@ struct passwd * getpwnam_android(const char* name) {
 
 struct group * getgrnam_android(const char* name) {
 	gid_t gid;
-	struct android_id_info* info;
+	const struct android_id_entry* info;
 
 	gid = app_id_from_name_android(name, 1);
 	if (gid != 0)
@@ -4,8 +4,14 @@
 #include <pwd.h>
 #include <grp.h>
 
-struct android_id_info * find_android_id_info_by_id(unsigned id);
-struct android_id_info * find_android_id_info_by_name(const char* name);
+/* One entry of the generated android-id-index.h.  */
+struct android_id_entry {
+	const char *name;
+	unsigned aid;
+};
+
+const struct android_id_entry * find_android_id_info_by_id(unsigned id);
+const struct android_id_entry * find_android_id_info_by_name(const char* name);
 int is_oem_id_android(id_t id);
 int is_valid_id_android(id_t id, int is_group);
 id_t oem_id_from_name_android(const char* name);
@@ -0,0 +1,112 @@
+#!/usr/bin/python3
+# Generate the lookup index for the Android system user and group IDs.
+# Copyright (C) 2024 Free Software Foundation, Inc.
+# This file is part of the GNU C Library.
+#
+# The GNU C Library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# The GNU C Library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with the GNU C Library; if not, see
+# <https://www.gnu.org/licenses/>.
+
+"""Generate android-id-index.h from android_system_user_ids.h.
+
+The names follow bionic's fs_config_generator.py: the AID_ prefix is
+dropped, the rest is lower-cased, and a few names are fixed up.  Range
+limits and other macros that do not name a single ID are skipped.  The
+entries are sorted by name, and a second array lists their indices in
+order of ID, so that both kinds of lookup are binary searches.
+"""
+
+import argparse
+import re
+import sys
+
+
+# Friendly names that differ from the lower-cased macro name.
+FIXUPS = {
+    'media_codec': 'mediacodec',
+    'media_drm': 'mediadrm',
+    'media_ex': 'mediaex',
+}
+
+# Macros that do not name a single ID.
+SKIP = {'AID_APP', 'AID_USER', 'AID_USER_OFFSET', 'AID_OVERFLOWUID'}
+
+DEFINE_RE = re.compile(r'^\s*#\s*define\s+(AID_[A-Z0-9_]+)\s+(\d+)\b')
+
+
+def read_ids(path):
+    """Return a list of (name, id) pairs for the IDs defined in PATH."""
+    ids = []
+    with open(path, encoding='utf-8') as f:
+        for line in f:
+            m = DEFINE_RE.match(line)
+            if m is None:
+                continue
+            macro = m.group(1)
+            if (macro in SKIP or macro.endswith('_START')
+                    or macro.endswith('_END')):
+                continue
+            name = macro[len('AID_'):].lower()
+            ids.append((FIXUPS.get(name, name), int(m.group(2))))
+    return ids
+
+
+def check_ids(ids):
+    """Reject duplicate names and IDs, which would make lookups
+    ambiguous."""
+    names = set()
+    values = set()
+    for name, value in ids:
+        if name in names:
+            sys.exit('duplicate Android ID name: %s' % name)
+        if value in values:
+            sys.exit('duplicate Android ID: %d' % value)
+        names.add(name)
+        values.add(value)
+
+
+def write_index(ids, out):
+    """Write the C tables for IDS to OUT."""
+    by_name = sorted(ids)
+    by_aid = sorted(range(len(by_name)), key=lambda i: by_name[i][1])
+    out.write('/* This file is automatically generated by gen-android-ids.py.\n'
+              '   Do not edit.  */\n\n')
+    out.write('/* Sorted by name with strcmp.  */\n')
+    out.write('static const struct android_id_entry android_ids_by_name[] =\n'
+              '{\n')
+    for name, value in by_name:
+        out.write('  { "%s", %d },\n' % (name, value))
+    out.write('};\n\n')
+    out.write('/* Indices into android_ids_by_name, sorted by ID.  */\n')
+    out.write('static const unsigned char android_ids_by_aid[] =\n{\n')
+    for i in by_aid:
+        out.write('  %d, /* %d */\n' % (i, by_name[i][1]))
+    out.write('};\n')
+
+
+def main():
+    """The main entry point."""
+    parser = argparse.ArgumentParser(
+        description='Generate the Android ID lookup index.')
+    parser.add_argument('header',
+                        help='header with the AID_* definitions')
+    args = parser.parse_args()
+    ids = read_ids(args.header)
+    check_ids(ids)
+    if len(ids) > 255:
+        sys.exit('too many Android IDs for an unsigned char index')
+    write_index(ids, sys.stdout)
+
+
+if __name__ == '__main__':
+    main()
@@ -23,6 +23,7 @@
 #include <nss/nss_database.h>
 #include <register-atfork.h>
 #include <stdio-lock.h>
+#include <stdlib.h>
 #include <sys/single_threaded.h>
 #include <unwind-link.h>
 
@@ -105,6 +106,10 @@ __libc_fork (void)
       /* Reset the lock protecting dynamic TLS related data.  */
       __rtld_lock_initialize (GL(dl_load_tls_lock));
 
+      /* Erase the arc4random state, so that the child does not repeat
+	 the output of the parent.  */
+      call_function_static_weak (__arc4random_fork_subprocess);
+
       reclaim_stacks ();
 
       /* Run the handlers registered for the child.  */
@@ -17,21 +17,69 @@
    <https://www.gnu.org/licenses/>.  */
 
 #include <errno.h>
+#include <ldsodefs.h>
+#include <libc-lock.h>
+#include <libc-pointer-arith.h>
 #include <not-cancel.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/mman.h>
 #include <sys/param.h>
 #include <sys/random.h>
 
+/* Each thread keeps a buffer of ChaCha20 keystream, and arc4random
+   hands out bytes from it.  Whenever the buffer is refilled, the start
+   of the new keystream becomes the next key and is erased from the
+   buffer, so that earlier output cannot be recovered from the state.
+   The key is seeded from the kernel on first use, and again after
+   ARC4RANDOM_RESEED_SIZE bytes.
+
+   The states live in mappings that are excluded from core dumps and
+   wiped in the child on fork.  The fork handler also erases the state
+   of the forking thread, in case the kernel does not support
+   MADV_WIPEONFORK.  */
+
+#include <chacha20.c>
+
+/* Number of bytes generated from one seed.  */
+#define ARC4RANDOM_RESEED_SIZE (16 * 1024 * 1024)
+
+/* Size of the mappings the states are carved from.  */
+#define ARC4RANDOM_CHUNK_SIZE (16 * 1024)
+
+struct arc4random_state
+{
+  uint32_t ctx[CHACHA20_STATE_LEN];
+  uint8_t buf[CHACHA20_BUFSIZE];
+  /* Number of unused bytes at the end of BUF.  */
+  size_t have;
+  /* Number of bytes left until the next reseed.  Zero forces a reseed,
+     so an all-zero state is valid.  */
+  size_t count;
+  /* Link in the list of unused states.  */
+  struct arc4random_state *next;
+};
+
+/* Protects free_states, chunk_next and chunk_left.  */
+__libc_lock_define_initialized (static, state_lock);
+/* States released by exited threads.  */
+static struct arc4random_state *free_states;
+/* Unused part of the last mapping.  */
+static char *chunk_next;
+static size_t chunk_left;
+
+static __thread struct arc4random_state *thread_state attribute_tls_model_ie;
+
 static void
 arc4random_getrandom_failure (void)
 {
   __libc_fatal ("Fatal glibc error: cannot get entropy for arc4random\n");
 }
 
-void
-__arc4random_buf (void *p, size_t n)
+/* Fill P with N bytes of entropy from the kernel.  */
+static void
+arc4random_getentropy (void *p, size_t n)
 {
   static int seen_initialized;
   ssize_t l;
@@ -88,6 +136,135 @@ __arc4random_buf (void *p, size_t n)
   if (__close_nocancel (fd) < 0)
     arc4random_getrandom_failure ();
 }
+
+/* Return a zeroed state, or NULL if no memory is available.  */
+static struct arc4random_state *
+arc4random_alloc_state (void)
+{
+  struct arc4random_state *state;
+
+  __libc_lock_lock (state_lock);
+  state = free_states;
+  if (state != NULL)
+    {
+      free_states = state->next;
+      state->next = NULL;
+    }
+  else
+    {
+      if (chunk_left < sizeof (*state))
+	{
+	  size_t size = ALIGN_UP (ARC4RANDOM_CHUNK_SIZE, GLRO (dl_pagesize));
+	  void *p = __mmap (NULL, size, PROT_READ | PROT_WRITE,
+			    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	  if (p == MAP_FAILED)
+	    {
+	      __libc_lock_unlock (state_lock);
+	      return NULL;
+	    }
+#ifdef MADV_DONTDUMP
+	  __madvise (p, size, MADV_DONTDUMP);
+#endif
+#ifdef MADV_WIPEONFORK
+	  __madvise (p, size, MADV_WIPEONFORK);
+#endif
+	  chunk_next = p;
+	  chunk_left = size;
+	}
+      state = (struct arc4random_state *) chunk_next;
+      chunk_next += sizeof (*state);
+      chunk_left -= sizeof (*state);
+    }
+  __libc_lock_unlock (state_lock);
+
+  return state;
+}
+
+/* Refill the keystream buffer of STATE, reseeding it first if
+   needed.  */
+static void
+arc4random_refill (struct arc4random_state *state)
+{
+  if (state->count < sizeof (state->buf))
+    {
+      uint8_t seed[CHACHA20_KEY_SIZE + CHACHA20_IV_SIZE];
+      arc4random_getentropy (seed, sizeof seed);
+      chacha20_init (state->ctx, seed, seed + CHACHA20_KEY_SIZE);
+      explicit_bzero (seed, sizeof seed);
+      state->count = ARC4RANDOM_RESEED_SIZE;
+    }
+
+  chacha20_keystream (state->ctx, state->buf, sizeof state->buf);
+
+  /* Rekey immediately for backtracking resistance.  */
+  chacha20_init (state->ctx, state->buf, state->buf + CHACHA20_KEY_SIZE);
+  explicit_bzero (state->buf, CHACHA20_KEY_SIZE + CHACHA20_IV_SIZE);
+  state->have = sizeof (state->buf) - (CHACHA20_KEY_SIZE + CHACHA20_IV_SIZE);
+  state->count -= sizeof (state->buf);
+}
+
+/* Called from the fork function in the child.  Only the current
+   thread exists there, so the states of the other threads and the
+   unused ones are abandoned.  */
+void
+__arc4random_fork_subprocess (void)
+{
+  __libc_lock_init (state_lock);
+  free_states = NULL;
+  chunk_next = NULL;
+  chunk_left = 0;
+
+  struct arc4random_state *state = thread_state;
+  if (state != NULL)
+    explicit_bzero (state, sizeof (*state));
+}
+
+/* Erase the state of the exiting thread and make it available for
+   reuse.  */
+void
+__arc4random_thread_freeres (void)
+{
+  struct arc4random_state *state = thread_state;
+  if (state == NULL)
+    return;
+  thread_state = NULL;
+
+  explicit_bzero (state, sizeof (*state));
+  __libc_lock_lock (state_lock);
+  state->next = free_states;
+  free_states = state;
+  __libc_lock_unlock (state_lock);
+}
+
+void
+__arc4random_buf (void *p, size_t n)
+{
+  struct arc4random_state *state = thread_state;
+  if (__glibc_unlikely (state == NULL))
+    {
+      state = arc4random_alloc_state ();
+      if (state == NULL)
+	{
+	  arc4random_getentropy (p, n);
+	  return;
+	}
+      thread_state = state;
+    }
+
+  while (n > 0)
+    {
+      if (state->have == 0)
+	arc4random_refill (state);
+
+      size_t m = MIN (n, state->have);
+      uint8_t *ks = state->buf + sizeof (state->buf) - state->have;
+      memcpy (p, ks, m);
+      explicit_bzero (ks, m);
+      p = (uint8_t *) p + m;
+      n -= m;
+      state->have -= m;
+    }
+}
 libc_hidden_def (__arc4random_buf)
 weak_alias (__arc4random_buf, arc4random_buf)
 
@@ -0,0 +1,127 @@
+/* Generic ChaCha20 implementation (used on arc4random).
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <endian.h>
+#include <stdint.h>
+#include <string.h>
+
+/* 32-bit block counter, then 96-bit nonce.  */
+#define CHACHA20_IV_SIZE	16
+#define CHACHA20_KEY_SIZE	32
+
+#define CHACHA20_STATE_LEN	16
+#define CHACHA20_BLOCK_SIZE	64
+
+/* Number of keystream bytes generated at once.  */
+#ifndef CHACHA20_BUFSIZE
+# define CHACHA20_BUFSIZE	(8 * CHACHA20_BLOCK_SIZE)
+#endif
+
+/* The ChaCha20 implementation is based on RFC 8439.  Only the keystream
+   is generated, since arc4random has no plaintext to XOR it with.  */
+
+enum chacha20_constants
+{
+  CHACHA20_CONSTANT_EXPA = 0x61707865U,
+  CHACHA20_CONSTANT_ND_3 = 0x3320646eU,
+  CHACHA20_CONSTANT_2_BY = 0x79622d32U,
+  CHACHA20_CONSTANT_TE_K = 0x6b206574U
+};
+
+static inline uint32_t
+read_le32 (const uint8_t *p)
+{
+  uint32_t r;
+  memcpy (&r, p, sizeof (r));
+  return le32toh (r);
+}
+
+static inline void
+write_le32 (uint8_t *p, uint32_t v)
+{
+  v = htole32 (v);
+  memcpy (p, &v, sizeof (v));
+}
+
+static inline void
+chacha20_init (uint32_t *state, const uint8_t *key, const uint8_t *iv)
+{
+  state[0]  = CHACHA20_CONSTANT_EXPA;
+  state[1]  = CHACHA20_CONSTANT_ND_3;
+  state[2]  = CHACHA20_CONSTANT_2_BY;
+  state[3]  = CHACHA20_CONSTANT_TE_K;
+
+  for (int i = 0; i < CHACHA20_KEY_SIZE / sizeof (uint32_t); i++)
+    state[4 + i] = read_le32 (key + i * sizeof (uint32_t));
+
+  for (int i = 0; i < CHACHA20_IV_SIZE / sizeof (uint32_t); i++)
+    state[12 + i] = read_le32 (iv + i * sizeof (uint32_t));
+}
+
+static inline uint32_t
+rotl32 (unsigned int shift, uint32_t word)
+{
+  return (word << (shift & 31)) | (word >> ((-shift) & 31));
+}
+
+#define QROUND(_x0, _x1, _x2, _x3) 			\
+  do {							\
+   _x0 = _x0 + _x1; _x3 = rotl32 (16, (_x0 ^ _x3)); 	\
+   _x2 = _x2 + _x3; _x1 = rotl32 (12, (_x1 ^ _x2)); 	\
+   _x0 = _x0 + _x1; _x3 = rotl32 (8,  (_x0 ^ _x3));	\
+   _x2 = _x2 + _x3; _x1 = rotl32 (7,  (_x1 ^ _x2));	\
+  } while (0)
+
+/* Store the keystream block for STATE in DST and advance the block
+   counter.  */
+static inline void
+chacha20_block (uint32_t *state, uint8_t *dst)
+{
+  uint32_t x[CHACHA20_STATE_LEN];
+
+  memcpy (x, state, sizeof (x));
+
+  for (int i = 0; i < 20; i += 2)
+    {
+      QROUND (x[0], x[4], x[8],  x[12]);
+      QROUND (x[1], x[5], x[9],  x[13]);
+      QROUND (x[2], x[6], x[10], x[14]);
+      QROUND (x[3], x[7], x[11], x[15]);
+
+      QROUND (x[0], x[5], x[10], x[15]);
+      QROUND (x[1], x[6], x[11], x[12]);
+      QROUND (x[2], x[7], x[8],  x[13]);
+      QROUND (x[3], x[4], x[9],  x[14]);
+    }
+
+  for (int i = 0; i < CHACHA20_STATE_LEN; i++)
+    write_le32 (dst + i * sizeof (uint32_t), x[i] + state[i]);
+
+  state[12]++;
+}
+
+#undef QROUND
+
+/* Store LEN bytes of keystream in DST.  LEN must be a multiple of
+   CHACHA20_BLOCK_SIZE.  */
+static void
+chacha20_keystream (uint32_t *state, uint8_t *dst, size_t len)
+{
+  for (; len > 0; len -= CHACHA20_BLOCK_SIZE, dst += CHACHA20_BLOCK_SIZE)
+    chacha20_block (state, dst);
+}
@@ -126,7 +126,11 @@ __run_exit_handlers (int status, struct exit_function_list **listp,
   __libc_lock_unlock (__exit_funcs_lock);
 
   if (run_list_atexit)
-    call_function_static_weak (_IO_cleanup);
+    {
+      /* Send messages queued by the asynchronous syslog path.  */
+      call_function_static_weak (__syslog_flush_at_exit);
+      call_function_static_weak (_IO_cleanup);
+    }
 
   _exit (status);
 }
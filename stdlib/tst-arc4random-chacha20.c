@@ -0,0 +1,77 @@
+/* Basic tests for the ChaCha20 implementation used by arc4random.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#include <chacha20.c>
+#include <support/check.h>
+
+/* Test vector from RFC 8439, section 2.3.2.  */
+static const uint8_t key[CHACHA20_KEY_SIZE] =
+{
+  0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+  0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+  0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17,
+  0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f,
+};
+
+/* Block counter 1, then the nonce.  */
+static const uint8_t iv[CHACHA20_IV_SIZE] =
+{
+  0x01, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 0x4a, 0x00, 0x00, 0x00, 0x00,
+};
+
+static const uint8_t expected[CHACHA20_BLOCK_SIZE] =
+{
+  0x10, 0xf1, 0xe7, 0xe4, 0xd1, 0x3b, 0x59, 0x15,
+  0x50, 0x0f, 0xdd, 0x1f, 0xa3, 0x20, 0x71, 0xc4,
+  0xc7, 0xd1, 0xf4, 0xc7, 0x33, 0xc0, 0x68, 0x03,
+  0x04, 0x22, 0xaa, 0x9a, 0xc3, 0xd4, 0x6c, 0x4e,
+  0xd2, 0x82, 0x64, 0x46, 0x07, 0x9f, 0xaa, 0x09,
+  0x14, 0xc2, 0xd7, 0x05, 0xd9, 0x8b, 0x02, 0xa2,
+  0xb5, 0x12, 0x9c, 0xd1, 0xde, 0x16, 0x4e, 0xb9,
+  0xcb, 0xd0, 0x83, 0xe8, 0xa2, 0x50, 0x3c, 0x4e,
+};
+
+static int
+do_test (void)
+{
+  uint32_t state[CHACHA20_STATE_LEN];
+  uint8_t block[CHACHA20_BLOCK_SIZE];
+
+  chacha20_init (state, key, iv);
+  chacha20_keystream (state, block, sizeof block);
+  TEST_COMPARE_BLOB (block, sizeof block, expected, sizeof expected);
+  /* The block counter is advanced.  */
+  TEST_COMPARE (state[12], 2);
+
+  /* Generating several blocks at once gives the same keystream as
+     generating them one by one.  */
+  uint8_t buf[CHACHA20_BUFSIZE];
+  uint8_t ref[CHACHA20_BUFSIZE];
+  chacha20_init (state, key, iv);
+  chacha20_keystream (state, buf, sizeof buf);
+  chacha20_init (state, key, iv);
+  for (size_t i = 0; i < sizeof ref; i += CHACHA20_BLOCK_SIZE)
+    chacha20_keystream (state, ref + i, CHACHA20_BLOCK_SIZE);
+  TEST_COMPARE_BLOB (buf, sizeof buf, ref, sizeof ref);
+  TEST_COMPARE_BLOB (buf, CHACHA20_BLOCK_SIZE, expected, sizeof expected);
+
+  return 0;
+}
+
+#include <support/test-driver.c>
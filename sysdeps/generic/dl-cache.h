@@ -220,6 +220,14 @@ enum cache_extension_tag
       size must be a multiple of 4.  */
    cache_extension_tag_glibc_hwcaps,
 
+   /* Hash index of the keys of the new format entries.  A struct
+      cache_name_hash, see below.  The dynamic loader uses it instead
+      of the binary search over the sorted entries if it is present.
+
+      For this section, 4-byte alignment is required, and the section
+      size must match the number of buckets.  */
+   cache_extension_tag_name_hash,
+
    /* Total number of known cache extension tags.  */
    cache_extension_count
   };
@@ -255,6 +263,51 @@ struct cache_extension
   struct cache_extension_section sections[];
 };
 
+/* Marks an unused bucket in struct cache_name_hash.  */
+enum { cache_name_hash_empty = (uint32_t) -1 };
+
+/* Bucket of the cache_extension_tag_name_hash section.  */
+struct cache_name_hash_bucket
+{
+  /* Hash of the key, computed with _dl_cache_name_hash.  */
+  uint32_t hash;
+
+  /* Index of the first entry in struct cache_file_new with this key,
+     or cache_name_hash_empty.  */
+  uint32_t index;
+};
+
+/* Contents of the cache_extension_tag_name_hash section.  The table
+   uses open addressing: the key of an entry hashed to HASH is found in
+   the first bucket starting at HASH % nbuckets, wrapping around, that
+   either is empty or holds that key.  There is one bucket for every
+   distinct key, for the first of the entries with that key, and at
+   least a quarter of the buckets are empty.  */
+struct cache_name_hash
+{
+  uint32_t nbuckets;		/* Number of buckets, a power of two.  */
+  struct cache_name_hash_bucket buckets[];
+};
+
+/* Return the hash of NAME for struct cache_name_hash.  Names which
+   _dl_cache_libcmp considers equal have the same hash: leading zeros
+   of numbers are ignored, like the numeric comparison does.  */
+static inline uint32_t
+_dl_cache_name_hash (const char *name)
+{
+  uint32_t hash = 5381;
+  bool in_number = false;
+  for (; *name != '\0'; ++name)
+    {
+      bool digit = *name >= '0' && *name <= '9';
+      if (digit && !in_number && *name == '0')
+	continue;
+      in_number = digit;
+      hash = hash * 33 + (unsigned char) *name;
+    }
+  return hash;
+}
+
 /* A relocated version of struct cache_extension_section.  */
 struct cache_extension_loaded
 {
@@ -293,6 +346,27 @@ cache_extension_verify (struct cache_extension_all_loaded *loaded)
 	hwcaps->flags = 0;
       }
   }
+
+  {
+    /* The buckets must fill the section exactly, and their number
+       must be a non-zero power of two.  */
+    struct cache_extension_loaded *hash
+      = &loaded->sections[cache_extension_tag_name_hash];
+    const struct cache_name_hash *table = hash->base;
+    if (hash->size < sizeof (struct cache_name_hash)
+	|| ((uintptr_t) hash->base % 4) != 0
+	|| table->nbuckets == 0
+	|| (table->nbuckets & (table->nbuckets - 1)) != 0
+	|| ((hash->size - sizeof (struct cache_name_hash))
+	    / sizeof (struct cache_name_hash_bucket)) != table->nbuckets
+	|| ((hash->size - sizeof (struct cache_name_hash))
+	    % sizeof (struct cache_name_hash_bucket)) != 0)
+      {
+	hash->base = NULL;
+	hash->size = 0;
+	hash->flags = 0;
+      }
+  }
 }
 
 static bool __attribute__ ((unused))
@@ -350,6 +424,208 @@ cache_extension_load (const struct cache_file_new *cache,
 (((addr) + __alignof__ (struct cache_file_new) -1)	\
  & (~(__alignof__ (struct cache_file_new) - 1)))
 
-extern int _dl_cache_libcmp (const char *p1, const char *p2) attribute_hidden;
+/* Compare the library names P1 and P2 like strcmp, except that numbers
+   are compared by their value.  ldconfig sorts the cache entries in
+   descending order of this comparison.  */
+static inline int
+_dl_cache_libcmp (const char *p1, const char *p2)
+{
+  while (*p1 != '\0')
+    {
+      if (*p1 >= '0' && *p1 <= '9')
+        {
+          if (*p2 >= '0' && *p2 <= '9')
+            {
+	      /* Must compare this numerically.  */
+	      int val1;
+	      int val2;
+
+	      val1 = *p1++ - '0';
+	      val2 = *p2++ - '0';
+	      while (*p1 >= '0' && *p1 <= '9')
+	        val1 = val1 * 10 + *p1++ - '0';
+	      while (*p2 >= '0' && *p2 <= '9')
+	        val2 = val2 * 10 + *p2++ - '0';
+	      if (val1 != val2)
+		return val1 - val2;
+	    }
+	  else
+            return 1;
+        }
+      else if (*p2 >= '0' && *p2 <= '9')
+        return -1;
+      else if (*p1 != *p2)
+        return *p1 - *p2;
+      else
+	{
+	  ++p1;
+	  ++p2;
+	}
+    }
+  return *p1 - *p2;
+}
+
+/* True if PTR is a valid string table index.  */
+static inline bool
+_dl_cache_verify_ptr (uint32_t ptr, size_t string_table_size)
+{
+  return ptr < string_table_size;
+}
+
+/* Compute the address of the element INDEX of the array at LIBS.
+   Conceptually, this is &LIBS[INDEX], but use ENTRY_SIZE for the size
+   of *LIBS.  */
+static inline const struct file_entry *
+_dl_cache_file_entry (const struct file_entry *libs, size_t entry_size,
+		      size_t index)
+{
+  return (const void *) libs + index * entry_size;
+}
+
+/* Search the NLIBS entries at LIBS, each ENTRY_SIZE bytes long, for
+   the key NAME.  We use binary search since the table is sorted in the
+   cache file.  It is important to use the same algorithm as used while
+   generating the cache file.  Return the index of the first entry with
+   the key, and store in *MATCHED the index of the last entry known to
+   have it and in *LAST the index of the last entry which may have it.
+   Return -1 if there is no such entry or if a string table index is
+   bogus.  STRING_TABLE_SIZE indicates the maximum offset in
+   STRING_TABLE at which data is mapped; it is not exact.  */
+static inline int
+_dl_cache_search_binary (const char *string_table,
+			 uint32_t string_table_size,
+			 const struct file_entry *libs, uint32_t nlibs,
+			 uint32_t entry_size, const char *name,
+			 int *matched, int *last)
+{
+  int left = 0;
+  int right = nlibs - 1;
+
+  while (left <= right)
+    {
+      int middle = (left + right) / 2;
+      uint32_t key = _dl_cache_file_entry (libs, entry_size, middle)->key;
+
+      /* Make sure string table indices are not bogus before using
+	 them.  */
+      if (!_dl_cache_verify_ptr (key, string_table_size))
+	return -1;
+
+      /* Actually compare the entry with the key.  */
+      int cmpres = _dl_cache_libcmp (name, string_table + key);
+      if (__glibc_unlikely (cmpres == 0))
+	{
+	  /* Found it.  This is the last entry for which we know the
+	     name is correct.  */
+	  *matched = middle;
+	  *last = right;
+
+	  /* There might be entries with this name before the one we
+	     found.  So we have to find the beginning.  */
+	  while (middle > 0)
+	    {
+	      key = _dl_cache_file_entry (libs, entry_size, middle - 1)->key;
+	      /* Make sure string table indices are not bogus before
+		 using them.  */
+	      if (!_dl_cache_verify_ptr (key, string_table_size)
+		  /* Actually compare the entry.  */
+		  || _dl_cache_libcmp (name, string_table + key) != 0)
+		break;
+	      --middle;
+	    }
+	  return middle;
+	}
+
+      if (cmpres < 0)
+	left = middle + 1;
+      else
+	right = middle - 1;
+    }
+
+  return -1;
+}
+
+/* Like _dl_cache_search_binary, but find the first entry with the key
+   NAME in the hash index HASH instead of searching for it.  */
+static inline int
+_dl_cache_search_hashed (const char *string_table,
+			 uint32_t string_table_size,
+			 const struct file_entry *libs, uint32_t nlibs,
+			 uint32_t entry_size,
+			 const struct cache_name_hash *hash,
+			 const char *name, int *matched, int *last)
+{
+  uint32_t hashval = _dl_cache_name_hash (name);
+  uint32_t mask = hash->nbuckets - 1;
+  uint32_t bucket = hashval & mask;
+
+  /* An index generated by ldconfig always has empty buckets, but do
+     not rely on that.  */
+  for (uint32_t probes = 0; probes <= mask; ++probes)
+    {
+      uint32_t index = hash->buckets[bucket].index;
+      if (index == cache_name_hash_empty
+	  /* Make sure the index is not bogus before using it.  */
+	  || index >= nlibs)
+	return -1;
+
+      if (hash->buckets[bucket].hash == hashval)
+	{
+	  uint32_t key = _dl_cache_file_entry (libs, entry_size, index)->key;
+	  if (!_dl_cache_verify_ptr (key, string_table_size))
+	    return -1;
+	  if (_dl_cache_libcmp (name, string_table + key) == 0)
+	    {
+	      /* A corrupt index may point into the middle of the
+		 entries for NAME.  */
+	      while (index > 0)
+		{
+		  key = _dl_cache_file_entry (libs, entry_size,
+					      index - 1)->key;
+		  if (!_dl_cache_verify_ptr (key, string_table_size)
+		      || _dl_cache_libcmp (name, string_table + key) != 0)
+		    break;
+		  --index;
+		}
+	      *matched = index;
+	      *last = nlibs - 1;
+	      return index;
+	    }
+	}
+
+      bucket = (bucket + 1) & mask;
+    }
+
+  return -1;
+}
+
+/* Return the number of buckets of a cache_extension_tag_name_hash
+   section for COUNT keys.  At least a quarter of the buckets are kept
+   empty, so that lookups of names which are not in the cache end
+   soon.  */
+static inline uint32_t
+_dl_cache_name_hash_buckets (uint32_t count)
+{
+  uint32_t nbuckets = 4;
+  while (nbuckets - nbuckets / 4 < count)
+    nbuckets *= 2;
+  return nbuckets;
+}
+
+/* Enter the entry INDEX with the key NAME into HASH, which has to
+   have an empty bucket left.  Only the first of the entries with the
+   same key is entered.  */
+static inline void
+_dl_cache_name_hash_insert (struct cache_name_hash *hash, const char *name,
+			    uint32_t index)
+{
+  uint32_t hashval = _dl_cache_name_hash (name);
+  uint32_t mask = hash->nbuckets - 1;
+  uint32_t bucket = hashval & mask;
+  while (hash->buckets[bucket].index != cache_name_hash_empty)
+    bucket = (bucket + 1) & mask;
+  hash->buckets[bucket].hash = hashval;
+  hash->buckets[bucket].index = index;
+}
 
 #endif /* _DL_CACHE_H */
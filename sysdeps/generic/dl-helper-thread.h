@@ -0,0 +1,69 @@
+/* Helper threads for the dynamic linker.  Generic stub version.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#ifndef DL_HELPER_THREAD_H
+#define DL_HELPER_THREAD_H
+
+#include <stdbool.h>
+
+/* A thread which runs a function of the dynamic linker during
+   startup, before libc is initialized.  It shares the thread control
+   block of the thread which created it, so the function must not use
+   thread-local state.  */
+struct dl_helper_thread
+{
+  int unused;
+};
+
+/* Start THREAD running FUNC (ARG).  Return false if no thread can be
+   created.  */
+static inline bool
+_dl_helper_thread_create (struct dl_helper_thread *thread,
+			  int (*func) (void *), void *arg)
+{
+  return false;
+}
+
+/* Wait until THREAD has returned from its function and release its
+   resources.  */
+static inline void
+_dl_helper_thread_join (struct dl_helper_thread *thread)
+{
+}
+
+/* Return the number of CPUs the process may run on.  */
+static inline int
+_dl_helper_thread_cpus (void)
+{
+  return 1;
+}
+
+/* Block while *WORD is VALUE, until _dl_helper_thread_wake is called
+   for WORD.  May return spuriously.  */
+static inline void
+_dl_helper_thread_wait (unsigned int *word, unsigned int value)
+{
+}
+
+/* Wake all threads blocked on WORD.  */
+static inline void
+_dl_helper_thread_wake (unsigned int *word)
+{
+}
+
+#endif /* DL_HELPER_THREAD_H */
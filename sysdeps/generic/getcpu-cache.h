@@ -0,0 +1,53 @@
+/* CPU number lookup for threads without rseq.  Generic version.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#ifndef _GETCPU_CACHE_H
+#define _GETCPU_CACHE_H
+
+#include <stdbool.h>
+
+/* Return true if the glibc.pthread.getcpu_cache tunable enables the
+   cache.  */
+static inline bool
+__getcpu_cache_enabled (void)
+{
+  return false;
+}
+
+/* Return the CPU the calling thread runs on, or -1 if unknown.  */
+static inline int
+__getcpu_cached (void)
+{
+  return -1;
+}
+
+/* Return the CPU the calling thread runs on if it is known without
+   asking the kernel, or -1.  */
+static inline int
+__getcpu_peek (void)
+{
+  return -1;
+}
+
+/* Drop the cached CPU number of the calling thread.  */
+static inline void
+__getcpu_cache_invalidate (void)
+{
+}
+
+#endif /* getcpu-cache.h */
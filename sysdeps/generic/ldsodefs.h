@@ -350,6 +350,26 @@ struct rtld_global
       size_t n_elements;
       void (*free) (void *);
     } _ns_unique_sym_table;
+    /* Results of symbol lookups in the global scope during relocation
+       processing, see dl-lookup.c.  */
+    struct lookup_cache_table
+    {
+      struct lookup_cache_entry
+      {
+	uint32_t hashval;
+	int type_class;
+	const char *name;
+	const char *version_name;
+	ElfW(Word) version_hash;
+	int version_hidden;
+	int found;
+	const ElfW(Sym) *sym;
+	struct link_map *map;
+      } *entries;
+      size_t size;
+      size_t n_elements;
+      void (*free) (void *);
+    } _ns_lookup_cache;
     /* Keep track of changes to each namespace' list.  */
     struct r_debug_extended _ns_debug;
   } _dl_ns[DL_NNS];
@@ -389,6 +409,15 @@ struct rtld_global
   EXTERN unsigned long int _dl_num_relocations;
   EXTERN unsigned long int _dl_num_cache_relocations;
 
+#ifdef SHARED
+  /* Nonzero while objects are relocated on helper threads during
+     startup, see _dl_relocate_parallel.  Symbol lookups then update
+     the lookup cache and the unique symbol tables only with
+     _dl_parallel_relocation_lock held.  */
+  EXTERN int _dl_parallel_relocation;
+  EXTERN int _dl_parallel_relocation_lock;
+#endif
+
   /* List of search directories.  */
   EXTERN struct r_search_path_elem *_dl_all_dirs;
 
@@ -432,6 +461,9 @@ struct rtld_global
   {
     size_t len;
     struct dtv_slotinfo_list *next;
+    /* Largest generation of the entries in slotinfo, so that
+       _dl_update_slotinfo can skip elements without changes.  */
+    size_t gen;
     struct dtv_slotinfo
     {
       size_t gen;
@@ -982,6 +1014,34 @@ extern lookup_t _dl_lookup_symbol_x (const char *undef,
 				     struct link_map *skip_map)
      attribute_hidden;
 
+/* Forget the symbol lookups cached for namespace NSID.  This is
+   necessary whenever its global scope changes or objects are
+   removed from it.  */
+extern void _dl_lookup_cache_reset (Lmid_t nsid) attribute_hidden;
+
+/* Record in the lookup cache of namespace NSID that looking up
+   UNDEF_NAME with hash NEW_HASH, version VERSION and type class
+   TYPE_CLASS in the global scope yields SYM in MAP, and that the
+   search stopped there if FOUND is nonzero.  Return false if the
+   cache is disabled or cannot be allocated.  */
+extern bool _dl_lookup_cache_insert (Lmid_t nsid, const char *undef_name,
+				     unsigned int new_hash,
+				     const struct r_found_version *version,
+				     int type_class, int found,
+				     const ElfW(Sym) *sym,
+				     struct link_map *map) attribute_hidden;
+
+/* Return true if looking up UNDEF_NAME with hash NEW_HASH, version
+   VERSION and type class TYPE_CLASS in MAP finds SYM, and if FOUND is
+   what the search of the global scope returns for it, so that the
+   result can be entered in the lookup cache.  */
+extern bool _dl_lookup_cache_check (const char *undef_name,
+				    unsigned int new_hash,
+				    const struct r_found_version *version,
+				    int type_class, int found,
+				    const ElfW(Sym) *sym,
+				    struct link_map *map) attribute_hidden;
+
 
 /* Restricted version of _dl_lookup_symbol_x.  Searches MAP (and only
    MAP) for the symbol UNDEF_NAME, with GNU hash NEW_HASH (computed
@@ -0,0 +1,40 @@
+/* Malloc NUMA support.  Generic implementation.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License as
+   published by the Free Software Foundation; either version 2.1 of the
+   License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; see the file COPYING.LIB.  If
+   not, see <https://www.gnu.org/licenses/>.  */
+
+#ifndef _MALLOC_NUMA_H
+#define _MALLOC_NUMA_H
+
+#include <stddef.h>
+
+/* Highest number of NUMA nodes that memory can be bound to.  */
+#define MALLOC_NUMA_MAX_NODES 1024
+
+/* Return the number of NUMA nodes of the system, or 1 if it is not
+   known.  */
+int __malloc_numa_nodes (void) attribute_hidden;
+
+/* Return the NUMA node of the CPU the calling thread runs on, or -1 if
+   it is not known.  */
+int __malloc_numa_node (void) attribute_hidden;
+
+/* Make the pages of the LEN bytes at ADDR come from NODE when they are
+   first touched, unless it has no free memory left.  Return 0 on
+   success and -1 on failure, without changing errno.  */
+int __malloc_numa_bind (void *addr, size_t len, int node) attribute_hidden;
+
+#endif /* _MALLOC_NUMA_H */
@@ -16,6 +16,7 @@
   "LD_ORIGIN_PATH\0"							      \
   "LD_PRELOAD\0"							      \
   "LD_PROFILE\0"							      \
+  "LD_RELOC_CACHE\0"							      \
   "LD_SHOW_AUXV\0"							      \
   "LD_VERBOSE\0"							      \
   "LD_WARN\0"								      \
@@ -30,6 +31,7 @@
   "GLIBC_LD_ORIGIN_PATH\0"						      \
   "GLIBC_LD_PRELOAD\0"							      \
   "GLIBC_LD_PROFILE\0"							      \
+  "GLIBC_LD_RELOC_CACHE\0"						      \
   "GLIBC_LD_SHOW_AUXV\0"						      \
   "GLIBC_LD_VERBOSE\0"							      \
   "GLIBC_LD_WARN\0"							      \
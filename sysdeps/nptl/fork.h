@@ -24,8 +24,10 @@
 #include <ldsodefs.h>
 #include <list.h>
 #include <mqueue.h>
+#include <nptl-stack.h>
 #include <pthreadP.h>
 #include <sysdep.h>
+#include <syslog.h>
 
 static inline void
 fork_system_setup (void)
@@ -44,8 +46,14 @@ fork_system_setup_after_fork (void)
   GL (dl_stack_cache_lock) = LLL_LOCK_INITIALIZER;
   __default_pthread_attr_lock = LLL_LOCK_INITIALIZER;
 
+  /* The thread refilling the stack cache does not exist in the child.
+     It is started again when a stack is taken from the cache.  */
+  if (__nptl_stack_refill_state == 1)
+    __nptl_stack_refill_state = 0;
+
   call_function_static_weak (__mq_notify_fork_subprocess);
   call_function_static_weak (__timer_fork_subprocess);
+  call_function_static_weak (__syslog_fork_subprocess);
 }
 
 /* In case of a fork() call the memory allocation in the child will be
@@ -49,6 +49,9 @@ struct pthread_attr
 #define ATTR_FLAG_SCHED_SET		0x0020
 #define ATTR_FLAG_POLICY_SET		0x0040
 #define ATTR_FLAG_DO_RSEQ		0x0080
+/* Set by __nptl_create_helper.  The thread is not counted in
+   __nptl_nthreads.  */
+#define ATTR_FLAG_HELPER		0x0100
 
 /* Used to allocate a pthread_attr_t object which is also accessed
    internally.  */
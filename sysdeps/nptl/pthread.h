@@ -60,6 +60,8 @@ enum
 #ifdef __USE_GNU
   /* For compatibility.  */
   , PTHREAD_MUTEX_FAST_NP = PTHREAD_MUTEX_TIMED_NP
+  /* Adaptive mutex that learns how long to spin.  */
+  , PTHREAD_MUTEX_ADAPTIVE_SPIN_NP = PTHREAD_MUTEX_ADAPTIVE_NP | 4
 #endif
 };
 
@@ -106,6 +108,7 @@ enum
   PTHREAD_RWLOCK_PREFER_READER_NP,
   PTHREAD_RWLOCK_PREFER_WRITER_NP,
   PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP,
+  PTHREAD_RWLOCK_PREFER_READER_SCALABLE_NP,
   PTHREAD_RWLOCK_DEFAULT_NP = PTHREAD_RWLOCK_PREFER_READER_NP
 };
 
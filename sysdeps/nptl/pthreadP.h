@@ -60,6 +60,10 @@ enum
 {
   PTHREAD_MUTEX_KIND_MASK_NP = 3,
 
+  /* Set together with PTHREAD_MUTEX_ADAPTIVE_NP for
+     PTHREAD_MUTEX_ADAPTIVE_SPIN_NP, see pthread_mutex_spin.h.  */
+  PTHREAD_MUTEX_SPIN_HISTORY_NP = 4,
+
   PTHREAD_MUTEX_ELISION_NP    = 256,
   PTHREAD_MUTEX_NO_ELISION_NP = 512,
 
@@ -160,6 +164,15 @@ enum
 #define PTHREAD_RWLOCK_WRHANDOVER	((unsigned int) 1 \
 					 << (sizeof (unsigned int) * 8 - 1))
 #define PTHREAD_RWLOCK_FUTEX_USED	2
+#define PTHREAD_RWLOCK_BIAS_SUPPORTED	1
+#define PTHREAD_RWLOCK_BIAS_ENABLED	2
+#define PTHREAD_RWLOCK_BIAS_REVOKING	4
+#define PTHREAD_RWLOCK_BIAS_SLOTS_LOG2	12
+#define PTHREAD_RWLOCK_BIAS_SLOTS	(1 << PTHREAD_RWLOCK_BIAS_SLOTS_LOG2)
+
+/* Reader slots of PTHREAD_RWLOCK_PREFER_READER_SCALABLE_NP rwlocks.  */
+extern pthread_rwlock_t *__pthread_rwlock_bias_table
+  [PTHREAD_RWLOCK_BIAS_SLOTS] attribute_hidden;
 
 
 /* Bits used in robust mutex implementation.  */
@@ -324,6 +337,14 @@ extern unsigned long int *__fork_generation_pointer attribute_hidden;
 extern size_t __pthread_get_minstack (const pthread_attr_t *attr);
 libc_hidden_proto (__pthread_get_minstack)
 
+/* Start a detached thread running START_ROUTINE (ARG) for use by the
+   implementation, with a minimal stack and all signals blocked except
+   SIGSETXID.  The thread is not counted in __nptl_nthreads, so it does
+   not keep the process alive once the last application thread has
+   exited.  Returns 0 or an error number.  */
+extern int __nptl_create_helper (void *(*start_routine) (void *),
+				 void *arg) attribute_hidden;
+
 /* Namespace save aliases.  */
 extern int __pthread_getschedparam (pthread_t thread_id, int *policy,
 				    struct sched_param *param);
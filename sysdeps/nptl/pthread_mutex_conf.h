@@ -23,6 +23,9 @@
 struct mutex_config
 {
   int spin_count;
+  /* Nonzero if adaptive mutexes learn how long to spin, as
+     PTHREAD_MUTEX_ADAPTIVE_SPIN_NP mutexes do.  */
+  int adaptive_spin;
 };
 
 extern struct mutex_config __mutex_aconf;
@@ -0,0 +1,97 @@
+/* Spinning of PTHREAD_MUTEX_ADAPTIVE_SPIN_NP mutexes.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#ifndef _PTHREAD_MUTEX_SPIN_H
+#define _PTHREAD_MUTEX_SPIN_H 1
+
+#include <getcpu-cache.h>
+#include <pthreadP.h>
+#include <stdbool.h>
+#include <sys/param.h>
+
+/* A PTHREAD_MUTEX_ADAPTIVE_SPIN_NP mutex keeps a spin budget in __spins,
+   learned from the acquisitions that had to wait.  It grows towards
+   twice the number of spins after which the lock was acquired, and
+   shrinks by a quarter whenever spinning did not pay off, so that a
+   lock which is held for long, or by threads that get preempted, soon
+   goes to the futex right away.
+
+   __count, which only recursive mutexes use otherwise, holds the CPU
+   the owner took the lock on plus one, or zero if that is unknown.  A
+   spinning thread on that same CPU knows that the owner cannot be
+   running and stops spinning.  The owner only records CPU numbers that
+   are known without a system call.  */
+
+/* Minimum spin budget, so that a budget of zero can grow again.  */
+#define ADAPTIVE_SPIN_MIN 10
+
+/* Return the number of times to spin on MUTEX before blocking.  */
+static inline int
+adaptive_spin_budget (pthread_mutex_t *mutex)
+{
+  return MIN (max_adaptive_count (),
+	      mutex->__data.__spins + ADAPTIVE_SPIN_MIN);
+}
+
+/* Return the CPU number the owner of MUTEX recorded, or -1.  */
+static inline int
+adaptive_spin_owner_cpu (pthread_mutex_t *mutex)
+{
+  return (int) atomic_load_relaxed (&mutex->__data.__count) - 1;
+}
+
+/* Record the CPU of the calling thread, which has just acquired
+   MUTEX.  */
+static inline void
+adaptive_spin_set_owner (pthread_mutex_t *mutex)
+{
+  atomic_store_relaxed (&mutex->__data.__count, __getcpu_peek () + 1);
+}
+
+/* Return true if spinning on MUTEX is pointless because its owner is
+   preempted by the calling thread, which runs on CPU.  */
+static inline bool
+adaptive_spin_owner_preempted (pthread_mutex_t *mutex, int cpu)
+{
+  return cpu >= 0 && adaptive_spin_owner_cpu (mutex) == cpu;
+}
+
+/* Return the CPU to pass to adaptive_spin_owner_preempted while
+   spinning on MUTEX.  Only look it up if the owner recorded its CPU.  */
+static inline int
+adaptive_spin_self_cpu (pthread_mutex_t *mutex)
+{
+  if (adaptive_spin_owner_cpu (mutex) < 0)
+    return -1;
+  return __getcpu_cached ();
+}
+
+/* Learn from an acquisition of MUTEX that spun CNT times, and either
+   got the lock by spinning (ACQUIRED) or had to block.  */
+static inline void
+adaptive_spin_update (pthread_mutex_t *mutex, int cnt, bool acquired)
+{
+  int budget = mutex->__data.__spins;
+  if (acquired)
+    budget += (2 * cnt - budget) / 8;
+  else
+    budget -= budget / 4;
+  mutex->__data.__spins = MIN (budget, max_adaptive_count ());
+}
+
+#endif
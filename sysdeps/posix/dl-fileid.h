@@ -20,11 +20,14 @@
 #include <sys/stat.h>
 
 /* For POSIX.1 systems, the pair of st_dev and st_ino constitute
-   a unique identifier for a file.  */
+   a unique identifier for a file.  The modification time is only
+   recorded to tell whether the file was changed in place.  */
 struct r_file_id
   {
     dev_t dev;
     ino64_t ino;
+    __time64_t mtime_sec;
+    __time64_t mtime_nsec;
   };
 
 /* Sample FD to fill in *ID.  Returns true on success.
@@ -39,6 +42,8 @@ _dl_get_file_id (int fd, struct r_file_id *id)
 
   id->dev = st.st_dev;
   id->ino = st.st_ino;
+  id->mtime_sec = st.st_mtim.tv_sec;
+  id->mtime_nsec = st.st_mtim.tv_nsec;
   return true;
 }
 
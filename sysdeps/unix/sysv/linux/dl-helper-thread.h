@@ -0,0 +1,146 @@
+/* Helper threads for the dynamic linker.  Linux version.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#ifndef DL_HELPER_THREAD_H
+#define DL_HELPER_THREAD_H
+
+#include <atomic.h>
+#include <clone_internal.h>
+#include <errno.h>
+#include <limits.h>
+#include <ldsodefs.h>
+#include <libc-pointer-arith.h>
+#include <lowlevellock-futex.h>
+#include <sched.h>
+#include <stackinfo.h>
+#include <stdbool.h>
+#include <sys/mman.h>
+#include <sysdep.h>
+
+/* The stack size of a helper thread, without the guard page.  */
+#define DL_HELPER_THREAD_STACK_SIZE (256 * 1024)
+
+/* A thread which runs a function of the dynamic linker during
+   startup, before libc is initialized.  It shares the thread control
+   block of the thread which created it, so the function must not use
+   thread-local state.  */
+struct dl_helper_thread
+{
+  void *stack;
+  size_t stack_size;
+
+  /* Nonzero until the kernel clears it when the thread exits
+     (CLONE_CHILD_CLEARTID).  */
+  pid_t tid;
+};
+
+/* Start THREAD running FUNC (ARG).  Return false if no thread can be
+   created.  */
+static inline bool
+_dl_helper_thread_create (struct dl_helper_thread *thread,
+			  int (*func) (void *), void *arg)
+{
+  size_t guardsize = GLRO(dl_pagesize);
+  size_t size = ALIGN_UP (DL_HELPER_THREAD_STACK_SIZE, guardsize) + guardsize;
+  void *stack = __mmap (NULL, size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+  if (stack == MAP_FAILED)
+    return false;
+
+#if _STACK_GROWS_DOWN
+  void *guard = stack;
+  void *base = stack + guardsize;
+#else
+  void *guard = stack + size - guardsize;
+  void *base = stack;
+#endif
+  if (__mprotect (guard, guardsize, PROT_NONE) != 0)
+    {
+      __munmap (stack, size);
+      return false;
+    }
+
+  thread->stack = stack;
+  thread->stack_size = size;
+  /* Set before the thread is created, so that a thread which exits
+     right away cannot be mistaken for a running one.  */
+  thread->tid = -1;
+
+  struct clone_args clone_args =
+    {
+      .flags = (CLONE_VM | CLONE_FS | CLONE_FILES | CLONE_SIGHAND
+		| CLONE_THREAD | CLONE_SYSVSEM | CLONE_CHILD_CLEARTID),
+      .stack = (uintptr_t) base,
+      .stack_size = size - guardsize,
+      .child_tid = (uintptr_t) &thread->tid,
+    };
+  if (__clone_internal (&clone_args, func, arg) == -1)
+    {
+      __munmap (stack, size);
+      return false;
+    }
+  return true;
+}
+
+/* Wait until THREAD has returned from its function and release its
+   resources.  */
+static inline void
+_dl_helper_thread_join (struct dl_helper_thread *thread)
+{
+  /* The kernel wakes shared futex waiters on the TID.  */
+  pid_t tid;
+  while ((tid = atomic_load_acquire (&thread->tid)) != 0)
+    lll_futex_wait (&thread->tid, tid, LLL_SHARED);
+
+  __munmap (thread->stack, thread->stack_size);
+}
+
+/* Return the number of CPUs the process may run on.  */
+static inline int
+_dl_helper_thread_cpus (void)
+{
+  unsigned long int mask[1024 / (8 * sizeof (unsigned long int))];
+  int ret = INTERNAL_SYSCALL_CALL (sched_getaffinity, 0, sizeof (mask), mask);
+  if (INTERNAL_SYSCALL_ERROR_P (ret))
+    /* The mask is too small for the CPUs of the system.  Otherwise do
+       not run anything in parallel.  */
+    return INTERNAL_SYSCALL_ERRNO (ret) == EINVAL ? INT_MAX : 1;
+
+  int cpus = 0;
+  for (size_t i = 0; i < ret / sizeof (mask[0]); i++)
+    for (unsigned long int bits = mask[i]; bits != 0; bits &= bits - 1)
+      ++cpus;
+  return cpus;
+}
+
+/* Block while *WORD is VALUE, until _dl_helper_thread_wake is called
+   for WORD.  May return spuriously.  */
+static inline void
+_dl_helper_thread_wait (unsigned int *word, unsigned int value)
+{
+  lll_futex_wait (word, value, LLL_PRIVATE);
+}
+
+/* Wake all threads blocked on WORD.  */
+static inline void
+_dl_helper_thread_wake (unsigned int *word)
+{
+  lll_futex_wake (word, INT_MAX, LLL_PRIVATE);
+}
+
+#endif /* DL_HELPER_THREAD_H */
@@ -0,0 +1,110 @@
+/* CPU number lookup for threads without rseq.  Linux version.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+#ifndef _GETCPU_CACHE_H
+#define _GETCPU_CACHE_H
+
+#include <stdbool.h>
+#include <sysdep.h>
+#include <sysdep-vdso.h>
+#include <tls.h>
+
+/* When rseq registration fails (Android's seccomp policy blocks it), the
+   kernel does not maintain rseq_area.cpu_id and every CPU number lookup
+   would need getcpu, which is a real system call on targets without a
+   vDSO implementation.  Instead, each thread caches the last result and
+   serves up to __getcpu_cache_refresh further lookups from it before
+   querying again.  The result may thus be somewhat out of date, which
+   sched_getcpu already permits since the thread can migrate at any time;
+   changing the affinity of the calling thread drops the cached value.
+
+   The refresh interval is set by the glibc.pthread.getcpu_cache tunable.
+   Zero (the default) disables caching.  */
+extern unsigned int __getcpu_cache_refresh attribute_hidden;
+
+/* Return true if the glibc.pthread.getcpu_cache tunable enables the
+   cache.  */
+static inline bool
+__getcpu_cache_enabled (void)
+{
+  return __getcpu_cache_refresh != 0;
+}
+
+/* Ask the kernel for the CPU the calling thread runs on.  Return -1 on
+   failure.  */
+static inline int
+__getcpu_query (void)
+{
+  unsigned int cpu;
+  int r;
+#ifdef HAVE_GETCPU_VSYSCALL
+  r = INLINE_VSYSCALL (getcpu, 3, &cpu, NULL, NULL);
+#else
+  r = INLINE_SYSCALL_CALL (getcpu, &cpu, NULL, NULL);
+#endif
+  return r == -1 ? r : cpu;
+}
+
+/* Return the CPU the calling thread runs on, or -1 if unknown.  */
+static inline int
+__getcpu_cached (void)
+{
+  struct pthread *self = THREAD_SELF;
+  int cpu = THREAD_GETMEM_VOLATILE (self, rseq_area.cpu_id);
+  if (__glibc_likely (cpu >= 0))
+    return cpu;
+
+  unsigned int countdown = THREAD_GETMEM (self, getcpu_cache_countdown);
+  if (countdown > 0)
+    {
+      THREAD_SETMEM (self, getcpu_cache_countdown, countdown - 1);
+      return THREAD_GETMEM (self, getcpu_cache_cpu);
+    }
+
+  cpu = __getcpu_query ();
+  if (cpu >= 0)
+    {
+      THREAD_SETMEM (self, getcpu_cache_cpu, cpu);
+      THREAD_SETMEM (self, getcpu_cache_countdown, __getcpu_cache_refresh);
+    }
+  return cpu;
+}
+
+/* Return the CPU the calling thread runs on if it is known without
+   asking the kernel, or -1.  Unlike __getcpu_cached, this does not use
+   up a cached lookup.  */
+static inline int
+__getcpu_peek (void)
+{
+  struct pthread *self = THREAD_SELF;
+  int cpu = THREAD_GETMEM_VOLATILE (self, rseq_area.cpu_id);
+  if (__glibc_likely (cpu >= 0))
+    return cpu;
+  if (THREAD_GETMEM (self, getcpu_cache_countdown) > 0)
+    return THREAD_GETMEM (self, getcpu_cache_cpu);
+  return -1;
+}
+
+/* Drop the cached CPU number of the calling thread.  */
+static inline void
+__getcpu_cache_invalidate (void)
+{
+  THREAD_SETMEM (THREAD_SELF, getcpu_cache_countdown, 0);
+}
+
+#endif /* getcpu-cache.h */
@@ -0,0 +1,87 @@
+/* Malloc NUMA support.  Linux implementation.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License as
+   published by the Free Software Foundation; either version 2.1 of the
+   License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; see the file COPYING.LIB.  If
+   not, see <https://www.gnu.org/licenses/>.  */
+
+#include <fcntl.h>
+#include <limits.h>
+#include <malloc-numa.h>
+#include <not-cancel.h>
+#include <sysdep.h>
+#include <sysdep-vdso.h>
+
+/* Memory policy from <linux/mempolicy.h>.  */
+#define MPOL_PREFERRED 1
+
+int
+__malloc_numa_nodes (void)
+{
+  int fd = __open64_nocancel ("/sys/devices/system/node/possible", O_RDONLY);
+  if (fd == -1)
+    return 1;
+
+  char str[256];
+  ssize_t s = __read_nocancel (fd, str, sizeof (str));
+  __close_nocancel (fd);
+  if (s <= 0)
+    return 1;
+
+  /* The nodes are listed as ranges, such as 0-3 or 0,2-3.  The last
+     number is the highest node.  */
+  int last = 0;
+  for (ssize_t i = 0; i < s && str[i] != '\n'; i++)
+    {
+      if (str[i] >= '0' && str[i] <= '9')
+	last = last * 10 + str[i] - '0';
+      else
+	last = 0;
+      if (last >= MALLOC_NUMA_MAX_NODES)
+	return 1;
+    }
+  return last + 1;
+}
+
+int
+__malloc_numa_node (void)
+{
+  unsigned int cpu, node;
+  int r;
+#if IS_IN (libc) && defined HAVE_GETCPU_VSYSCALL
+  r = INLINE_VSYSCALL (getcpu, 3, &cpu, &node, NULL);
+#else
+  r = INTERNAL_SYSCALL_CALL (getcpu, &cpu, &node, NULL);
+  if (INTERNAL_SYSCALL_ERROR_P (r))
+    r = -1;
+#endif
+  return r == -1 ? -1 : node;
+}
+
+int
+__malloc_numa_bind (void *addr, size_t len, int node)
+{
+  if (node < 0 || node >= MALLOC_NUMA_MAX_NODES)
+    return -1;
+
+  unsigned long int mask[MALLOC_NUMA_MAX_NODES / ULONG_WIDTH] = { 0 };
+  mask[node / ULONG_WIDTH] = 1UL << (node % ULONG_WIDTH);
+
+  /* MPOL_PREFERRED rather than MPOL_BIND, so that the allocation falls
+     back to other nodes instead of failing when the node is full.  The
+     kernel expects the number of bits in the mask plus one.  */
+  int r = INTERNAL_SYSCALL_CALL (mbind, addr, len, MPOL_PREFERRED, mask,
+				 MALLOC_NUMA_MAX_NODES + 1, 0);
+  return INTERNAL_SYSCALL_ERROR_P (r) ? -1 : 0;
+}
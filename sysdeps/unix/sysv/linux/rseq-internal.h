@@ -34,11 +34,14 @@
 extern unsigned int _rseq_size attribute_hidden;
 extern ptrdiff_t _rseq_offset attribute_hidden;
 
-/* Android: rseq syscall is blocked by seccomp, always fail registration */
+/* Android: rseq syscall is blocked by seccomp, always fail registration.
+   CPU numbers come from the per-thread cache in getcpu-cache.h instead,
+   which starts out empty for every thread.  */
 static inline bool
 rseq_register_current_thread (struct pthread *self, bool do_rseq)
 {
   THREAD_SETMEM (self, rseq_area.cpu_id, RSEQ_CPU_ID_REGISTRATION_FAILED);
+  THREAD_SETMEM (self, getcpu_cache_countdown, 0);
   return false;
 }
 
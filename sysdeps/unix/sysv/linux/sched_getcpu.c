@@ -17,25 +17,13 @@
 
 #include <errno.h>
 #include <sched.h>
-#include <sysdep.h>
-#include <sysdep-vdso.h>
+#include <getcpu-cache.h>
 
-static int
-vsyscall_sched_getcpu (void)
-{
-  unsigned int cpu;
-  int r = -1;
-#ifdef HAVE_GETCPU_VSYSCALL
-  r = INLINE_VSYSCALL (getcpu, 3, &cpu, NULL, NULL);
-#else
-  r = INLINE_SYSCALL_CALL (getcpu, &cpu, NULL, NULL);
-#endif
-  return r == -1 ? r : cpu;
-}
+/* Set from the glibc.pthread.getcpu_cache tunable.  */
+unsigned int __getcpu_cache_refresh;
 
 int
 sched_getcpu (void)
 {
-  int cpu_id = THREAD_GETMEM_VOLATILE (THREAD_SELF, rseq_area.cpu_id);
-  return __glibc_likely (cpu_id >= 0) ? cpu_id : vsyscall_sched_getcpu ();
+  return __getcpu_cached ();
 }
@@ -22,6 +22,7 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <shlib-compat.h>
+#include <getcpu-cache.h>
 
 
 extern int __sched_setaffinity_new (pid_t, size_t, const cpu_set_t *);
@@ -32,6 +33,10 @@ __sched_setaffinity_new (pid_t pid, size_t cpusetsize, const cpu_set_t *cpuset)
 {
   int result = INLINE_SYSCALL (sched_setaffinity, 3, pid, cpusetsize, cpuset);
 
+  /* The calling thread may have to move to another CPU.  */
+  if (result == 0 && (pid == 0 || pid == THREAD_GETMEM (THREAD_SELF, tid)))
+    __getcpu_cache_invalidate ();
+
   return result;
 }
 libc_hidden_def (__sched_setaffinity_new)
@@ -9,24 +9,24 @@ int __shmctl64(int shmid, int cmd, struct __shmid64_ds *buf) {
 
 	if (cmd == IPC_RMID) {
 		DBG("%s: IPC_RMID for shmid=%x\n", __PRETTY_FUNCTION__, shmid);
-		pthread_mutex_lock(&mutex);
-		int idx = ashv_find_local_index(shmid);
-		if (idx == -1) {
+		shmem_t* seg = ashv_segment_get(shmid);
+		if (seg == NULL) {
 			DBG("%s: shmid=%x does not exist locally\n", __PRETTY_FUNCTION__, shmid);
 			/* We do not rm non-local regions, but do not report an error for that. */
-			pthread_mutex_unlock(&mutex);
 			return 0;
 		}
 
-		if (shmem[idx].addr) {
+		pthread_mutex_lock(&seg->lock);
+		if (seg->addr) {
 			// shmctl(2): The segment will actually be destroyed only
 			// after the last process detaches it (i.e., when the shm_nattch
 			// member of the associated structure shmid_ds is zero.
-			shmem[idx].markedForDeletion = true;
+			seg->markedForDeletion = true;
 		} else {
-			android_shmem_delete(idx);
+			android_shmem_delete(seg);
 		}
-		pthread_mutex_unlock(&mutex);
+		pthread_mutex_unlock(&seg->lock);
+		ashv_segment_put(seg);
 		return 0;
 	} else if (cmd == IPC_STAT) {
 		if (!buf) {
@@ -35,19 +35,17 @@ int __shmctl64(int shmid, int cmd, struct __shmid64_ds *buf) {
 			return -1;
 		}
 
-		pthread_mutex_lock(&mutex);
-		int idx = ashv_find_local_index(shmid);
-		if (idx == -1) {
+		shmem_t* seg = ashv_segment_get(shmid);
+		if (seg == NULL) {
 			DBG ("%s: ERROR: shmid %x does not exist\n", __PRETTY_FUNCTION__, shmid);
-			pthread_mutex_unlock (&mutex);
 			errno = EINVAL;
 			return -1;
 		}
 		/* Report max permissive mode */
 		memset(buf, 0, sizeof(struct shmid_ds));
-		buf->shm_segsz = shmem[idx].size;
+		buf->shm_segsz = seg->size;
 		buf->shm_nattch = 1;
-		buf->shm_perm.__key = shmem[idx].key;
+		buf->shm_perm.__key = seg->key;
 		buf->shm_perm.uid = geteuid();
 		buf->shm_perm.gid = getegid();
 		buf->shm_perm.cuid = geteuid();
@@ -55,7 +53,7 @@ int __shmctl64(int shmid, int cmd, struct __shmid64_ds *buf) {
 		buf->shm_perm.mode = 0666;
 		buf->shm_perm.__seq = 1;
 
-		pthread_mutex_unlock (&mutex);
+		ashv_segment_put(seg);
 		return 0;
 	}
 
@@ -1,6 +1,86 @@
 #include <shmem-android.h>
 #include <sys/msg.h>
 #include <stddef.h>
+#include <atomic.h>
+
+// Bind the socket that reserves our socket id and start the thread that
+// hands out segment descriptors to other processes.
+// Called with ashv_setup_mutex held.
+static int ashv_start_listener(void) {
+	int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sock < 0) {
+		DBG ("%s: cannot create UNIX socket: %s\n", __PRETTY_FUNCTION__, strerror(errno));
+		errno = EINVAL;
+		return -1;
+	}
+	int i;
+	for (i = 0; i < 4096; i++) {
+		struct sockaddr_un addr;
+		int len;
+		memset (&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		ashv_local_socket_id = (getpid() + i) & 0xffff;
+		sprintf(&addr.sun_path[1], ANDROID_SHMEM_SOCKNAME, ashv_local_socket_id);
+		len = sizeof(addr.sun_family) + strlen(&addr.sun_path[1]) + 1;
+		if (bind(sock, (struct sockaddr *)&addr, len) != 0) continue;
+		DBG("%s: bound UNIX socket %s in pid=%d\n", __PRETTY_FUNCTION__, addr.sun_path + 1, getpid());
+		break;
+	}
+	if (i == 4096) {
+		DBG("%s: cannot bind UNIX socket, bailing out\n", __PRETTY_FUNCTION__);
+		ashv_local_socket_id = 0;
+		close(sock);
+		errno = ENOMEM;
+		return -1;
+	}
+	if (listen(sock, 4) != 0) {
+		DBG("%s: listen failed\n", __PRETTY_FUNCTION__);
+		close(sock);
+		errno = ENOMEM;
+		return -1;
+	}
+	int* socket_arg = malloc(sizeof(int));
+	*socket_arg = sock;
+	pthread_create(&ashv_listening_thread_id, NULL, &ashv_thread_function, socket_arg);
+	atomic_store_release(&ashv_socket_bound, true);
+	return 0;
+}
+
+// Create and register a new segment of SIZE bytes for KEY.  Returns it
+// with a reference for the caller, or NULL.
+static shmem_t* ashv_create_segment(key_t key, size_t size) {
+	// Counter wrapping around at 15 bits.
+	static unsigned int shmem_counter = 0;
+
+	for (unsigned int i = 0; i <= 0x7fff; i++) {
+		unsigned int counter = (atomic_fetch_add_relaxed(&shmem_counter, 1) + 1) & 0x7fff;
+		int shmid = ashv_shmid_from_counter(counter);
+
+		int descriptor = ashv_create_region(shmid, key, size);
+		if (descriptor < 0) {
+			DBG("%s: ashv_create_region() failed for size %zu: %s\n", __PRETTY_FUNCTION__, size, strerror(errno));
+			return NULL;
+		}
+
+		shmem_t* seg = ashv_segment_new(shmid, descriptor, size, key);
+		if (seg == NULL) {
+			close(descriptor);
+			return NULL;
+		}
+
+		// The counter wrapped around onto a segment that still exists.
+		shmem_t* existing = ashv_segment_insert(seg);
+		if (existing == NULL) {
+			ashv_publish_segment(seg);
+			return seg;
+		}
+		ashv_segment_put(existing);
+		ashv_segment_put(seg);
+	}
+
+	errno = ENOSPC;
+	return NULL;
+}
 
 /* Return an identifier for an shared memory segment of at least size SIZE
    which is associated with KEY.  */
@@ -10,48 +90,17 @@ int shmget(key_t key, size_t size, int flags) {
 
 	ashv_check_pid();
 
-	// Counter wrapping around at 15 bits.
-	static size_t shmem_counter = 0;
-
-	if (!ashv_listening_thread_id) {
-		int sock = socket(AF_UNIX, SOCK_STREAM, 0);
-		if (!sock) {
-			DBG ("%s: cannot create UNIX socket: %s\n", __PRETTY_FUNCTION__, strerror(errno));
-			errno = EINVAL;
+	if (!atomic_load_acquire(&ashv_socket_bound)) {
+		pthread_mutex_lock(&ashv_setup_mutex);
+		int ret = ashv_socket_bound ? 0 : ashv_start_listener();
+		pthread_mutex_unlock(&ashv_setup_mutex);
+		if (ret != 0)
 			return -1;
-		}
-		int i;
-		for (i = 0; i < 4096; i++) {
-			struct sockaddr_un addr;
-			int len;
-			memset (&addr, 0, sizeof(addr));
-			addr.sun_family = AF_UNIX;
-			ashv_local_socket_id = (getpid() + i) & 0xffff;
-			sprintf(&addr.sun_path[1], ANDROID_SHMEM_SOCKNAME, ashv_local_socket_id);
-			len = sizeof(addr.sun_family) + strlen(&addr.sun_path[1]) + 1;
-			if (bind(sock, (struct sockaddr *)&addr, len) != 0) continue;
-			DBG("%s: bound UNIX socket %s in pid=%d\n", __PRETTY_FUNCTION__, addr.sun_path + 1, getpid());
-			break;
-		}
-		if (i == 4096) {
-			DBG("%s: cannot bind UNIX socket, bailing out\n", __PRETTY_FUNCTION__);
-			ashv_local_socket_id = 0;
-			errno = ENOMEM;
-			return -1;
-		}
-		if (listen(sock, 4) != 0) {
-			DBG("%s: listen failed\n", __PRETTY_FUNCTION__);
-			errno = ENOMEM;
-			return -1;
-		}
-		int* socket_arg = malloc(sizeof(int));
-		*socket_arg = sock;
-		pthread_create(&ashv_listening_thread_id, NULL, &ashv_thread_function, socket_arg);
 	}
 
-	int shmid = -1;
+	size = ROUND_UP(size, getpagesize());
 
-	pthread_mutex_lock(&mutex);
+	shmem_t* seg = NULL;
 	char symlink_path[256];
 	if (key != IPC_PRIVATE) {
 		// (1) Check if symlink exists telling us where to connect.
@@ -59,6 +108,10 @@ int shmget(key_t key, size_t size, int flags) {
 		// (3) If connected and opened, done. If connection refused
 		//     take ownership of the key and create the symlink.
 		// (4) If no symlink, create it.
+		//
+		// The segment is registered before the symlink is created, so
+		// that other threads which find the symlink also find the
+		// segment.
 		sprintf(symlink_path, ASHV_KEY_SYMLINK_PATH, key);
 		char path_buffer[256];
 		char num_buffer[64];
@@ -68,15 +121,15 @@ int shmget(key_t key, size_t size, int flags) {
 				path_buffer[path_length] = '\0';
 				int shmid = atoi(path_buffer);
 				if (shmid != 0) {
-					int idx = ashv_find_local_index(shmid);
-
-					if (idx == -1) {
-						idx = ashv_read_remote_segment(shmid);
-					}
-
-					if (idx != -1) {
-						pthread_mutex_unlock(&mutex);
-						return shmem[idx].id;
+					shmem_t* found = ashv_lookup_segment(shmid);
+					if (found != NULL) {
+						// Somebody else won the race for the key.
+						if (seg != NULL) {
+							android_shmem_delete(seg);
+							ashv_segment_put(seg);
+						}
+						ashv_segment_put(found);
+						return shmid;
 					}
 				}
 				// TODO: Not sure we should try to remove previous owner if e.g.
@@ -86,64 +139,21 @@ int shmget(key_t key, size_t size, int flags) {
 			}
 			// Take ownership.
 			// TODO: HAndle error (out of resouces, no infinite loop)
-			if (shmid == -1) {
-				shmem_counter = (shmem_counter + 1) & 0x7fff;
-				shmid = ashv_shmid_from_counter(shmem_counter);
-				sprintf(num_buffer, "%d", shmid);
+			if (seg == NULL) {
+				seg = ashv_create_segment(key, size);
+				if (seg == NULL)
+					return -1;
+				sprintf(num_buffer, "%d", seg->id);
 			}
 			if (symlink(num_buffer, symlink_path) == 0) break;
 		}
+	} else {
+		seg = ashv_create_segment(key, size);
+		if (seg == NULL)
+			return -1;
 	}
 
-
-	int idx = shmem_amount;
-	char buf[256];
-	sprintf(buf, ANDROID_SHMEM_SOCKNAME "-%d", ashv_local_socket_id, idx);
-
-	shmem_amount++;
-	if (shmid == -1) {
-		shmem_counter = (shmem_counter + 1) & 0x7fff;
-		shmid = ashv_shmid_from_counter(shmem_counter);
-	}
-
-	shmem = realloc(shmem, shmem_amount * sizeof(shmem_t));
-	size = ROUND_UP(size, getpagesize());
-	shmem[idx].size = size;
-	shmem[idx].descriptor = ashmem_create_region(buf, size);
-	shmem[idx].addr = NULL;
-	shmem[idx].id = shmid;
-	shmem[idx].markedForDeletion = false;
-	shmem[idx].key = key;
-
-	if (shmem[idx].descriptor < 0) {
-		DBG("%s: ashmem_create_region() failed for size %zu: %s\n", __PRETTY_FUNCTION__, size, strerror(errno));
-		shmem_amount --;
-		shmem = realloc(shmem, shmem_amount * sizeof(shmem_t));
-		pthread_mutex_unlock (&mutex);
-		return -1;
-	}
-	//DBG("%s: ID %d shmid %x FD %d size %zu\n", __PRETTY_FUNCTION__, idx, shmid, shmem[idx].descriptor, shmem[idx].size);
-	/*
-	status = ashmem_set_prot_region (shmem[idx].descriptor, 0666);
-	if (status < 0) {
-		//DBG ("%s: ashmem_set_prot_region() failed for size %zu: %s %d\n", __PRETTY_FUNCTION__, size, strerror(status), status);
-		shmem_amount --;
-		shmem = realloc (shmem, shmem_amount * sizeof(shmem_t));
-		pthread_mutex_unlock (&mutex);
-		return -1;
-	}
-	*/
-	/*
-	status = ashmem_pin_region (shmem[idx].descriptor, 0, shmem[idx].size);
-	if (status < 0) {
-		//DBG ("%s: ashmem_pin_region() failed for size %zu: %s %d\n", __PRETTY_FUNCTION__, size, strerror(status), status);
-		shmem_amount --;
-		shmem = realloc (shmem, shmem_amount * sizeof(shmem_t));
-		pthread_mutex_unlock (&mutex);
-		return -1;
-	}
-	*/
-	pthread_mutex_unlock(&mutex);
-
+	int shmid = seg->id;
+	ashv_segment_put(seg);
 	return shmid;
 }
@@ -0,0 +1,80 @@
+/* Test the per-thread CPU number cache used without rseq.
+   Copyright (C) 2024 Free Software Foundation, Inc.
+   This file is part of the GNU C Library.
+
+   The GNU C Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   The GNU C Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the GNU C Library; if not, see
+   <https://www.gnu.org/licenses/>.  */
+
+/* The test runs with a large glibc.pthread.getcpu_cache value, so the
+   cached CPU number would be stale after every migration below unless
+   changing the affinity drops it.  */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <support/check.h>
+#include <support/xthread.h>
+
+static void
+check_affinity (bool use_pthread)
+{
+  cpu_set_t initial;
+  TEST_COMPARE (sched_getaffinity (0, sizeof (initial), &initial), 0);
+
+  for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+      if (!CPU_ISSET (cpu, &initial))
+        continue;
+
+      cpu_set_t set;
+      CPU_ZERO (&set);
+      CPU_SET (cpu, &set);
+      if (use_pthread)
+        TEST_COMPARE (pthread_setaffinity_np (pthread_self (), sizeof (set),
+                                              &set), 0);
+      else
+        TEST_COMPARE (sched_setaffinity (0, sizeof (set), &set), 0);
+
+      /* Both the first lookup and lookups served from the cache must
+         report the new CPU.  */
+      for (int i = 0; i < 10; ++i)
+        TEST_COMPARE (sched_getcpu (), cpu);
+    }
+
+  TEST_COMPARE (sched_setaffinity (0, sizeof (initial), &initial), 0);
+}
+
+static void *
+thread_func (void *ignored)
+{
+  check_affinity (true);
+  return NULL;
+}
+
+static int
+do_test (void)
+{
+  puts ("info: checking main thread with sched_setaffinity");
+  check_affinity (false);
+
+  puts ("info: checking main thread with pthread_setaffinity_np");
+  check_affinity (true);
+
+  puts ("info: checking new thread");
+  xpthread_join (xpthread_create (NULL, thread_func, NULL));
+
+  return 0;
+}
+
+#include <support/test-driver.c>
@@ -1,5 +1,5 @@
 /* <shmem-android.{h,c}> - dependencies (values ​​and commands) for system V shared
- * memory emulation on Android using ashmem. Needed in the following files:
+ * memory emulation on Android using ashmem or memfds. Needed in the following files:
  * - shmat.c
  * - shmctl.c
  * - shmdt.c
@@ -13,10 +13,30 @@
  */
 
 #include <shmem-android.h>
-
-pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
-shmem_t* shmem = NULL;
-size_t shmem_amount = 0;
+#include <atomic.h>
+#include <signal.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* Segments are kept in a hash table by id, and attached segments also in
+ * a hash table by address.  Each bucket has its own lock and each segment
+ * its own lock for its attach state, so that operations on different
+ * segments do not serialize on a single mutex.  Segments are reference
+ * counted (see shmem_t) and destroyed when the last reference goes away.
+ */
+struct ashv_bucket {
+	pthread_mutex_t lock;
+	shmem_t* head;
+};
+
+static struct ashv_bucket ashv_segments[ASHV_HASH_SIZE];
+static struct ashv_bucket ashv_addrs[ASHV_HASH_SIZE];
+// Registered segments of other processes.
+static unsigned int ashv_remote_count = 0;
+
+pthread_mutex_t ashv_setup_mutex = PTHREAD_MUTEX_INITIALIZER;
+bool ashv_socket_bound = false;
 int ashv_local_socket_id = 0;
 int ashv_pid_setup = 0;
 pthread_t ashv_listening_thread_id = 0;
@@ -82,7 +102,15 @@ static int ancil_recv_fd(int sock) {
 static int ashmem_get_size_region(int fd) {
 	//int ret = __ashmem_is_ashmem(fd, 1);
 	//if (ret < 0) return ret;
-	return TEMP_FAILURE_RETRY(ioctl(fd, ASHMEM_GET_SIZE, NULL));
+	int size = TEMP_FAILURE_RETRY(ioctl(fd, ASHMEM_GET_SIZE, NULL));
+	if (size < 0) {
+		// Not ashmem, but a (sealed) memfd.
+		struct stat64 st;
+		if (fstat64(fd, &st) != 0)
+			return -1;
+		size = st.st_size;
+	}
+	return size;
 }
 
 /*
@@ -114,24 +142,386 @@ error:
 	return ret;
 }
 
+static void ashv_buckets_init(struct ashv_bucket* buckets) {
+	for (size_t i = 0; i < ASHV_HASH_SIZE; i++) {
+		pthread_mutex_init(&buckets[i].lock, NULL);
+		buckets[i].head = NULL;
+	}
+}
+
+/*
+ * Newer Android versions restrict /dev/ashmem, so segments are memfds
+ * when /dev/ashmem cannot be opened.  Where ashmem works it is still
+ * used, since processes running libandroid-shmem or an older libc expect
+ * ashmem descriptors.  A memfd can be reopened by other processes of the
+ * same user through /proc/PID/fd/FD, which is published as a symlink in
+ * ASHV_SEGMENT_DIR, so that other processes of this libc attach without
+ * a round trip to our listener thread.  The size is sealed, so that the
+ * attaching side can trust fstat.
+ *
+ * The listener thread runs with either backend: it serves processes
+ * which do not know about ASHV_SEGMENT_DIR, and segments whose symlink
+ * could not be created.
+ */
+static int ashv_backend = ASHV_BACKEND_UNKNOWN;
+
+int ashv_shm_backend(void) {
+	int backend = atomic_load_relaxed(&ashv_backend);
+	if (backend == ASHV_BACKEND_UNKNOWN) {
+		int fd = open("/dev/ashmem", O_RDWR | O_CLOEXEC);
+		if (fd < 0)
+			fd = memfd_create("ashv-probe", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+		else
+			backend = ASHV_BACKEND_ASHMEM;
+		if (fd >= 0) {
+			close(fd);
+			if (backend == ASHV_BACKEND_UNKNOWN) {
+				DBG("%s: /dev/ashmem unavailable, using memfds\n", __PRETTY_FUNCTION__);
+				backend = ASHV_BACKEND_MEMFD;
+			}
+		} else {
+			DBG("%s: memfd_create failed, using ashmem: %s\n", __PRETTY_FUNCTION__, strerror(errno));
+			backend = ASHV_BACKEND_ASHMEM;
+		}
+		atomic_store_relaxed(&ashv_backend, backend);
+	}
+	return backend;
+}
+
+static int ashv_memfd_create_region(int shmid, key_t key, size_t size) {
+	char name[64];
+	sprintf(name, ASHV_MEMFD_NAME, shmid, key);
+	int fd = memfd_create(name, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (fd < 0) return fd;
+
+	if (ftruncate(fd, size) != 0
+	    || fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) != 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+int ashv_create_region(int shmid, key_t key, size_t size) {
+	if (ashv_shm_backend() == ASHV_BACKEND_MEMFD)
+		return ashv_memfd_create_region(shmid, key, size);
+
+	char name[256];
+	sprintf(name, ANDROID_SHMEM_SOCKNAME "-%d", ashv_local_socket_id, shmid & 0xffff);
+	return ashmem_create_region(name, size);
+}
+
+void ashv_publish_segment(shmem_t* seg) {
+	char path[64];
+	char target[64];
+	sprintf(path, ASHV_SEGMENT_PATH, seg->id);
+	sprintf(target, "/proc/%d/fd/%d", ashv_pid_setup, seg->descriptor);
+
+	mkdir(ASHV_SEGMENT_DIR, 0700);
+	for (int i = 0; i < 2; i++) {
+		if (symlink(target, path) == 0) {
+			seg->published = true;
+			return;
+		}
+		if (errno != EEXIST)
+			break;
+		// Socket ids, and thus shmids, are unique among live processes,
+		// so this was left behind by a process that has exited.
+		unlink(path);
+	}
+	DBG("%s: cannot publish shmid %x: %s\n", __PRETTY_FUNCTION__, seg->id, strerror(errno));
+}
+
+// Look up the symlink under which the segment shmid is published.
+static bool ashv_published_lstat(int shmid, struct stat64* st) {
+	char path[64];
+	sprintf(path, ASHV_SEGMENT_PATH, shmid);
+	return lstat64(path, st) == 0;
+}
+
+// Remember the symlink found by ashv_published_lstat, which was taken
+// before the descriptor was obtained: if the symlink was replaced in
+// between, the segment only fails validation too early.
+static void ashv_segment_set_link(shmem_t* seg, const struct stat64* st) {
+	seg->link_seen = true;
+	seg->link_dev = st->st_dev;
+	seg->link_ino = st->st_ino;
+	seg->link_ctime = st->st_ctim;
+}
+
+shmem_t* ashv_open_published_segment(int shmid) {
+	char path[64];
+	char target[64];
+	struct stat64 link;
+	if (!ashv_published_lstat(shmid, &link))
+		return NULL;
+	sprintf(path, ASHV_SEGMENT_PATH, shmid);
+	ssize_t len = readlink(path, target, sizeof(target) - 1);
+	if (len < 0)
+		return NULL;
+	target[len] = '\0';
+
+	pid_t owner;
+	int owner_fd;
+	if (sscanf(target, "/proc/%d/fd/%d", &owner, &owner_fd) != 2)
+		return NULL;
+
+	// Segments of processes using ashmem cannot be reopened, they are
+	// fetched from the owner's listener thread instead.
+	char name[128];
+	len = readlink(target, name, sizeof(name) - 1);
+	if (len < 0 || strncmp(name, "/memfd:", strlen("/memfd:")) != 0)
+		return NULL;
+
+	int descriptor = open(target, O_RDWR | O_CLOEXEC);
+	if (descriptor < 0) {
+		DBG("%s: cannot open %s for shmid %x: %s\n", __PRETTY_FUNCTION__, target, shmid, strerror(errno));
+		return NULL;
+	}
+
+	// The owner may have closed the segment and reused the descriptor, so
+	// check that this is the memfd of the segment.
+	char self[64];
+	sprintf(self, "/proc/self/fd/%d", descriptor);
+	len = readlink(self, name, sizeof(name) - 1);
+	if (len >= 0)
+		name[len] = '\0';
+	unsigned int id;
+	key_t key;
+	struct stat64 st;
+	if (len < 0
+	    || sscanf(name, "/memfd:" ASHV_MEMFD_NAME, &id, &key) != 2
+	    || (int) id != shmid
+	    || fstat64(descriptor, &st) != 0) {
+		close(descriptor);
+		return NULL;
+	}
+
+	shmem_t* seg = ashv_segment_new(shmid, descriptor, st.st_size, key);
+	if (seg == NULL) {
+		close(descriptor);
+		return NULL;
+	}
+	seg->remote = true;
+	seg->owner = owner;
+	ashv_segment_set_link(seg, &link);
+
+	shmem_t* existing = ashv_segment_insert(seg);
+	if (existing != NULL) {
+		ashv_segment_put(seg);
+		return existing;
+	}
+	return seg;
+}
+
 void ashv_check_pid(void) {
 	pid_t mypid = getpid();
+	// Pairs with the release stores below, so that the tables are set up.
+	pid_t setup = atomic_load_acquire(&ashv_pid_setup);
+	if (setup == mypid)
+		return;
+
+	// After a fork the lock may have been held by another thread of the
+	// parent.
+	if (setup != 0)
+		pthread_mutex_init(&ashv_setup_mutex, NULL);
+	pthread_mutex_lock(&ashv_setup_mutex);
 	if (ashv_pid_setup == 0) {
-		ashv_pid_setup = mypid;
+		ashv_buckets_init(ashv_segments);
+		ashv_buckets_init(ashv_addrs);
+		atomic_store_release(&ashv_pid_setup, mypid);
 	} else if (ashv_pid_setup != mypid) {
 		DBG("%s: Cleaning to new pid=%d from oldpid=%d\n", __PRETTY_FUNCTION__, mypid, ashv_pid_setup);
-		// We inherited old state across a fork.
-		ashv_pid_setup = mypid;
+		// We inherited old state across a fork.  Locks may have been held
+		// by other threads of the parent, so start over.
 		ashv_local_socket_id = 0;
+		ashv_socket_bound = false;
 		ashv_listening_thread_id = 0;
-		shmem_amount = 0;
-		// Unlock if fork left us with held lock from parent thread.
-		pthread_mutex_unlock(&mutex);
-		if (shmem != NULL) free(shmem);
-		shmem = NULL;
+		ashv_remote_count = 0;
+		for (size_t i = 0; i < ASHV_HASH_SIZE; i++) {
+			shmem_t* seg = ashv_segments[i].head;
+			while (seg != NULL) {
+				shmem_t* next = seg->next;
+				free(seg);
+				seg = next;
+			}
+		}
+		ashv_buckets_init(ashv_segments);
+		ashv_buckets_init(ashv_addrs);
+		atomic_store_release(&ashv_pid_setup, mypid);
 	}
+	pthread_mutex_unlock(&ashv_setup_mutex);
 }
 
+static struct ashv_bucket* ashv_segment_bucket(int shmid) {
+	unsigned int h = (unsigned int) shmid;
+	return &ashv_segments[(h ^ (h >> 16)) % ASHV_HASH_SIZE];
+}
+
+static struct ashv_bucket* ashv_addr_bucket(const void* addr) {
+	return &ashv_addrs[((uintptr_t) addr / getpagesize()) % ASHV_HASH_SIZE];
+}
+
+shmem_t* ashv_segment_new(int shmid, int descriptor, size_t size, key_t key) {
+	shmem_t* seg = calloc(1, sizeof(shmem_t));
+	if (seg == NULL)
+		return NULL;
+	pthread_mutex_init(&seg->lock, NULL);
+	seg->refcount = 1;
+	seg->id = shmid;
+	seg->descriptor = descriptor;
+	seg->size = size;
+	seg->key = key;
+	return seg;
+}
+
+static void ashv_segment_ref(shmem_t* seg) {
+	atomic_fetch_add_relaxed(&seg->refcount, 1);
+}
+
+void ashv_segment_put(shmem_t* seg) {
+	if (atomic_fetch_add_acq_rel(&seg->refcount, -1) != 1)
+		return;
+	if (seg->descriptor) close(seg->descriptor);
+	free(seg);
+}
+
+shmem_t* ashv_segment_insert(shmem_t* seg) {
+	struct ashv_bucket* b = ashv_segment_bucket(seg->id);
+	pthread_mutex_lock(&b->lock);
+	for (shmem_t* s = b->head; s != NULL; s = s->next)
+		if (s->id == seg->id) {
+			ashv_segment_ref(s);
+			pthread_mutex_unlock(&b->lock);
+			return s;
+		}
+	ashv_segment_ref(seg);
+	seg->linked = true;
+	seg->next = b->head;
+	b->head = seg;
+	if (seg->remote)
+		atomic_fetch_add_relaxed(&ashv_remote_count, 1);
+	pthread_mutex_unlock(&b->lock);
+	return NULL;
+}
+
+shmem_t* ashv_segment_get(int shmid) {
+	struct ashv_bucket* b = ashv_segment_bucket(shmid);
+	pthread_mutex_lock(&b->lock);
+	shmem_t* s = b->head;
+	while (s != NULL && s->id != shmid)
+		s = s->next;
+	if (s != NULL)
+		ashv_segment_ref(s);
+	pthread_mutex_unlock(&b->lock);
+	return s;
+}
+
+void android_shmem_delete(shmem_t* seg) {
+	struct ashv_bucket* b = ashv_segment_bucket(seg->id);
+	pthread_mutex_lock(&b->lock);
+	if (!seg->linked) {
+		pthread_mutex_unlock(&b->lock);
+		return;
+	}
+	shmem_t** p = &b->head;
+	while (*p != seg)
+		p = &(*p)->next;
+	*p = seg->next;
+	seg->linked = false;
+	if (seg->remote)
+		atomic_fetch_add_relaxed(&ashv_remote_count, -1);
+	pthread_mutex_unlock(&b->lock);
+	if (seg->published) {
+		char path[64];
+		sprintf(path, ASHV_SEGMENT_PATH, seg->id);
+		unlink(path);
+	}
+	ashv_segment_put(seg);
+}
+
+void ashv_addr_insert(shmem_t* seg) {
+	struct ashv_bucket* b = ashv_addr_bucket(seg->addr);
+	ashv_segment_ref(seg);
+	pthread_mutex_lock(&b->lock);
+	seg->addr_next = b->head;
+	b->head = seg;
+	pthread_mutex_unlock(&b->lock);
+}
+
+shmem_t* ashv_addr_get(const void* addr) {
+	struct ashv_bucket* b = ashv_addr_bucket(addr);
+	pthread_mutex_lock(&b->lock);
+	shmem_t* s = b->head;
+	while (s != NULL && s->addr != addr)
+		s = s->addr_next;
+	if (s != NULL)
+		ashv_segment_ref(s);
+	pthread_mutex_unlock(&b->lock);
+	return s;
+}
+
+void ashv_addr_remove(shmem_t* seg) {
+	struct ashv_bucket* b = ashv_addr_bucket(seg->addr);
+	pthread_mutex_lock(&b->lock);
+	shmem_t** p = &b->head;
+	while (*p != NULL && *p != seg)
+		p = &(*p)->addr_next;
+	bool found = *p != NULL;
+	if (found)
+		*p = seg->addr_next;
+	pthread_mutex_unlock(&b->lock);
+	if (found)
+		ashv_segment_put(seg);
+}
+
+bool ashv_remote_cache_keep(shmem_t* seg) {
+	return seg->remote && seg->link_seen && !seg->markedForDeletion
+		&& atomic_load_relaxed(&ashv_remote_count) <= ASHV_REMOTE_CACHE_MAX;
+}
+
+// Check that a registered segment of another process still is what its
+// owner calls shmid.  The owner may have removed it, and once its 15-bit
+// counter wraps around, or a new owner takes over its socket id, the same
+// shmid names a different segment.  Both replace the symlink under which
+// the segment was published.  Segments of owners that do not publish
+// them are not kept after shmdt, so they are only looked up here while
+// attached, and only the owner's exit is detected.
+static bool ashv_remote_valid(shmem_t* seg) {
+	if (!seg->link_seen)
+		return kill(seg->owner, 0) == 0 || errno != ESRCH;
+
+	struct stat64 st;
+	return ashv_published_lstat(seg->id, &st)
+		&& st.st_dev == seg->link_dev
+		&& st.st_ino == seg->link_ino
+		&& st.st_ctim.tv_sec == seg->link_ctime.tv_sec
+		&& st.st_ctim.tv_nsec == seg->link_ctime.tv_nsec;
+}
+
+shmem_t* ashv_lookup_segment(int shmid) {
+	shmem_t* seg = ashv_segment_get(shmid);
+	if (seg != NULL && seg->remote) {
+		// Revalidated on every lookup, so that shmat never maps a removed
+		// or reused shmid.  A stale segment that is still attached stays
+		// in the address table until shmdt.
+		pthread_mutex_lock(&seg->lock);
+		bool stale = !ashv_remote_valid(seg);
+		if (stale)
+			android_shmem_delete(seg);
+		pthread_mutex_unlock(&seg->lock);
+		if (stale) {
+			ashv_segment_put(seg);
+			seg = NULL;
+		}
+	}
+	if (seg == NULL && ashv_socket_id_from_shmid(shmid) != ashv_local_socket_id) {
+		seg = ashv_open_published_segment(shmid);
+		if (seg == NULL)
+			seg = ashv_read_remote_segment(shmid);
+	}
+	return seg;
+}
 
 // Store index in the lower 15 bits and the socket id in the
 // higher 16 bits.
@@ -143,13 +533,6 @@ int ashv_socket_id_from_shmid(int shmid) {
 	return shmid / 0x10000;
 }
 
-int ashv_find_local_index(int shmid) {
-	for (size_t i = 0; i < shmem_amount; i++)
-		if (shmem[i].id == shmid)
-			return i;
-	return -1;
-}
-
 void* ashv_thread_function(void* arg) {
 	int sock = *(int*)arg;
 	free(arg);
@@ -164,19 +547,18 @@ void* ashv_thread_function(void* arg) {
 			close(sendsock);
 			continue;
 		}
-		pthread_mutex_lock(&mutex);
-		int idx = ashv_find_local_index(shmid);
-		if (idx != -1) {
-			if (write(sendsock, &shmem[idx].key, sizeof(key_t)) != sizeof(key_t)) {
+		shmem_t* seg = ashv_segment_get(shmid);
+		if (seg != NULL) {
+			if (write(sendsock, &seg->key, sizeof(key_t)) != sizeof(key_t)) {
 				DBG("%s: ERROR: write failed: %s\n", __PRETTY_FUNCTION__, strerror(errno));
 			}
-			if (ancil_send_fd(sendsock, shmem[idx].descriptor) != 0) {
+			if (ancil_send_fd(sendsock, seg->descriptor) != 0) {
 				DBG("%s: ERROR: ancil_send_fd() failed: %s\n", __PRETTY_FUNCTION__, strerror(errno));
 			}
+			ashv_segment_put(seg);
 		} else {
 			DBG("%s: ERROR: cannot find shmid 0x%x\n", __PRETTY_FUNCTION__, shmid);
 		}
-		pthread_mutex_unlock(&mutex);
 		close(sendsock);
 		len = sizeof(addr);
 	}
@@ -184,13 +566,11 @@ void* ashv_thread_function(void* arg) {
 	return NULL;
 }
 
-void android_shmem_delete(int idx) {
-	if (shmem[idx].descriptor) close(shmem[idx].descriptor);
-	shmem_amount--;
-	memmove(&shmem[idx], &shmem[idx+1], (shmem_amount - idx) * sizeof(shmem_t));
-}
+shmem_t* ashv_read_remote_segment(int shmid) {
+	// Owners publish ashmem segments as well, for validation.
+	struct stat64 link;
+	bool link_seen = ashv_published_lstat(shmid, &link);
 
-int ashv_read_remote_segment(int shmid) {
 	struct sockaddr_un addr;
 	memset(&addr, 0, sizeof(addr));
 	addr.sun_family = AF_UNIX;
@@ -200,49 +580,81 @@ int ashv_read_remote_segment(int shmid) {
 	int recvsock = socket(AF_UNIX, SOCK_STREAM, 0);
 	if (recvsock == -1) {
 		DBG ("%s: cannot create UNIX socket: %s\n", __PRETTY_FUNCTION__, strerror(errno));
-		return -1;
+		return NULL;
 	}
 	if (connect(recvsock, (struct sockaddr*) &addr, addrlen) != 0) {
 		DBG("%s: Cannot connect to UNIX socket %s: %s, len %d\n", __PRETTY_FUNCTION__, addr.sun_path + 1, strerror(errno), addrlen);
 		close(recvsock);
-		return -1;
+		return NULL;
 	}
 
 	if (send(recvsock, &shmid, sizeof(shmid), 0) != sizeof(shmid)) {
 		DBG ("%s: send() failed on socket %s: %s\n", __PRETTY_FUNCTION__, addr.sun_path + 1, strerror(errno));
 		close(recvsock);
-		return -1;
+		return NULL;
+	}
+
+	struct ucred cred;
+	socklen_t cred_len = sizeof(cred);
+	if (getsockopt(recvsock, SOL_SOCKET, SO_PEERCRED, &cred, &cred_len) != 0) {
+		DBG("%s: ERROR: getsockopt(SO_PEERCRED) failed on socket %s: %s\n", __PRETTY_FUNCTION__, addr.sun_path + 1, strerror(errno));
+		close(recvsock);
+		return NULL;
+	}
+
+	// The symlink may be left over from an exited process, if the owner
+	// does not publish its segments.
+	if (link_seen) {
+		char path[64];
+		char target[64];
+		pid_t owner;
+		int owner_fd;
+		sprintf(path, ASHV_SEGMENT_PATH, shmid);
+		ssize_t len = readlink(path, target, sizeof(target) - 1);
+		if (len >= 0)
+			target[len] = '\0';
+		link_seen = len >= 0
+			&& sscanf(target, "/proc/%d/fd/%d", &owner, &owner_fd) == 2
+			&& owner == cred.pid;
 	}
 
 	key_t key;
 	if (read(recvsock, &key, sizeof(key_t)) != sizeof(key_t)) {
 		DBG("%s: ERROR: failed read\n", __PRETTY_FUNCTION__);
 		close(recvsock);
-		return -1;
+		return NULL;
 	}
 
 	int descriptor = ancil_recv_fd(recvsock);
 	if (descriptor < 0) {
 		DBG("%s: ERROR: ancil_recv_fd() failed on socket %s: %s\n", __PRETTY_FUNCTION__, addr.sun_path + 1, strerror(errno));
 		close(recvsock);
-		return -1;
+		return NULL;
 	}
 	close(recvsock);
 
 	int size = ashmem_get_size_region(descriptor);
 	if (size == 0 || size == -1) {
 		DBG ("%s: ERROR: ashmem_get_size_region() returned %d on socket %s: %s\n", __PRETTY_FUNCTION__, size, addr.sun_path + 1, strerror(errno));
-		return -1;
+		close(descriptor);
+		return NULL;
 	}
 
-	int idx = shmem_amount;
-	shmem_amount ++;
-	shmem = realloc(shmem, shmem_amount * sizeof(shmem_t));
-	shmem[idx].id = shmid;
-	shmem[idx].descriptor = descriptor;
-	shmem[idx].size = size;
-	shmem[idx].addr = NULL;
-	shmem[idx].markedForDeletion = false;
-	shmem[idx].key = key;
-	return idx;
+	shmem_t* seg = ashv_segment_new(shmid, descriptor, size, key);
+	if (seg == NULL) {
+		close(descriptor);
+		return NULL;
+	}
+	seg->remote = true;
+	seg->owner = cred.pid;
+	if (link_seen)
+		ashv_segment_set_link(seg, &link);
+
+	// Another thread may have fetched the same segment meanwhile.
+	shmem_t* existing = ashv_segment_insert(seg);
+	if (existing != NULL) {
+		ashv_segment_put(seg);
+		return existing;
+	}
+	return seg;
 }
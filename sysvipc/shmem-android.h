@@ -14,6 +14,7 @@
 #include <ipc_priv.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <stdbool.h>
 
 #ifdef ENABLE_DEBUG_SHMEM_ANDROID
 # define DBG(...) printf(__VA_ARGS__)
@@ -28,21 +29,68 @@
 #define ASHMEM_SET_NAME _IOW(__ASHMEMIOC, 1, char[ASHMEM_NAME_LEN])
 
 #define ASHV_KEY_SYMLINK_PATH _PATH_TMP "ashv_key_%d"
+// Segments are published as symlinks to /proc/PID/fd/FD in this
+// directory, named after their shmid.  Memfds are reopened through them,
+// and they tell other processes whether a shmid still names the segment
+// they have cached.
+#define ASHV_SEGMENT_DIR _PATH_TMP "ashv_seg"
+#define ASHV_SEGMENT_PATH ASHV_SEGMENT_DIR "/%x"
+// Name of the memfd of a segment, with its shmid and key.
+#define ASHV_MEMFD_NAME "ashv:%x:%d"
 #define ANDROID_SHMEM_SOCKNAME "/dev/shm/%08x"
 #define ROUND_UP(N, S) ((((N) + (S) - 1) / (S)) * (S))
 
-typedef struct {
+// How segments are created, see ashv_shm_backend.
+enum {
+	ASHV_BACKEND_UNKNOWN,
+	ASHV_BACKEND_ASHMEM,
+	ASHV_BACKEND_MEMFD
+};
+
+// Number of buckets of the segment registry and of the address table.
+#define ASHV_HASH_SIZE 256
+// Number of segments of other processes whose descriptors are kept after
+// they are detached, so that attaching them again needs no connection to
+// the owner.
+#define ASHV_REMOTE_CACHE_MAX 64
+
+typedef struct shmem {
+	// Chains in the registry (by id) and in the address table.
+	struct shmem *next;
+	struct shmem *addr_next;
+	// Protects addr and markedForDeletion.  Taken before the bucket
+	// locks of the address table.
+	pthread_mutex_t lock;
+	// One reference is owned by the registry while the segment is
+	// linked, one by the address table while it is attached, and one by
+	// every caller of ashv_segment_get until ashv_segment_put.
+	unsigned int refcount;
+	bool linked;
+	// The segment belongs to another process, which is still alive if
+	// kill(owner, 0) succeeds.
+	bool remote;
+	pid_t owner;
+	// For remote segments, the symlink in ASHV_SEGMENT_DIR under which
+	// the owner published the segment when we opened it.  The owner
+	// removes it with the segment, and a new segment with the same id
+	// gets a new symlink, so the segment is only valid while lstat still
+	// finds the same one.
+	bool link_seen;
+	dev_t link_dev;
+	ino64_t link_ino;
+	struct timespec link_ctime;
 	int id;
 	void *addr;
 	int descriptor;
 	size_t size;
 	bool markedForDeletion;
+	// The segment has a symlink in ASHV_SEGMENT_DIR.
+	bool published;
 	key_t key;
 } shmem_t;
 
-extern pthread_mutex_t mutex;
-extern shmem_t* shmem;
-extern size_t shmem_amount;
+extern pthread_mutex_t ashv_setup_mutex;
+extern bool ashv_socket_bound;
 extern int ashv_local_socket_id;
 extern int ashv_pid_setup;
 extern pthread_t ashv_listening_thread_id;
@@ -61,6 +109,19 @@ extern pthread_t ashv_listening_thread_id;
 extern int ashmem_create_region(char const* name, size_t size) __THROW;
 libc_hidden_proto(ashmem_create_region)
 
+extern int ashv_shm_backend(void) __THROW;
+libc_hidden_proto(ashv_shm_backend)
+
+// Create the memory of a new segment with the current backend.
+extern int ashv_create_region(int shmid, key_t key, size_t size) __THROW;
+libc_hidden_proto(ashv_create_region)
+
+extern void ashv_publish_segment(shmem_t* seg) __THROW;
+libc_hidden_proto(ashv_publish_segment)
+
+extern shmem_t* ashv_open_published_segment(int shmid) __THROW;
+libc_hidden_proto(ashv_open_published_segment)
+
 extern void ashv_check_pid(void) __THROW;
 libc_hidden_proto(ashv_check_pid)
 
@@ -70,16 +131,55 @@ libc_hidden_proto(ashv_shmid_from_counter)
 extern int ashv_socket_id_from_shmid(int shmid) __THROW;
 libc_hidden_proto(ashv_socket_id_from_shmid)
 
-extern int ashv_find_local_index(int shmid) __THROW;
-libc_hidden_proto(ashv_find_local_index)
+// Allocate a segment that is not yet registered.  The caller owns the
+// only reference.
+extern shmem_t* ashv_segment_new(int shmid, int descriptor, size_t size, key_t key) __THROW;
+libc_hidden_proto(ashv_segment_new)
+
+// Register seg.  If a segment with the same id is already registered,
+// return it with a new reference and leave seg alone; otherwise return
+// NULL.
+extern shmem_t* ashv_segment_insert(shmem_t* seg) __THROW;
+libc_hidden_proto(ashv_segment_insert)
+
+// Return the registered segment shmid with a new reference, or NULL.
+extern shmem_t* ashv_segment_get(int shmid) __THROW;
+libc_hidden_proto(ashv_segment_get)
+
+extern void ashv_segment_put(shmem_t* seg) __THROW;
+libc_hidden_proto(ashv_segment_put)
+
+// Like ashv_segment_get, but also open segments of other processes, from
+// ASHV_SEGMENT_DIR or from their owner's listener thread.  Cached segments
+// which their owner has removed, or whose owner has exited, are dropped.
+extern shmem_t* ashv_lookup_segment(int shmid) __THROW;
+libc_hidden_proto(ashv_lookup_segment)
+
+// Add the attached seg to the address table; seg->lock must be held.
+extern void ashv_addr_insert(shmem_t* seg) __THROW;
+libc_hidden_proto(ashv_addr_insert)
+
+// Return the segment attached at addr with a new reference, or NULL.
+extern shmem_t* ashv_addr_get(const void* addr) __THROW;
+libc_hidden_proto(ashv_addr_get)
+
+// Remove seg from the address table; seg->lock must be held.
+extern void ashv_addr_remove(shmem_t* seg) __THROW;
+libc_hidden_proto(ashv_addr_remove)
+
+// Return true if the detached remote segment seg may stay cached.  Only
+// segments that can be revalidated through their symlink are kept.
+extern bool ashv_remote_cache_keep(shmem_t* seg) __THROW;
+libc_hidden_proto(ashv_remote_cache_keep)
 
 extern void* ashv_thread_function(void* arg) __THROW;
 libc_hidden_proto(ashv_thread_function)
 
-extern void android_shmem_delete(int idx) __THROW;
+// Unregister seg.  It is destroyed once the last reference is dropped.
+extern void android_shmem_delete(shmem_t* seg) __THROW;
 libc_hidden_proto(android_shmem_delete)
 
-extern int ashv_read_remote_segment(int shmid) __THROW;
+extern shmem_t* ashv_read_remote_segment(int shmid) __THROW;
 libc_hidden_proto(ashv_read_remote_segment)
 
 #endif /* __SHMEM_ANDROID */